@@ -0,0 +1,448 @@
+#include "AsyncHnS.hh"
+
+#include <HnS.hh>
+#include <PhotoHnS/PhotoHnS.hh>
+#include <Registry/Registry.hh>
+#include <SegmentHnS/SegmentHnS.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <memory>
+
+namespace Yps
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        double since(Clock::time_point start)
+        {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        /**
+         * State of one request, shared by its stages (the chain owns it, no thread waits on it)
+         */
+        template <typename Result, typename Callback>
+        struct Request
+        {
+            Result result;
+            Callback done;
+            EmbedOptions options;
+            std::string path;
+            Clock::time_point stage_start{Clock::now()};
+            bool finished{false};
+
+            void finish()
+            {
+                this->finished = true;
+                this->done(std::move(this->result));
+            }
+        };
+
+        using EmbedRequest = Request<AsyncEmbedResult, AsyncHnS::EmbedCallback>;
+        using ExtractRequest = Request<AsyncExtractResult, AsyncHnS::ExtractCallback>;
+        using ProbeRequest = Request<AsyncProbeResult, AsyncHnS::ProbeCallback>;
+        using RecordsRequest = Request<AsyncRecordsResult, AsyncHnS::RecordsCallback>;
+
+        void set_error(AsyncEmbedResult& result, std::string error) { result.error = std::move(error); }
+        void set_error(AsyncExtractResult& result, std::string error) { result.error = std::move(error); }
+        void set_error(AsyncProbeResult& result, std::string error) { result.report.error = std::move(error); }
+        void set_error(AsyncRecordsResult& result, std::string error) { result.error = std::move(error); }
+
+        void store(AsyncEmbedResult& result, const std::optional<std::string>& output) { result.ok = output.has_value(); }
+        void store(AsyncExtractResult& result, std::optional<std::vector<byte>> data) { result.data = std::move(data); }
+        void store(AsyncRecordsResult& result, std::optional<std::vector<RecordEntry>> records)
+        { result.records = std::move(records); }
+
+        /**
+         * Run CPU stage on the pool; an exception fails the request instead of losing its callback
+         */
+        template <typename R, typename Stage>
+        void run_cpu(ThreadPool& cpu, const std::shared_ptr<R>& request, Stage stage)
+        {
+            cpu.submit([request, stage = std::move(stage)]() mutable {
+                request->stage_start = Clock::now();
+                try {
+                    stage();
+                } catch (const std::exception& e) {
+                    if (request->finished)
+                        throw;  // Thrown by the callback itself
+                    request->result.times.cpu = since(request->stage_start);
+                    set_error(request->result, std::string("exception: ") + e.what());
+                    request->finish();
+                }
+            });
+        }
+
+        /**
+         * Queue output write; its completion fulfils the request
+         */
+        void write_output(AsyncIO& io, const std::shared_ptr<EmbedRequest>& request, std::vector<byte> output)
+        {
+            request->stage_start = Clock::now();
+            io.write(request->result.output, std::move(output), [request](bool ok) {
+                request->result.times.write = since(request->stage_start);
+                request->result.ok = ok;
+                if (!ok)
+                    request->result.error = "write failed";
+                request->finish();
+            });
+        }
+
+        /**
+         * Error for a carrier whose header could not be sniffed
+         */
+        std::string sniff_error(const std::string& path, const char* unknown)
+        {
+            std::error_code ignored;
+            return std::filesystem::exists(path, ignored) ? unknown : "read failed";
+        }
+
+        /**
+         * Read the whole carrier through AsyncIO, then run stage(file) on the pool
+         */
+        template <typename R, typename Stage>
+        void read_then(AsyncIO& io, ThreadPool& cpu, const std::shared_ptr<R>& request, Stage stage)
+        {
+            request->stage_start = Clock::now();
+            io.read(request->path, [&cpu, request, stage = std::move(stage)](std::optional<std::vector<byte>> file) {
+                request->result.times.read = since(request->stage_start);
+                if (!file) {
+                    set_error(request->result, "read failed");
+                    request->finish();
+                    return;
+                }
+                auto shared_file = std::make_shared<std::vector<byte>>(std::move(*file));
+                run_cpu(cpu, request, [stage, shared_file]() { stage(std::move(*shared_file)); });
+            });
+        }
+
+        /**
+         * CPU stage of a PNG/JPEG sample embed from memory
+         */
+        void embed_memory_stage(AsyncIO& io, const std::shared_ptr<EmbedRequest>& request, const std::vector<byte>& data,
+                                const std::shared_ptr<const PreparedPayload>& prepared, std::vector<byte> carrier)
+        {
+            AsyncEmbedResult& result = request->result;
+            PhotoHnS photo;
+            photo.set_options(request->options);
+            photo.set_prepared(prepared);
+            auto output = photo.embed_memory(data, carrier, request->path);
+            carrier = {};  // Free the carrier before the output is queued
+            result.times.cpu = since(request->stage_start);
+            if (!output) {
+                result.error = "embed failed";
+                request->finish();
+                return;
+            }
+            result.report = photo.get_report();
+            write_output(io, request, std::move(*output));
+        }
+
+        /**
+         * CPU stage of embed: sniff the header, then embed PNG/JPEG samples from memory (read ahead
+         * through AsyncIO) or run a file-based backend, which parses or maps the carrier itself
+         */
+        void embed_stage(AsyncIO& io, ThreadPool& cpu, const std::shared_ptr<EmbedRequest>& request,
+                         const std::shared_ptr<const std::vector<byte>>& data,
+                         const std::shared_ptr<const PreparedPayload>& prepared)
+        {
+            AsyncEmbedResult& result = request->result;
+            const auto format = HnS::detect_format(request->path);
+            if ((format == Extension::PNG || format == Extension::JPEG) &&
+                request->options.placement == Placement::Samples) {
+                read_then(io, cpu, request, [&io, request, data, prepared](std::vector<byte> carrier) {
+                    embed_memory_stage(io, request, *data, prepared, std::move(carrier));
+                });
+                return;
+            }
+
+            auto backend = format ? BackendRegistry::getInstance().create(*format) : nullptr;
+            if (!backend) {
+                result.times.cpu = since(request->stage_start);
+                result.error = sniff_error(request->path, "unsupported format");
+                request->finish();
+                return;
+            }
+            backend->set_options(request->options);
+            backend->set_prepared(prepared);
+            result.ok = backend->embed(*data, request->path, result.output).has_value();
+            result.times.cpu = since(request->stage_start);
+            if (result.ok) {
+                result.report = backend->get_report();
+                io.mark_written(result.output);
+            } else {
+                result.error = "embed failed";
+            }
+            request->finish();
+        }
+
+        /**
+         * CPU stage of extract: PNG/JPEG samples are read ahead and extracted from memory, everything
+         * else (segments included) goes through the backend, which reads only what it needs
+         */
+        void extract_stage(AsyncIO& io, ThreadPool& cpu, const std::shared_ptr<ExtractRequest>& request)
+        {
+            AsyncExtractResult& result = request->result;
+            const auto format = HnS::detect_format(request->path);
+            if ((format == Extension::PNG || format == Extension::JPEG) && !SegmentHnS::has_segments(request->path)) {
+                read_then(io, cpu, request, [request](std::vector<byte> file) {
+                    PhotoHnS photo;
+                    photo.set_options(request->options);
+                    request->result.data = photo.extract_memory(file);
+                    if (!request->result.data)
+                        request->result.error = "extract failed";
+                    request->result.times.cpu = since(request->stage_start);
+                    request->finish();
+                });
+                return;
+            }
+
+            if (!format) {
+                result.error = sniff_error(request->path, "unknown format");
+            } else if (auto backend = BackendRegistry::getInstance().create(*format)) {
+                backend->set_options(request->options);
+                result.data = backend->extract(request->path);
+            } else {
+                result.error = "unsupported format";
+            }
+            if (!result.data && result.error.empty())
+                result.error = "extract failed";
+            result.times.cpu = since(request->stage_start);
+            request->finish();
+        }
+
+        /**
+         * CPU stage of ranged reads and updates: the backend opens (or maps) the carrier itself
+         */
+        template <typename R, typename Fn>
+        void backend_stage(const std::shared_ptr<R>& request, Fn&& fn, const char* failure = "extract failed")
+        {
+            auto& result = request->result;
+            auto match = BackendRegistry::getInstance().open(request->path);
+            if (!match || !match->backend) {
+                set_error(result, "unknown format");
+            } else {
+                match->backend->set_options(request->options);
+                auto value = fn(*match->backend, request->path);
+                if (!value)
+                    set_error(result, failure);
+                store(result, std::move(value));
+            }
+            result.times.cpu = since(request->stage_start);
+            request->finish();
+        }
+
+        template <typename Result>
+        std::shared_ptr<std::promise<Result>> make_promise(std::future<Result>& future)
+        {
+            auto promise = std::make_shared<std::promise<Result>>();
+            future = promise->get_future();
+            return promise;
+        }
+    }
+
+    AsyncHnS::AsyncHnS(EmbedOptions options, AsyncIO& io, ThreadPool& cpu)
+        : options(std::move(options)), io(io), cpu(cpu)
+    {
+    }
+
+    void AsyncHnS::embed(std::vector<byte> data, const std::string& path, const std::string& out_path,
+                         EmbedCallback done)
+    {
+        this->embed_shared(std::make_shared<const std::vector<byte>>(std::move(data)), nullptr, path, out_path,
+                           std::move(done));
+    }
+
+    std::future<AsyncEmbedResult> AsyncHnS::embed(std::vector<byte> data, const std::string& path,
+                                                  const std::string& out_path)
+    {
+        std::future<AsyncEmbedResult> result;
+        auto promise = make_promise(result);
+        this->embed(std::move(data), path, out_path,
+                    [promise](AsyncEmbedResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    std::shared_ptr<const PreparedPayload> AsyncHnS::prepare(const std::vector<byte>& data, bool fresh_iv) const
+    {
+        PhotoHnS preparer;
+        preparer.set_options(this->options);
+        return preparer.prepare(data, fresh_iv);
+    }
+
+    void AsyncHnS::embed(std::shared_ptr<const PreparedPayload> prepared, const std::string& path,
+                         const std::string& out_path, EmbedCallback done)
+    {
+        // The request keeps the prepared payload alive; its plain data is not copied.
+        std::shared_ptr<const std::vector<byte>> data(prepared, &prepared->plain_data);
+        this->embed_shared(std::move(data), std::move(prepared), path, out_path, std::move(done));
+    }
+
+    std::future<AsyncEmbedResult> AsyncHnS::embed(std::shared_ptr<const PreparedPayload> prepared,
+                                                  const std::string& path, const std::string& out_path)
+    {
+        std::future<AsyncEmbedResult> result;
+        auto promise = make_promise(result);
+        this->embed(std::move(prepared), path, out_path,
+                    [promise](AsyncEmbedResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::embed_shared(std::shared_ptr<const std::vector<byte>> shared_data,
+                                std::shared_ptr<const PreparedPayload> prepared, const std::string& path,
+                                const std::string& out_path, EmbedCallback done)
+    {
+        auto request = std::make_shared<EmbedRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+        request->result.output = out_path;
+        AsyncIO* io = &this->io;        // Stages outlive this call: capture the executors, not this
+        ThreadPool* cpu = &this->cpu;
+
+        run_cpu(*cpu, request, [io, cpu, request, shared_data, prepared]() {
+            embed_stage(*io, *cpu, request, shared_data, prepared);
+        });
+    }
+
+    void AsyncHnS::extract(const std::string& path, ExtractCallback done)
+    {
+        auto request = std::make_shared<ExtractRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+        AsyncIO* io = &this->io;
+        ThreadPool* cpu = &this->cpu;
+
+        run_cpu(*cpu, request, [io, cpu, request]() { extract_stage(*io, *cpu, request); });
+    }
+
+    std::future<AsyncExtractResult> AsyncHnS::extract(const std::string& path)
+    {
+        std::future<AsyncExtractResult> result;
+        auto promise = make_promise(result);
+        this->extract(path, [promise](AsyncExtractResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::extract_range(const std::string& path, uint64_t offset, uint64_t length, ExtractCallback done)
+    {
+        auto request = std::make_shared<ExtractRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+
+        run_cpu(this->cpu, request, [request, offset, length]() {
+            backend_stage(request, [offset, length](HnS& backend, const std::string& file) {
+                return backend.extract_range(file, offset, length);
+            });
+        });
+    }
+
+    std::future<AsyncExtractResult> AsyncHnS::extract_range(const std::string& path, uint64_t offset, uint64_t length)
+    {
+        std::future<AsyncExtractResult> result;
+        auto promise = make_promise(result);
+        this->extract_range(path, offset, length, [promise](AsyncExtractResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::extract_record(const std::string& path, const std::string& name, ExtractCallback done)
+    {
+        auto request = std::make_shared<ExtractRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+
+        run_cpu(this->cpu, request, [request, name]() {
+            backend_stage(request, [&name](HnS& backend, const std::string& file) {
+                return backend.extract_record(file, name);
+            });
+        });
+    }
+
+    std::future<AsyncExtractResult> AsyncHnS::extract_record(const std::string& path, const std::string& name)
+    {
+        std::future<AsyncExtractResult> result;
+        auto promise = make_promise(result);
+        this->extract_record(path, name, [promise](AsyncExtractResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::list_records(const std::string& path, RecordsCallback done)
+    {
+        auto request = std::make_shared<RecordsRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+
+        run_cpu(this->cpu, request, [request]() {
+            backend_stage(request, [](HnS& backend, const std::string& file) { return backend.list_records(file); });
+        });
+    }
+
+    std::future<AsyncRecordsResult> AsyncHnS::list_records(const std::string& path)
+    {
+        std::future<AsyncRecordsResult> result;
+        auto promise = make_promise(result);
+        this->list_records(path, [promise](AsyncRecordsResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::update(const std::string& path, uint64_t offset, std::vector<byte> data, const std::string& out_path,
+                          EmbedCallback done)
+    {
+        auto request = std::make_shared<EmbedRequest>();
+        request->done = std::move(done);
+        request->options = this->options;
+        request->path = path;
+        request->result.output = out_path;
+        auto shared_data = std::make_shared<const std::vector<byte>>(std::move(data));
+        AsyncIO* io = &this->io;
+
+        run_cpu(this->cpu, request, [io, request, offset, shared_data]() {
+            backend_stage(request, [io, offset, &shared_data, &request](HnS& backend, const std::string& file) {
+                auto output = backend.update(file, offset, *shared_data, request->result.output);
+                if (output)
+                    io->mark_written(*output);
+                return output;
+            }, "update failed");
+        });
+    }
+
+    std::future<AsyncEmbedResult> AsyncHnS::update(const std::string& path, uint64_t offset, std::vector<byte> data,
+                                                   const std::string& out_path)
+    {
+        std::future<AsyncEmbedResult> result;
+        auto promise = make_promise(result);
+        this->update(path, offset, std::move(data), out_path,
+                     [promise](AsyncEmbedResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+
+    void AsyncHnS::probe(const std::string& path, ProbeCallback done)
+    {
+        auto request = std::make_shared<ProbeRequest>();
+        request->done = std::move(done);
+        request->path = path;
+
+        // Mapped, not read: the backend faults in only the bytes its inspect touches.
+        run_cpu(this->cpu, request, [request]() {
+            request->result.report = Probe::inspect_file(request->path);
+            request->result.times.cpu = since(request->stage_start);
+            request->finish();
+        });
+    }
+
+    std::future<AsyncProbeResult> AsyncHnS::probe(const std::string& path)
+    {
+        std::future<AsyncProbeResult> result;
+        auto promise = make_promise(result);
+        this->probe(path, [promise](AsyncProbeResult r) { promise->set_value(std::move(r)); });
+        return result;
+    }
+} // Yps
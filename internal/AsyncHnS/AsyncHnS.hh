@@ -0,0 +1,203 @@
+#ifndef YPSHNS_ASYNCHNS_HH
+#define YPSHNS_ASYNCHNS_HH
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <AsyncIO/AsyncIO.hh>
+#include <Parallel/Parallel.hh>
+#include <Probe/Probe.hh>
+#include <RecordArchive/RecordArchive.hh>
+
+namespace Yps
+{
+    /**
+     * Time spent by one request in each stage, seconds: read/write from submission to completion
+     * (ring backlog included), cpu from the start of the pool task
+     */
+    struct StageTimes
+    {
+        double read{};
+        double cpu{};
+        double write{};
+    };
+
+    struct AsyncEmbedResult
+    {
+        std::string output;
+        bool ok{false};
+        std::string error;
+
+        /**
+         * EmbedOptions::quality_report result (PNG/JPEG)
+         */
+        std::optional<EmbedReport> report;
+        StageTimes times;
+    };
+
+    struct AsyncExtractResult
+    {
+        /**
+         * Plain payload or std::nullopt (error set)
+         */
+        std::optional<std::vector<byte>> data;
+        std::string error;
+        StageTimes times;
+    };
+
+    struct AsyncRecordsResult
+    {
+        /**
+         * Index of a multi-record payload or std::nullopt (error set)
+         */
+        std::optional<std::vector<RecordEntry>> records;
+        std::string error;
+        StageTimes times;
+    };
+
+    struct AsyncProbeResult
+    {
+        ProbeReport report;
+        StageTimes times;
+    };
+
+    /**
+     * Non-blocking embed/extract/probe for services with many requests in flight. Every request is a
+     * chain of stages without a thread of its own: a pool task sniffs the carrier header, PNG/JPEG with
+     * sample placement are then read whole through AsyncIO, whose completion queues the CPU stage (decode,
+     * bit kernels, encode) on a ThreadPool, and the CPU stage queues the output write, whose completion
+     * fulfils the request. Other formats, Placement::Segment and segment files are never read ahead: their
+     * backend's file-based embed/extract runs inside the first pool task. probe() maps the carrier.
+     * Each call has a callback form (runs on an I/O thread or pool worker: keep it short) and a
+     * std::future form. io and cpu must outlive every request.
+     */
+    class AsyncHnS
+    {
+    public:
+        using EmbedCallback = std::function<void(AsyncEmbedResult)>;
+        using ExtractCallback = std::function<void(AsyncExtractResult)>;
+        using ProbeCallback = std::function<void(AsyncProbeResult)>;
+        using RecordsCallback = std::function<void(AsyncRecordsResult)>;
+
+    private:
+        EmbedOptions options;
+        AsyncIO& io;
+        ThreadPool& cpu;
+
+        /**
+         * Sniff carrier, embed on the pool (with prepared payload, if set), write output
+         */
+        void embed_shared(std::shared_ptr<const std::vector<byte>> data, std::shared_ptr<const PreparedPayload> prepared,
+                          const std::string& path, const std::string& out_path, EmbedCallback done);
+
+    public:
+        /**
+         * @param options Embedding parameters (and passphrase for extract) of every request
+         * @param io I/O backend
+         * @param cpu Executor of the CPU stages
+         */
+        explicit AsyncHnS(EmbedOptions options = {}, AsyncIO& io = AsyncIO::shared(),
+                          ThreadPool& cpu = ThreadPool::shared());
+
+        [[nodiscard]] const EmbedOptions& get_options() const { return this->options; }
+
+        /**
+         * Embed data into carrier, write result to out_path (not synced: see AsyncIO::sync())
+         * @param data Data to hide
+         * @param path Path to carrier
+         * @param out_path Path to modified file
+         * @param done Called once with the outcome
+         */
+        void embed(std::vector<byte> data, const std::string& path, const std::string& out_path, EmbedCallback done);
+        std::future<AsyncEmbedResult> embed(std::vector<byte> data, const std::string& path, const std::string& out_path);
+
+        /**
+         * Key, encrypt and ECC-code a payload once (HnS::prepare with this object's options) for broadcast embeds.
+         * Runs on the calling thread (key derivation included).
+         * @param data Payload
+         * @param fresh_iv Every carrier gets its own ciphertext (see PreparedPayload::fresh_iv)
+         * @return prepared payload or nullptr, if failed
+         */
+        [[nodiscard]] std::shared_ptr<const PreparedPayload> prepare(const std::vector<byte>& data,
+                                                                     bool fresh_iv = false) const;
+
+        /**
+         * Broadcast embed: like embed(), but the carrier only gets metadata, bit insertion and its codec
+         * (the payload was keyed, encrypted and coded by prepare()). Requests share the prepared payload.
+         * @param prepared Result of prepare()
+         * @param path Path to carrier
+         * @param out_path Path to modified file
+         * @param done Called once with the outcome
+         */
+        void embed(std::shared_ptr<const PreparedPayload> prepared, const std::string& path, const std::string& out_path,
+                   EmbedCallback done);
+        std::future<AsyncEmbedResult> embed(std::shared_ptr<const PreparedPayload> prepared, const std::string& path,
+                                            const std::string& out_path);
+
+        /**
+         * Extract hidden data
+         * @param path Path to modified file
+         * @param done Called once with the outcome
+         */
+        void extract(const std::string& path, ExtractCallback done);
+        std::future<AsyncExtractResult> extract(const std::string& path);
+
+        /**
+         * Extract plain bytes [offset, offset + length) (HnS::extract_range). Nothing is read ahead:
+         * the backend reads (or maps) only what the range needs inside the CPU stage.
+         * @param path Path to modified file
+         * @param offset First byte
+         * @param length Number of bytes (clipped to the end of data)
+         * @param done Called once with the outcome
+         */
+        void extract_range(const std::string& path, uint64_t offset, uint64_t length, ExtractCallback done);
+        std::future<AsyncExtractResult> extract_range(const std::string& path, uint64_t offset, uint64_t length);
+
+        /**
+         * Extract one record of a multi-record payload (HnS::extract_record), read like extract_range
+         * @param path Path to modified file
+         * @param name Record name
+         * @param done Called once with the outcome
+         */
+        void extract_record(const std::string& path, const std::string& name, ExtractCallback done);
+        std::future<AsyncExtractResult> extract_record(const std::string& path, const std::string& name);
+
+        /**
+         * Read the record index of a multi-record payload (HnS::list_records)
+         * @param path Path to modified file
+         * @param done Called once with the outcome
+         */
+        void list_records(const std::string& path, RecordsCallback done);
+        std::future<AsyncRecordsResult> list_records(const std::string& path);
+
+        /**
+         * Overwrite plain bytes [offset, offset + data.size()) in a modified file (HnS::update): only the
+         * re-encrypted chunks are written into the carrier, inside the CPU stage (not synced: see AsyncIO::sync())
+         * @param path Path to modified file
+         * @param offset First byte
+         * @param data New bytes
+         * @param out_path Path to updated file (path itself: in place)
+         * @param done Called once with the outcome
+         */
+        void update(const std::string& path, uint64_t offset, std::vector<byte> data, const std::string& out_path,
+                    EmbedCallback done);
+        std::future<AsyncEmbedResult> update(const std::string& path, uint64_t offset, std::vector<byte> data,
+                                             const std::string& out_path);
+
+        /**
+         * Inspect carrier (Probe::inspect_file: mapped, so WAV/Y4M/raw read only their headers and first samples)
+         * @param path Path to carrier
+         * @param done Called once with the report
+         */
+        void probe(const std::string& path, ProbeCallback done);
+        std::future<AsyncProbeResult> probe(const std::string& path);
+    };
+} // Yps
+
+#endif //YPSHNS_ASYNCHNS_HH
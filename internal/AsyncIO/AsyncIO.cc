@@ -0,0 +1,526 @@
+#include "AsyncIO.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>   // For std::memset
+#include <deque>
+#include <fstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define YPS_IO_URING 1
+#endif
+#endif
+
+namespace Yps
+{
+    namespace
+    {
+        std::optional<std::vector<byte>> read_blocking(const std::string& path)
+        {
+            std::ifstream in(path, std::ios::binary | std::ios::ate);
+            if (!in)
+                return std::nullopt;
+            std::streamsize size = in.tellg();
+            if (size < 0)
+                return std::nullopt;
+            in.seekg(0, std::ios::beg);
+            std::vector<byte> data(static_cast<size_t>(size));
+            if (size > 0 && !in.read(reinterpret_cast<char*>(data.data()), size))
+                return std::nullopt;
+            return data;
+        }
+
+        bool write_blocking(const std::string& path, const std::vector<byte>& data)
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            return static_cast<bool>(out.flush());
+        }
+
+        /**
+         * fsync by path (a fresh descriptor flushes the file's dirty pages as well)
+         */
+        bool sync_blocking(const std::string& path)
+        {
+        #ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            const bool ok = FlushFileBuffers(file) != 0;
+            CloseHandle(file);
+            return ok;
+        #else
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return false;
+            const bool ok = ::fsync(fd) == 0;
+            ::close(fd);
+            return ok;
+        #endif
+        }
+    }
+
+#ifdef YPS_IO_URING
+    /**
+     * Submission/completion rings mapped from the kernel. Submitters fill SQEs under mutex and
+     * enter immediately (the SQ never holds more than one pending entry); the reaper thread waits
+     * for CQEs, resubmits short transfers and runs completion callbacks. At most `capacity` requests
+     * are in flight, which keeps the CQ (twice the SQ size) from overflowing; further requests wait
+     * in a backlog that completions drain, so submitters never block.
+     */
+    struct AsyncIO::Ring
+    {
+        struct SyncGroup
+        {
+            std::atomic<uint32_t> remaining{};
+            std::atomic<bool> ok{true};
+            std::promise<bool> result;
+        };
+
+        struct Request
+        {
+            enum class Op { Read, Write, Fsync } op{Op::Read};
+            int fd{-1};
+            std::vector<byte> buffer;   // Read target / write source
+            uint64_t done{};
+            iovec iov{};
+            ReadCallback on_read;
+            WriteCallback on_write;
+            std::shared_ptr<SyncGroup> group;
+        };
+
+        static constexpr uint64_t MAX_TRANSFER = 1ULL << 30;  // Below the kernel's per-call limit
+
+        int fd{-1};
+        void* sq_ptr{MAP_FAILED};
+        size_t sq_size{};
+        void* cq_ptr{MAP_FAILED};
+        size_t cq_size{};
+        io_uring_sqe* sqes{static_cast<io_uring_sqe*>(MAP_FAILED)};
+        size_t sqes_size{};
+
+        unsigned* sq_tail{};
+        unsigned* sq_mask{};
+        unsigned* sq_array{};
+        unsigned* cq_head{};
+        unsigned* cq_tail{};
+        unsigned* cq_mask{};
+        io_uring_cqe* cqes{};
+
+        std::mutex mutex;
+        std::condition_variable space;
+        uint32_t capacity{};
+        uint32_t in_flight{};
+        std::deque<Request*> backlog;   // Waiting for a slot
+        bool stopping{false};
+        std::thread reaper;
+
+        ~Ring()
+        {
+            if (this->reaper.joinable()) {
+                {
+                    std::unique_lock<std::mutex> lock(this->mutex);
+                    this->space.wait(lock, [this]() { return this->in_flight == 0 && this->backlog.empty(); });
+                    this->stopping = true;
+                    this->push(IORING_OP_NOP, -1, nullptr, 0, 0);  // Wakes the reaper (user_data 0)
+                }
+                this->reaper.join();
+            }
+            if (this->sqes != MAP_FAILED)
+                munmap(this->sqes, this->sqes_size);
+            if (this->cq_ptr != MAP_FAILED && this->cq_ptr != this->sq_ptr)
+                munmap(this->cq_ptr, this->cq_size);
+            if (this->sq_ptr != MAP_FAILED)
+                munmap(this->sq_ptr, this->sq_size);
+            if (this->fd >= 0)
+                ::close(this->fd);
+        }
+
+        static int enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+        {
+            return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+        }
+
+        /**
+         * Set up ring and check that the kernel completes a NOP (seccomp may allow setup only).
+         * @return ring or nullptr (io_uring unavailable)
+         */
+        static std::unique_ptr<Ring> create(uint32_t entries)
+        {
+            io_uring_params params{};
+            const int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+            if (fd < 0)
+                return nullptr;
+
+            auto ring = std::make_unique<Ring>();
+            ring->fd = fd;
+            ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single)
+                ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+
+            ring->sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                IORING_OFF_SQ_RING);
+            if (ring->sq_ptr == MAP_FAILED)
+                return nullptr;
+            ring->cq_ptr = single ? ring->sq_ptr
+                                  : mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                         IORING_OFF_CQ_RING);
+            if (ring->cq_ptr == MAP_FAILED)
+                return nullptr;
+            ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if (ring->sqes == MAP_FAILED)
+                return nullptr;
+
+            auto* sq = static_cast<byte*>(ring->sq_ptr);
+            auto* cq = static_cast<byte*>(ring->cq_ptr);
+            ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            ring->capacity = std::min(params.sq_entries, params.cq_entries);
+
+            // Probe: one NOP submitted and reaped synchronously.
+            if (!ring->push(IORING_OP_NOP, -1, nullptr, 0, 0) || enter(fd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+                return nullptr;
+            const unsigned head = *ring->cq_head;
+            if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) || ring->cqes[head & *ring->cq_mask].res < 0)
+                return nullptr;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+            ring->reaper = std::thread([raw = ring.get()]() { raw->reap_loop(); });
+            return ring;
+        }
+
+        /**
+         * Fill one SQE and submit it (caller holds mutex or owns the ring exclusively).
+         */
+        bool push(uint8_t opcode, int file, const iovec* iov, uint64_t offset, uint64_t user_data)
+        {
+            const unsigned tail = *this->sq_tail;
+            const unsigned index = tail & *this->sq_mask;
+            io_uring_sqe* sqe = this->sqes + index;
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = opcode;
+            sqe->fd = file;
+            sqe->addr = reinterpret_cast<uint64_t>(iov);
+            sqe->len = iov ? 1 : 0;
+            sqe->off = offset;
+            sqe->user_data = user_data;
+            this->sq_array[index] = index;
+            __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+            for (;;) {
+                const int submitted = enter(this->fd, 1, 0, 0);
+                if (submitted >= 0)
+                    return submitted == 1;
+                if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    return false;
+                std::this_thread::yield();
+            }
+        }
+
+        /**
+         * Submit next chunk of a request (caller holds mutex)
+         */
+        bool push_request(Request* request)
+        {
+            uint8_t opcode = IORING_OP_FSYNC;
+            const iovec* iov = nullptr;
+            if (request->op != Request::Op::Fsync) {
+                const uint64_t left = request->buffer.size() - request->done;
+                request->iov.iov_base = request->buffer.data() + request->done;
+                request->iov.iov_len = static_cast<size_t>(std::min(left, MAX_TRANSFER));
+                opcode = request->op == Request::Op::Read ? IORING_OP_READV : IORING_OP_WRITEV;
+                iov = &request->iov;
+            }
+            return this->push(opcode, request->fd, iov, request->done, reinterpret_cast<uint64_t>(request));
+        }
+
+        /**
+         * Queue new request: submitted now if a slot is free, otherwise kept in the backlog.
+         * The request is finished (failed) if submission fails.
+         */
+        void submit(Request* request)
+        {
+            bool pushed = true;
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if (this->in_flight >= this->capacity) {
+                    this->backlog.push_back(request);
+                    return;
+                }
+                pushed = this->push_request(request);
+                this->in_flight += pushed ? 1 : 0;
+            }
+            if (!pushed)
+                this->finish(request, false, false);
+        }
+
+        /**
+         * Give a freed slot to the backlog (or release it). Backlog requests that fail to submit are
+         * finished here and the slot is offered to the next one.
+         */
+        void release_slot()
+        {
+            for (;;) {
+                Request* next = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    if (this->backlog.empty()) {
+                        --this->in_flight;
+                        break;
+                    }
+                    next = this->backlog.front();
+                    this->backlog.pop_front();
+                    if (this->push_request(next))
+                        return;  // Slot handed over
+                }
+                this->finish(next, false, false);
+            }
+            this->space.notify_all();
+        }
+
+        /**
+         * Complete request: close file, run callback, free slot (counted = request was in flight).
+         */
+        void finish(Request* request, bool ok, bool counted)
+        {
+            if (request->fd >= 0)
+                ::close(request->fd);
+            switch (request->op) {
+                case Request::Op::Read:
+                    if (ok)
+                        request->on_read(std::move(request->buffer));
+                    else
+                        request->on_read(std::nullopt);
+                    break;
+                case Request::Op::Write:
+                    request->on_write(ok);
+                    break;
+                case Request::Op::Fsync:
+                    if (!ok)
+                        request->group->ok = false;
+                    if (--request->group->remaining == 0)
+                        request->group->result.set_value(request->group->ok.load());
+                    break;
+            }
+            delete request;
+            if (counted)
+                this->release_slot();
+            else
+                this->space.notify_all();
+        }
+
+        void complete(Request* request, int32_t res)
+        {
+            if (res < 0) {
+                this->finish(request, false, true);
+                return;
+            }
+            if (request->op != Request::Op::Fsync) {
+                if (res == 0) {
+                    // EOF before the expected size: file shrank after fstat.
+                    request->buffer.resize(static_cast<size_t>(request->done));
+                    this->finish(request, request->op == Request::Op::Read, true);
+                    return;
+                }
+                request->done += static_cast<uint64_t>(res);
+                if (request->done < request->buffer.size()) {
+                    bool pushed;
+                    {
+                        std::lock_guard<std::mutex> lock(this->mutex);
+                        pushed = this->push_request(request);  // Same slot, still in flight
+                    }
+                    if (!pushed)
+                        this->finish(request, false, true);
+                    return;
+                }
+            }
+            this->finish(request, true, true);
+        }
+
+        void reap_loop()
+        {
+            for (;;) {
+                unsigned head = *this->cq_head;
+                const unsigned tail = __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE);
+                if (head == tail) {
+                    if (enter(this->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+                        std::this_thread::yield();
+                    continue;
+                }
+                bool stop = false;
+                for (; head != tail; ++head) {
+                    const io_uring_cqe& cqe = this->cqes[head & *this->cq_mask];
+                    const uint64_t user_data = cqe.user_data;
+                    const int32_t res = cqe.res;
+                    __atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);  // Slot free before resubmits
+                    if (user_data == 0)
+                        stop = true;
+                    else
+                        this->complete(reinterpret_cast<Request*>(user_data), res);
+                }
+                if (stop)
+                    return;
+            }
+        }
+    };
+#else
+    struct AsyncIO::Ring
+    {
+    };
+#endif
+
+    AsyncIO::AsyncIO(bool use_io_uring)
+    {
+    #ifdef YPS_IO_URING
+        if (use_io_uring)
+            this->ring = Ring::create(QUEUE_DEPTH);
+    #else
+        (void)use_io_uring;
+    #endif
+        if (!this->ring)
+            this->fallback = std::make_unique<ThreadPool>(FALLBACK_THREADS);
+    }
+
+    AsyncIO::~AsyncIO() = default;
+
+    AsyncIO& AsyncIO::shared()
+    {
+        static AsyncIO instance;
+        return instance;
+    }
+
+    void AsyncIO::mark_written(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(this->written_mutex);
+        this->written.push_back(path);
+    }
+
+    void AsyncIO::read(const std::string& path, ReadCallback done)
+    {
+    #ifdef YPS_IO_URING
+        if (this->ring) {
+            auto* request = new Ring::Request();
+            request->op = Ring::Request::Op::Read;
+            request->on_read = std::move(done);
+            struct stat st{};
+            request->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (request->fd < 0 || fstat(request->fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                this->ring->finish(request, false, false);
+                return;
+            }
+            request->buffer.resize(static_cast<size_t>(st.st_size));
+            if (request->buffer.empty())
+                this->ring->finish(request, true, false);
+            else
+                this->ring->submit(request);
+            return;
+        }
+    #endif
+        this->fallback->submit([path, done = std::move(done)]() { done(read_blocking(path)); });
+    }
+
+    void AsyncIO::write(const std::string& path, std::vector<byte> data, WriteCallback done)
+    {
+        this->mark_written(path);
+    #ifdef YPS_IO_URING
+        if (this->ring) {
+            auto* request = new Ring::Request();
+            request->op = Ring::Request::Op::Write;
+            request->on_write = std::move(done);
+            request->buffer = std::move(data);
+            request->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (request->fd < 0)
+                this->ring->finish(request, false, false);
+            else if (request->buffer.empty())
+                this->ring->finish(request, true, false);
+            else
+                this->ring->submit(request);
+            return;
+        }
+    #endif
+        auto shared_data = std::make_shared<std::vector<byte>>(std::move(data));
+        this->fallback->submit([path, shared_data, done = std::move(done)]() { done(write_blocking(path, *shared_data)); });
+    }
+
+    std::future<std::optional<std::vector<byte>>> AsyncIO::read(const std::string& path)
+    {
+        auto promise = std::make_shared<std::promise<std::optional<std::vector<byte>>>>();
+        auto result = promise->get_future();
+        this->read(path, [promise](std::optional<std::vector<byte>> data) { promise->set_value(std::move(data)); });
+        return result;
+    }
+
+    std::future<bool> AsyncIO::write(const std::string& path, std::vector<byte> data)
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto result = promise->get_future();
+        this->write(path, std::move(data), [promise](bool ok) { promise->set_value(ok); });
+        return result;
+    }
+
+    std::future<bool> AsyncIO::sync()
+    {
+        std::vector<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(this->written_mutex);
+            paths.swap(this->written);
+        }
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    #ifdef YPS_IO_URING
+        if (this->ring) {
+            auto group = std::make_shared<Ring::SyncGroup>();
+            auto result = group->result.get_future();
+            group->remaining = static_cast<uint32_t>(paths.size()) + 1;  // +1: released after submitting all
+            for (const auto& path : paths) {
+                auto* request = new Ring::Request();
+                request->op = Ring::Request::Op::Fsync;
+                request->group = group;
+                request->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                if (request->fd < 0)
+                    this->ring->finish(request, false, false);
+                else
+                    this->ring->submit(request);
+            }
+            if (--group->remaining == 0)
+                group->result.set_value(group->ok.load());
+            return result;
+        }
+    #endif
+        return this->fallback->submit([paths]() {
+            bool ok = true;
+            for (const auto& path : paths)
+                ok = sync_blocking(path) && ok;
+            return ok;
+        });
+    }
+} // Yps
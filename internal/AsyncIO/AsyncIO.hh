@@ -0,0 +1,118 @@
+#ifndef YPSHNS_ASYNCIO_HH
+#define YPSHNS_ASYNCIO_HH
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <Parallel/Parallel.hh>
+
+namespace Yps
+{
+    /**
+     * Asynchronous whole-file reads/writes for batch pipelines: the caller keeps submitting
+     * and collects futures, so disk time overlaps embedding on the CPU pool.
+     * Linux: io_uring (raw syscalls, no liburing) with one completion thread; files are opened
+     * synchronously, data moves through the ring. Elsewhere, or when the kernel/sandbox refuses
+     * io_uring, a small dedicated I/O ThreadPool does blocking reads/writes instead, so
+     * ThreadPool::shared() workers never wait on disk.
+     */
+    class AsyncIO
+    {
+    private:
+        struct Ring;                        // io_uring state (defined in AsyncIO.cc)
+        std::unique_ptr<Ring> ring;
+        std::unique_ptr<ThreadPool> fallback;
+
+        std::mutex written_mutex;
+        std::vector<std::string> written;   // Files written since last sync()
+
+    public:
+        /**
+         * Completion callbacks run on the I/O thread (io_uring reaper or fallback worker):
+         * keep them short, e.g. hand the data to a CPU executor.
+         */
+        using ReadCallback = std::function<void(std::optional<std::vector<byte>>)>;
+        using WriteCallback = std::function<void(bool)>;
+
+        /**
+         * Ring entries / fallback I/O threads
+         */
+        static constexpr uint32_t QUEUE_DEPTH = 64;
+        static constexpr uint32_t FALLBACK_THREADS = 4;
+
+        /**
+         * @param use_io_uring Try io_uring first (false - always the thread-pool backend)
+         */
+        explicit AsyncIO(bool use_io_uring = true);
+
+        /**
+         * Wait for submitted (and backlogged) requests, stop the completion thread
+         */
+        ~AsyncIO();
+
+        AsyncIO(const AsyncIO&) = delete;
+        AsyncIO& operator=(const AsyncIO&) = delete;
+
+        /**
+         * Process-wide instance (io_uring if available)
+         */
+        static AsyncIO& shared();
+
+        /**
+         * @return true, if requests go through io_uring
+         */
+        [[nodiscard]] bool uses_io_uring() const { return static_cast<bool>(this->ring); }
+
+        /**
+         * Read whole file
+         * @param path Path to file
+         * @return future with file bytes or std::nullopt (missing/unreadable file)
+         */
+        std::future<std::optional<std::vector<byte>>> read(const std::string& path);
+
+        /**
+         * Read whole file, never blocks on the ring (excess requests wait in a backlog)
+         * @param path Path to file
+         * @param done Called with file bytes or std::nullopt
+         */
+        void read(const std::string& path, ReadCallback done);
+
+        /**
+         * Create/truncate file and write data (not synced: see sync())
+         * @param path Path to file
+         * @param data Bytes to write (moved into the request)
+         * @return future with true on success
+         */
+        std::future<bool> write(const std::string& path, std::vector<byte> data);
+
+        /**
+         * Create/truncate file and write data, never blocks on the ring
+         * @param path Path to file
+         * @param data Bytes to write
+         * @param done Called with true on success
+         */
+        void write(const std::string& path, std::vector<byte> data, WriteCallback done);
+
+        /**
+         * Include a file written by other means (e.g. a file-based backend) in the next sync()
+         * @param path Path to file
+         */
+        void mark_written(const std::string& path);
+
+        /**
+         * Flush every file written since the previous call to stable storage, all fsyncs in one batch.
+         * Call after the writes' futures completed.
+         * @return future with true, if every fsync succeeded
+         */
+        std::future<bool> sync();
+    };
+} // Yps
+
+#endif //YPSHNS_ASYNCIO_HH
@@ -0,0 +1,319 @@
+#include "AudioHnS.hh"
+
+#include <BitKernels/BitKernels.hh>
+#include <MappedFile/MemoryBuf.hh>
+#include <Probe/Probe.hh>
+
+#include <cstring>
+#include <iostream>
+
+namespace Yps
+{
+    namespace
+    {
+        uint32_t read_le(const byte* p, uint32_t bytes)
+        {
+            uint32_t v = 0;
+            for (uint32_t i = bytes; i-- > 0;)
+                v = (v << 8) | p[i];
+            return v;
+        }
+
+        /**
+         * Copy size bytes between streams through a bounded buffer.
+         */
+        bool copy_stream(std::istream& in, std::ostream& out, uint64_t size, std::vector<byte>& buffer)
+        {
+            while (size > 0) {
+                auto take = static_cast<std::streamsize>(std::min<uint64_t>(size, buffer.size()));
+                if (!in.read(reinterpret_cast<char*>(buffer.data()), take))
+                    return false;
+                out.write(reinterpret_cast<const char*>(buffer.data()), take);
+                size -= static_cast<uint64_t>(take);
+            }
+            return static_cast<bool>(out);
+        }
+
+        /**
+         * Copy until end of input (trailing chunks after "data").
+         */
+        bool copy_rest(std::istream& in, std::ostream& out, std::vector<byte>& buffer)
+        {
+            while (in) {
+                in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+                out.write(reinterpret_cast<const char*>(buffer.data()), in.gcount());
+            }
+            return static_cast<bool>(out);
+        }
+    }
+
+    std::optional<AudioHnS::WavLayout> AudioHnS::parse_header(std::istream& in)
+    {
+        byte riff[12];
+        if (!in.read(reinterpret_cast<char*>(riff), sizeof(riff)) ||
+            std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+            return std::nullopt;
+
+        WavLayout layout;
+        bool have_fmt = false;
+        uint64_t offset = sizeof(riff);
+        byte chunk[8];
+        while (in.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+            uint32_t size = read_le(chunk + 4, 4);
+            offset += sizeof(chunk);
+
+            if (std::memcmp(chunk, "fmt ", 4) == 0) {
+                if (size < 16)
+                    return std::nullopt;
+                std::vector<byte> fmt(size);
+                if (!in.read(reinterpret_cast<char*>(fmt.data()), size))
+                    return std::nullopt;
+                uint32_t format = read_le(fmt.data(), 2);
+                // WAVE_FORMAT_EXTENSIBLE: real format is the first 2 bytes of SubFormat GUID.
+                if (format == 0xFFFE && size >= 26)
+                    format = read_le(fmt.data() + 24, 2);
+                if (format != 1)  // Integer PCM only
+                    return std::nullopt;
+                layout.channels = static_cast<uint16_t>(read_le(fmt.data() + 2, 2));
+                layout.block_align = static_cast<uint16_t>(read_le(fmt.data() + 12, 2));
+                layout.bits_per_sample = static_cast<uint16_t>(read_le(fmt.data() + 14, 2));
+                have_fmt = true;
+                if (size & 1)
+                    in.ignore(1);
+                offset += size + (size & 1);
+            } else if (std::memcmp(chunk, "data", 4) == 0) {
+                if (!have_fmt || (layout.bits_per_sample != 16 && layout.bits_per_sample != 24) ||
+                    layout.channels == 0 || layout.block_align != layout.channels * layout.bytes_per_sample())
+                    return std::nullopt;
+                layout.data_offset = offset;
+                layout.data_size = size;
+                return layout;
+            } else {
+                in.ignore(static_cast<std::streamsize>(size) + (size & 1));
+                offset += size + (size & 1);
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool AudioHnS::process_buffer(byte* samples, uint64_t count, uint64_t first_sample, uint32_t bytes_per_sample,
+                                  byte* stream, uint64_t stream_bytes, LsbMode mode, bool embed) const
+    {
+        const uint64_t meta_bytes = std::min<uint64_t>(stream_bytes, META_STREAM_SIZE);
+        const uint64_t meta_end = meta_bytes * 8ULL;
+        const uint64_t per_byte = mode == LsbMode::TwoBits ? 4 : 8;
+        const uint64_t stream_end = BitKernels::slots_needed(stream_bytes, mode);
+        const uint64_t last = std::min(first_sample + count, stream_end);
+        KernelMode kernel = this->options.kernel_mode;
+
+        // Buffers start on multiples of 8 samples, so both regions split on whole stream bytes.
+        auto run = [&](uint64_t from, uint64_t to, uint64_t stream_offset, LsbMode region_mode) {
+            byte* carrier = samples + (from - first_sample) * bytes_per_sample;
+            uint64_t region_per_byte = region_mode == LsbMode::TwoBits ? 4 : 8;
+            uint64_t bytes = (to - from) / region_per_byte;
+            return embed
+                ? BitKernels::strided_embed(carrier, to - from, bytes_per_sample, stream + stream_offset, bytes,
+                                            region_mode, kernel)
+                : BitKernels::strided_extract(carrier, to - from, bytes_per_sample, stream + stream_offset, bytes,
+                                              region_mode, kernel);
+        };
+
+        if (first_sample < meta_end) {
+            uint64_t to = std::min(last, meta_end);
+            if (!run(first_sample, to, first_sample / 8ULL, LsbMode::OneBit))
+                return false;
+        }
+        uint64_t from = std::max(first_sample, meta_end);
+        if (from < last && !run(from, last, meta_bytes + (from - meta_end) / per_byte, mode))
+            return false;
+        return true;
+    }
+
+    std::optional<std::string> AudioHnS::embed(const std::vector<byte>& data, const std::string& path,
+                                               const std::string& out_path)
+    {
+        this->embed_data = std::make_unique<EmbedData>();
+        this->embed_data->plain_data = data;
+        this->embed_data->meta.container = ContainerType::AUDIO;
+        this->embed_data->meta.ext = Extension::WAV;
+
+        // Content is checked by parse_header: the extension may be missing or wrong.
+        if (!validate_path(path)) {
+            std::cerr << CLI_RED << "AudioHnS::embed(): Invalid path: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // The output is streamed while the carrier is still being read: truncating it would destroy the input.
+        std::error_code ec;
+        if (std::filesystem::exists(out_path, ec) && std::filesystem::equivalent(path, out_path, ec)) {
+            std::cerr << CLI_RED << "AudioHnS::embed(): Output is the input WAV, write to another file: " << out_path
+                      << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::string filename_str = std::filesystem::path(path).filename().string();
+        if (filename_str.size() >= 64) {
+            std::cerr << CLI_RED << "AudioHnS::embed(): Filename too long (max 63 chars): " << filename_str << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::strncpy(this->embed_data->meta.filename, filename_str.c_str(), 63);
+        this->embed_data->meta.filename[63] = '\0';
+
+        // Key, encryption, ECC (sets write_size).
+        if (!this->seal_payload())
+            return std::nullopt;
+
+        std::ifstream in(path, std::ios::binary);
+        auto layout = in ? parse_header(in) : std::nullopt;
+        if (!layout) {
+            std::cerr << CLI_RED << "AudioHnS::embed(): Not a 16/24-bit PCM WAV: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        // Capacity: 1 bit per sample, 2 bits if needed.
+        MetaData& meta = this->embed_data->meta;
+        uint64_t samples = layout->samples();
+        if (BitKernels::slots_needed(meta.write_size, LsbMode::OneBit) <= samples) {
+            meta.lsb_mode = LsbMode::OneBit;
+        } else if (BitKernels::slots_needed(meta.write_size, LsbMode::TwoBits) <= samples) {
+            meta.lsb_mode = LsbMode::TwoBits;
+        } else {
+            std::cerr << CLI_RED << "Error: Data too large for WAV (" << meta.write_size << " bytes, "
+                      << samples << " samples)." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        std::vector<byte> stream(meta.write_size);
+        HnS::pack_meta(meta, stream.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  stream.begin() + META_STREAM_SIZE);
+
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << CLI_RED << "Error: Failed to open output WAV: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        const uint32_t bps = layout->bytes_per_sample();
+        std::vector<byte> buffer(BUFFER_SAMPLES * bps);
+        in.clear();
+        in.seekg(0, std::ios::beg);
+        if (!copy_stream(in, out, layout->data_offset, buffer)) {
+            std::cerr << CLI_RED << "Error: Failed to copy WAV header." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        const uint64_t stream_end = BitKernels::slots_needed(meta.write_size, meta.lsb_mode);
+        uint64_t remaining = layout->data_size;
+        for (uint64_t first = 0; remaining > 0; first += BUFFER_SAMPLES) {
+            uint64_t bytes = std::min<uint64_t>(remaining, buffer.size());
+            if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(bytes))) {
+                std::cerr << CLI_RED << "Error: Truncated WAV data chunk." << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            if (first < stream_end &&
+                !this->process_buffer(buffer.data(), bytes / bps, first, bps, stream.data(), stream.size(),
+                                      meta.lsb_mode, true))
+                return std::nullopt;
+            out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(bytes));
+            remaining -= bytes;
+        }
+
+        if (!copy_rest(in, out, buffer)) {
+            std::cerr << CLI_RED << "Error: Failed to write WAV: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        std::cout << CLI_GREEN << "Embedded " << meta.write_size << " bytes into " << out_path
+                  << " (mode: " << static_cast<int>(meta.lsb_mode) << ")." << CLI_RESET << std::endl;
+        return out_path;
+    }
+
+    std::optional<std::vector<byte>> AudioHnS::extract(const std::string& path)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        std::ifstream in(path, std::ios::binary);
+        auto layout = in ? parse_header(in) : std::nullopt;
+        if (!layout) {
+            std::cerr << CLI_RED << "Error: Not a 16/24-bit PCM WAV: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        const uint32_t bps = layout->bytes_per_sample();
+        const uint64_t samples = layout->samples();
+        std::vector<byte> buffer(BUFFER_SAMPLES * bps);
+        std::vector<byte> stream(META_STREAM_SIZE);
+        MetaData& meta = this->embed_data->meta;
+        uint64_t stream_end = META_STREAM_SIZE * 8ULL;
+        bool have_meta = false;
+
+        // Reading stops as soon as the stream is complete (break leaves first short of stream_end).
+        uint64_t remaining = layout->data_size;
+        uint64_t first = 0;
+        for (; remaining > 0 && first < stream_end; first += BUFFER_SAMPLES) {
+            uint64_t bytes = std::min<uint64_t>(remaining, buffer.size());
+            if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(bytes)))
+                break;
+            remaining -= bytes;
+            uint64_t count = bytes / bps;
+
+            if (!have_meta) {
+                // Metadata fits in the first buffer (BUFFER_SAMPLES >> META_STREAM_SIZE * 8).
+                if (!this->process_buffer(buffer.data(), count, first, bps, stream.data(), stream.size(),
+                                          LsbMode::OneBit, false))
+                    break;
+                if (!HnS::unpack_meta(stream.data(), meta) || meta.container != ContainerType::AUDIO || meta.ext != Extension::WAV ||
+                    meta.write_size < META_STREAM_SIZE ||
+                    (meta.lsb_mode != LsbMode::OneBit && meta.lsb_mode != LsbMode::TwoBits) ||
+                    BitKernels::slots_needed(meta.write_size, meta.lsb_mode) > samples) {
+                    std::cerr << CLI_RED << "Error: No valid metadata in WAV: " << path << CLI_RESET << std::endl;
+                    return std::nullopt;
+                }
+                have_meta = true;
+                stream.resize(meta.write_size);
+                stream_end = BitKernels::slots_needed(meta.write_size, meta.lsb_mode);
+            }
+            if (!this->process_buffer(buffer.data(), count, first, bps, stream.data(), stream.size(),
+                                      meta.lsb_mode, false))
+                break;
+        }
+
+        if (!have_meta || first < stream_end) {
+            std::cerr << CLI_RED << "Error: Incomplete extraction from WAV: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        this->embed_data->coded_data.assign(stream.begin() + META_STREAM_SIZE, stream.end());
+        if (!this->decode_payload())
+            return std::nullopt;
+
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from WAV." << CLI_RESET << std::endl;
+        return this->embed_data->plain_data;
+    }
+
+    void AudioHnS::inspect(const byte* file, uint64_t size, Extension, ProbeReport& report) const
+    {
+        MemoryBuf buffer(file, size);
+        std::istream in(&buffer);
+        auto layout = parse_header(in);
+        if (!layout) {
+            report.error = "unsupported variant";
+            return;
+        }
+        report.channels = layout->channels;
+        report.bits_per_sample = layout->bits_per_sample;
+
+        // A truncated "data" chunk holds only the samples present.
+        const uint64_t present = std::min<uint64_t>(layout->data_size, size - layout->data_offset);
+        const uint64_t samples = present / layout->bytes_per_sample();
+        report.capacity[0] = Probe::payload_capacity(BitKernels::max_stream(samples, LsbMode::OneBit));
+        report.capacity[1] = Probe::payload_capacity(BitKernels::max_stream(samples, LsbMode::TwoBits));
+        if (samples < META_STREAM_SIZE * 8ULL)
+            return;
+        std::vector<byte> stream(META_STREAM_SIZE);
+        if (BitKernels::strided_extract(file + layout->data_offset, META_STREAM_SIZE * 8ULL,
+                                        layout->bytes_per_sample(), stream.data(), stream.size(), LsbMode::OneBit,
+                                        KernelMode::Fast))
+            report.has_payload = Probe::plausible_meta(stream, Extension::WAV);
+    }
+} // Yps
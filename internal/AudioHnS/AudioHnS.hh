@@ -0,0 +1,86 @@
+#ifndef YPSHNS_AUDIOHNS_HH
+#define YPSHNS_AUDIOHNS_HH
+
+#include <fstream>
+#include <memory>
+#include <HnS.hh>
+#include <EmbedData.hh>
+#include <Encryption.hh>
+
+namespace Yps
+{
+    /**
+     * WAV (16/24-bit integer PCM) container: LSB of every sample of every channel.
+     * The file is streamed through a fixed-size buffer, so memory does not depend on recording length.
+     * Layout: metadata in 1-bit mode over the first META_STREAM_SIZE * 8 samples,
+     * then payload in 1-bit (or 2-bit, if needed) mode. Chunks other than "data" are copied untouched.
+     */
+    class AudioHnS : public HnS
+    {
+    private:
+        /**
+         * Samples per streaming buffer (multiple of 8: every buffer holds whole payload bytes)
+         */
+        static constexpr uint64_t BUFFER_SAMPLES = 1ULL << 18;
+
+        struct WavLayout
+        {
+            uint16_t channels{};
+            uint16_t bits_per_sample{};
+            uint16_t block_align{};
+            uint64_t data_offset{};     // First byte of "data" chunk payload
+            uint64_t data_size{};
+
+            [[nodiscard]] uint32_t bytes_per_sample() const { return bits_per_sample / 8u; }
+            [[nodiscard]] uint64_t samples() const { return data_size / bytes_per_sample(); }
+        };
+
+        /**
+         * Walk RIFF chunks up to "data".
+         * @param in Stream at file start (left at data_offset on success)
+         * @return layout or std::nullopt (not RIFF/WAVE, not 16/24-bit PCM)
+         */
+        static std::optional<WavLayout> parse_header(std::istream& in);
+
+        /**
+         * Embed/extract stream region inside one buffer.
+         * @param samples Buffer (first sample has global index first_sample)
+         * @param count Samples in buffer
+         * @param first_sample Global index of first sample
+         * @param stream Meta + payload bytes (embed: source, extract: destination)
+         * @param mode Payload mode
+         * @param embed Direction
+         * @return false, if kernel failed
+         */
+        bool process_buffer(byte* samples, uint64_t count, uint64_t first_sample, uint32_t bytes_per_sample,
+                            byte* stream, uint64_t stream_bytes, LsbMode mode, bool embed) const;
+
+    public:
+        ~AudioHnS() = default;
+        AudioHnS() = default;
+
+        /**
+         * Embed data into WAV
+         * @param data Data to hide
+         * @param path Input WAV
+         * @param out_path Output WAV
+         * @return out_path or std::nullopt (invalid file/capacity)
+         */
+        std::optional<std::string> embed(const std::vector<byte>& data, const std::string& path,
+                                         const std::string& out_path) override;
+
+        /**
+         * Extract data from WAV (stops reading once payload is complete)
+         * @param path WAV with embedded data
+         * @return plain_data or std::nullopt
+         */
+        std::optional<std::vector<byte>> extract(const std::string& path) override;
+
+        /**
+         * Probe a WAV in memory or mapped: channels, sample width, capacity and header check (HnS::inspect)
+         */
+        void inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const override;
+    };
+} // Yps
+
+#endif //YPSHNS_AUDIOHNS_HH
@@ -1,80 +1,50 @@
 #ifndef YPSHNS_AUTHORKEY_HH
 #define YPSHNS_AUTHORKEY_HH
 #include <memory>
-#include <cstring>
+#include <mutex>
 #include <optional>
 #include <iomanip>
 #include <sstream>
 #include <array>
-#include <random>
 #include <defines.hh>
 #include <openssl/sha.h>
 #include <iostream>
 
-#ifdef _WIN32
-#include <intrin.h>  // __cpuid
-#include <winsock2.h>
-#include <iphlpapi.h>
-#pragma comment(lib, "iphlpapi.lib")
-#pragma comment(lib, "ws2_32.lib")
-#else
-#include <cpuid.h>
-#include <ifaddrs.h>
-#include <net/if.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <netpacket/packet.h>
-#include <unistd.h>
-#endif
+#include "KeyProvider.hh"
 
 namespace Yps
 {
     /**
-     * Singleton class to gen machine-unique 256bit key.
-     * If gen type UUID - key will be unique for every generation
+     * Singleton holding the 256bit key for cryptography and identification.
+     * Key is derived lazily on first get_key() from a pluggable KeyProvider
+     * (default: default_key_provider(), i.e. env/file or machine id) and shared through KeyCache.
+     * A failing provider fails get_key(): there is no silent fallback to another source,
+     * whose key would not open the payload anywhere else.
      */
     class AuthorKey
     {
     private:
-        AuthorKey();
+        AuthorKey() = default;
 
-        static std::unique_ptr<AuthorKey> instance;
-        /**
-         * Key for cryptography and identification
-         */
-        std::array<byte, SHA256_DIGEST_LENGTH> key_;
-
-        enum class IDType {CPUID, MAC, UUID};
-        IDType id_type;
+        std::mutex mutex;
+        std::unique_ptr<KeyProvider> provider;
 
         /**
-         * Get unique id for identification and cryptography
-         * @return string with id
-         * @note working with x86/x86_64
+         * Key for cryptography and identification (empty until first use)
          */
-        [[nodiscard]]std::optional<std::string> get_cpu_id() const;
+        std::optional<std::array<byte, SHA256_DIGEST_LENGTH>> key_;
 
         /**
-         * Get Mac Address for identification and cryptography
-         * @return string with address
-         * @note Fallback for : get_cpu_id()
+         * Seed source reported by provider
          */
-        [[nodiscard]]std::optional<std::string> get_mac_address() const;
+        std::string id_type;
 
         /**
-         * Generate id for identification and cryptography
-         * @return string with uuid
-         * @note Fallback for : get_cpu_id()
+         * Derive key if not derived yet
+         * @return false, if provider failed (retried on next call)
+         * @note Caller holds mutex
          */
-        [[nodiscard]]std::string generate_uuid() const;
-
-        /**
-         * Generate AuthorKey
-         * @param seed Seed for SHA256
-         * @note Result in AuthorKey::key_
-         */
-        void generate_key(const std::string& seed);
+        bool ensure_key();
 
     public:
 
@@ -90,26 +60,31 @@ namespace Yps
             return instance;
         }
 
+        /**
+         * Replace key source. Next get_key() derives from it (cached keys are reused).
+         * @param new_provider Key source
+         */
+        void set_provider(std::unique_ptr<KeyProvider> new_provider);
+
         /**
          *
-         * @return Key for cryptography and identification
+         * @return Key for cryptography and identification or std::nullopt (provider failed)
          */
-        std::array<byte, SHA256_DIGEST_LENGTH> get_key()
-        { return this->key_; }
+        std::optional<std::array<byte, SHA256_DIGEST_LENGTH>> get_key();
 
         /**
          *
-         * @return string with id
+         * @return string with id or std::nullopt (provider failed)
          */
-        std::string get_author_id() const;
+        std::optional<std::string> get_author_id();
 
         /**
          * Get what's type of ID was generated (which seed source)
-         * @return string with id_type
+         * @return string with id_type (empty, if provider failed)
          */
-        std::string get_id_type() const;
+        std::string get_id_type();
 
     };
 } // Yps
 
-#endif //YPSHNS_AUTHORKEY_HH
\ No newline at end of file
+#endif //YPSHNS_AUTHORKEY_HH
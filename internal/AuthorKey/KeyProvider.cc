@@ -0,0 +1,316 @@
+#include "KeyProvider.hh"
+
+#include <KDF/KDF.hh>
+#include <Random/Random.hh>
+
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <openssl/crypto.h>
+
+namespace Yps
+{
+    namespace
+    {
+        Key256 sha256(const void* data, size_t size)
+        {
+            Key256 key{};
+            SHA256(static_cast<const unsigned char*>(data), size, key.data());
+            return key;
+        }
+
+        /**
+         * Decode exactly 64 hex chars.
+         */
+        std::optional<Key256> parse_hex_key(const std::string& text)
+        {
+            if (text.size() != 2 * SHA256_DIGEST_LENGTH)
+                return std::nullopt;
+            auto nibble = [](char c) -> int32_t {
+                if (c >= '0' && c <= '9') return c - '0';
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                return -1;
+            };
+            Key256 key{};
+            for (size_t i = 0; i < key.size(); ++i) {
+                int32_t hi = nibble(text[2 * i]);
+                int32_t lo = nibble(text[2 * i + 1]);
+                if (hi < 0 || lo < 0)
+                    return std::nullopt;
+                key[i] = static_cast<byte>((hi << 4) | lo);
+            }
+            return key;
+        }
+
+        /**
+         * Raw/hex/hashed key from arbitrary secret material.
+         */
+        Key256 key_from_material(const std::string& material, bool allow_raw)
+        {
+            if (allow_raw && material.size() == SHA256_DIGEST_LENGTH) {
+                Key256 key{};
+                std::copy(material.begin(), material.end(), key.begin());
+                return key;
+            }
+            std::string trimmed = material;
+            while (!trimmed.empty() && (trimmed.back() == '\n' || trimmed.back() == '\r'))
+                trimmed.pop_back();
+            if (auto key = parse_hex_key(trimmed))
+                return *key;
+            return sha256(material.data(), material.size());
+        }
+    }
+
+
+    std::optional<Key256> MachineKeyProvider::derive()
+    {
+        /*Check CPUID*/
+        if (std::optional<std::string> cpuid = this->get_cpu_id()) {
+            this->id_type = IDType::CPUID;
+            return sha256(cpuid->data(), cpuid->size());
+        }
+
+        /*Fallback(MAC)*/
+        if (std::optional<std::string> mac = this->get_mac_address()) {
+            this->id_type = IDType::MAC;
+            return sha256(mac->data(), mac->size());
+        }
+
+        /*Fallback(UUID)*/
+        this->id_type = IDType::UUID;
+        std::string uuid = this->generate_uuid();
+        return sha256(uuid.data(), uuid.size());
+    }
+
+    std::string MachineKeyProvider::name() const
+    {
+        switch (this->id_type)
+        {
+            case IDType::CPUID:
+                return "CPUID";
+            case IDType::MAC:
+                return "MAC";
+            case IDType::UUID:
+                return "UUID";
+            default:
+                return "Error! No type";
+        }
+    }
+
+    std::optional<std::string> MachineKeyProvider::get_cpu_id() const
+    {
+    #if defined(_WIN32) || defined(__x86_64__) || defined(__i386__)
+            // Get CPUID (eax=1 for base info).
+            int cpuInfo[4] = {0};
+    #ifdef _WIN32
+            __cpuid(cpuInfo, 1);
+    #else
+            __get_cpuid(1, (unsigned int*)&cpuInfo[0], (unsigned int*)&cpuInfo[1],
+                        (unsigned int*)&cpuInfo[2], (unsigned int*)&cpuInfo[3]);
+    #endif
+
+            // Check data: stepping, model, family.
+            int stepping = cpuInfo[0] & 0xF;
+            int model = (cpuInfo[0] >> 4) & 0xF;
+            int family = (cpuInfo[0] >> 8) & 0xF;
+            int extended_model = (cpuInfo[0] >> 16) & 0xF;
+            int extended_family = (cpuInfo[0] >> 20) & 0xFF;
+
+            // Additionally: Vendor ID (eax=0).
+            int vendorInfo[4] = {0};
+    #ifdef _WIN32
+            __cpuid(vendorInfo, 0);
+    #else
+            __get_cpuid(0, (unsigned int*)&vendorInfo[0], (unsigned int*)&vendorInfo[1],
+                        (unsigned int*)&vendorInfo[2], (unsigned int*)&vendorInfo[3]);
+    #endif
+            char vendor[13] = {0};
+            memcpy(vendor, &vendorInfo[1], 4);  // ebx
+            memcpy(vendor + 4, &vendorInfo[3], 4);  // edx
+            memcpy(vendor + 8, &vendorInfo[2], 4);  // ecx
+
+            // Make string.
+            std::ostringstream oss;
+            oss << vendor << ":" << std::hex << family << extended_family << model << extended_model << stepping;
+            return oss.str();  // Например: "GenuineIntel:0f00a1"
+    #else
+            // CPUID Forbidden or NotFound.
+            return std::nullopt;
+    #endif
+    }
+
+
+    std::optional<std::string> MachineKeyProvider::get_mac_address() const
+    {
+    #ifdef _WIN32
+                ULONG bufferSize = 0;
+                GetAdaptersAddresses(AF_UNSPEC, GAA_FLAG_INCLUDE_PREFIX, nullptr, nullptr, &bufferSize);
+                std::vector<BYTE> buffer(bufferSize);
+                PIP_ADAPTER_ADDRESSES adapters = reinterpret_cast<PIP_ADAPTER_ADDRESSES>(buffer.data());
+                if (GetAdaptersAddresses(AF_UNSPEC, GAA_FLAG_INCLUDE_PREFIX, nullptr, adapters, &bufferSize) != ERROR_SUCCESS) {
+                        return std::nullopt;
+                }
+                while (adapters) {
+                        if (adapters->PhysicalAddressLength == 6) {
+                                std::ostringstream oss;
+                                for (int i = 0; i < 6; ++i) {
+                                        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(adapters->PhysicalAddress[i]);
+                                        if (i < 5) oss << ':';
+                                }
+                                return oss.str();
+                        }
+                        adapters = adapters->Next;
+                }
+                return std::nullopt;
+    #else
+                struct ifaddrs* ifaddr;
+                if (getifaddrs(&ifaddr) == -1) {
+                        return std::nullopt;
+                }
+                std::optional<std::string> result;
+                for (struct ifaddrs* ifa = ifaddr; ifa != nullptr; ifa = ifa->ifa_next) {
+                        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_PACKET) {
+                                struct sockaddr_ll* s = reinterpret_cast<struct sockaddr_ll*>(ifa->ifa_addr);
+                                if (s->sll_halen == 6) {
+                                        std::ostringstream oss;
+                                        for (int i = 0; i < 6; ++i) {
+                                                oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(s->sll_addr[i]);
+                                                if (i < 5) oss << ':';
+                                        }
+                                        result = oss.str();
+                                        break;
+                                }
+                        }
+                }
+                freeifaddrs(ifaddr);
+                return result;
+    #endif
+}
+
+
+    std::string MachineKeyProvider::generate_uuid() const
+    {
+        std::string uuid(16, 0);
+        Random::fill(reinterpret_cast<byte*>(uuid.data()), uuid.size());
+        return uuid;
+    }
+
+
+
+
+    std::optional<Key256> EnvKeyProvider::derive()
+    {
+        const char* value = std::getenv(this->variable.c_str());
+        if (!value || !*value) {
+            std::cerr << CLI_RED << "Environment variable " << this->variable << " is not set" << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        return key_from_material(value, false);
+    }
+
+
+    std::string EnvKeyProvider::cache_id() const
+    {
+        const char* value = std::getenv(this->variable.c_str());
+        if (!value)
+            return "env:" + this->variable;
+        std::string material = this->variable;
+        material.push_back('\0');
+        material += value;
+        std::string id = "env:" + this->variable + ":" + process_keyed_digest(material);
+        OPENSSL_cleanse(material.data(), material.size());
+        return id;
+    }
+
+
+    std::optional<Key256> FileKeyProvider::derive()
+    {
+        std::ifstream file(this->path, std::ios::binary);
+        if (!file) {
+            std::cerr << CLI_RED << "Failed to open key file " << this->path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::string material((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (material.empty()) {
+            std::cerr << CLI_RED << "Key file " << this->path << " is empty" << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        Key256 key = key_from_material(material, true);
+        OPENSSL_cleanse(material.data(), material.size());
+        return key;
+    }
+
+
+    KeyCache& KeyCache::getInstance()
+    {
+        static KeyCache instance;
+        return instance;
+    }
+
+    std::optional<Key256> KeyCache::get_or_derive(KeyProvider& provider, std::string* source)
+    {
+        std::string id = provider.cache_id();
+        std::promise<void> promise;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            for (;;) {
+                auto it = this->keys.find(id);
+                if (it != this->keys.end()) {
+                    if (source)
+                        *source = it->second.source;
+                    return it->second.key;
+                }
+                auto derived = this->pending.find(id);
+                if (derived == this->pending.end())
+                    break;
+                // Same id is being derived: wait and look again (a failed derivation is retried here).
+                std::shared_future<void> waiting = derived->second;
+                lock.unlock();
+                waiting.wait();
+                lock.lock();
+            }
+            this->pending.emplace(id, promise.get_future().share());
+        }
+
+        // Derive outside the lock: a slow KDF must not block other providers.
+        std::optional<Key256> key;
+        try {
+            key = provider.derive();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->pending.erase(id);
+            promise.set_value();
+            throw;
+        }
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->pending.erase(id);
+        promise.set_value();
+        if (!key)
+            return std::nullopt;
+        const Entry& entry = this->keys.emplace(id, Entry{*key, provider.name()}).first->second;
+        OPENSSL_cleanse(key->data(), key->size());
+        if (source)
+            *source = entry.source;
+        return entry.key;
+    }
+
+    void KeyCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (auto& [id, entry] : this->keys)
+            OPENSSL_cleanse(entry.key.data(), entry.key.size());
+        this->keys.clear();
+    }
+
+
+    std::unique_ptr<KeyProvider> default_key_provider()
+    {
+        if (std::getenv("YPSHNS_KEY"))
+            return std::make_unique<EnvKeyProvider>("YPSHNS_KEY");
+        if (const char* path = std::getenv("YPSHNS_KEY_FILE"))
+            return std::make_unique<FileKeyProvider>(path);
+        return std::make_unique<MachineKeyProvider>();
+    }
+} // Yps
@@ -0,0 +1,190 @@
+#ifndef YPSHNS_KEYPROVIDER_HH
+#define YPSHNS_KEYPROVIDER_HH
+#include <array>
+#include <cstring>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <defines.hh>
+#include <openssl/sha.h>
+
+#ifdef _WIN32
+#include <intrin.h>  // __cpuid
+#include <winsock2.h>
+#include <iphlpapi.h>
+#pragma comment(lib, "iphlpapi.lib")
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <cpuid.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netpacket/packet.h>
+#include <unistd.h>
+#endif
+
+namespace Yps
+{
+    using Key256 = std::array<byte, SHA256_DIGEST_LENGTH>;
+
+    /**
+     * Source of the 256-bit key used by AuthorKey.
+     * derive() may be expensive (hardware probe, KDF) and is called at most once per cache_id() per process.
+     */
+    class KeyProvider
+    {
+    public:
+        virtual ~KeyProvider() = default;
+
+        /**
+         * Derive key
+         * @return key or std::nullopt (source unavailable)
+         */
+        virtual std::optional<Key256> derive() = 0;
+
+        /**
+         * Identity of provider configuration for KeyCache (must not expose secrets)
+         * @return cache id
+         */
+        [[nodiscard]] virtual std::string cache_id() const = 0;
+
+        /**
+         * Which seed source was used (valid after derive)
+         * @return e.g. CPUID, MAC, UUID, ENV, FILE
+         */
+        [[nodiscard]] virtual std::string name() const = 0;
+    };
+
+    /**
+     * Machine-unique key: SHA256 of CPUID, fallback MAC address, fallback random UUID.
+     * If type UUID - key will be unique for every process
+     */
+    class MachineKeyProvider : public KeyProvider
+    {
+    private:
+        enum class IDType {NONE, CPUID, MAC, UUID};
+        IDType id_type{IDType::NONE};
+
+        /**
+         * Get unique id for identification and cryptography
+         * @return string with id
+         * @note working with x86/x86_64
+         */
+        [[nodiscard]] std::optional<std::string> get_cpu_id() const;
+
+        /**
+         * Get Mac Address for identification and cryptography
+         * @return string with address
+         * @note Fallback for : get_cpu_id()
+         */
+        [[nodiscard]] std::optional<std::string> get_mac_address() const;
+
+        /**
+         * Generate id for identification and cryptography
+         * @return string with uuid
+         * @note Fallback for : get_mac_address()
+         */
+        [[nodiscard]] std::string generate_uuid() const;
+
+    public:
+        std::optional<Key256> derive() override;
+        [[nodiscard]] std::string cache_id() const override { return "machine"; }
+        [[nodiscard]] std::string name() const override;
+    };
+
+    /**
+     * Key from environment variable: 64 hex chars are used as raw key, anything else is hashed (SHA256).
+     * The value is read on every cache_id(), so changing it (setenv) selects a new key.
+     */
+    class EnvKeyProvider : public KeyProvider
+    {
+    private:
+        std::string variable;
+
+    public:
+        explicit EnvKeyProvider(std::string variable) : variable(std::move(variable)) {}
+        std::optional<Key256> derive() override;
+
+        /**
+         * @return variable name and keyed hash of its current value
+         */
+        [[nodiscard]] std::string cache_id() const override;
+        [[nodiscard]] std::string name() const override { return "ENV"; }
+    };
+
+    /**
+     * Key from file: exactly 32 bytes are used as raw key, 64 hex chars are decoded, anything else is hashed.
+     */
+    class FileKeyProvider : public KeyProvider
+    {
+    private:
+        std::string path;
+
+    public:
+        explicit FileKeyProvider(std::string path) : path(std::move(path)) {}
+        std::optional<Key256> derive() override;
+        [[nodiscard]] std::string cache_id() const override { return "file:" + this->path; }
+        [[nodiscard]] std::string name() const override { return "FILE"; }
+    };
+
+    /**
+     * Process-wide cache of derived keys, shared by every AuthorKey user in a batch.
+     */
+    class KeyCache
+    {
+    private:
+        KeyCache() = default;
+
+        struct Entry
+        {
+            Key256 key;
+            std::string source;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> keys;
+
+        /**
+         * Ids being derived right now (later callers wait instead of deriving again)
+         */
+        std::unordered_map<std::string, std::shared_future<void>> pending;
+
+    public:
+        KeyCache(const KeyCache&) = delete;
+        KeyCache& operator=(const KeyCache&) = delete;
+
+        static KeyCache& getInstance();
+
+        /**
+         * Return cached key for provider or derive it once: the KDF runs outside the lock,
+         * concurrent callers with the same cache_id() wait for the first one.
+         * @param provider Key source
+         * @param source Out: provider name() at derivation time (optional)
+         * @return key or std::nullopt (derive failed)
+         */
+        std::optional<Key256> get_or_derive(KeyProvider& provider, std::string* source = nullptr);
+
+        /**
+         * Drop all cached keys (wipes memory)
+         */
+        void clear();
+    };
+
+    /**
+     * Provider chosen from environment: YPSHNS_KEY (raw/hashed key), YPSHNS_KEY_FILE, otherwise machine id.
+     * Passphrases don't make an AuthorKey: they go through the salted Argon2id path (EmbedOptions::passphrase).
+     * @return provider
+     */
+    std::unique_ptr<KeyProvider> default_key_provider();
+} // Yps
+
+#endif //YPSHNS_KEYPROVIDER_HH
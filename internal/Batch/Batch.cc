@@ -0,0 +1,207 @@
+#include "Batch.hh"
+
+#include <HnS.hh>
+#include <PhotoHnS/PhotoHnS.hh>
+#include <Registry/Registry.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+
+namespace Yps
+{
+    namespace
+    {
+        /**
+         * CPU stage output: the write is already queued when the task returns
+         */
+        struct Embedded
+        {
+            BatchResult result;
+            std::optional<std::future<bool>> written;
+        };
+
+        /**
+         * One carrier of embed() or broadcast()
+         */
+        struct Item
+        {
+            const std::string& carrier;
+            const std::string& output;
+            const std::vector<byte>& data;
+        };
+
+        /**
+         * PNG/JPEG with sample placement are embedded from memory; everything else reads its own file
+         */
+        bool embeds_in_memory(const std::optional<Extension>& format, const EmbedOptions& options)
+        {
+            return (format == Extension::PNG || format == Extension::JPEG) && options.placement == Placement::Samples;
+        }
+
+        /**
+         * @param format Sniffed carrier format (std::nullopt: unreadable or unknown)
+         * @param carrier Whole carrier, read ahead only when embeds_in_memory()
+         */
+        Embedded embed_one(const Item& job, const std::optional<Extension>& format,
+                           std::optional<std::vector<byte>> carrier, const EmbedOptions& options,
+                           const std::shared_ptr<const PreparedPayload>& prepared, AsyncIO& io)
+        {
+            Embedded stage;
+            stage.result.output = job.output;
+
+            const auto start = std::chrono::steady_clock::now();
+            if (embeds_in_memory(format, options)) {
+                if (!carrier) {
+                    stage.result.error = "read failed";
+                    return stage;
+                }
+                PhotoHnS photo;
+                photo.set_options(options);
+                photo.set_prepared(prepared);
+                auto output = photo.embed_memory(job.data, *carrier, job.carrier);
+                carrier.reset();  // Free the carrier before the output is queued
+                stage.result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                if (!output) {
+                    stage.result.error = "embed failed";
+                    return stage;
+                }
+                stage.result.report = photo.get_report();
+                stage.written = io.write(job.output, std::move(*output));
+                return stage;
+            }
+
+            // File-based backends (they parse or map the carrier themselves).
+            auto backend = format ? BackendRegistry::getInstance().create(*format) : nullptr;
+            if (!backend) {
+                std::error_code ignored;
+                stage.result.error = std::filesystem::exists(job.carrier, ignored) ? "unsupported format" : "read failed";
+                return stage;
+            }
+            backend->set_options(options);
+            backend->set_prepared(prepared);
+            const bool ok = backend->embed(job.data, job.carrier, job.output).has_value();
+            stage.result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!ok) {
+                stage.result.error = "embed failed";
+                return stage;
+            }
+            stage.result.report = backend->get_report();
+            stage.result.ok = true;
+            io.mark_written(job.output);
+            return stage;
+        }
+
+        /**
+         * Wait for CPU stage and its write
+         */
+        BatchResult finish(std::future<Embedded>& pending)
+        {
+            Embedded stage = pending.get();
+            if (stage.written) {
+                stage.result.ok = stage.written->get();
+                if (!stage.result.ok)
+                    stage.result.error = "write failed";
+            }
+            return std::move(stage.result);
+        }
+
+        /**
+         * Read-ahead / CPU / write pipeline shared by embed() and broadcast()
+         */
+        std::vector<BatchResult> run(const std::vector<Item>& jobs, const EmbedOptions& options,
+                                     const std::shared_ptr<const PreparedPayload>& prepared, bool sync, AsyncIO& io)
+        {
+            const size_t n = jobs.size();
+            std::vector<std::optional<Extension>> formats(n);
+            std::vector<std::future<std::optional<std::vector<byte>>>> reads(n);
+            std::vector<std::future<Embedded>> embeds(n);
+            std::vector<BatchResult> results(n);
+
+            // On a worker of the shared pool the CPU stage runs inline (waiting on the same pool could deadlock).
+            const bool inline_cpu = ThreadPool::shared().in_worker();
+
+            // Only the header is sniffed up front; whole carriers are read ahead just for the in-memory path.
+            auto read_ahead = [&](size_t i) {
+                formats[i] = HnS::detect_format(jobs[i].carrier);
+                if (embeds_in_memory(formats[i], options))
+                    reads[i] = io.read(jobs[i].carrier);
+            };
+
+            for (size_t i = 0; i < std::min<size_t>(n, Batch::PREFETCH); ++i)
+                read_ahead(i);
+
+            for (size_t i = 0; i < n; ++i) {
+                std::optional<std::vector<byte>> carrier;
+                if (reads[i].valid())
+                    carrier = reads[i].get();
+                if (i + Batch::PREFETCH < n)
+                    read_ahead(i + Batch::PREFETCH);
+
+                // Bounded memory: at most PREFETCH embed tasks (with their carriers/outputs) in flight.
+                if (i >= Batch::PREFETCH)
+                    results[i - Batch::PREFETCH] = finish(embeds[i - Batch::PREFETCH]);
+
+                const Item& job = jobs[i];
+                if (inline_cpu) {
+                    std::promise<Embedded> done;
+                    done.set_value(embed_one(job, formats[i], std::move(carrier), options, prepared, io));
+                    embeds[i] = done.get_future();
+                } else {
+                    auto shared_carrier = std::make_shared<std::optional<std::vector<byte>>>(std::move(carrier));
+                    const std::optional<Extension>& format = formats[i];
+                    embeds[i] = ThreadPool::shared().submit([&job, &format, shared_carrier, &options, &prepared, &io]() {
+                        return embed_one(job, format, std::move(*shared_carrier), options, prepared, io);
+                    });
+                }
+            }
+            for (size_t i = n > Batch::PREFETCH ? n - Batch::PREFETCH : 0; i < n; ++i)
+                results[i] = finish(embeds[i]);
+
+            // One batch of fsyncs for every output written above.
+            if (sync && !io.sync().get()) {
+                for (auto& result : results) {
+                    if (result.ok) {
+                        result.ok = false;
+                        result.error = "fsync failed";
+                    }
+                }
+            }
+            return results;
+        }
+    }
+
+    std::vector<BatchResult> Batch::embed(const std::vector<BatchJob>& jobs, const EmbedOptions& options, bool sync,
+                                          AsyncIO& io)
+    {
+        std::vector<Item> items;
+        items.reserve(jobs.size());
+        for (const auto& job : jobs)
+            items.push_back(Item{job.carrier, job.output, job.data});
+        return run(items, options, nullptr, sync, io);
+    }
+
+    std::vector<BatchResult> Batch::broadcast(const std::vector<byte>& data, const std::vector<BatchTarget>& targets,
+                                              const EmbedOptions& options, bool fresh_iv, bool sync, AsyncIO& io)
+    {
+        // Key derivation, encryption and ECC once for every carrier.
+        PhotoHnS preparer;
+        preparer.set_options(options);
+        auto prepared = preparer.prepare(data, fresh_iv);
+        if (!prepared) {
+            std::vector<BatchResult> results(targets.size());
+            for (size_t i = 0; i < targets.size(); ++i) {
+                results[i].output = targets[i].output;
+                results[i].error = "prepare failed";
+            }
+            return results;
+        }
+
+        std::vector<Item> items;
+        items.reserve(targets.size());
+        for (const auto& target : targets)
+            items.push_back(Item{target.carrier, target.output, prepared->plain_data});
+        return run(items, options, prepared, sync, io);
+    }
+} // Yps
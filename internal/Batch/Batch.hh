@@ -0,0 +1,96 @@
+#ifndef YPSHNS_BATCH_HH
+#define YPSHNS_BATCH_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <AsyncIO/AsyncIO.hh>
+
+namespace Yps
+{
+    /**
+     * One carrier of a batch
+     */
+    struct BatchJob
+    {
+        std::string carrier;
+        std::string output;
+        std::vector<byte> data;
+    };
+
+    /**
+     * One carrier of a broadcast (the payload is shared)
+     */
+    struct BatchTarget
+    {
+        std::string carrier;
+        std::string output;
+    };
+
+    /**
+     * Outcome of one job (same order as the jobs)
+     */
+    struct BatchResult
+    {
+        std::string output;
+        bool ok{false};
+        std::string error;
+
+        /**
+         * EmbedOptions::quality_report result (PNG/JPEG)
+         */
+        std::optional<EmbedReport> report;
+
+        /**
+         * Embedding time on the CPU pool (I/O excluded)
+         */
+        double seconds{};
+    };
+
+    /**
+     * Embed pipeline over many carriers: each carrier's header is sniffed, up to PREFETCH PNG/JPEG
+     * carriers are read ahead whole through AsyncIO and embedded in memory on ThreadPool::shared()
+     * (one task per carrier), outputs are written asynchronously as soon as each task finishes and,
+     * optionally, fsynced in one batch at the end. Other carriers (WAV, Y4M, raw bitmaps,
+     * Placement::Segment) are never read here: their backend's file-based embed runs inside the CPU task.
+     */
+    class Batch
+    {
+    public:
+        /**
+         * Carriers read ahead (and embed tasks kept in flight) per batch
+         */
+        static constexpr uint32_t PREFETCH = 16;
+
+        /**
+         * @param jobs Carriers, outputs and payloads
+         * @param options Embedding parameters for every job
+         * @param sync fsync all outputs (one batch) before returning
+         * @param io I/O backend
+         * @return one result per job
+         */
+        static std::vector<BatchResult> embed(const std::vector<BatchJob>& jobs, const EmbedOptions& options,
+                                              bool sync = true, AsyncIO& io = AsyncIO::shared());
+
+        /**
+         * Embed one payload into every carrier (same pipeline as embed()): key derivation, encryption and ECC
+         * run once (HnS::prepare), each carrier only pays for metadata, bit insertion and its codec.
+         * @param data Payload
+         * @param targets Carriers and outputs
+         * @param options Embedding parameters for every carrier
+         * @param fresh_iv Encrypt again per carrier with its own IV (key still derived once, see PreparedPayload)
+         * @param sync fsync all outputs (one batch) before returning
+         * @param io I/O backend
+         * @return one result per target ("prepare failed" for all, if the payload couldn't be encrypted)
+         */
+        static std::vector<BatchResult> broadcast(const std::vector<byte>& data, const std::vector<BatchTarget>& targets,
+                                                  const EmbedOptions& options, bool fresh_iv = false, bool sync = true,
+                                                  AsyncIO& io = AsyncIO::shared());
+    };
+} // Yps
+
+#endif //YPSHNS_BATCH_HH
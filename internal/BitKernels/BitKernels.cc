@@ -0,0 +1,1346 @@
+#include "BitKernels.hh"
+
+#include <Parallel/Parallel.hh>
+
+#include <array>
+#include <chrono>
+#include <cstring>   // For std::memcpy
+#include <mutex>
+#include <numeric>   // For std::gcd
+#include <random>
+#include <type_traits>  // For std::integral_constant
+#include <utility>   // For std::index_sequence
+
+namespace Yps
+{
+    namespace
+    {
+        // Payload bytes per parallel range (keeps small payloads in one thread).
+        constexpr size_t MIN_CHUNK = 16 * 1024;
+
+        bool little_endian()
+        {
+            const uint16_t probe = 1;
+            byte first = 0;
+            std::memcpy(&first, &probe, 1);
+            return first == 1;
+        }
+
+        /**
+         * Payload byte → carrier LSB pattern, built through memcpy (endian-agnostic).
+         */
+        struct SpreadTables
+        {
+            std::array<uint64_t, 256> one_bit{};
+            std::array<uint32_t, 256> two_bit{};
+
+            SpreadTables()
+            {
+                for (uint32_t d = 0; d < 256; ++d) {
+                    byte one[8];
+                    for (int j = 0; j < 8; ++j)
+                        one[j] = static_cast<byte>((d >> (7 - j)) & 1);
+                    std::memcpy(&one_bit[d], one, 8);
+
+                    byte two[4];
+                    for (int j = 0; j < 4; ++j)
+                        two[j] = static_cast<byte>((d >> (6 - 2 * j)) & 0x03);
+                    std::memcpy(&two_bit[d], two, 4);
+                }
+            }
+        };
+
+        const SpreadTables& spread_tables()
+        {
+            static const SpreadTables tables;
+            return tables;
+        }
+
+        /*-------- 1 bit per carrier byte --------*/
+
+        void embed_one_fast(byte* carrier, const byte* data, size_t count)
+        {
+            const SpreadTables& t = spread_tables();
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                uint64_t x;
+                std::memcpy(&x, carrier, 8);
+                x = (x & 0xFEFEFEFEFEFEFEFEULL) | t.one_bit[data[i]];  // Secret-indexed load.
+                std::memcpy(carrier, &x, 8);
+            }
+        }
+
+        void embed_one_hardened(byte* carrier, const byte* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                const uint32_t d = data[i];
+                for (int j = 0; j < 8; ++j)
+                    carrier[j] = static_cast<byte>((carrier[j] & 0xFE) | ((d >> (7 - j)) & 1));
+            }
+        }
+
+        void extract_one_fast(const byte* carrier, byte* out, size_t count)
+        {
+            // Gather 8 LSBs (little-endian load): multiply moves bit of byte j to bit 63 - j.
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                uint64_t x;
+                std::memcpy(&x, carrier, 8);
+                out[i] = static_cast<byte>(((x & 0x0101010101010101ULL) * 0x8040201008040201ULL) >> 56);
+            }
+        }
+
+        void extract_one_hardened(const byte* carrier, byte* out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                uint32_t d = 0;
+                for (int j = 0; j < 8; ++j)
+                    d |= static_cast<uint32_t>(carrier[j] & 1) << (7 - j);
+                out[i] = static_cast<byte>(d);
+            }
+        }
+
+        /*-------- 2 bits per carrier byte --------*/
+
+        void embed_two_fast(byte* carrier, const byte* data, size_t count)
+        {
+            const SpreadTables& t = spread_tables();
+            for (size_t i = 0; i < count; ++i, carrier += 4) {
+                uint32_t x;
+                std::memcpy(&x, carrier, 4);
+                x = (x & 0xFCFCFCFCu) | t.two_bit[data[i]];
+                std::memcpy(carrier, &x, 4);
+            }
+        }
+
+        void embed_two_hardened(byte* carrier, const byte* data, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i, carrier += 4) {
+                const uint32_t d = data[i];
+                for (int j = 0; j < 4; ++j)
+                    carrier[j] = static_cast<byte>((carrier[j] & 0xFC) | ((d >> (6 - 2 * j)) & 0x03));
+            }
+        }
+
+        void extract_two_fast(const byte* carrier, byte* out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i, carrier += 4) {
+                uint32_t x;
+                std::memcpy(&x, carrier, 4);
+                out[i] = static_cast<byte>(((x & 0x03030303u) * 0x40100401u) >> 24);
+            }
+        }
+
+        void extract_two_hardened(const byte* carrier, byte* out, size_t count)
+        {
+            for (size_t i = 0; i < count; ++i, carrier += 4) {
+                uint32_t d = 0;
+                for (int j = 0; j < 4; ++j)
+                    d |= static_cast<uint32_t>(carrier[j] & 0x03) << (6 - 2 * j);
+                out[i] = static_cast<byte>(d);
+            }
+        }
+
+        using EmbedFn = void (*)(byte*, const byte*, size_t);
+        using ExtractFn = void (*)(const byte*, byte*, size_t);
+
+        EmbedFn pick_embed(uint32_t bits, KernelMode kernel)
+        {
+            if (kernel == KernelMode::Fast)
+                return bits == 1 ? embed_one_fast : embed_two_fast;
+            return bits == 1 ? embed_one_hardened : embed_two_hardened;
+        }
+
+        ExtractFn pick_extract(uint32_t bits, KernelMode kernel)
+        {
+            // Multiply-gather assumes little-endian loads.
+            if (kernel == KernelMode::Fast && little_endian())
+                return bits == 1 ? extract_one_fast : extract_two_fast;
+            return bits == 1 ? extract_one_hardened : extract_two_hardened;
+        }
+
+        /*-------- Strided slots (PCM samples) --------*/
+
+        /**
+         * Bits of a nibble/byte spread to the low byte of 16-bit little-endian words.
+         */
+        struct StrideTables
+        {
+            std::array<uint64_t, 16> one_bit{};    // 4 payload bits → 4 samples
+            std::array<uint64_t, 256> two_bit{};   // 4 bit pairs → 4 samples
+
+            StrideTables()
+            {
+                for (uint32_t d = 0; d < 16; ++d) {
+                    byte one[8] = {};
+                    for (int j = 0; j < 4; ++j)
+                        one[2 * j] = static_cast<byte>((d >> (3 - j)) & 1);
+                    std::memcpy(&one_bit[d], one, 8);
+                }
+                for (uint32_t d = 0; d < 256; ++d) {
+                    byte two[8] = {};
+                    for (int j = 0; j < 4; ++j)
+                        two[2 * j] = static_cast<byte>((d >> (6 - 2 * j)) & 0x03);
+                    std::memcpy(&two_bit[d], two, 8);
+                }
+            }
+        };
+
+        const StrideTables& stride_tables()
+        {
+            static const StrideTables tables;
+            return tables;
+        }
+
+        template <uint32_t Bits>
+        void strided_embed_generic(byte* carrier, size_t stride, const byte* data, size_t count)
+        {
+            constexpr uint32_t slots = 8 / Bits;
+            constexpr uint32_t mask = (1u << Bits) - 1;
+            for (size_t i = 0; i < count; ++i) {
+                const uint32_t d = data[i];
+                for (uint32_t j = 0; j < slots; ++j, carrier += stride)
+                    *carrier = static_cast<byte>((*carrier & ~mask) | ((d >> (8 - Bits * (j + 1))) & mask));
+            }
+        }
+
+        template <uint32_t Bits>
+        void strided_extract_generic(const byte* carrier, size_t stride, byte* out, size_t count)
+        {
+            constexpr uint32_t slots = 8 / Bits;
+            constexpr uint32_t mask = (1u << Bits) - 1;
+            for (size_t i = 0; i < count; ++i) {
+                uint32_t d = 0;
+                for (uint32_t j = 0; j < slots; ++j, carrier += stride)
+                    d |= static_cast<uint32_t>(*carrier & mask) << (8 - Bits * (j + 1));
+                out[i] = static_cast<byte>(d);
+            }
+        }
+
+        /**
+         * 16-bit samples, 1 bit: 8 samples = two 64-bit words, LSBs at bits 0/16/32/48.
+         */
+        void stride2_embed_one_fast(byte* carrier, const byte* data, size_t count)
+        {
+            const StrideTables& t = stride_tables();
+            for (size_t i = 0; i < count; ++i, carrier += 16) {
+                uint64_t lo, hi;
+                std::memcpy(&lo, carrier, 8);
+                std::memcpy(&hi, carrier + 8, 8);
+                lo = (lo & 0xFFFEFFFEFFFEFFFEULL) | t.one_bit[data[i] >> 4];
+                hi = (hi & 0xFFFEFFFEFFFEFFFEULL) | t.one_bit[data[i] & 0x0F];
+                std::memcpy(carrier, &lo, 8);
+                std::memcpy(carrier + 8, &hi, 8);
+            }
+        }
+
+        void stride2_extract_one_fast(const byte* carrier, byte* out, size_t count)
+        {
+            // Bit 16j moves to bit 63 - j; partial products land on distinct bits below 60 (no carries).
+            constexpr uint64_t gather = (1ULL << 63) | (1ULL << 46) | (1ULL << 29) | (1ULL << 12);
+            for (size_t i = 0; i < count; ++i, carrier += 16) {
+                uint64_t lo, hi;
+                std::memcpy(&lo, carrier, 8);
+                std::memcpy(&hi, carrier + 8, 8);
+                uint32_t high = static_cast<uint32_t>(((lo & 0x0001000100010001ULL) * gather) >> 60);
+                uint32_t low = static_cast<uint32_t>(((hi & 0x0001000100010001ULL) * gather) >> 60);
+                out[i] = static_cast<byte>((high << 4) | low);
+            }
+        }
+
+        void stride2_embed_two_fast(byte* carrier, const byte* data, size_t count)
+        {
+            const StrideTables& t = stride_tables();
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                uint64_t x;
+                std::memcpy(&x, carrier, 8);
+                x = (x & 0xFFFCFFFCFFFCFFFCULL) | t.two_bit[data[i]];
+                std::memcpy(carrier, &x, 8);
+            }
+        }
+
+        void stride2_extract_two_fast(const byte* carrier, byte* out, size_t count)
+        {
+            // Pair at bit 16j moves to bits 62 - 2j; partial products land on distinct pairs below 56.
+            constexpr uint64_t gather = (1ULL << 62) | (1ULL << 44) | (1ULL << 26) | (1ULL << 8);
+            for (size_t i = 0; i < count; ++i, carrier += 8) {
+                uint64_t x;
+                std::memcpy(&x, carrier, 8);
+                out[i] = static_cast<byte>(((x & 0x0003000300030003ULL) * gather) >> 56);
+            }
+        }
+
+        /*-------- Interleaved images (channels x depth x bits x skip-alpha) --------*/
+
+        /**
+         * Payload byte -> slot values, MSB-first (Bits per slot).
+         */
+        template <uint32_t Bits>
+        constexpr std::array<std::array<byte, 8 / Bits>, 256> make_slot_table()
+        {
+            std::array<std::array<byte, 8 / Bits>, 256> table{};
+            for (uint32_t d = 0; d < 256; ++d)
+                for (uint32_t j = 0; j < 8 / Bits; ++j)
+                    table[d][j] = static_cast<byte>((d >> (8 - Bits * (j + 1))) & ((1u << Bits) - 1));
+            return table;
+        }
+
+        template <uint32_t Bits>
+        constexpr std::array<std::array<byte, 8 / Bits>, 256> SLOT_TABLE = make_slot_table<Bits>();
+
+        /**
+         * Slot -> sample mapping from a pixel boundary.
+         */
+        template <uint32_t Channels, bool SkipAlpha>
+        struct PixelGeometry
+        {
+            static constexpr uint32_t used = SkipAlpha ? Channels - 1 : Channels;  // Slots per pixel
+
+            static constexpr uint64_t sample_of(uint64_t slot)
+            {
+                return SkipAlpha ? slot / used * Channels + slot % used : slot;
+            }
+        };
+
+        /**
+         * One specialization per image format and slot width.
+         * Contiguous layouts reuse the SWAR kernels; alpha-skipping layouts walk a group of whole pixels
+         * and whole payload bytes whose slot -> sample offsets are compile-time constants.
+         * Fast takes slot values from SLOT_TABLE, Hardened shifts them out (no payload-indexed loads).
+         */
+        template <uint32_t Channels, uint32_t Depth, uint32_t Bits, bool SkipAlpha, bool Hardened>
+        struct ImageKernel
+        {
+            using Geometry = PixelGeometry<Channels, SkipAlpha>;
+            static constexpr uint32_t per_byte = 8 / Bits;
+            static constexpr uint32_t mask = (1u << Bits) - 1;
+            static constexpr size_t stride = Depth / 8;
+
+            // Payload bytes / samples per group (group starts are pixel-aligned).
+            static constexpr uint32_t group_bytes = SkipAlpha ? Geometry::used / std::gcd(Geometry::used, per_byte) : 1;
+            static constexpr uint32_t group_slots = group_bytes * per_byte;
+            static constexpr uint64_t group_samples = SkipAlpha ? group_slots / Geometry::used * Channels : group_slots;
+
+            static inline uint32_t slot_value(byte d, uint32_t j)
+            {
+                if constexpr (Hardened)
+                    return (d >> (8 - Bits * (j + 1))) & mask;
+                else
+                    return SLOT_TABLE<Bits>[d][j];
+            }
+
+            template <typename Slots>
+            static inline void embed_slots(byte* low, const byte* data, Slots slots)
+            {
+                for (uint32_t k = 0; k < slots; ++k) {
+                    byte* p = low + Geometry::sample_of(k) * stride;
+                    *p = static_cast<byte>((*p & ~mask) | slot_value(data[k / per_byte], k % per_byte));
+                }
+            }
+
+            template <typename Slots>
+            static inline void extract_slots(const byte* low, byte* out, Slots slots)
+            {
+                for (uint32_t k = 0; k < slots; k += per_byte) {
+                    uint32_t d = 0;
+                    for (uint32_t j = 0; j < per_byte; ++j)
+                        d |= static_cast<uint32_t>(low[Geometry::sample_of(k + j) * stride] & mask) << (8 - Bits * (j + 1));
+                    out[k / per_byte] = static_cast<byte>(d);
+                }
+            }
+
+            /**
+             * @param low Low byte of the first sample (pixel boundary for SkipAlpha)
+             */
+            static void embed(byte* low, const byte* data, size_t count)
+            {
+                if constexpr (!SkipAlpha && Depth == 8) {
+                    pick_embed(Bits, Hardened ? KernelMode::Hardened : KernelMode::Fast)(low, data, count);
+                    return;
+                } else if constexpr (!SkipAlpha && Depth == 16 && !Hardened) {
+                    if (little_endian()) {
+                        (Bits == 1 ? stride2_embed_one_fast : stride2_embed_two_fast)(low, data, count);
+                        return;
+                    }
+                }
+                const size_t groups = count / group_bytes;
+                for (size_t g = 0; g < groups; ++g, low += group_samples * stride, data += group_bytes)
+                    embed_slots(low, data, std::integral_constant<uint32_t, group_slots>{});  // Unrolled, no branches
+                embed_slots(low, data, static_cast<uint32_t>(count % group_bytes) * per_byte);
+            }
+
+            static void extract(const byte* low, byte* out, size_t count)
+            {
+                if constexpr (!SkipAlpha && Depth == 8) {
+                    pick_extract(Bits, Hardened ? KernelMode::Hardened : KernelMode::Fast)(low, out, count);
+                    return;
+                } else if constexpr (!SkipAlpha && Depth == 16 && !Hardened) {
+                    if (little_endian()) {
+                        (Bits == 1 ? stride2_extract_one_fast : stride2_extract_two_fast)(low, out, count);
+                        return;
+                    }
+                }
+                const size_t groups = count / group_bytes;
+                for (size_t g = 0; g < groups; ++g, low += group_samples * stride, out += group_bytes)
+                    extract_slots(low, out, std::integral_constant<uint32_t, group_slots>{});
+                extract_slots(low, out, static_cast<uint32_t>(count % group_bytes) * per_byte);
+            }
+        };
+
+        struct ImageKernelEntry
+        {
+            EmbedFn embed;
+            ExtractFn extract;
+            uint32_t group_bytes;
+            uint64_t group_samples;
+        };
+
+        /**
+         * Index: ((((channels - 1) * 2 + is16) * 2 + (bits - 1)) * 2 + skip_alpha) * 2 + hardened.
+         * Skip-alpha entries of formats without alpha are the contiguous kernels.
+         */
+        template <size_t I>
+        constexpr ImageKernelEntry make_image_kernel()
+        {
+            constexpr uint32_t channels = static_cast<uint32_t>(I / 16) + 1;
+            constexpr uint32_t depth = (I / 8) % 2 ? 16 : 8;
+            constexpr uint32_t bits = static_cast<uint32_t>((I / 4) % 2) + 1;
+            constexpr bool skip = (I / 2) % 2 && (channels == 2 || channels == 4);
+            constexpr bool hardened = I % 2;
+            using Kernel = ImageKernel<channels, depth, bits, skip, hardened>;
+            return {&Kernel::embed, &Kernel::extract, Kernel::group_bytes, Kernel::group_samples};
+        }
+
+        template <size_t... I>
+        constexpr std::array<ImageKernelEntry, sizeof...(I)> make_image_kernels(std::index_sequence<I...>)
+        {
+            return {make_image_kernel<I>()...};
+        }
+
+        constexpr std::array<ImageKernelEntry, 64> IMAGE_KERNELS = make_image_kernels(std::make_index_sequence<64>{});
+
+        bool valid_format(const BitKernels::PixelFormat& format)
+        {
+            return format.channels >= 1 && format.channels <= 4 &&
+                   (format.bits_per_sample == 8 || format.bits_per_sample == 16) &&
+                   (!format.skip_alpha || format.has_alpha());
+        }
+
+        const ImageKernelEntry& image_kernel(const BitKernels::PixelFormat& format, uint32_t bits, bool skip_alpha,
+                                             KernelMode kernel)
+        {
+            size_t index = (format.channels - 1) * 2 + (format.bits_per_sample == 16);
+            index = ((index * 2 + (bits - 1)) * 2 + skip_alpha) * 2 + (kernel == KernelMode::Hardened);
+            return IMAGE_KERNELS[index];
+        }
+
+        /**
+         * Samples covered by `slots` slots from a pixel boundary.
+         */
+        uint64_t span_samples(uint64_t slots, uint32_t channels, bool skip_alpha)
+        {
+            if (!skip_alpha)
+                return slots;
+            return slots / (channels - 1) * channels + slots % (channels - 1);
+        }
+
+        /**
+         * Meta region, then payload region (first sample, stream offset, bytes, kernel).
+         */
+        struct ImageRegion
+        {
+            uint64_t first_sample;
+            uint64_t offset;
+            uint64_t bytes;
+            uint32_t bits;
+            bool skip_alpha;
+        };
+
+        std::array<ImageRegion, 2> image_regions(uint64_t stream_bytes, LsbMode mode,
+                                                 const BitKernels::PixelFormat& format)
+        {
+            const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, stream_bytes);
+            const bool meta_skip = format.has_alpha();  // Metadata never touches alpha
+            uint64_t payload_first = span_samples(meta_bytes * 8ULL, format.channels, meta_skip);
+            if (format.skip_alpha)  // Alpha-skipping groups start on a pixel
+                payload_first = (payload_first + format.channels - 1) / format.channels * format.channels;
+            return {ImageRegion{0, 0, meta_bytes, 1, meta_skip},
+                    ImageRegion{payload_first, meta_bytes, stream_bytes - meta_bytes,
+                                mode == LsbMode::TwoBits ? 2u : 1u, format.skip_alpha}};
+        }
+
+        /**
+         * Split region into whole groups for parallel_for, remainder bytes in the last call.
+         */
+        template <typename Fn>
+        void for_each_group_range(const ImageKernelEntry& entry, uint64_t bytes, Fn&& fn)
+        {
+            const size_t groups = static_cast<size_t>(bytes / entry.group_bytes);
+            Parallel::parallel_for(groups, [&](size_t begin, size_t end) {
+                fn(begin * entry.group_samples, begin * entry.group_bytes, (end - begin) * entry.group_bytes);
+            }, std::max<size_t>(1, MIN_CHUNK / entry.group_bytes));
+            if (uint64_t rest = bytes % entry.group_bytes)
+                fn(groups * entry.group_samples, groups * entry.group_bytes, static_cast<size_t>(rest));
+        }
+
+        /**
+         * Visit AC coefficients carrying stream bits [bit_begin, bit_end).
+         * Order: components → block rows → blocks → AC coeffs (skip DC=0), 63 bits per block.
+         */
+        template <typename Image, typename Fn>
+        void for_each_ac(Image& image, uint64_t bit_begin, uint64_t bit_end, Fn&& fn)
+        {
+            constexpr uint64_t bits_per_block = DCTSIZE2 - 1;
+            uint64_t comp_first = 0;
+            for (auto& comp : image.components) {
+                uint64_t comp_bits = comp.block_count() * bits_per_block;
+                if (bit_begin < comp_first + comp_bits && bit_end > comp_first) {
+                    uint64_t from = std::max(bit_begin, comp_first) - comp_first;
+                    uint64_t to = std::min(bit_end, comp_first + comp_bits) - comp_first;
+                    auto* block = comp.coefs.data() + (from / bits_per_block) * DCTSIZE2;
+                    int k = 1 + static_cast<int>(from % bits_per_block);
+                    for (uint64_t i = from; i < to; ++i) {
+                        fn(block[k], comp_first + i);
+                        if (++k == DCTSIZE2) {
+                            k = 1;
+                            block += DCTSIZE2;
+                        }
+                    }
+                }
+                comp_first += comp_bits;
+            }
+        }
+
+        inline JCOEF set_lsb_fast(JCOEF coef, uint32_t bit)
+        {
+            int32_t v = (coef & ~1) | static_cast<int32_t>(bit);
+            // Clamp for DCT-range (avoid overflow in Huffman).
+            if (v > 1023) v = 1023;
+            else if (v < -1024) v = -1024;
+            return static_cast<JCOEF>(v);
+        }
+
+        inline JCOEF set_lsb_hardened(JCOEF coef, uint32_t bit)
+        {
+            int32_t v = (coef & ~1) | static_cast<int32_t>(bit);
+            // Branch-free clamp: comparison results become all-ones/zero masks.
+            int32_t over = -static_cast<int32_t>(v > 1023);
+            v = (v & ~over) | (1023 & over);
+            int32_t under = -static_cast<int32_t>(v < -1024);
+            v = (v & ~under) | (-1024 & under);
+            return static_cast<JCOEF>(v);
+        }
+
+        /**
+         * Units (pixels / DCT blocks) taken by SlotOrder::Adaptive among [first, first + count):
+         * activity above threshold, plus the first `ties` units with activity == threshold.
+         * Counts are kept per fixed band of units, so every band is independent and the layout
+         * does not depend on thread count.
+         */
+        struct AdaptiveSelection
+        {
+            static constexpr uint64_t BAND = 4096;
+
+            uint64_t first{};
+            uint64_t count{};
+            uint32_t threshold{};
+            uint64_t ties{};
+            std::vector<uint64_t> units_before;  // Selected units before each band (one extra: total)
+            std::vector<uint64_t> ties_before;   // Units with activity == threshold before each band
+        };
+
+        std::optional<AdaptiveSelection> select_units(const byte* activity, uint64_t first, uint64_t count,
+                                                      uint64_t needed)
+        {
+            if (needed > count)
+                return std::nullopt;
+
+            AdaptiveSelection selection;
+            selection.first = first;
+            selection.count = count;
+            const size_t bands = static_cast<size_t>((count + AdaptiveSelection::BAND - 1) / AdaptiveSelection::BAND);
+            auto band_range = [&](size_t band) {
+                const uint64_t begin = first + band * AdaptiveSelection::BAND;
+                return std::make_pair(begin, std::min(begin + AdaptiveSelection::BAND, first + count));
+            };
+
+            // Histogram of activities, then the lowest activity that still has to be taken.
+            std::array<uint64_t, 256> histogram{};
+            std::mutex mutex;
+            Parallel::parallel_for(bands, [&](size_t begin, size_t end) {
+                // Two tables: neighbouring units often share an activity (no store-to-load stalls).
+                std::array<std::array<uint64_t, 256>, 2> local{};
+                const uint64_t last = band_range(end - 1).second;
+                uint64_t u = band_range(begin).first;
+                for (; u + 2 <= last; u += 2) {
+                    ++local[0][activity[u]];
+                    ++local[1][activity[u + 1]];
+                }
+                if (u < last)
+                    ++local[0][activity[u]];
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t v = 0; v < histogram.size(); ++v)
+                    histogram[v] += local[0][v] + local[1][v];
+            }, 16);
+
+            uint64_t above = 0;
+            uint32_t threshold = 255;
+            while (threshold > 0 && above + histogram[threshold] < needed)
+                above += histogram[threshold--];
+            selection.threshold = threshold;
+            selection.ties = needed - above;
+
+            // Per band counts, then prefix sums (ties are taken in unit order).
+            std::vector<uint64_t> greater(bands), equal(bands);
+            Parallel::parallel_for(bands, [&](size_t begin, size_t end) {
+                for (size_t band = begin; band < end; ++band) {
+                    auto [u, last] = band_range(band);
+                    uint32_t gt = 0, eq = 0;
+                    for (; u < last; ++u) {
+                        gt += activity[u] > threshold;
+                        eq += activity[u] == threshold;
+                    }
+                    greater[band] = gt;
+                    equal[band] = eq;
+                }
+            }, 16);
+
+            selection.units_before.assign(bands + 1, 0);
+            selection.ties_before.assign(bands + 1, 0);
+            for (size_t band = 0; band < bands; ++band) {
+                const uint64_t tie_quota = selection.ties - std::min(selection.ties, selection.ties_before[band]);
+                selection.units_before[band + 1] = selection.units_before[band] + greater[band] + std::min(equal[band], tie_quota);
+                selection.ties_before[band + 1] = selection.ties_before[band] + equal[band];
+            }
+            return selection;
+        }
+
+        /**
+         * Call fn(unit, ordinal) for the selected units of bands [band_begin, band_end), in unit order.
+         */
+        template <typename Fn>
+        void for_each_selected(const byte* activity, const AdaptiveSelection& selection, size_t band_begin,
+                               size_t band_end, Fn&& fn)
+        {
+            // Branch-free compaction of the band first: selected units are scattered, a `take` branch
+            // would mispredict on most of them. Locals: fn stores bytes, which may alias the selection.
+            const uint32_t threshold = selection.threshold;
+            const uint64_t ties = selection.ties;
+            std::array<uint32_t, AdaptiveSelection::BAND> picked;
+            for (size_t band = band_begin; band < band_end; ++band) {
+                uint64_t tie = selection.ties_before[band];
+                const uint64_t begin = selection.first + band * AdaptiveSelection::BAND;
+                const uint64_t end = std::min(begin + AdaptiveSelection::BAND, selection.first + selection.count);
+                size_t n = 0;
+                for (uint64_t u = begin; u < end; ++u) {
+                    const uint32_t a = activity[u];
+                    picked[n] = static_cast<uint32_t>(u - begin);
+                    n += (a > threshold) | ((a == threshold) & (tie < ties));
+                    tie += a == threshold;
+                }
+                const uint64_t ordinal = selection.units_before[band];
+                for (size_t i = 0; i < n; ++i)
+                    fn(begin + picked[i], ordinal + i);
+            }
+        }
+
+        /**
+         * Run fn(band_begin, band_end, write) over bands in parallel. write(index, bits) ORs bits into out[index];
+         * the first and last byte of a worker's slot range may be shared with neighbours and are merged under a lock.
+         */
+        template <typename Fn>
+        void gather_selected(const AdaptiveSelection& selection, uint64_t slots_per_unit, uint32_t bits,
+                             std::vector<byte>& out, Fn&& fn)
+        {
+            std::mutex mutex;
+            const size_t bands = selection.units_before.size() - 1;
+            Parallel::parallel_for(bands, [&](size_t begin, size_t end) {
+                const uint64_t head = selection.units_before[begin] * slots_per_unit * bits / 8;
+                const uint64_t tail = selection.units_before[end] * slots_per_unit * bits / 8;
+                byte head_bits = 0, tail_bits = 0;
+                fn(begin, end, [&](uint64_t index, byte value) {
+                    if (index == head)
+                        head_bits |= value;
+                    else if (index == tail)
+                        tail_bits |= value;
+                    else
+                        out[index] |= value;
+                });
+                std::lock_guard<std::mutex> lock(mutex);
+                if (head < out.size())
+                    out[head] |= head_bits;
+                if (tail < out.size() && tail != head)
+                    out[tail] |= tail_bits;
+            }, 16);
+        }
+
+        /**
+         * First pixel after the metadata region (adaptive payload starts on a pixel).
+         */
+        uint64_t adaptive_first_pixel(uint64_t stream_bytes, const BitKernels::PixelFormat& format)
+        {
+            const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, stream_bytes);
+            const uint64_t meta_samples = span_samples(meta_bytes * 8ULL, format.channels, format.has_alpha());
+            return (meta_samples + format.channels - 1) / format.channels;
+        }
+
+        /**
+         * First DCT block after the metadata region.
+         */
+        uint64_t adaptive_first_block(uint64_t stream_bytes)
+        {
+            const uint64_t meta_bits = std::min<uint64_t>(META_STREAM_SIZE, stream_bytes) * 8ULL;
+            return (meta_bits + DCTSIZE2 - 2) / (DCTSIZE2 - 1);
+        }
+
+        /**
+         * Block pointers by global block index (BitKernels DCT order).
+         */
+        template <typename Image>
+        auto block_table(Image& image)
+        {
+            using Coef = std::conditional_t<std::is_const_v<Image>, const JCOEF, JCOEF>;
+            std::vector<std::pair<uint64_t, Coef*>> table;  // (first global block, coefficients)
+            uint64_t first = 0;
+            for (auto& comp : image.components) {
+                table.emplace_back(first, comp.coefs.data());
+                first += comp.block_count();
+            }
+            return [table](uint64_t block) {
+                size_t c = table.size() - 1;
+                while (table[c].first > block)
+                    --c;
+                return table[c].second + (block - table[c].first) * DCTSIZE2;
+            };
+        }
+    }
+
+    std::string to_string(KernelMode kernel)
+    {
+        return kernel == KernelMode::Hardened ? "Hardened" : "Fast";
+    }
+
+    bool BitKernels::pixel_embed(byte* carrier, uint64_t carrier_bytes, const std::vector<byte>& data,
+                                 LsbMode mode, KernelMode kernel)
+    {
+        uint64_t one_bit_bytes = data.size();
+        if (mode == LsbMode::TwoBits)
+            one_bit_bytes = std::min<uint64_t>(META_STREAM_SIZE, data.size());  // Metadata always in 1-bit.
+        else if (mode != LsbMode::OneBit)
+            return false;
+
+        uint64_t two_bit_bytes = data.size() - one_bit_bytes;
+        if (one_bit_bytes * 8ULL + two_bit_bytes * 4ULL > carrier_bytes)
+            return false;
+
+        EmbedFn one = pick_embed(1, kernel);
+        Parallel::parallel_for(static_cast<size_t>(one_bit_bytes), [&](size_t begin, size_t end) {
+            one(carrier + begin * 8ULL, data.data() + begin, end - begin);
+        }, MIN_CHUNK);
+
+        if (two_bit_bytes > 0) {
+            EmbedFn two = pick_embed(2, kernel);
+            byte* base = carrier + one_bit_bytes * 8ULL;
+            const byte* src = data.data() + one_bit_bytes;
+            Parallel::parallel_for(static_cast<size_t>(two_bit_bytes), [&](size_t begin, size_t end) {
+                two(base + begin * 4ULL, src + begin, end - begin);
+            }, MIN_CHUNK);
+        }
+        return true;
+    }
+
+    std::optional<std::vector<byte>> BitKernels::pixel_extract(const byte* carrier, uint64_t carrier_bytes,
+                                                               uint64_t num_bytes, LsbMode mode, KernelMode kernel)
+    {
+        uint64_t one_bit_bytes = num_bytes;
+        if (mode == LsbMode::TwoBits)
+            one_bit_bytes = std::min<uint64_t>(META_STREAM_SIZE, num_bytes);
+        else if (mode != LsbMode::OneBit)
+            return std::nullopt;
+
+        uint64_t two_bit_bytes = num_bytes - one_bit_bytes;
+        if (one_bit_bytes * 8ULL + two_bit_bytes * 4ULL > carrier_bytes)
+            return std::nullopt;
+
+        std::vector<byte> data(num_bytes);
+        ExtractFn one = pick_extract(1, kernel);
+        Parallel::parallel_for(static_cast<size_t>(one_bit_bytes), [&](size_t begin, size_t end) {
+            one(carrier + begin * 8ULL, data.data() + begin, end - begin);
+        }, MIN_CHUNK);
+
+        if (two_bit_bytes > 0) {
+            ExtractFn two = pick_extract(2, kernel);
+            const byte* base = carrier + one_bit_bytes * 8ULL;
+            byte* dst = data.data() + one_bit_bytes;
+            Parallel::parallel_for(static_cast<size_t>(two_bit_bytes), [&](size_t begin, size_t end) {
+                two(base + begin * 4ULL, dst + begin, end - begin);
+            }, MIN_CHUNK);
+        }
+        return data;
+    }
+
+    uint64_t BitKernels::slots_needed(uint64_t stream_bytes, LsbMode mode)
+    {
+        uint64_t meta_bytes = std::min<uint64_t>(stream_bytes, META_STREAM_SIZE);
+        uint64_t per_byte = mode == LsbMode::TwoBits ? 4 : 8;
+        return meta_bytes * 8ULL + (stream_bytes - meta_bytes) * per_byte;
+    }
+
+    uint64_t BitKernels::max_stream(uint64_t slots, LsbMode mode)
+    {
+        if (slots < META_STREAM_SIZE * 8ULL)
+            return 0;
+        uint64_t per_byte = mode == LsbMode::TwoBits ? 4 : 8;
+        return META_STREAM_SIZE + (slots - META_STREAM_SIZE * 8ULL) / per_byte;
+    }
+
+    uint64_t BitKernels::image_samples_needed(uint64_t stream_bytes, LsbMode mode, const PixelFormat& format)
+    {
+        const auto regions = image_regions(stream_bytes, mode, format);
+        const ImageRegion& payload = regions[1];
+        return payload.first_sample +
+               span_samples(payload.bytes * (8 / payload.bits), format.channels, payload.skip_alpha);
+    }
+
+    bool BitKernels::image_embed(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                 const std::vector<byte>& data, LsbMode mode, KernelMode kernel)
+    {
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            image_samples_needed(data.size(), mode, format) > sample_count)
+            return false;
+
+        const size_t stride = format.bits_per_sample / 8;
+        byte* low = static_cast<byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        for (const ImageRegion& region : image_regions(data.size(), mode, format)) {
+            const ImageKernelEntry& entry = image_kernel(format, region.bits, region.skip_alpha, kernel);
+            byte* base = low + region.first_sample * stride;
+            const byte* src = data.data() + region.offset;
+            for_each_group_range(entry, region.bytes, [&](uint64_t sample, uint64_t offset, size_t count) {
+                entry.embed(base + sample * stride, src + offset, count);
+            });
+        }
+        return true;
+    }
+
+    std::optional<std::vector<byte>> BitKernels::image_extract(const void* samples, uint64_t sample_count,
+                                                               const PixelFormat& format, uint64_t num_bytes,
+                                                               LsbMode mode, KernelMode kernel)
+    {
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            image_samples_needed(num_bytes, mode, format) > sample_count)
+            return std::nullopt;
+
+        const size_t stride = format.bits_per_sample / 8;
+        const byte* low = static_cast<const byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        std::vector<byte> out(num_bytes);
+        for (const ImageRegion& region : image_regions(num_bytes, mode, format)) {
+            const ImageKernelEntry& entry = image_kernel(format, region.bits, region.skip_alpha, kernel);
+            const byte* base = low + region.first_sample * stride;
+            byte* dst = out.data() + region.offset;
+            for_each_group_range(entry, region.bytes, [&](uint64_t sample, uint64_t offset, size_t count) {
+                entry.extract(base + sample * stride, dst + offset, count);
+            });
+        }
+        return out;
+    }
+
+    std::optional<std::vector<byte>> BitKernels::image_extract_range(const void* samples, uint64_t sample_count,
+                                                                     const PixelFormat& format, uint64_t stream_offset,
+                                                                     uint64_t num_bytes, LsbMode mode, KernelMode kernel)
+    {
+        const uint64_t stream_end = stream_offset + num_bytes;
+        if (stream_end < stream_offset)
+            return std::nullopt;
+        // Inside metadata the layout is the prefix one.
+        if (stream_offset < META_STREAM_SIZE) {
+            auto prefix = image_extract(samples, sample_count, format, stream_end, mode, kernel);
+            if (prefix)
+                prefix->erase(prefix->begin(), prefix->begin() + stream_offset);
+            return prefix;
+        }
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            image_samples_needed(stream_end, mode, format) > sample_count)
+            return std::nullopt;
+
+        // Payload region from the kernel group holding stream_offset (groups start on fixed samples).
+        const ImageRegion payload = image_regions(stream_end, mode, format)[1];
+        const ImageKernelEntry& entry = image_kernel(format, payload.bits, payload.skip_alpha, kernel);
+        const uint64_t group = (stream_offset - payload.offset) / entry.group_bytes;
+        const uint64_t skip = stream_offset - payload.offset - group * entry.group_bytes;
+
+        const size_t stride = format.bits_per_sample / 8;
+        const byte* low = static_cast<const byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        const byte* base = low + (payload.first_sample + group * entry.group_samples) * stride;
+        std::vector<byte> out(static_cast<size_t>(skip + num_bytes));
+        for_each_group_range(entry, out.size(), [&](uint64_t sample, uint64_t offset, size_t count) {
+            entry.extract(base + sample * stride, out.data() + offset, count);
+        });
+        out.erase(out.begin(), out.begin() + skip);
+        return out;
+    }
+
+    bool BitKernels::image_embed_range(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                       uint64_t stream_offset, const std::vector<byte>& data, LsbMode mode,
+                                       KernelMode kernel)
+    {
+        const uint64_t stream_end = stream_offset + data.size();
+        if (stream_end < stream_offset)
+            return false;
+        // Inside metadata the layout is the prefix one: rewrite the prefix.
+        if (stream_offset < META_STREAM_SIZE) {
+            auto prefix = image_extract(samples, sample_count, format, stream_end, mode, kernel);
+            if (!prefix)
+                return false;
+            std::copy(data.begin(), data.end(), prefix->begin() + static_cast<std::ptrdiff_t>(stream_offset));
+            return image_embed(samples, sample_count, format, *prefix, mode, kernel);
+        }
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            image_samples_needed(stream_end, mode, format) > sample_count)
+            return false;
+
+        // Kernels start on a group: bytes of the first group before the range are written back unchanged.
+        const ImageRegion payload = image_regions(stream_end, mode, format)[1];
+        const ImageKernelEntry& entry = image_kernel(format, payload.bits, payload.skip_alpha, kernel);
+        const uint64_t group = (stream_offset - payload.offset) / entry.group_bytes;
+        const uint64_t skip = stream_offset - payload.offset - group * entry.group_bytes;
+
+        const size_t stride = format.bits_per_sample / 8;
+        byte* low = static_cast<byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        byte* base = low + (payload.first_sample + group * entry.group_samples) * stride;
+        std::vector<byte> bytes(static_cast<size_t>(skip + data.size()));
+        if (skip > 0)
+            entry.extract(base, bytes.data(), static_cast<size_t>(skip));
+        std::copy(data.begin(), data.end(), bytes.begin() + static_cast<std::ptrdiff_t>(skip));
+        for_each_group_range(entry, bytes.size(), [&](uint64_t sample, uint64_t offset, size_t count) {
+            entry.embed(base + sample * stride, bytes.data() + offset, count);
+        });
+        return true;
+    }
+
+    uint64_t BitKernels::image_adaptive_pixels_needed(uint64_t stream_bytes, LsbMode mode, const PixelFormat& format)
+    {
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, stream_bytes);
+        const uint64_t used = format.skip_alpha ? format.channels - 1 : format.channels;
+        const uint64_t slots = (stream_bytes - meta_bytes) * (mode == LsbMode::TwoBits ? 4 : 8);
+        return adaptive_first_pixel(stream_bytes, format) + (slots + used - 1) / used;
+    }
+
+    bool BitKernels::image_embed_adaptive(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                          const std::vector<byte>& activity, const std::vector<byte>& data,
+                                          LsbMode mode, KernelMode kernel)
+    {
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            activity.size() != sample_count / format.channels ||
+            image_adaptive_pixels_needed(data.size(), mode, format) > activity.size())
+            return false;
+
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, data.size());
+        const uint32_t bits = mode == LsbMode::TwoBits ? 2 : 1;
+        const uint64_t used = format.skip_alpha ? format.channels - 1 : format.channels;
+        const uint64_t slots = (data.size() - meta_bytes) * 8ULL / bits;
+        const uint64_t first = adaptive_first_pixel(data.size(), format);
+        auto selection = select_units(activity.data(), first, activity.size() - first, (slots + used - 1) / used);
+        if (!selection)
+            return false;
+
+        // Metadata exactly as in image_embed (1-bit, sequential, never in alpha).
+        std::vector<byte> meta(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(meta_bytes));
+        if (!image_embed(samples, sample_count, format, meta, LsbMode::OneBit, kernel))
+            return false;
+
+        // Slot values by shifts in both families (no payload-indexed lookups); selection depends on the image only.
+        const size_t stride = format.bits_per_sample / 8;
+        byte* low = static_cast<byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        const byte* payload = data.data() + meta_bytes;
+        const uint32_t mask = (1u << bits) - 1;
+        const uint64_t pixel_stride = format.channels * stride;
+        Parallel::parallel_for(selection->units_before.size() - 1, [&, low](size_t begin, size_t end) {
+            for_each_selected(activity.data(), *selection, begin, end, [=](uint64_t pixel, uint64_t ordinal) {
+                const uint64_t slot = ordinal * used;
+                byte* p = low + pixel * pixel_stride;
+                for (uint64_t j = 0; j < used && slot + j < slots; ++j, p += stride) {
+                    const uint64_t bit = (slot + j) * bits;
+                    const uint32_t value = (payload[bit / 8] >> (8 - bits - bit % 8)) & mask;
+                    *p = static_cast<byte>((*p & ~mask) | value);
+                }
+            });
+        }, 16);
+        return true;
+    }
+
+    std::optional<std::vector<byte>> BitKernels::image_extract_adaptive(const void* samples, uint64_t sample_count,
+                                                                        const PixelFormat& format,
+                                                                        const std::vector<byte>& activity,
+                                                                        uint64_t num_bytes, LsbMode mode,
+                                                                        KernelMode kernel)
+    {
+        if (!valid_format(format) || (mode != LsbMode::OneBit && mode != LsbMode::TwoBits) ||
+            activity.size() != sample_count / format.channels ||
+            image_adaptive_pixels_needed(num_bytes, mode, format) > activity.size())
+            return std::nullopt;
+
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, num_bytes);
+        const uint32_t bits = mode == LsbMode::TwoBits ? 2 : 1;
+        const uint64_t used = format.skip_alpha ? format.channels - 1 : format.channels;
+        const uint64_t slots = (num_bytes - meta_bytes) * 8ULL / bits;
+        const uint64_t first = adaptive_first_pixel(num_bytes, format);
+        auto selection = select_units(activity.data(), first, activity.size() - first, (slots + used - 1) / used);
+        auto meta = image_extract(samples, sample_count, format, meta_bytes, LsbMode::OneBit, kernel);
+        if (!selection || !meta)
+            return std::nullopt;
+
+        const size_t stride = format.bits_per_sample / 8;
+        const byte* low = static_cast<const byte*>(samples) + (stride == 2 && !little_endian() ? 1 : 0);
+        const uint32_t mask = (1u << bits) - 1;
+        std::vector<byte> payload(num_bytes - meta_bytes, 0);
+        gather_selected(*selection, used, bits, payload, [&](size_t begin, size_t end, auto&& write) {
+            for_each_selected(activity.data(), *selection, begin, end, [&](uint64_t pixel, uint64_t ordinal) {
+                const uint64_t slot = ordinal * used;
+                for (uint64_t j = 0; j < used && slot + j < slots; ++j) {
+                    const uint64_t bit = (slot + j) * bits;
+                    const uint32_t value = low[(pixel * format.channels + j) * stride] & mask;
+                    write(bit / 8, static_cast<byte>(value << (8 - bits - bit % 8)));
+                }
+            });
+        });
+
+        meta->insert(meta->end(), payload.begin(), payload.end());
+        return meta;
+    }
+
+    bool BitKernels::strided_embed(byte* carrier, uint64_t slots, size_t stride, const byte* data, uint64_t num_bytes,
+                                   LsbMode mode, KernelMode kernel)
+    {
+        if (mode != LsbMode::OneBit && mode != LsbMode::TwoBits)
+            return false;
+        const uint64_t per_byte = mode == LsbMode::OneBit ? 8 : 4;
+        if (stride == 0 || num_bytes * per_byte > slots)
+            return false;
+
+        // Fast SWAR path reads whole 16-bit samples (the slot byte and its high byte).
+        const bool swar = kernel == KernelMode::Fast && stride == 2 && little_endian();
+        const uint32_t bits = mode == LsbMode::OneBit ? 1 : 2;
+        Parallel::parallel_for(static_cast<size_t>(num_bytes), [&](size_t begin, size_t end) {
+            byte* base = carrier + begin * per_byte * stride;
+            if (stride == 1)
+                pick_embed(bits, kernel)(base, data + begin, end - begin);
+            else if (swar)
+                (mode == LsbMode::OneBit ? stride2_embed_one_fast : stride2_embed_two_fast)(base, data + begin, end - begin);
+            else if (mode == LsbMode::OneBit)
+                strided_embed_generic<1>(base, stride, data + begin, end - begin);
+            else
+                strided_embed_generic<2>(base, stride, data + begin, end - begin);
+        }, MIN_CHUNK);
+        return true;
+    }
+
+    bool BitKernels::strided_extract(const byte* carrier, uint64_t slots, size_t stride, byte* out, uint64_t num_bytes,
+                                     LsbMode mode, KernelMode kernel)
+    {
+        if (mode != LsbMode::OneBit && mode != LsbMode::TwoBits)
+            return false;
+        const uint64_t per_byte = mode == LsbMode::OneBit ? 8 : 4;
+        if (stride == 0 || num_bytes * per_byte > slots)
+            return false;
+
+        const bool swar = kernel == KernelMode::Fast && stride == 2 && little_endian();
+        const uint32_t bits = mode == LsbMode::OneBit ? 1 : 2;
+        Parallel::parallel_for(static_cast<size_t>(num_bytes), [&](size_t begin, size_t end) {
+            const byte* base = carrier + begin * per_byte * stride;
+            if (stride == 1)
+                pick_extract(bits, kernel)(base, out + begin, end - begin);
+            else if (swar)
+                (mode == LsbMode::OneBit ? stride2_extract_one_fast : stride2_extract_two_fast)(base, out + begin, end - begin);
+            else if (mode == LsbMode::OneBit)
+                strided_extract_generic<1>(base, stride, out + begin, end - begin);
+            else
+                strided_extract_generic<2>(base, stride, out + begin, end - begin);
+        }, MIN_CHUNK);
+        return true;
+    }
+
+    bool BitKernels::dct_embed(JpegCoefImage& image, const std::vector<byte>& data, KernelMode kernel)
+    {
+        return dct_embed_range(image, 0, data, kernel);
+    }
+
+    std::optional<std::vector<byte>> BitKernels::dct_extract(const JpegCoefImage& image, uint64_t num_bytes,
+                                                             KernelMode kernel)
+    {
+        return dct_extract_range(image, 0, num_bytes, kernel);
+    }
+
+    std::optional<std::vector<byte>> BitKernels::dct_extract_range(const JpegCoefImage& image, uint64_t stream_offset,
+                                                                   uint64_t num_bytes, KernelMode kernel)
+    {
+        (void)kernel;  // LSB gather has no secret-dependent branches or lookups: both families share it.
+        const uint64_t end_bits = (stream_offset + num_bytes) * 8ULL;
+        if (stream_offset + num_bytes < stream_offset || end_bits > image.ac_capacity_bits())
+            return std::nullopt;
+
+        std::vector<byte> data(num_bytes, 0);
+        const uint64_t first_bit = stream_offset * 8ULL;
+        Parallel::parallel_for(static_cast<size_t>(num_bytes), [&](size_t byte_begin, size_t byte_end) {
+            for_each_ac(image, first_bit + byte_begin * 8ULL, first_bit + byte_end * 8ULL,
+                        [&](const JCOEF& coef, uint64_t bit_idx) {
+                data[bit_idx / 8ULL - stream_offset] |= static_cast<byte>((coef & 1) << (7 - bit_idx % 8));
+            });
+        }, MIN_CHUNK);
+        return data;
+    }
+
+    bool BitKernels::dct_embed_range(JpegCoefImage& image, uint64_t stream_offset, const std::vector<byte>& data,
+                                     KernelMode kernel)
+    {
+        const uint64_t end_bits = (stream_offset + data.size()) * 8ULL;
+        if (stream_offset + data.size() < stream_offset || end_bits > image.ac_capacity_bits())
+            return false;
+
+        // Split on data bytes: every thread owns whole bytes and distinct coefficients.
+        const uint64_t first_bit = stream_offset * 8ULL;
+        Parallel::parallel_for(data.size(), [&](size_t byte_begin, size_t byte_end) {
+            if (kernel == KernelMode::Fast) {
+                for_each_ac(image, first_bit + byte_begin * 8ULL, first_bit + byte_end * 8ULL, [&](JCOEF& coef, uint64_t bit_idx) {
+                    coef = set_lsb_fast(coef, (data[bit_idx / 8ULL - stream_offset] >> (7 - bit_idx % 8)) & 1);
+                });
+            } else {
+                for_each_ac(image, first_bit + byte_begin * 8ULL, first_bit + byte_end * 8ULL, [&](JCOEF& coef, uint64_t bit_idx) {
+                    coef = set_lsb_hardened(coef, (data[bit_idx / 8ULL - stream_offset] >> (7 - bit_idx % 8)) & 1);
+                });
+            }
+        }, MIN_CHUNK);
+        return true;
+    }
+
+    uint64_t BitKernels::dct_adaptive_blocks_needed(uint64_t stream_bytes)
+    {
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, stream_bytes);
+        const uint64_t slots = (stream_bytes - meta_bytes) * 8ULL;
+        return adaptive_first_block(stream_bytes) + (slots + DCTSIZE2 - 2) / (DCTSIZE2 - 1);
+    }
+
+    bool BitKernels::dct_embed_adaptive(JpegCoefImage& image, const std::vector<byte>& activity,
+                                        const std::vector<byte>& data, KernelMode kernel)
+    {
+        constexpr uint64_t per_block = DCTSIZE2 - 1;
+        if (activity.size() * per_block != image.ac_capacity_bits() ||
+            dct_adaptive_blocks_needed(data.size()) > activity.size())
+            return false;
+
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, data.size());
+        const uint64_t slots = (data.size() - meta_bytes) * 8ULL;
+        const uint64_t first = adaptive_first_block(data.size());
+        auto selection = select_units(activity.data(), first, activity.size() - first, (slots + per_block - 1) / per_block);
+        if (!selection)
+            return false;
+
+        std::vector<byte> meta(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(meta_bytes));
+        if (!dct_embed(image, meta, kernel))
+            return false;
+
+        // LSB replacement keeps coef >> 1, so the block activities (and the selection) survive embedding.
+        const byte* payload = data.data() + meta_bytes;
+        auto block_at = block_table(image);
+        Parallel::parallel_for(selection->units_before.size() - 1, [&](size_t begin, size_t end) {
+            for_each_selected(activity.data(), *selection, begin, end, [&](uint64_t block, uint64_t ordinal) {
+                JCOEF* coefs = block_at(block);
+                const uint64_t slot = ordinal * per_block;
+                for (uint64_t j = 0; j < per_block && slot + j < slots; ++j) {
+                    const uint32_t bit = (payload[(slot + j) / 8] >> (7 - (slot + j) % 8)) & 1;
+                    coefs[j + 1] = kernel == KernelMode::Fast ? set_lsb_fast(coefs[j + 1], bit)
+                                                              : set_lsb_hardened(coefs[j + 1], bit);
+                }
+            });
+        }, 16);
+        return true;
+    }
+
+    std::optional<std::vector<byte>> BitKernels::dct_extract_adaptive(const JpegCoefImage& image,
+                                                                      const std::vector<byte>& activity,
+                                                                      uint64_t num_bytes, KernelMode kernel)
+    {
+        constexpr uint64_t per_block = DCTSIZE2 - 1;
+        if (activity.size() * per_block != image.ac_capacity_bits() ||
+            dct_adaptive_blocks_needed(num_bytes) > activity.size())
+            return std::nullopt;
+
+        const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, num_bytes);
+        const uint64_t slots = (num_bytes - meta_bytes) * 8ULL;
+        const uint64_t first = adaptive_first_block(num_bytes);
+        auto selection = select_units(activity.data(), first, activity.size() - first, (slots + per_block - 1) / per_block);
+        auto meta = dct_extract(image, meta_bytes, kernel);
+        if (!selection || !meta)
+            return std::nullopt;
+
+        auto block_at = block_table(image);
+        std::vector<byte> payload(num_bytes - meta_bytes, 0);
+        gather_selected(*selection, per_block, 1, payload, [&](size_t begin, size_t end, auto&& write) {
+            for_each_selected(activity.data(), *selection, begin, end, [&](uint64_t block, uint64_t ordinal) {
+                const JCOEF* coefs = block_at(block);
+                const uint64_t slot = ordinal * per_block;
+                for (uint64_t j = 0; j < per_block && slot + j < slots; ++j)
+                    write((slot + j) / 8, static_cast<byte>((coefs[j + 1] & 1) << (7 - (slot + j) % 8)));
+            });
+        });
+
+        meta->insert(meta->end(), payload.begin(), payload.end());
+        return meta;
+    }
+
+    std::vector<BitKernels::BenchResult> BitKernels::benchmark(uint64_t payload_bytes, uint32_t rounds)
+    {
+        using clock = std::chrono::steady_clock;
+        std::mt19937 rng(42);  // Fixed seed: same carriers for both families.
+
+        std::vector<byte> payload(payload_bytes);
+        for (auto& b : payload)
+            b = static_cast<byte>(rng());
+
+        auto best_of = [rounds](auto&& fn) {
+            double best = 0;
+            for (uint32_t r = 0; r < std::max(1u, rounds); ++r) {
+                auto start = clock::now();
+                fn();
+                double seconds = std::chrono::duration<double>(clock::now() - start).count();
+                if (r == 0 || seconds < best)
+                    best = seconds;
+            }
+            return best;
+        };
+        auto mb_s = [payload_bytes](double seconds) {
+            return seconds > 0 ? static_cast<double>(payload_bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+        };
+
+        std::vector<BenchResult> results;
+
+        /*Pixel carriers*/
+        for (LsbMode mode : {LsbMode::OneBit, LsbMode::TwoBits}) {
+            std::vector<byte> carrier(payload_bytes * (mode == LsbMode::OneBit ? 8 : 4) + META_STREAM_SIZE * 8);
+            for (auto& b : carrier)
+                b = static_cast<byte>(rng());
+            for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+                double embed = best_of([&] { pixel_embed(carrier.data(), carrier.size(), payload, mode, kernel); });
+                double extract = best_of([&] { (void)pixel_extract(carrier.data(), carrier.size(), payload_bytes, mode, kernel); });
+                results.push_back({mode == LsbMode::OneBit ? "pixel-1bit" : "pixel-2bit", kernel, mb_s(embed), mb_s(extract)});
+            }
+        }
+
+        /*Decoded images: the image_embed specializations PhotoHnS dispatches to (alpha-skip leaves alpha samples alone)*/
+        struct ImageCase
+        {
+            const char* name;
+            PixelFormat format;
+        };
+        const ImageCase images[] = {{"img8-rgb", {3, 8, false}}, {"img8-rgba-sa", {4, 8, true}},
+                                    {"img16-rgb", {3, 16, false}}, {"img16-rgba-sa", {4, 16, true}}};
+        for (const ImageCase& image : images) {
+            for (LsbMode mode : {LsbMode::OneBit, LsbMode::TwoBits}) {
+                uint64_t sample_count = image_samples_needed(payload_bytes, mode, image.format);
+                std::vector<byte> samples(sample_count * (image.format.bits_per_sample / 8));
+                for (auto& b : samples)
+                    b = static_cast<byte>(rng());
+                std::string name = std::string(image.name) + (mode == LsbMode::OneBit ? "-1bit" : "-2bit");
+                for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+                    double embed = best_of([&] {
+                        image_embed(samples.data(), sample_count, image.format, payload, mode, kernel);
+                    });
+                    double extract = best_of([&] {
+                        (void)image_extract(samples.data(), sample_count, image.format, payload_bytes, mode, kernel);
+                    });
+                    results.push_back({name, kernel, mb_s(embed), mb_s(extract)});
+                }
+            }
+        }
+
+        /*Raw bitmaps (RawHnS): metadata 1-bit, payload in mode, on 8-bit (stride 1) and 16-bit (stride 2) samples*/
+        for (size_t stride : {size_t{1}, size_t{2}}) {
+            for (LsbMode mode : {LsbMode::OneBit, LsbMode::TwoBits}) {
+                const uint64_t meta_bytes = std::min<uint64_t>(META_STREAM_SIZE, payload_bytes);
+                const uint64_t slots = slots_needed(payload_bytes, mode);
+                std::vector<byte> raw(slots * stride);
+                for (auto& b : raw)
+                    b = static_cast<byte>(rng());
+                std::vector<byte> out(payload_bytes);
+                byte* payload_base = raw.data() + meta_bytes * 8ULL * stride;
+                const uint64_t payload_slots = slots - meta_bytes * 8ULL;
+                std::string name = std::string(stride == 1 ? "raw8" : "raw16") + (mode == LsbMode::OneBit ? "-1bit" : "-2bit");
+                for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+                    double embed = best_of([&] {
+                        strided_embed(raw.data(), meta_bytes * 8ULL, stride, payload.data(), meta_bytes, LsbMode::OneBit, kernel);
+                        strided_embed(payload_base, payload_slots, stride, payload.data() + meta_bytes,
+                                      payload_bytes - meta_bytes, mode, kernel);
+                    });
+                    double extract = best_of([&] {
+                        strided_extract(raw.data(), meta_bytes * 8ULL, stride, out.data(), meta_bytes, LsbMode::OneBit, kernel);
+                        strided_extract(payload_base, payload_slots, stride, out.data() + meta_bytes,
+                                        payload_bytes - meta_bytes, mode, kernel);
+                    });
+                    results.push_back({name, kernel, mb_s(embed), mb_s(extract)});
+                }
+            }
+        }
+
+        /*Y4M (VideoHnS): one strided call per 1080p 4:2:0 frame, 1 bit per plane byte*/
+        {
+            constexpr uint64_t frame_size = 1920ULL * 1080 * 3 / 2;
+            constexpr uint64_t per_frame = frame_size / 8;
+            const uint64_t frames = (payload_bytes + per_frame - 1) / per_frame;
+            std::vector<byte> video(frames * frame_size);
+            for (auto& b : video)
+                b = static_cast<byte>(rng());
+            std::vector<byte> out(payload_bytes);
+            auto each_frame = [&](auto&& fn) {
+                for (uint64_t f = 0; f < frames; ++f) {
+                    uint64_t begin = f * per_frame;
+                    fn(video.data() + f * frame_size, begin, std::min(per_frame, payload_bytes - begin));
+                }
+            };
+            for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+                double embed = best_of([&] {
+                    each_frame([&](byte* frame, uint64_t begin, uint64_t bytes) {
+                        strided_embed(frame, frame_size, 1, payload.data() + begin, bytes, LsbMode::OneBit, kernel);
+                    });
+                });
+                double extract = best_of([&] {
+                    each_frame([&](byte* frame, uint64_t begin, uint64_t bytes) {
+                        strided_extract(frame, bytes * 8ULL, 1, out.data() + begin, bytes, LsbMode::OneBit, kernel);
+                    });
+                });
+                results.push_back({"y4m-frames", kernel, mb_s(embed), mb_s(extract)});
+            }
+        }
+
+        /*PCM carriers: 16/24-bit samples, 1 bit per sample*/
+        for (size_t stride : {size_t{2}, size_t{3}}) {
+            std::vector<byte> samples(payload_bytes * 8 * stride);
+            for (auto& b : samples)
+                b = static_cast<byte>(rng());
+            std::vector<byte> out(payload_bytes);
+            uint64_t slots = payload_bytes * 8;
+            for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+                double embed = best_of([&] {
+                    strided_embed(samples.data(), slots, stride, payload.data(), payload_bytes, LsbMode::OneBit, kernel);
+                });
+                double extract = best_of([&] {
+                    strided_extract(samples.data(), slots, stride, out.data(), payload_bytes, LsbMode::OneBit, kernel);
+                });
+                results.push_back({stride == 2 ? "pcm16-1bit" : "pcm24-1bit", kernel, mb_s(embed), mb_s(extract)});
+            }
+        }
+
+        /*DCT carrier: one component, coefficients spread over full range to hit clamps*/
+        JpegCoefImage dct;
+        JpegComponentCoefs comp;
+        comp.width_in_blocks = static_cast<JDIMENSION>((payload_bytes * 8ULL + DCTSIZE2 - 2) / (DCTSIZE2 - 1));
+        comp.height_in_blocks = 1;
+        comp.coefs.resize(static_cast<size_t>(comp.block_count()) * DCTSIZE2);
+        std::uniform_int_distribution<int32_t> coef_dist(-1100, 1100);
+        for (auto& c : comp.coefs)
+            c = static_cast<JCOEF>(coef_dist(rng));
+        dct.components.push_back(std::move(comp));
+        for (KernelMode kernel : {KernelMode::Fast, KernelMode::Hardened}) {
+            double embed = best_of([&] { dct_embed(dct, payload, kernel); });
+            double extract = best_of([&] { (void)dct_extract(dct, payload_bytes, kernel); });
+            results.push_back({"dct", kernel, mb_s(embed), mb_s(extract)});
+        }
+        return results;
+    }
+} // Yps
@@ -0,0 +1,264 @@
+#ifndef YPSHNS_BITKERNELS_HH
+#define YPSHNS_BITKERNELS_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <JpegCoefImage/JpegCoefImage.hh>
+
+namespace Yps
+{
+    /**
+     * Bit insertion/extraction kernels for every carrier type (MSB-first bit order).
+     * KernelMode::Fast      - SWAR over 8/4 carrier bytes with lookup tables indexed by payload bytes,
+     *                         branchy clamps and early exits (secret-dependent cache/branch behaviour).
+     * KernelMode::Hardened  - no table lookups or branches depending on payload bits, fixed trip counts,
+     *                         masked (branch-free) clamps; timing depends on payload size only.
+     * Work is split on payload bytes with Parallel::parallel_for.
+     */
+    class BitKernels
+    {
+    public:
+        /**
+         * Pixel LSB embed. OneBit: 1 bit per carrier byte.
+         * TwoBits: first META_STREAM_SIZE bytes in 1-bit mode, remainder 2 bits per carrier byte.
+         * @param carrier Modified in-place
+         * @param carrier_bytes Carrier size (bounds)
+         * @param data Stream to embed (meta + coded)
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param kernel Kernel family
+         * @return false, if carrier is too small or mode unsupported
+         */
+        static bool pixel_embed(byte* carrier, uint64_t carrier_bytes, const std::vector<byte>& data,
+                                LsbMode mode, KernelMode kernel);
+
+        /**
+         * Pixel LSB extract (layout as in pixel_embed).
+         * @param carrier Carrier bytes
+         * @param carrier_bytes Carrier size (bounds)
+         * @param num_bytes Bytes to extract (from stream start)
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param kernel Kernel family
+         * @return stream bytes or std::nullopt (carrier too small)
+         */
+        static std::optional<std::vector<byte>> pixel_extract(const byte* carrier, uint64_t carrier_bytes,
+                                                              uint64_t num_bytes, LsbMode mode, KernelMode kernel);
+
+        /**
+         * Carrier slots taken by a stream in pixel layout (first META_STREAM_SIZE bytes 1-bit, rest in mode).
+         * @param stream_bytes Meta + payload size
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @return number of slots
+         */
+        static uint64_t slots_needed(uint64_t stream_bytes, LsbMode mode);
+
+        /**
+         * Largest stream that fits a carrier in the layout of slots_needed (raw bitmaps, WAV, Y4M).
+         * @param slots Carrier slots
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @return stream bytes (0 if not even the metadata fits)
+         */
+        static uint64_t max_stream(uint64_t slots, LsbMode mode);
+
+        /**
+         * Interleaved image samples as decoded (stb order, native-endian 16-bit samples)
+         */
+        struct PixelFormat
+        {
+            uint32_t channels{1};         // 1..4 (2 and 4 carry alpha last)
+            uint32_t bits_per_sample{8};  // 8 or 16
+            bool skip_alpha{false};       // Payload leaves alpha samples untouched
+
+            [[nodiscard]] bool has_alpha() const { return channels == 2 || channels == 4; }
+        };
+
+        /**
+         * Samples spanned by a stream in image layout: metadata 1-bit from sample 0 (never in alpha),
+         * then payload in mode (from the next pixel boundary, if it skips alpha).
+         * @param stream_bytes Meta + payload size
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param format Image format
+         * @return number of samples
+         */
+        static uint64_t image_samples_needed(uint64_t stream_bytes, LsbMode mode, const PixelFormat& format);
+
+        /**
+         * Image LSB embed with a kernel specialized at compile time on (channels, bits per sample,
+         * bits per slot, skip alpha, kernel family); the specialization is picked once per call from a table.
+         * @param samples Decoded samples, modified in-place
+         * @param sample_count Number of samples (bounds)
+         * @param format Image format
+         * @param data Stream to embed (meta + coded)
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param kernel Kernel family
+         * @return false, if image is too small, format or mode unsupported
+         */
+        static bool image_embed(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                const std::vector<byte>& data, LsbMode mode, KernelMode kernel);
+
+        /**
+         * Image LSB extract (layout as in image_embed).
+         * @return stream bytes or std::nullopt (image too small, format or mode unsupported)
+         */
+        static std::optional<std::vector<byte>> image_extract(const void* samples, uint64_t sample_count,
+                                                              const PixelFormat& format, uint64_t num_bytes,
+                                                              LsbMode mode, KernelMode kernel);
+
+        /**
+         * Image LSB extract of stream bytes [stream_offset, stream_offset + num_bytes) (layout as in image_embed
+         * for a stream of at least that size): only the kernel groups covering the range are read.
+         * @return stream bytes or std::nullopt (image too small, format or mode unsupported)
+         */
+        static std::optional<std::vector<byte>> image_extract_range(const void* samples, uint64_t sample_count,
+                                                                    const PixelFormat& format, uint64_t stream_offset,
+                                                                    uint64_t num_bytes, LsbMode mode, KernelMode kernel);
+
+        /**
+         * Image LSB embed of stream bytes [stream_offset, stream_offset + data.size()) (layout as in image_embed
+         * for a stream of at least that size): only the samples of those bytes change.
+         * @return false, if image is too small, format or mode unsupported
+         */
+        static bool image_embed_range(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                      uint64_t stream_offset, const std::vector<byte>& data, LsbMode mode,
+                                      KernelMode kernel);
+
+        /**
+         * Pixels spanned by a stream in adaptive image layout (SlotOrder::Adaptive): metadata as in
+         * image layout, payload in whole pixels after it.
+         * @param stream_bytes Meta + payload size
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param format Image format
+         * @return number of pixels (upper bound: the most active pixels may lie anywhere after metadata)
+         */
+        static uint64_t image_adaptive_pixels_needed(uint64_t stream_bytes, LsbMode mode, const PixelFormat& format);
+
+        /**
+         * Adaptive image embed: metadata as in image_embed, payload in mode into the most active pixels
+         * after metadata (activity above a threshold, ties in raster order), filled in raster order.
+         * @param samples Decoded samples, modified in-place
+         * @param sample_count Number of samples (bounds)
+         * @param format Image format
+         * @param activity One byte per pixel (CostMap::pixel_activity)
+         * @param data Stream to embed (meta + coded)
+         * @param mode LsbMode::OneBit or LsbMode::TwoBits
+         * @param kernel Kernel family (metadata and clamps; slot order depends on the image only)
+         * @return false, if image is too small, format or mode unsupported
+         */
+        static bool image_embed_adaptive(void* samples, uint64_t sample_count, const PixelFormat& format,
+                                         const std::vector<byte>& activity, const std::vector<byte>& data,
+                                         LsbMode mode, KernelMode kernel);
+
+        /**
+         * Adaptive image extract (layout as in image_embed_adaptive, same activity map).
+         * @return stream bytes or std::nullopt (image too small, format or mode unsupported)
+         */
+        static std::optional<std::vector<byte>> image_extract_adaptive(const void* samples, uint64_t sample_count,
+                                                                       const PixelFormat& format,
+                                                                       const std::vector<byte>& activity,
+                                                                       uint64_t num_bytes, LsbMode mode,
+                                                                       KernelMode kernel);
+
+        /**
+         * Strided LSB embed into every stride-th byte (e.g. low bytes of little-endian PCM samples).
+         * Unlike pixel_embed there is no metadata region: mode applies to all bytes, callers split regions.
+         * @param carrier First slot byte
+         * @param slots Number of slots available
+         * @param stride Distance between slots in bytes (1 - contiguous planes, 2 - 16-bit, 3 - 24-bit samples)
+         * @param data Bytes to embed
+         * @param num_bytes Number of bytes
+         * @param mode LsbMode::OneBit (8 slots per byte) or LsbMode::TwoBits (4 slots per byte)
+         * @param kernel Kernel family
+         * @return false, if slots are too few or mode unsupported
+         */
+        static bool strided_embed(byte* carrier, uint64_t slots, size_t stride, const byte* data, uint64_t num_bytes,
+                                  LsbMode mode, KernelMode kernel);
+
+        /**
+         * Strided LSB extract (layout as in strided_embed).
+         * @return false, if slots are too few or mode unsupported
+         */
+        static bool strided_extract(const byte* carrier, uint64_t slots, size_t stride, byte* out, uint64_t num_bytes,
+                                    LsbMode mode, KernelMode kernel);
+
+        /**
+         * DCT-LSB embed: 1 bit per AC coefficient (skip DC), clamped to [-1024, 1023].
+         * @return false, if capacity is too small (nothing embedded)
+         */
+        static bool dct_embed(JpegCoefImage& image, const std::vector<byte>& data, KernelMode kernel);
+
+        /**
+         * DCT-LSB extract.
+         * @return stream bytes or std::nullopt (capacity too small)
+         */
+        static std::optional<std::vector<byte>> dct_extract(const JpegCoefImage& image, uint64_t num_bytes,
+                                                            KernelMode kernel);
+
+        /**
+         * DCT-LSB extract of stream bytes [stream_offset, stream_offset + num_bytes) (AC coefficients of the range only).
+         * @return stream bytes or std::nullopt (capacity too small)
+         */
+        static std::optional<std::vector<byte>> dct_extract_range(const JpegCoefImage& image, uint64_t stream_offset,
+                                                                  uint64_t num_bytes, KernelMode kernel);
+
+        /**
+         * DCT-LSB embed of stream bytes [stream_offset, stream_offset + data.size()) (AC coefficients of the range only).
+         * @return false, if capacity is too small
+         */
+        static bool dct_embed_range(JpegCoefImage& image, uint64_t stream_offset, const std::vector<byte>& data,
+                                    KernelMode kernel);
+
+        /**
+         * DCT blocks spanned by a stream in adaptive DCT layout: metadata as in dct_embed,
+         * payload in whole blocks (63 AC coefficients) after it.
+         * @return number of blocks (upper bound, as for image_adaptive_pixels_needed)
+         */
+        static uint64_t dct_adaptive_blocks_needed(uint64_t stream_bytes);
+
+        /**
+         * Adaptive DCT-LSB embed: metadata as in dct_embed, payload into the most active blocks after it.
+         * @param activity One byte per block (CostMap::block_activity)
+         * @return false, if capacity is too small (nothing embedded)
+         */
+        static bool dct_embed_adaptive(JpegCoefImage& image, const std::vector<byte>& activity,
+                                       const std::vector<byte>& data, KernelMode kernel);
+
+        /**
+         * Adaptive DCT-LSB extract (layout as in dct_embed_adaptive, same activity map).
+         * @return stream bytes or std::nullopt (capacity too small)
+         */
+        static std::optional<std::vector<byte>> dct_extract_adaptive(const JpegCoefImage& image,
+                                                                     const std::vector<byte>& activity,
+                                                                     uint64_t num_bytes, KernelMode kernel);
+
+        /**
+         * Throughput of one kernel family on one carrier type.
+         */
+        struct BenchResult
+        {
+            std::string carrier;
+            KernelMode kernel;
+            double embed_mb_s;
+            double extract_mb_s;
+        };
+
+        /**
+         * Measure every carrier path with both kernel families on synthetic carriers: generic pixel,
+         * the image_embed specializations (8/16-bit, alpha-skip), raw bitmaps, Y4M frames, PCM and DCT.
+         * @param payload_bytes Payload size per run
+         * @param rounds Runs per measurement (best time is taken)
+         * @return results (payload MB/s)
+         */
+        static std::vector<BenchResult> benchmark(uint64_t payload_bytes, uint32_t rounds);
+    };
+
+    /**
+     * @return "Fast" or "Hardened"
+     */
+    std::string to_string(KernelMode kernel);
+} // Yps
+
+#endif //YPSHNS_BITKERNELS_HH
@@ -0,0 +1,217 @@
+#ifndef YPSHNS_LRUCACHE_HH
+#define YPSHNS_LRUCACHE_HH
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+namespace Yps
+{
+    /**
+     * Thread-safe least-recently-used cache.
+     * get_or_compute() runs the (expensive) producer outside the lock and only once per key:
+     * concurrent callers asking for the same missing key wait for the first one.
+     * Optionally bounded by total weight too (e.g. bytes held by the values), not only by entry count.
+     * @tparam K Key (hashable)
+     * @tparam V Value (copyable)
+     */
+    template <typename K, typename V, typename Hash = std::hash<K>>
+    class LruCache
+    {
+    public:
+        /**
+         * Weight of a value (e.g. its size in bytes)
+         */
+        using Weigh = std::function<size_t(const V&)>;
+
+    private:
+        struct Entry
+        {
+            K key;
+            V value;
+            size_t weight;
+        };
+
+        size_t capacity;
+        size_t max_weight;
+        Weigh weigh;
+        size_t total_weight{0};
+        mutable std::mutex mutex;
+
+        /**
+         * Most recently used first
+         */
+        std::list<Entry> order;
+        std::unordered_map<K, typename std::list<Entry>::iterator, Hash> index;
+
+        /**
+         * Keys being computed right now
+         */
+        std::unordered_map<K, std::shared_future<std::optional<V>>, Hash> pending;
+
+        /**
+         * @note Caller holds mutex
+         */
+        std::optional<V> lookup(const K& key)
+        {
+            auto it = this->index.find(key);
+            if (it == this->index.end())
+                return std::nullopt;
+            this->order.splice(this->order.begin(), this->order, it->second);
+            return it->second->value;
+        }
+
+        /**
+         * Drop least recently used entries over capacity or max_weight
+         * @note Caller holds mutex
+         */
+        void evict()
+        {
+            while (!this->order.empty() &&
+                   (this->order.size() > this->capacity || (this->max_weight != 0 && this->total_weight > this->max_weight))) {
+                this->total_weight -= this->order.back().weight;
+                this->index.erase(this->order.back().key);
+                this->order.pop_back();
+            }
+        }
+
+        /**
+         * @note Caller holds mutex
+         */
+        void insert(const K& key, const V& value)
+        {
+            const size_t weight = this->weigh ? this->weigh(value) : 0;
+            auto it = this->index.find(key);
+            if (it != this->index.end()) {
+                this->total_weight -= it->second->weight;
+                this->order.erase(it->second);
+                this->index.erase(it);
+            }
+            // A value heavier than the whole budget would only flush everything else.
+            if (this->capacity == 0 || (this->max_weight != 0 && weight > this->max_weight))
+                return;
+            this->order.push_front(Entry{key, value, weight});
+            this->index[key] = this->order.begin();
+            this->total_weight += weight;
+            this->evict();
+        }
+
+    public:
+        /**
+         * @param capacity Maximum number of entries
+         * @param max_weight Maximum sum of weigh(value) over entries (0 - no limit)
+         * @param weigh Weight of a value (required for max_weight)
+         */
+        explicit LruCache(size_t capacity, size_t max_weight = 0, Weigh weigh = {})
+            : capacity(capacity), max_weight(weigh ? max_weight : 0), weigh(std::move(weigh)) {}
+
+        LruCache(const LruCache&) = delete;
+        LruCache& operator=(const LruCache&) = delete;
+
+        /**
+         * @return cached value (marks it most recently used) or std::nullopt
+         */
+        std::optional<V> get(const K& key)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->lookup(key);
+        }
+
+        /**
+         * Insert or replace value, evicting least recently used entries over capacity or max_weight
+         */
+        void put(const K& key, const V& value)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->insert(key, value);
+        }
+
+        /**
+         * Return cached value or produce it once.
+         * @param key Key
+         * @param produce Callable returning std::optional<V> (std::nullopt is not cached)
+         * @return value or std::nullopt (producer failed)
+         */
+        template <typename F>
+        std::optional<V> get_or_compute(const K& key, F&& produce)
+        {
+            std::promise<std::optional<V>> promise;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                if (auto hit = this->lookup(key))
+                    return hit;
+                auto it = this->pending.find(key);
+                if (it != this->pending.end()) {
+                    std::shared_future<std::optional<V>> waiting = it->second;
+                    lock.unlock();
+                    return waiting.get();
+                }
+                this->pending.emplace(key, promise.get_future().share());
+            }
+
+            std::optional<V> value;
+            try {
+                value = produce();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->pending.erase(key);
+                promise.set_value(std::nullopt);
+                throw;
+            }
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (value)
+                this->insert(key, *value);
+            this->pending.erase(key);
+            promise.set_value(value);
+            return value;
+        }
+
+        /**
+         * Visit and drop all entries (e.g. to wipe secrets)
+         * @param on_evict Called for every value before removal
+         */
+        void clear(const std::function<void(V&)>& on_evict = {})
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (on_evict)
+                for (auto& entry : this->order)
+                    on_evict(entry.value);
+            this->order.clear();
+            this->index.clear();
+            this->total_weight = 0;
+        }
+
+        /**
+         * Change limits, evicting least recently used entries over the new ones
+         * @param capacity Maximum number of entries
+         * @param max_weight Maximum total weight (0 - no limit; ignored without weigh)
+         */
+        void set_limits(size_t capacity, size_t max_weight)
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->capacity = capacity;
+            this->max_weight = this->weigh ? max_weight : 0;
+            this->evict();
+        }
+
+        [[nodiscard]] size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->order.size();
+        }
+
+        [[nodiscard]] size_t weight() const
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->total_weight;
+        }
+    };
+} // Yps
+
+#endif //YPSHNS_LRUCACHE_HH
@@ -0,0 +1,61 @@
+#include "CarrierCache.hh"
+
+#include <openssl/sha.h>
+
+namespace Yps
+{
+    uint64_t DecodedCarrier::bytes() const
+    {
+        uint64_t total = this->samples.size();
+        if (this->coefs)
+            for (const auto& comp : this->coefs->components)
+                total += comp.coefs.size() * sizeof(JCOEF);
+        return total;
+    }
+
+    CarrierCache::CarrierCache(size_t max_entries, uint64_t max_bytes)
+        : cache(max_entries, static_cast<size_t>(max_bytes),
+                [](const Entry& entry) { return static_cast<size_t>(entry->bytes()); })
+    {}
+
+    CarrierCache& CarrierCache::shared()
+    {
+        static CarrierCache instance;
+        return instance;
+    }
+
+    CarrierCache::Entry CarrierCache::get_or_decode(const std::vector<byte>& file, const Decoder& decode)
+    {
+        // Content key: the same template under another name (or path) still hits.
+        std::string key(SHA256_DIGEST_LENGTH, '\0');
+        SHA256(file.data(), file.size(), reinterpret_cast<byte*>(key.data()));
+
+        auto entry = this->cache.get_or_compute(key, [&]() -> std::optional<Entry> {
+            auto decoded = decode();
+            if (!decoded)
+                return std::nullopt;
+            return std::make_shared<const DecodedCarrier>(std::move(*decoded));
+        });
+        return entry ? *entry : nullptr;
+    }
+
+    void CarrierCache::set_limits(size_t max_entries, uint64_t max_bytes)
+    {
+        this->cache.set_limits(max_entries, static_cast<size_t>(max_bytes));
+    }
+
+    void CarrierCache::clear()
+    {
+        this->cache.clear();
+    }
+
+    size_t CarrierCache::size() const
+    {
+        return this->cache.size();
+    }
+
+    uint64_t CarrierCache::bytes() const
+    {
+        return this->cache.weight();
+    }
+} // Yps
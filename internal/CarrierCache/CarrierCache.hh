@@ -0,0 +1,102 @@
+#ifndef YPSHNS_CARRIERCACHE_HH
+#define YPSHNS_CARRIERCACHE_HH
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <Cache/LruCache.hh>
+#include <ImageAnalysis/ImageAnalysis.hh>
+#include <JpegCoefImage/JpegCoefImage.hh>
+
+namespace Yps
+{
+    /**
+     * Carrier as the embed kernels need it: PNG samples at file depth (with their one-sweep stats)
+     * or JPEG DCT coefficients.
+     */
+    struct DecodedCarrier
+    {
+        Extension format{Extension::PNG};
+
+        // PNG
+        int32_t width{};
+        int32_t height{};
+        int32_t channels{};
+        bool wide{false};
+
+        /**
+         * width * height * channels samples (native-endian uint16 when wide)
+         */
+        std::vector<byte> samples;
+        ImageStats stats;
+
+        // JPEG
+        std::optional<JpegCoefImage> coefs;
+
+        /**
+         * Memory held by samples/coefficients (cache weight)
+         */
+        [[nodiscard]] uint64_t bytes() const;
+    };
+
+    /**
+     * Decoded carriers keyed by the SHA-256 of the carrier file, for watermarking one template with
+     * many payloads: the first embed decodes, later ones start from the cached samples/coefficients.
+     * Entries are immutable and shared between jobs; each job embeds into its own copy, so the cached
+     * decode is never written. Least recently used entries are evicted over the entry or byte limit.
+     */
+    class CarrierCache
+    {
+    public:
+        using Entry = std::shared_ptr<const DecodedCarrier>;
+        using Decoder = std::function<std::optional<DecodedCarrier>()>;
+
+        static constexpr size_t DEFAULT_ENTRIES = 16;
+        static constexpr uint64_t DEFAULT_BYTES = 512ULL << 20;
+
+    private:
+        LruCache<std::string, Entry> cache;
+
+    public:
+        /**
+         * @param max_entries Maximum number of carriers
+         * @param max_bytes Maximum decoded bytes (DecodedCarrier::bytes()) over all carriers; a larger carrier is not kept
+         */
+        explicit CarrierCache(size_t max_entries = DEFAULT_ENTRIES, uint64_t max_bytes = DEFAULT_BYTES);
+
+        /**
+         * Process-wide cache used by PhotoHnS when EmbedOptions::cache_carrier is set
+         */
+        static CarrierCache& shared();
+
+        /**
+         * Cached decode of file, or decode it now (once per file: concurrent callers wait for the first).
+         * @param file Whole carrier file
+         * @param decode Decoder of file (std::nullopt is not cached)
+         * @return shared decode or nullptr (decode failed)
+         */
+        Entry get_or_decode(const std::vector<byte>& file, const Decoder& decode);
+
+        /**
+         * Change limits (evicts over the new ones)
+         */
+        void set_limits(size_t max_entries, uint64_t max_bytes);
+
+        void clear();
+
+        [[nodiscard]] size_t size() const;
+
+        /**
+         * Decoded bytes held
+         */
+        [[nodiscard]] uint64_t bytes() const;
+    };
+} // Yps
+
+#endif //YPSHNS_CARRIERCACHE_HH
@@ -0,0 +1,214 @@
+#include "ChunkedPayload.hh"
+
+#include <Encryption.hh>
+#include <Parallel/Parallel.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>   // For std::memcpy
+#include <exception>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr uint64_t ENTRY = sizeof(uint64_t);
+
+        void store_le(byte* out, uint64_t value)
+        {
+            for (uint32_t i = 0; i < ENTRY; ++i)
+                out[i] = static_cast<byte>(value >> (8 * i));
+        }
+
+        uint64_t load_le(const byte* in)
+        {
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < ENTRY; ++i)
+                value |= static_cast<uint64_t>(in[i]) << (8 * i);
+            return value;
+        }
+
+        uint64_t chunk_plain(uint64_t index, uint64_t plain_size, uint32_t chunk_size)
+        {
+            return std::min<uint64_t>(chunk_size, plain_size - index * chunk_size);
+        }
+
+        /**
+         * Ciphertext of chunks first..last and their seek-table entries (first..last+1).
+         */
+        struct ChunkSpan
+        {
+            std::vector<uint64_t> starts;
+            std::vector<byte> cipher;
+        };
+
+        std::optional<ChunkSpan> read_chunks(const ChunkedPayload::Reader& read, uint64_t plain_size,
+                                             uint32_t chunk_size, uint64_t first, uint64_t last)
+        {
+            auto table = read(first * ENTRY, (last - first + 2) * ENTRY);
+            if (!table || table->size() != (last - first + 2) * ENTRY)
+                return std::nullopt;
+
+            // Entries come from the carrier: each chunk must have exactly the size its plaintext implies.
+            const uint64_t chunks = ChunkedPayload::chunk_count(plain_size, chunk_size);
+            ChunkSpan span;
+            span.starts.resize(static_cast<size_t>(last - first + 2));
+            for (size_t k = 0; k < span.starts.size(); ++k)
+                span.starts[k] = load_le(table->data() + k * ENTRY);
+            for (uint64_t i = first; i <= last; ++i) {
+                const uint64_t expected = AES256Encryption::cipher_size(chunk_plain(i, plain_size, chunk_size));
+                if (span.starts[i - first] < (chunks + 1) * ENTRY ||
+                    span.starts[i - first + 1] - span.starts[i - first] != expected)
+                    return std::nullopt;
+            }
+
+            auto cipher = read(span.starts.front(), span.starts.back() - span.starts.front());
+            if (!cipher || cipher->size() != span.starts.back() - span.starts.front())
+                return std::nullopt;
+            span.cipher = std::move(*cipher);
+            return span;
+        }
+    }
+
+    uint64_t ChunkedPayload::chunk_count(uint64_t plain_size, uint32_t chunk_size)
+    {
+        return (plain_size + chunk_size - 1) / chunk_size;
+    }
+
+    uint64_t ChunkedPayload::encrypted_size(uint64_t plain_size, uint32_t chunk_size)
+    {
+        const uint64_t chunks = chunk_count(plain_size, chunk_size);
+        uint64_t size = (chunks + 1) * ENTRY;
+        if (chunks > 0) {
+            size += (chunks - 1) * AES256Encryption::cipher_size(chunk_size);
+            size += AES256Encryption::cipher_size(chunk_plain(chunks - 1, plain_size, chunk_size));
+        }
+        return size;
+    }
+
+    std::vector<byte> ChunkedPayload::encrypt(const std::vector<byte>& plain, uint32_t chunk_size, const byte* key)
+    {
+        const uint64_t chunks = chunk_count(plain.size(), chunk_size);
+        std::vector<byte> out(encrypted_size(plain.size(), chunk_size));
+
+        // Every chunk but the last has the same ciphertext size: offsets are known before encrypting.
+        uint64_t offset = (chunks + 1) * ENTRY;
+        for (uint64_t i = 0; i < chunks; ++i) {
+            store_le(out.data() + i * ENTRY, offset);
+            offset += AES256Encryption::cipher_size(chunk_plain(i, plain.size(), chunk_size));
+        }
+        store_le(out.data() + chunks * ENTRY, offset);
+
+        Parallel::parallel_for(static_cast<size_t>(chunks), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                AES256Encryption::encrypt_with(key, plain.data() + i * chunk_size,
+                                               static_cast<size_t>(chunk_plain(i, plain.size(), chunk_size)),
+                                               out.data() + load_le(out.data() + i * ENTRY));
+        });
+        return out;
+    }
+
+    std::optional<std::vector<byte>> ChunkedPayload::decrypt_range(const Reader& read, uint64_t plain_size,
+                                                                   uint32_t chunk_size, const byte* key,
+                                                                   uint64_t offset, uint64_t length)
+    {
+        if (chunk_size == 0 || chunk_size > MAX_CHUNK || offset > plain_size || length > plain_size - offset)
+            return std::nullopt;
+        if (length == 0)
+            return std::vector<byte>();
+
+        // Seek-table entries first..last+1 bound the chunks to read.
+        const uint64_t first = offset / chunk_size;
+        const uint64_t last = (offset + length - 1) / chunk_size;
+        auto span = read_chunks(read, plain_size, chunk_size, first, last);
+        if (!span)
+            return std::nullopt;
+        const std::vector<uint64_t>& starts = span->starts;
+        const std::vector<byte>& cipher = span->cipher;
+
+        // Chunks are independent: decrypt in parallel straight into the output window.
+        std::vector<byte> out(static_cast<size_t>(length));
+        std::atomic<bool> failed{false};
+        Parallel::parallel_for(static_cast<size_t>(last - first + 1), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end && !failed; ++k) {
+                const uint64_t index = first + k;
+                std::vector<byte> plain;
+                try {
+                    plain = AES256Encryption::decrypt_with(key, cipher.data() + (starts[k] - starts.front()),
+                                                           static_cast<size_t>(starts[k + 1] - starts[k]));
+                } catch (const std::exception&) {
+                    failed = true;
+                    return;
+                }
+                if (plain.size() != chunk_plain(index, plain_size, chunk_size)) {
+                    failed = true;
+                    return;
+                }
+                // Overlap of chunk [index * chunk_size, ...) with [offset, offset + length).
+                const uint64_t chunk_begin = index * chunk_size;
+                const uint64_t from = std::max(offset, chunk_begin);
+                const uint64_t to = std::min(offset + length, chunk_begin + plain.size());
+                std::memcpy(out.data() + (from - offset), plain.data() + (from - chunk_begin),
+                            static_cast<size_t>(to - from));
+            }
+        });
+        if (failed)
+            return std::nullopt;
+        return out;
+    }
+
+    std::optional<ChunkedPayload::Patch> ChunkedPayload::update(const Reader& read, uint64_t plain_size,
+                                                                uint32_t chunk_size, const byte* key,
+                                                                uint64_t offset, const std::vector<byte>& data)
+    {
+        if (chunk_size == 0 || chunk_size > MAX_CHUNK || offset > plain_size || data.size() > plain_size - offset)
+            return std::nullopt;
+        if (data.empty())
+            return Patch();
+
+        const uint64_t first = offset / chunk_size;
+        const uint64_t last = (offset + data.size() - 1) / chunk_size;
+        auto span = read_chunks(read, plain_size, chunk_size, first, last);
+        if (!span)
+            return std::nullopt;
+        const std::vector<uint64_t>& starts = span->starts;
+        Patch patch{starts.front(), std::move(span->cipher)};
+
+        // Same plain sizes, same ciphertext sizes: every chunk is re-encrypted (fresh IV) in its old place.
+        std::atomic<bool> failed{false};
+        Parallel::parallel_for(static_cast<size_t>(last - first + 1), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end && !failed; ++k) {
+                const uint64_t index = first + k;
+                const uint64_t chunk_begin = index * chunk_size;
+                const uint64_t size = chunk_plain(index, plain_size, chunk_size);
+                byte* chunk = patch.bytes.data() + (starts[k] - starts.front());
+                try {
+                    // Chunks inside the range are replaced whole; the edge ones keep the bytes around it
+                    // (decrypting them also rejects a wrong key before anything is written).
+                    if (index != first && index != last) {
+                        AES256Encryption::encrypt_with(key, data.data() + (chunk_begin - offset),
+                                                       static_cast<size_t>(size), chunk);
+                        continue;
+                    }
+                    std::vector<byte> plain = AES256Encryption::decrypt_with(key, chunk,
+                                                                             static_cast<size_t>(starts[k + 1] - starts[k]));
+                    if (plain.size() != size) {
+                        failed = true;
+                        return;
+                    }
+                    const uint64_t from = std::max(offset, chunk_begin);
+                    const uint64_t to = std::min<uint64_t>(offset + data.size(), chunk_begin + size);
+                    std::memcpy(plain.data() + (from - chunk_begin), data.data() + (from - offset),
+                                static_cast<size_t>(to - from));
+                    AES256Encryption::encrypt_with(key, plain.data(), plain.size(), chunk);
+                } catch (const std::exception&) {
+                    failed = true;
+                    return;
+                }
+            }
+        });
+        if (failed)
+            return std::nullopt;
+        return patch;
+    }
+} // Yps
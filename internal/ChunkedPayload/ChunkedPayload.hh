@@ -0,0 +1,91 @@
+#ifndef YPSHNS_CHUNKEDPAYLOAD_HH
+#define YPSHNS_CHUNKEDPAYLOAD_HH
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Encrypted payload cut into independently encrypted chunks (EmbedOptions::chunk_size), so any
+     * plaintext range can be recovered from the chunks covering it:
+     *   seek table: (chunks + 1) little-endian uint64 offsets of the chunks inside the payload
+     *               (the last one is the payload size);
+     *   chunk i:    AES-256-CBC(plain[i * chunk_size, ...)) with its own IV.
+     * Chunks are encrypted and decrypted in parallel; a range can be rewritten by re-encrypting its chunks.
+     */
+    class ChunkedPayload
+    {
+    public:
+        /**
+         * Reads bytes [offset, offset + size) of the encrypted payload (from carrier or memory)
+         */
+        using Reader = std::function<std::optional<std::vector<byte>>(uint64_t offset, uint64_t size)>;
+
+        /**
+         * Largest chunk (keeps one chunk inside an int-sized EVP call)
+         */
+        static constexpr uint32_t MAX_CHUNK = 1u << 30;
+
+        /**
+         * Bytes [offset, offset + bytes.size()) of the encrypted payload to overwrite
+         */
+        struct Patch
+        {
+            uint64_t offset{};
+            std::vector<byte> bytes;
+        };
+
+        static uint64_t chunk_count(uint64_t plain_size, uint32_t chunk_size);
+
+        /**
+         * Encrypted payload size for plain_size bytes (seek table included)
+         */
+        static uint64_t encrypted_size(uint64_t plain_size, uint32_t chunk_size);
+
+        /**
+         * @param plain Payload
+         * @param chunk_size Plain bytes per chunk (1..MAX_CHUNK)
+         * @param key 32-byte key
+         * @return seek table + chunks
+         */
+        static std::vector<byte> encrypt(const std::vector<byte>& plain, uint32_t chunk_size, const byte* key);
+
+        /**
+         * Decrypt plain bytes [offset, offset + length): reads the seek-table entries and the chunks
+         * covering the range only.
+         * @param read Source of the encrypted payload
+         * @param plain_size Payload size (from metadata)
+         * @param chunk_size Chunk size (from metadata)
+         * @param key 32-byte key
+         * @param offset First plain byte
+         * @param length Plain bytes (offset + length <= plain_size)
+         * @return plain bytes or std::nullopt (read failed, invalid seek table, bad key/padding)
+         */
+        static std::optional<std::vector<byte>> decrypt_range(const Reader& read, uint64_t plain_size,
+                                                              uint32_t chunk_size, const byte* key,
+                                                              uint64_t offset, uint64_t length);
+
+        /**
+         * Overwrite plain bytes [offset, offset + data.size()) without re-encrypting the rest: the chunks
+         * covering the range are re-encrypted with fresh IVs. Their sizes don't change, so neither does
+         * the seek table, and the new ciphertext replaces the old one in place.
+         * @param read Source of the encrypted payload
+         * @param plain_size Payload size (from metadata)
+         * @param chunk_size Chunk size (from metadata)
+         * @param key 32-byte key
+         * @param offset First plain byte
+         * @param data New bytes (offset + size <= plain_size)
+         * @return ciphertext of the covering chunks and its offset, or std::nullopt (read failed,
+         *         invalid seek table, bad key/padding)
+         */
+        static std::optional<Patch> update(const Reader& read, uint64_t plain_size, uint32_t chunk_size,
+                                           const byte* key, uint64_t offset, const std::vector<byte>& data);
+    };
+} // Yps
+
+#endif //YPSHNS_CHUNKEDPAYLOAD_HH
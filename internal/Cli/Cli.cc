@@ -0,0 +1,1069 @@
+#include "Cli.hh"
+
+#include <AuthorKey.hh>
+#include <EmbedData.hh>
+#include <AsyncHnS/AsyncHnS.hh>
+#include <BitKernels/BitKernels.hh>
+#include <ChunkedPayload/ChunkedPayload.hh>
+#include <ECC/ECC.hh>
+#include <KDF/KDF.hh>
+#include <PhotoHnS/PhotoHnS.hh>
+#include <Random/Random.hh>
+#include <RecordArchive/RecordArchive.hh>
+#include <Scanner/Scanner.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Yps
+{
+    namespace
+    {
+        namespace fs = std::filesystem;
+        using Clock = std::chrono::steady_clock;
+
+        constexpr const char* USAGE =
+            "usage: YpsHnS <command> [flags] <file|dir>...\n"
+            "  embed    -p <payload|-> [-o <file|dir>]  hide payload in every carrier\n"
+            "           -a <file> [-a <file>...]        several named records in one pass (instead of -p)\n"
+            "  extract  [-o <file|dir|->]               recover payloads (single input: stdout by default)\n"
+            "           [--offset N] [--length N]       byte range only (chunked payloads read just its chunks)\n"
+            "           [--record NAME]                 one record of a multi-record payload\n"
+            "  records                                  record index of multi-record payloads\n"
+            "  update   -p <bytes|-> --offset N [-o <file|dir>]\n"
+            "                                           overwrite part of a chunked payload (in place without -o)\n"
+            "  probe                                    format, geometry, capacity, own headers\n"
+            "  capacity                                 payload bytes per LsbMode (fails if a file can't be sized)\n"
+            "  scan                                     steganalysis table\n"
+            "  bench | selftest\n"
+            "flags: -j N  -r  -L <list|->  -q  --no-sync\n"
+            "embed: --ecc N  --chunk N  --segment  --adaptive  --hardened  --quality  --fresh-iv\n"
+            "       --passphrase-env VAR (default YPSHNS_PASSPHRASE)  --kdf-memory KiB  --kdf-passes N (also for extract)\n";
+
+        /**
+         * Parsed command line
+         */
+        struct Args
+        {
+            std::string command;
+            std::vector<std::string> paths;
+            std::optional<std::string> payload;
+            std::optional<std::string> output;
+            std::optional<std::string> list;
+            uint32_t jobs{};
+            bool recursive{false};
+            bool quiet{false};
+            bool sync{true};
+            bool fresh_iv{false};                  // embed: own ciphertext per carrier
+            EmbedOptions options;
+            std::optional<uint64_t> range_offset;  // extract/update --offset
+            std::optional<uint64_t> range_length;  // extract --length
+            std::vector<std::string> records;      // embed -a
+            std::optional<std::string> record;     // extract --record
+        };
+
+        /**
+         * One input file and its path below the argument it came from (mirrored into output directories)
+         */
+        struct Input
+        {
+            std::string path;
+            fs::path relative;
+        };
+
+        /**
+         * Swallows backend progress logs (-q)
+         */
+        class NullBuf : public std::streambuf
+        {
+        protected:
+            int overflow(int c) override { return traits_type::not_eof(c); }
+        };
+
+        /**
+         * Caps requests in flight: the submitting thread waits, callbacks release
+         */
+        class Window
+        {
+        private:
+            std::mutex mutex;
+            std::condition_variable changed;
+            size_t in_flight{};
+            const size_t limit;
+
+        public:
+            explicit Window(size_t limit) : limit(limit) {}
+
+            void acquire()
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->changed.wait(lock, [this]() { return this->in_flight < this->limit; });
+                ++this->in_flight;
+            }
+
+            void release()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(this->mutex);
+                    --this->in_flight;
+                }
+                this->changed.notify_all();
+            }
+
+            void drain()
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->changed.wait(lock, [this]() { return this->in_flight == 0; });
+            }
+        };
+
+        /**
+         * One JSON object per line (keys are literals, values escaped)
+         */
+        class JsonLine
+        {
+        private:
+            std::ostringstream stream;
+            bool first{true};
+
+            std::ostringstream& key(const char* name)
+            {
+                this->stream << (this->first ? "{\"" : ",\"") << name << "\":";
+                this->first = false;
+                return this->stream;
+            }
+
+        public:
+            JsonLine& str(const char* name, const std::string& value)
+            {
+                auto& s = this->key(name);
+                s << '"';
+                for (const char c : value) {
+                    switch (c) {
+                        case '"': s << "\\\""; break;
+                        case '\\': s << "\\\\"; break;
+                        case '\n': s << "\\n"; break;
+                        case '\t': s << "\\t"; break;
+                        default:
+                            if (static_cast<unsigned char>(c) < 0x20)
+                                s << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                                  << std::dec << std::setfill(' ');
+                            else
+                                s << c;
+                    }
+                }
+                s << '"';
+                return *this;
+            }
+
+            JsonLine& num(const char* name, uint64_t value)
+            {
+                this->key(name) << value;
+                return *this;
+            }
+
+            JsonLine& num(const char* name, int64_t value)
+            {
+                this->key(name) << value;
+                return *this;
+            }
+
+            JsonLine& real(const char* name, double value)
+            {
+                auto& s = this->key(name);
+                if (std::isfinite(value))
+                    s << std::setprecision(6) << value;
+                else
+                    s << "null";  // PSNR of an unchanged image
+                return *this;
+            }
+
+            JsonLine& flag(const char* name, bool value)
+            {
+                this->key(name) << (value ? "true" : "false");
+                return *this;
+            }
+
+            [[nodiscard]] std::string line() const { return this->stream.str() + "}"; }
+        };
+
+        /**
+         * Prints result lines as requests complete and sums stage times for the summary
+         */
+        class Reporter
+        {
+        private:
+            std::mutex mutex;
+            std::ostream& out;
+            uint64_t files{};
+            uint64_t succeeded{};
+            StageTimes total;
+
+        public:
+            explicit Reporter(std::ostream& out) : out(out) {}
+
+            void add(const JsonLine& line, bool ok, const StageTimes& times)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->out << line.line() << '\n';
+                ++this->files;
+                this->succeeded += ok ? 1 : 0;
+                this->total.read += times.read;
+                this->total.cpu += times.cpu;
+                this->total.write += times.write;
+            }
+
+            /**
+             * Detail lines of one file (not counted)
+             */
+            void add_lines(const std::vector<JsonLine>& lines)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                for (const JsonLine& line : lines)
+                    this->out << line.line() << '\n';
+            }
+
+            /**
+             * @return exit code (0 - all files succeeded)
+             */
+            int summary(const Args& args, uint32_t jobs, double wall, double sync_seconds)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                JsonLine line;
+                line.str("op", "summary").str("command", args.command).num("files", this->files)
+                    .num("ok", this->succeeded).num("failed", this->files - this->succeeded)
+                    .num("jobs", static_cast<uint64_t>(jobs)).real("wall_s", wall)
+                    .real("read_s", this->total.read).real("cpu_s", this->total.cpu)
+                    .real("write_s", this->total.write).real("sync_s", sync_seconds)
+                    .real("files_per_s", wall > 0 ? static_cast<double>(this->files) / wall : 0.0);
+                this->out << line.line() << std::endl;
+                return this->succeeded == this->files ? 0 : 1;
+            }
+        };
+
+        const char* extension_name(Extension ext)
+        {
+            switch (ext) {
+                case Extension::JPEG: return "JPEG";
+                case Extension::PNG: return "PNG";
+                case Extension::WAV: return "WAV";
+                case Extension::Y4M: return "Y4M";
+                case Extension::PPM: return "PPM";
+                case Extension::PGM: return "PGM";
+                case Extension::BMP: return "BMP";
+                case Extension::TGA: return "TGA";
+            }
+            return "?";
+        }
+
+        std::optional<uint64_t> parse_number(const std::string& text, uint64_t max)
+        {
+            if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 19)
+                return std::nullopt;
+            const uint64_t value = std::stoull(text);
+            if (value > max)
+                return std::nullopt;
+            return value;
+        }
+
+        /**
+         * @return arguments or std::nullopt (message printed)
+         */
+        std::optional<Args> parse_args(int argc, char** argv)
+        {
+            Args args;
+            args.command = argv[1];
+            bool positional_only = false;
+            for (int i = 2; i < argc; ++i) {
+                const std::string arg = argv[i];
+                auto value = [&]() -> std::optional<std::string> {
+                    if (i + 1 >= argc) {
+                        std::cerr << "YpsHnS: " << arg << " needs a value" << std::endl;
+                        return std::nullopt;
+                    }
+                    return std::string(argv[++i]);
+                };
+                auto number = [&](uint64_t max) -> std::optional<uint64_t> {
+                    auto text = value();
+                    if (!text)
+                        return std::nullopt;
+                    auto parsed = parse_number(*text, max);
+                    if (!parsed)
+                        std::cerr << "YpsHnS: invalid value for " << arg << ": " << *text << std::endl;
+                    return parsed;
+                };
+
+                if (positional_only || arg.empty() || arg[0] != '-' || arg == "-") {
+                    args.paths.push_back(arg);
+                } else if (arg == "--") {
+                    positional_only = true;
+                } else if (arg == "-p" || arg == "--payload") {
+                    if (!(args.payload = value()))
+                        return std::nullopt;
+                } else if (arg == "-a" || arg == "--add") {
+                    auto record = value();
+                    if (!record)
+                        return std::nullopt;
+                    args.records.push_back(*record);
+                } else if (arg == "--record") {
+                    if (!(args.record = value()))
+                        return std::nullopt;
+                } else if (arg == "-o" || arg == "--output") {
+                    if (!(args.output = value()))
+                        return std::nullopt;
+                } else if (arg == "-L" || arg == "--list") {
+                    if (!(args.list = value()))
+                        return std::nullopt;
+                } else if (arg == "-j" || arg == "--jobs") {
+                    auto jobs = number(4096);
+                    if (!jobs || *jobs == 0)
+                        return std::nullopt;
+                    args.jobs = static_cast<uint32_t>(*jobs);
+                } else if (arg == "-r") {
+                    args.recursive = true;
+                } else if (arg == "-q" || arg == "--quiet") {
+                    args.quiet = true;
+                } else if (arg == "--no-sync") {
+                    args.sync = false;
+                } else if (arg == "--ecc") {
+                    auto parity = number(254);
+                    if (!parity)
+                        return std::nullopt;
+                    args.options.ecc_parity = static_cast<uint8_t>(*parity);
+                } else if (arg == "--chunk") {
+                    auto chunk = number(ChunkedPayload::MAX_CHUNK);
+                    if (!chunk)
+                        return std::nullopt;
+                    args.options.chunk_size = static_cast<uint32_t>(*chunk);
+                } else if (arg == "--offset") {
+                    auto offset = number(UINT64_MAX);
+                    if (!offset)
+                        return std::nullopt;
+                    args.range_offset = *offset;
+                } else if (arg == "--length") {
+                    auto length = number(UINT64_MAX);
+                    if (!length)
+                        return std::nullopt;
+                    args.range_length = *length;
+                } else if (arg == "--segment") {
+                    args.options.placement = Placement::Segment;
+                } else if (arg == "--adaptive") {
+                    args.options.slot_order = SlotOrder::Adaptive;
+                } else if (arg == "--hardened") {
+                    args.options.kernel_mode = KernelMode::Hardened;
+                } else if (arg == "--quality") {
+                    args.options.quality_report = true;
+                } else if (arg == "--fresh-iv") {
+                    args.fresh_iv = true;
+                } else if (arg == "--passphrase-env") {
+                    auto name = value();
+                    if (!name)
+                        return std::nullopt;
+                    const char* passphrase = std::getenv(name->c_str());
+                    if (!passphrase) {
+                        std::cerr << "YpsHnS: environment variable not set: " << *name << std::endl;
+                        return std::nullopt;
+                    }
+                    args.options.passphrase = std::string(passphrase);
+                } else if (arg == "--kdf-memory") {
+                    auto kib = number(UINT32_MAX);
+                    if (!kib)
+                        return std::nullopt;
+                    args.options.kdf.memory_kib = static_cast<uint32_t>(*kib);
+                } else if (arg == "--kdf-passes") {
+                    auto passes = number(UINT32_MAX);
+                    if (!passes)
+                        return std::nullopt;
+                    args.options.kdf.passes = static_cast<uint32_t>(*passes);
+                } else {
+                    std::cerr << "YpsHnS: unknown flag " << arg << std::endl;
+                    return std::nullopt;
+                }
+            }
+            // YPSHNS_PASSPHRASE is the default passphrase: salted Argon2id per embed, like --passphrase-env.
+            if (!args.options.passphrase)
+                if (const char* passphrase = std::getenv("YPSHNS_PASSPHRASE"))
+                    args.options.passphrase = std::string(passphrase);
+            if (args.payload == std::string("-") && args.list == std::string("-")) {
+                std::cerr << "YpsHnS: payload and file list cannot both come from stdin" << std::endl;
+                return std::nullopt;
+            }
+            return args;
+        }
+
+        /**
+         * Paths of a -L list, one per line ("-" - stdin)
+         */
+        std::vector<std::string> read_list(const std::string& list)
+        {
+            std::vector<std::string> paths;
+            std::ifstream file;
+            std::istream* in = &std::cin;
+            if (list != "-") {
+                file.open(list);
+                if (!file)
+                    std::cerr << "YpsHnS: cannot read list " << list << std::endl;
+                in = &file;
+            }
+            for (std::string line; std::getline(*in, line);) {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (!line.empty())
+                    paths.push_back(line);
+            }
+            return paths;
+        }
+
+        /**
+         * Files of every argument (directories in sorted walk order, -r recurses) plus -L list entries
+         */
+        std::vector<Input> collect_inputs(const Args& args)
+        {
+            std::vector<std::string> paths = args.paths;
+            if (args.list) {
+                auto listed = read_list(*args.list);
+                paths.insert(paths.end(), listed.begin(), listed.end());
+            }
+
+            std::vector<Input> inputs;
+            for (const auto& path : paths) {
+                std::error_code ec;
+                if (!fs::is_directory(path, ec)) {
+                    inputs.push_back({path, fs::path(path).filename()});
+                    continue;
+                }
+                std::vector<Input> found;
+                auto collect = [&](auto iterator) {
+                    for (const auto& entry : iterator)
+                        if (entry.is_regular_file(ec))
+                            found.push_back({entry.path().string(), entry.path().lexically_relative(path)});
+                };
+                if (args.recursive)
+                    collect(fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied, ec));
+                else
+                    collect(fs::directory_iterator(path, fs::directory_options::skip_permission_denied, ec));
+                std::sort(found.begin(), found.end(), [](const Input& a, const Input& b) { return a.path < b.path; });
+                inputs.insert(inputs.end(), found.begin(), found.end());
+            }
+            return inputs;
+        }
+
+        /**
+         * Output path of every input: a file (single input, -o not a directory) or -o/<relative path> + suffix
+         */
+        std::optional<std::vector<std::string>> map_outputs(const std::vector<Input>& inputs, const std::string& output,
+                                                            const std::string& suffix)
+        {
+            std::error_code ec;
+            const bool to_dir = inputs.size() > 1 || fs::is_directory(output, ec) ||
+                                (!output.empty() && (output.back() == '/' || output.back() == '\\'));
+            std::vector<std::string> outputs;
+            outputs.reserve(inputs.size());
+            for (const auto& input : inputs) {
+                const fs::path path = to_dir ? fs::path(output) / (input.relative.string() + suffix) : fs::path(output);
+                if (fs::exists(path, ec) && fs::equivalent(path, input.path, ec)) {
+                    std::cerr << "YpsHnS: output would overwrite input " << input.path << std::endl;
+                    return std::nullopt;
+                }
+                if (path.has_parent_path())
+                    fs::create_directories(path.parent_path(), ec);
+                outputs.push_back(path.string());
+            }
+            return outputs;
+        }
+
+        std::optional<std::vector<byte>> read_payload(const std::string& source)
+        {
+            if (source == "-")
+                return std::vector<byte>(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            std::ifstream file(source, std::ios::binary);
+            if (!file)
+                return std::nullopt;
+            return std::vector<byte>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+
+        JsonLine result_line(const char* op, size_t index, const std::string& input)
+        {
+            JsonLine line;
+            line.str("op", op).num("index", static_cast<uint64_t>(index)).str("input", input);
+            return line;
+        }
+
+        void add_times(JsonLine& line, const StageTimes& times)
+        {
+            line.real("read_s", times.read).real("cpu_s", times.cpu).real("write_s", times.write);
+        }
+
+        double since(Clock::time_point start)
+        {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        /**
+         * Flush outputs (unless --no-sync)
+         * @return fsync time, or -1 if an fsync failed
+         */
+        double sync_outputs(const Args& args)
+        {
+            if (!args.sync)
+                return 0.0;
+            const auto start = Clock::now();
+            const bool ok = AsyncIO::shared().sync().get();
+            return ok ? since(start) : -1.0;
+        }
+
+        /**
+         * Multi-record payload of -a files (records named by file name)
+         */
+        std::optional<std::vector<byte>> pack_records(const std::vector<std::string>& files)
+        {
+            std::vector<Record> records;
+            records.reserve(files.size());
+            for (const auto& file : files) {
+                auto data = read_payload(file);
+                if (!data || file == "-") {
+                    std::cerr << "YpsHnS: cannot read record " << file << std::endl;
+                    return std::nullopt;
+                }
+                records.push_back(Record{fs::path(file).filename().string(), std::move(*data)});
+            }
+            auto payload = RecordArchive::pack(records);
+            if (!payload)
+                std::cerr << "YpsHnS: record names must be unique (at most " << RecordArchive::MAX_NAME << " bytes)" << std::endl;
+            return payload;
+        }
+
+        int run_embed(const Args& args, const std::vector<Input>& inputs, uint32_t jobs, std::ostream& out)
+        {
+            if (static_cast<bool>(args.payload) == !args.records.empty() || !args.output) {
+                std::cerr << "YpsHnS: embed needs -p <payload|-> or -a <file>... and -o <file|dir>" << std::endl;
+                return 2;
+            }
+            // Records: packed once, chunked so each one stays separately readable (as HnS::embed_records).
+            EmbedOptions options = args.options;
+            std::optional<std::vector<byte>> payload;
+            if (!args.records.empty()) {
+                payload = pack_records(args.records);
+                if (!payload)
+                    return 2;
+                if (options.chunk_size == 0)
+                    options.chunk_size = RecordArchive::DEFAULT_CHUNK;
+            } else if (!(payload = read_payload(*args.payload))) {
+                std::cerr << "YpsHnS: cannot read payload " << *args.payload << std::endl;
+                return 2;
+            }
+            auto outputs = map_outputs(inputs, *args.output, "");
+            if (!outputs)
+                return 2;
+
+            const auto start = Clock::now();
+            ThreadPool pool(jobs);
+            AsyncHnS hns(options, AsyncIO::shared(), pool);
+
+            // Broadcast: key, encryption and ECC once; every carrier only gets bit insertion and its codec.
+            auto prepared = hns.prepare(*payload, args.fresh_iv);
+            if (!prepared) {
+                std::cerr << "YpsHnS: cannot encrypt payload" << std::endl;
+                return 1;
+            }
+            payload.reset();
+
+            Window window(2 * static_cast<size_t>(jobs));  // Reads of the next carriers overlap CPU stages
+            Reporter reporter(out);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                window.acquire();
+                const std::string input = inputs[i].path;
+                hns.embed(prepared, input, (*outputs)[i], [&window, &reporter, i, input](AsyncEmbedResult result) {
+                    JsonLine line = result_line("embed", i, input);
+                    line.str("output", result.output).flag("ok", result.ok).str("error", result.error);
+                    add_times(line, result.times);
+                    if (result.report) {
+                        line.real("psnr", result.report->psnr).real("ssim", result.report->ssim)
+                            .real("dct_change_ratio", result.report->dct_change_ratio)
+                            .num("size_delta", result.report->size_delta());
+                    }
+                    reporter.add(line, result.ok, result.times);
+                    window.release();
+                });
+            }
+            window.drain();
+            const double sync_seconds = sync_outputs(args);
+            const int code = reporter.summary(args, jobs, since(start), sync_seconds);
+            return sync_seconds < 0 ? 1 : code;
+        }
+
+        int run_extract(const Args& args, const std::vector<Input>& inputs, uint32_t jobs, std::ostream& out,
+                        std::ostream& payload_out)
+        {
+            const bool to_stdout = args.output ? *args.output == "-" : inputs.size() == 1;
+            if (to_stdout && inputs.size() != 1) {
+                std::cerr << "YpsHnS: stdout takes the payload of exactly one file" << std::endl;
+                return 2;
+            }
+            std::vector<std::string> outputs(inputs.size(), "-");
+            if (!to_stdout) {
+                if (!args.output) {
+                    std::cerr << "YpsHnS: extract of several files needs -o <dir>" << std::endl;
+                    return 2;
+                }
+                auto mapped = map_outputs(inputs, *args.output, ".bin");
+                if (!mapped)
+                    return 2;
+                outputs = std::move(*mapped);
+            }
+
+            const auto start = Clock::now();
+            ThreadPool pool(jobs);
+            AsyncHnS hns(args.options, AsyncIO::shared(), pool);
+            Window window(2 * static_cast<size_t>(jobs));
+            Reporter reporter(out);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                window.acquire();
+                const std::string input = inputs[i].path;
+                const std::string output = outputs[i];
+                auto done = [&window, &reporter, &payload_out, i, input, output](AsyncExtractResult result) {
+                    auto report = [&window, &reporter, i, input, output](const AsyncExtractResult& r, bool ok,
+                                                                        const std::string& error, uint64_t bytes) {
+                        JsonLine line = result_line("extract", i, input);
+                        line.str("output", output).flag("ok", ok).str("error", error).num("bytes", bytes);
+                        add_times(line, r.times);
+                        reporter.add(line, ok, r.times);
+                        window.release();
+                    };
+                    if (!result.data) {
+                        report(result, false, result.error, 0);
+                        return;
+                    }
+                    const uint64_t bytes = result.data->size();
+                    if (output == "-") {
+                        payload_out.write(reinterpret_cast<const char*>(result.data->data()),
+                                          static_cast<std::streamsize>(bytes));
+                        payload_out.flush();
+                        report(result, static_cast<bool>(payload_out), payload_out ? "" : "write failed", bytes);
+                        return;
+                    }
+                    const auto write_start = Clock::now();
+                    auto shared_result = std::make_shared<AsyncExtractResult>(std::move(result));
+                    std::vector<byte> data = std::move(*shared_result->data);
+                    AsyncIO::shared().write(output, std::move(data), [report, shared_result, write_start, bytes](bool ok) {
+                        shared_result->times.write = since(write_start);
+                        report(*shared_result, ok, ok ? "" : "write failed", bytes);
+                    });
+                };
+                if (args.record)
+                    hns.extract_record(input, *args.record, done);
+                else if (args.range_offset || args.range_length)
+                    hns.extract_range(input, args.range_offset.value_or(0), args.range_length.value_or(UINT64_MAX), done);
+                else
+                    hns.extract(input, done);
+            }
+            window.drain();
+            const double sync_seconds = to_stdout ? 0.0 : sync_outputs(args);
+            const int code = reporter.summary(args, jobs, since(start), sync_seconds);
+            return sync_seconds < 0 ? 1 : code;
+        }
+
+        /**
+         * update: the same bytes at the same offset of every file, each updated in place or into -o
+         */
+        int run_update(const Args& args, const std::vector<Input>& inputs, uint32_t jobs, std::ostream& out)
+        {
+            if (!args.payload || !args.range_offset) {
+                std::cerr << "YpsHnS: update needs -p <bytes|-> and --offset N" << std::endl;
+                return 2;
+            }
+            auto data = read_payload(*args.payload);
+            if (!data) {
+                std::cerr << "YpsHnS: cannot read payload " << *args.payload << std::endl;
+                return 2;
+            }
+            std::vector<std::string> outputs;
+            if (args.output) {
+                auto mapped = map_outputs(inputs, *args.output, "");
+                if (!mapped)
+                    return 2;
+                outputs = std::move(*mapped);
+            } else {
+                for (const auto& input : inputs)
+                    outputs.push_back(input.path);
+            }
+
+            const auto start = Clock::now();
+            ThreadPool pool(jobs);
+            AsyncHnS hns(args.options, AsyncIO::shared(), pool);
+            Window window(2 * static_cast<size_t>(jobs));
+            Reporter reporter(out);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                window.acquire();
+                const std::string input = inputs[i].path;
+                hns.update(input, *args.range_offset, *data, outputs[i], [&window, &reporter, i, input](AsyncEmbedResult result) {
+                    JsonLine line = result_line("update", i, input);
+                    line.str("output", result.output).flag("ok", result.ok).str("error", result.error);
+                    add_times(line, result.times);
+                    reporter.add(line, result.ok, result.times);
+                    window.release();
+                });
+            }
+            window.drain();
+            const double sync_seconds = sync_outputs(args);
+            const int code = reporter.summary(args, jobs, since(start), sync_seconds);
+            return sync_seconds < 0 ? 1 : code;
+        }
+
+        /**
+         * records: a line per record, then a line per file
+         */
+        int run_records(const Args& args, const std::vector<Input>& inputs, uint32_t jobs, std::ostream& out)
+        {
+            const auto start = Clock::now();
+            ThreadPool pool(jobs);
+            AsyncHnS hns(args.options, AsyncIO::shared(), pool);
+            Window window(2 * static_cast<size_t>(jobs));
+            Reporter reporter(out);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                window.acquire();
+                const std::string input = inputs[i].path;
+                hns.list_records(input, [&window, &reporter, i, input](AsyncRecordsResult result) {
+                    const bool ok = result.records.has_value();
+                    std::vector<JsonLine> lines;
+                    if (ok) {
+                        for (const RecordEntry& entry : *result.records) {
+                            JsonLine line = result_line("record", i, input);
+                            line.str("name", entry.name).num("offset", entry.offset).num("size", entry.size);
+                            lines.push_back(std::move(line));
+                        }
+                    }
+                    reporter.add_lines(lines);
+                    JsonLine line = result_line("records", i, input);
+                    line.flag("ok", ok).str("error", result.error)
+                        .num("count", static_cast<uint64_t>(ok ? result.records->size() : 0));
+                    add_times(line, result.times);
+                    reporter.add(line, ok, result.times);
+                    window.release();
+                });
+            }
+            window.drain();
+            return reporter.summary(args, jobs, since(start), 0.0);
+        }
+
+        /**
+         * probe: full report; capacity: payload bytes only.
+         * A file whose format no backend can size (Probe error) is a failed row, so the exit status is 1.
+         */
+        int run_probe(const Args& args, const std::vector<Input>& inputs, uint32_t jobs, std::ostream& out)
+        {
+            const bool capacity_only = args.command == "capacity";
+            const auto start = Clock::now();
+            ThreadPool pool(jobs);
+            AsyncHnS hns(args.options, AsyncIO::shared(), pool);
+            Window window(2 * static_cast<size_t>(jobs));
+            Reporter reporter(out);
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                window.acquire();
+                const std::string input = inputs[i].path;
+                hns.probe(input, [&window, &reporter, &args, capacity_only, i, input](AsyncProbeResult result) {
+                    const ProbeReport& r = result.report;
+                    const bool ok = r.error.empty();
+                    JsonLine line = result_line(args.command.c_str(), i, input);
+                    line.flag("ok", ok).str("error", r.error);
+                    if (r.format)
+                        line.str("format", extension_name(*r.format));
+                    line.num("capacity_1bit", r.capacity[0]).num("capacity_2bit", r.capacity[1]);
+                    if (!capacity_only) {
+                        line.num("width", static_cast<uint64_t>(r.width)).num("height", static_cast<uint64_t>(r.height))
+                            .num("channels", static_cast<uint64_t>(r.channels))
+                            .num("bits_per_sample", static_cast<uint64_t>(r.bits_per_sample))
+                            .flag("has_payload", r.has_payload).flag("has_segments", r.has_segments);
+                        add_times(line, result.times);
+                    }
+                    reporter.add(line, ok, result.times);
+                    window.release();
+                });
+            }
+            window.drain();
+            return reporter.summary(args, jobs, since(start), 0.0);
+        }
+
+        // Benchmark Fast vs Hardened bit kernels per carrier type (payload MB/s, best of several runs).
+        int run_bench()
+        {
+            constexpr uint64_t payload_bytes = 8ULL * 1024 * 1024;
+            std::cout << "Kernel benchmark, payload " << payload_bytes / (1024 * 1024) << " MiB" << std::endl;
+            std::cout << std::left << std::setw(20) << "carrier" << std::setw(10) << "kernel"
+                      << std::setw(14) << "embed MB/s" << std::setw(14) << "extract MB/s" << std::endl;
+            for (const auto& r : BitKernels::benchmark(payload_bytes, 5)) {
+                std::cout << std::left << std::setw(20) << r.carrier << std::setw(10) << to_string(r.kernel)
+                          << std::setw(14) << std::fixed << std::setprecision(1) << r.embed_mb_s
+                          << std::setw(14) << r.extract_mb_s << std::endl;
+            }
+            return 0;
+        }
+
+        // Scan images (files or directories, -r to recurse) for hidden payloads; one row per file.
+        int run_scan(const Args& args)
+        {
+            std::vector<std::string> paths = args.paths;
+            if (args.list) {
+                auto listed = read_list(*args.list);
+                paths.insert(paths.end(), listed.begin(), listed.end());
+            }
+            if (paths.empty()) {
+                std::cerr << "usage: YpsHnS scan [-r] <file|dir>..." << std::endl;
+                return 2;
+            }
+
+            const auto start = Clock::now();
+            const auto reports = Scanner::scan(paths, args.recursive);
+            const double seconds = since(start);
+
+            std::cout << std::left << std::setw(8) << "score" << std::setw(8) << "chi" << std::setw(8) << "extent"
+                      << std::setw(8) << "rs" << std::setw(8) << "dct" << std::setw(6) << "own" << "path" << std::endl;
+            size_t scanned = 0;
+            for (const auto& r : reports) {
+                if (!r.error.empty()) {
+                    std::cout << std::setw(46) << ("- " + r.error) << r.path << std::endl;
+                    continue;
+                }
+                ++scanned;
+                const std::string own = std::string(r.own_payload ? "L" : "") + (r.own_segments ? "S" : "");
+                std::cout << std::fixed << std::setprecision(3) << std::setw(8) << r.score << std::setw(8) << r.chi_square
+                          << std::setw(8) << r.chi_extent << std::setw(8) << r.rs << std::setw(8) << r.dct
+                          << std::setw(6) << (own.empty() ? "-" : own) << r.path << std::endl;
+            }
+            std::cout << scanned << " images in " << std::setprecision(2) << seconds << " s ("
+                      << std::setprecision(1) << (seconds > 0 ? scanned / seconds : 0.0) << " images/s)" << std::endl;
+            return 0;
+        }
+
+        // Deterministic mode repeats its stream for the same seed; OS seeding comes back after it.
+        bool run_random_test()
+        {
+            Random::set_seed(20240601);
+            const uint64_t first = Random::next_u64();
+            const std::vector<byte> first_bytes = Random::bytes(Random::BUFFER_SIZE + 1);
+            Random::set_seed(20240601);
+            const bool repeated = Random::next_u64() == first && Random::bytes(Random::BUFFER_SIZE + 1) == first_bytes;
+            Random::set_seed(std::nullopt);
+            const bool reseeded = !Random::is_deterministic() && Random::bytes(first_bytes.size()) != first_bytes;
+            if (!repeated || !reseeded) {
+                std::cerr << "Random test failed: deterministic mode is not reproducible or did not end." << std::endl;
+                return false;
+            }
+            std::cout << "Random test passed: seeded streams repeat, OS seeding restored." << std::endl;
+            return true;
+        }
+
+        // Known-answer tests: BLAKE2b-512("abc") (RFC 7693 Appendix A) and Argon2id (RFC 9106 section 5.3).
+        bool run_kdf_test()
+        {
+            auto hex = [](const std::vector<byte>& bytes) {
+                std::ostringstream out;
+                for (byte b : bytes)
+                    out << std::hex << std::setw(2) << std::setfill('0') << static_cast<uint32_t>(b);
+                return out.str();
+            };
+
+            std::vector<byte> digest(Blake2b::MAX_OUT);
+            Blake2b blake;
+            blake.update("abc", 3);
+            blake.final(digest.data());
+            if (hex(digest) != "ba80a53f981c4d0d6a2797b69f12f6e94c212f14685ac4b74b12bb6fdbffa2d1"
+                               "7d87c5392aab792dc252d5de4533cc9518d38aa8dbf1925ab92386edd4009923") {
+                std::cerr << "KDF test failed: BLAKE2b-512(\"abc\") = " << hex(digest) << std::endl;
+                return false;
+            }
+
+            Argon2Params params;
+            params.memory_kib = 32;
+            params.passes = 3;
+            params.lanes = 4;
+            auto tag = Argon2id::derive(std::string(32, '\x01'), std::vector<byte>(16, 0x02), params, 32,
+                                        std::vector<byte>(8, 0x03), std::vector<byte>(12, 0x04));
+            if (!tag || hex(*tag) != "0d640df58d78766c08c037a34a8b53c9d01ef0452d75b65eb52520e96b01e659") {
+                std::cerr << "KDF test failed: Argon2id RFC 9106 vector = " << (tag ? hex(*tag) : "error") << std::endl;
+                return false;
+            }
+            std::cout << "KDF test passed: BLAKE2b-512 and Argon2id match the RFC vectors." << std::endl;
+            return true;
+        }
+
+        // Reed-Solomon round trip: parity/2 damaged bytes in every codeword of a payload and of the header.
+        bool run_ecc_test()
+        {
+            constexpr uint8_t parity = 16;
+            const uint64_t k = 255u - parity;
+            for (const uint64_t size : {4 * k, 3 * k + 100}) {
+                std::vector<byte> data(size);
+                for (uint64_t i = 0; i < size; ++i)
+                    data[i] = static_cast<byte>(i * 31 + 7);
+                const ReedSolomon rs(parity);
+                std::vector<byte> coded = rs.encode(data);
+                // Codewords are interleaved byte by byte: every run of `codewords` bytes hits each one at most once.
+                const uint64_t codewords = (size + k - 1) / k;
+                for (uint64_t i = 0; i < codewords * (parity / 2); ++i)
+                    coded[i] ^= 0xA5;
+                uint64_t corrected = 0;
+                auto decoded = rs.decode(coded, size, &corrected);
+                if (!decoded || *decoded != data || corrected != codewords * (parity / 2)) {
+                    std::cerr << "ECC test failed: " << size << " bytes not restored." << std::endl;
+                    return false;
+                }
+            }
+
+            MetaData meta{};
+            meta.write_size = 12345;
+            std::strncpy(meta.filename, "selftest.bin", sizeof(meta.filename) - 1);
+            std::vector<byte> header(META_STREAM_SIZE);
+            HnS::pack_meta(meta, header.data());
+            for (uint64_t i = 0; i < META_PARITY / 2; ++i)
+                header[i * 7] ^= 0xFF;
+            MetaData restored{};
+            if (!HnS::unpack_meta(header.data(), restored) || restored.write_size != meta.write_size ||
+                std::strcmp(restored.filename, meta.filename) != 0) {
+                std::cerr << "ECC test failed: header not restored." << std::endl;
+                return false;
+            }
+            std::cout << "ECC test passed: Reed-Solomon corrected parity/2 bytes per codeword." << std::endl;
+            return true;
+        }
+
+        // Embed, extract and compare one carrier (p_in.png / j_in.jpg smoke test).
+        bool run_test(PhotoHnS& ph, const std::vector<byte>& data, const std::string& input_path,
+                      const std::string& output_path, const std::string& format)
+        {
+            if (!ph.embed(data, input_path, output_path)) {
+                std::cerr << format << " embedding failed: Check '" << input_path
+                          << "' existence, format, and capacity." << std::endl;
+                return false;
+            }
+            auto extracted = ph.extract(output_path);
+            if (!extracted) {
+                std::cerr << format << " extraction failed: Verify '" << output_path << "' integrity." << std::endl;
+                return false;
+            }
+            if (*extracted != data) {
+                std::cout << format << " test failed: Data mismatch detected." << std::endl;
+                return false;
+            }
+            std::cout << format << " extracted: " << std::string(extracted->begin(), extracted->end()) << std::endl;
+            std::cout << format << " test passed: Data embedded and extracted successfully!" << std::endl;
+            return true;
+        }
+
+        int run_selftest()
+        {
+            // Author ID, key bytes and seed type of this machine.
+            std::optional<std::string> author_id = AuthorKey::getInstance().get_author_id();
+            std::optional<std::array<byte, SHA256_DIGEST_LENGTH>> key = AuthorKey::getInstance().get_key();
+            if (!author_id || !key)
+                return 1;
+            std::cout << *author_id << std::endl << std::endl;
+            for (byte b : *key)
+                std::cout << static_cast<uint16_t>(b);
+            std::cout << std::endl << std::endl;
+            std::cout << "Type of seed: " << AuthorKey::getInstance().get_id_type() << std::endl;
+            std::cout << "-------------------" << std::endl;
+
+            if (!run_random_test())
+                return 1;
+            if (!run_kdf_test())
+                return 1;
+            if (!run_ecc_test())
+                return 1;
+            std::cout << "-------------------" << std::endl;
+
+            std::string line = "Это зашифрованный текст ";
+            std::cout << line << std::endl;
+            std::vector<byte> data(line.begin(), line.end());
+
+            PhotoHnS png;
+            if (!run_test(png, data, "p_in.png", "p_out.png", "PNG"))
+                return 1;
+            std::cout << "-------------------" << std::endl;
+            PhotoHnS jpeg;
+            if (!run_test(jpeg, data, "j_in.jpg", "j_out.jpg", "JPEG"))
+                return 1;
+            return 0;
+        }
+
+        /**
+         * Restores the std::cout buffer redirected for a file command
+         */
+        struct StreamGuard
+        {
+            std::streambuf* cout_buf{std::cout.rdbuf()};
+            std::streambuf* cerr_buf{std::cerr.rdbuf()};
+
+            ~StreamGuard() { std::cout.rdbuf(this->cout_buf); }
+        };
+    }
+
+    int Cli::run(int argc, char** argv)
+    {
+        if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help") {
+            std::cerr << USAGE;
+            return argc < 2 ? 2 : 0;
+        }
+        auto args = parse_args(argc, argv);
+        if (!args) {
+            std::cerr << USAGE;
+            return 2;
+        }
+        if (args->command == "bench")
+            return run_bench();
+        if (args->command == "selftest")
+            return run_selftest();
+        if (args->command == "scan")
+            return run_scan(*args);
+        const bool file_command = args->command == "embed" || args->command == "extract" ||
+                                  args->command == "probe" || args->command == "capacity" ||
+                                  args->command == "records" || args->command == "update";
+        if (!file_command) {
+            std::cerr << "YpsHnS: unknown command " << args->command << std::endl << USAGE;
+            return 2;
+        }
+
+        const auto inputs = collect_inputs(*args);
+        if (inputs.empty()) {
+            std::cerr << "YpsHnS: no input files" << std::endl;
+            return 2;
+        }
+        const uint32_t jobs = args->jobs ? args->jobs : Parallel::thread_count();
+
+        // stdout is machine-readable: backend progress logs go to stderr (or nowhere with -q), errors stay on stderr.
+        StreamGuard guard;
+        std::ostream stdout_stream(guard.cout_buf);
+        std::ostream stderr_stream(guard.cerr_buf);
+        NullBuf null_buf;
+        std::cout.rdbuf(args->quiet ? &null_buf : guard.cerr_buf);
+
+        if (args->command == "embed")
+            return run_embed(*args, inputs, jobs, stdout_stream);
+        if (args->command == "extract") {
+            // Payload on stdout moves the JSON lines to stderr.
+            const bool payload_to_stdout = args->output ? *args->output == "-" : inputs.size() == 1;
+            return run_extract(*args, inputs, jobs, payload_to_stdout ? stderr_stream : stdout_stream, stdout_stream);
+        }
+        if (args->command == "records")
+            return run_records(*args, inputs, jobs, stdout_stream);
+        if (args->command == "update")
+            return run_update(*args, inputs, jobs, stdout_stream);
+        return run_probe(*args, inputs, jobs, stdout_stream);
+    }
+} // Yps
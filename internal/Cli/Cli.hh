@@ -0,0 +1,31 @@
+#ifndef YPSHNS_CLI_HH
+#define YPSHNS_CLI_HH
+
+namespace Yps
+{
+    /**
+     * Command-line front end of the YpsHnS executable:
+     *   embed    -p <payload|-> | -a <file>...  [-o <file|dir>] <carrier|dir>...
+     *   extract  [-o <file|dir|->] [--offset N --length N | --record NAME] <file|dir>...
+     *   records  <file|dir>...
+     *   update   -p <bytes|-> --offset N [-o <file|dir>] <file|dir>...
+     *   probe    <file|dir>...
+     *   capacity <file|dir>...
+     *   scan     <file|dir>...
+     *   bench, selftest
+     * Common flags: -j N (requests in flight / CPU threads), -r (recurse into directories),
+     * -L <list|-> (read paths, one per line), -q (silence backend progress logs).
+     * Files go through AsyncHnS; a JSON line per file and a final summary with per-stage timings
+     * are printed to stdout (stderr when stdout carries an extracted payload). Backend logs go to stderr.
+     */
+    class Cli
+    {
+    public:
+        /**
+         * @return process exit code: 0 - every file succeeded, 1 - some failed, 2 - usage error
+         */
+        static int run(int argc, char** argv);
+    };
+} // Yps
+
+#endif //YPSHNS_CLI_HH
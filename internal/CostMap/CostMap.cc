@@ -0,0 +1,194 @@
+#include "CostMap.hh"
+
+#include <Cache/LruCache.hh>
+#include <Parallel/Parallel.hh>
+
+#include <algorithm>
+#include <cstdlib>   // For std::abs
+#include <cstring>   // For std::memcpy
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t MIN_PIXELS = 64 * 1024;
+        constexpr size_t MIN_BLOCKS = 4 * 1024;
+        constexpr size_t HASH_BLOCK = 64 * 1024;  // Bytes per independently hashed block (multiple of 8)
+        constexpr size_t CACHED_MAPS = 8;
+
+        LruCache<uint64_t, CostMap::Map>& map_cache()
+        {
+            static LruCache<uint64_t, CostMap::Map> cache(CACHED_MAPS);
+            return cache;
+        }
+
+        /**
+         * Finalizer of MurmurHash3 (64-bit)
+         */
+        inline uint64_t mix(uint64_t h)
+        {
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 33;
+            h *= 0xC4CEB9FE1A85EC53ULL;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /**
+         * Hash of data with mask applied to every 8-byte word (mask clears the bits embedding may change).
+         * Fixed-size blocks are hashed in parallel and combined in order: the result does not depend on thread count.
+         */
+        uint64_t masked_hash(const byte* data, uint64_t size, uint64_t mask, uint64_t seed)
+        {
+            const size_t blocks = static_cast<size_t>((size + HASH_BLOCK - 1) / HASH_BLOCK);
+            std::vector<uint64_t> block_hash(blocks);
+            Parallel::parallel_for(blocks, [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; ++b) {
+                    const byte* p = data + b * HASH_BLOCK;
+                    const size_t n = static_cast<size_t>(std::min<uint64_t>(HASH_BLOCK, size - b * HASH_BLOCK));
+                    uint64_t h = b;
+                    size_t i = 0;
+                    for (; i + 8 <= n; i += 8) {
+                        uint64_t w;
+                        std::memcpy(&w, p + i, 8);
+                        h = (h ^ (w & mask)) * 0x9E3779B97F4A7C15ULL;
+                        h ^= h >> 29;
+                    }
+                    uint64_t w = 0;
+                    std::memcpy(&w, p + i, n - i);
+                    block_hash[b] = mix(h ^ (w & mask) ^ (static_cast<uint64_t>(n) << 48));
+                }
+            }, 16);
+
+            uint64_t h = mix(seed);
+            for (uint64_t block : block_hash)
+                h = mix(h ^ block);
+            return h;
+        }
+
+        /**
+         * Activity of rows [row_begin, row_end). Levels are colour sums of samples without their two LSBs,
+         * scaled to 6 bits per sample at both depths; neighbours outside the image replicate the edge.
+         */
+        template <uint32_t Channels, typename Sample>
+        void activity_rows(const Sample* samples, uint32_t width, uint32_t height, size_t row_begin, size_t row_end,
+                           byte* out)
+        {
+            constexpr uint32_t colour = (Channels == 2 || Channels == 4) ? Channels - 1 : Channels;
+            constexpr uint32_t shift = sizeof(Sample) == 2 ? 10 : 2;
+
+            std::vector<int16_t> levels(3 * static_cast<size_t>(width));  // Up to 4 * 63: 16 bits
+            auto level_row = [&](size_t y, int16_t* dst) {
+                const Sample* p = samples + y * width * Channels;
+                for (uint32_t x = 0; x < width; ++x, p += Channels) {
+                    uint32_t g = 0;
+                    for (uint32_t c = 0; c < colour; ++c)
+                        g += p[c] >> shift;
+                    dst[x] = static_cast<int16_t>(g);
+                }
+            };
+
+            int16_t* up = levels.data();
+            int16_t* mid = up + width;
+            int16_t* down = mid + width;
+            level_row(row_begin == 0 ? 0 : row_begin - 1, up);
+            level_row(row_begin, mid);
+            for (size_t y = row_begin; y < row_end; ++y) {
+                level_row(std::min<size_t>(y + 1, height - 1), down);
+                byte* dst = out + y * width;
+                auto activity = [&](uint32_t x, int16_t left, int16_t right) {
+                    const int16_t g = mid[x];
+                    const int16_t a = static_cast<int16_t>(std::abs(left - g) + std::abs(right - g) +
+                                                           std::abs(up[x] - g) + std::abs(down[x] - g));
+                    dst[x] = static_cast<byte>(std::min<int16_t>(a, 255));
+                };
+                // Edge columns peeled: the interior loop has no conditions and vectorizes.
+                activity(0, mid[0], mid[width > 1 ? 1 : 0]);
+                for (uint32_t x = 1; x + 1 < width; ++x)
+                    activity(x, mid[x - 1], mid[x + 1]);
+                if (width > 1)
+                    activity(width - 1, mid[width - 2], mid[width - 1]);
+                std::swap(up, mid);    // up <- mid
+                std::swap(mid, down);  // mid <- down, down <- old up (overwritten next row)
+            }
+        }
+
+        template <uint32_t Channels, typename Sample>
+        void activity_all(const void* samples, uint32_t width, uint32_t height, byte* out)
+        {
+            const auto* typed = static_cast<const Sample*>(samples);
+            Parallel::parallel_for(height, [&](size_t begin, size_t end) {
+                activity_rows<Channels, Sample>(typed, width, height, begin, end, out);
+            }, std::max<size_t>(1, MIN_PIXELS / width));
+        }
+
+        template <typename Sample>
+        void dispatch(uint32_t channels, const void* samples, uint32_t width, uint32_t height, byte* out)
+        {
+            switch (channels) {
+                case 1: activity_all<1, Sample>(samples, width, height, out); break;
+                case 2: activity_all<2, Sample>(samples, width, height, out); break;
+                case 3: activity_all<3, Sample>(samples, width, height, out); break;
+                case 4: activity_all<4, Sample>(samples, width, height, out); break;
+                default: break;
+            }
+        }
+    }
+
+    CostMap::Map CostMap::pixel_activity(const void* samples, uint32_t width, uint32_t height,
+                                         const BitKernels::PixelFormat& format)
+    {
+        if (!samples || width == 0 || height == 0 || format.channels < 1 || format.channels > 4 ||
+            (format.bits_per_sample != 8 && format.bits_per_sample != 16))
+            return nullptr;
+
+        // Two LSBs of every sample (and alpha, when used) may differ between cover and stego.
+        const bool wide = format.bits_per_sample == 16;
+        uint64_t mask = 0xFCFCFCFCFCFCFCFCULL;
+        if (wide) {
+            const uint16_t lanes[4] = {0xFFFC, 0xFFFC, 0xFFFC, 0xFFFC};
+            std::memcpy(&mask, lanes, sizeof(mask));
+        }
+        const uint64_t bytes = static_cast<uint64_t>(width) * height * format.channels * (wide ? 2 : 1);
+        const uint64_t seed = (static_cast<uint64_t>(width) << 32) ^ (static_cast<uint64_t>(height) << 8) ^
+                              (format.channels << 5) ^ format.bits_per_sample;
+        const uint64_t key = masked_hash(static_cast<const byte*>(samples), bytes, mask, seed);
+
+        auto map = map_cache().get_or_compute(key, [&]() -> std::optional<Map> {
+            auto activity = std::make_shared<std::vector<byte>>(static_cast<size_t>(width) * height);
+            if (wide)
+                dispatch<uint16_t>(format.channels, samples, width, height, activity->data());
+            else
+                dispatch<byte>(format.channels, samples, width, height, activity->data());
+            return Map(std::move(activity));
+        });
+        return map ? *map : nullptr;
+    }
+
+    CostMap::Map CostMap::block_activity(const JpegCoefImage& image)
+    {
+        uint64_t blocks = 0;
+        for (const auto& comp : image.components)
+            blocks += comp.block_count();
+
+        auto activity = std::make_shared<std::vector<byte>>(static_cast<size_t>(blocks));
+        byte* out = activity->data();
+        for (const auto& comp : image.components) {
+            const JCOEF* coefs = comp.coefs.data();
+            Parallel::parallel_for(static_cast<size_t>(comp.block_count()), [&](size_t begin, size_t end) {
+                for (size_t b = begin; b < end; ++b) {
+                    const JCOEF* block = coefs + b * DCTSIZE2;
+                    int32_t a = 0;
+                    for (int k = 1; k < DCTSIZE2; ++k) {
+                        const int32_t v = static_cast<int32_t>(block[k]) >> 1;  // LSB-free (arithmetic shift)
+                        a += v < 0 ? -v : v;
+                    }
+                    out[b] = static_cast<byte>(std::min(a, 255));
+                }
+            }, MIN_BLOCKS);
+            out += comp.block_count();
+        }
+        return activity;
+    }
+} // Yps
@@ -0,0 +1,50 @@
+#ifndef YPSHNS_COSTMAP_HH
+#define YPSHNS_COSTMAP_HH
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <BitKernels/BitKernels.hh>
+#include <JpegCoefImage/JpegCoefImage.hh>
+
+namespace Yps
+{
+    /**
+     * Embedding cost maps for SlotOrder::Adaptive, one activity byte per unit (pixel or DCT block).
+     * Higher activity = more texture = cheaper to change; flat areas get 0 and are filled last.
+     * Maps are built only from bits embedding never touches (samples without their two LSBs,
+     * coef >> 1), so extraction rebuilds exactly the map embed used from the stego carrier.
+     */
+    class CostMap
+    {
+    public:
+        using Map = std::shared_ptr<const std::vector<byte>>;
+
+        /**
+         * Per-pixel activity: sum of absolute differences to the 4 neighbours of the pixel's
+         * colour sum (alpha excluded), capped at 255. Rows are processed in parallel bands.
+         * Maps are cached by a hash of the LSB-free samples: re-embedding the same carrier
+         * or verifying a fresh stego image reuses the map.
+         * @param samples Decoded samples (stb order, native-endian 16-bit samples)
+         * @param width/height Image size in pixels
+         * @param format Image format
+         * @return width * height activities or nullptr (unsupported format)
+         */
+        static Map pixel_activity(const void* samples, uint32_t width, uint32_t height,
+                                  const BitKernels::PixelFormat& format);
+
+        /**
+         * Per-block activity: sum of |coef >> 1| over the 63 AC coefficients, capped at 255.
+         * Blocks in BitKernels DCT order (components -> block rows -> blocks). Not cached:
+         * the map costs one pass over the coefficients, as much as hashing them would.
+         * @param image Quantized DCT blocks
+         * @return activities (one per block)
+         */
+        static Map block_activity(const JpegCoefImage& image);
+    };
+} // Yps
+
+#endif //YPSHNS_COSTMAP_HH
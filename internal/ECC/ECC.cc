@@ -0,0 +1,293 @@
+#include "ECC.hh"
+
+#include <Parallel/Parallel.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace Yps
+{
+    namespace
+    {
+        /**
+         * GF(256) log/exp tables, exp doubled to skip "mod 255" in mul.
+         */
+        struct GaloisTables
+        {
+            std::array<byte, 512> exp{};
+            std::array<uint16_t, 256> log{};
+
+            GaloisTables()
+            {
+                uint16_t x = 1;
+                for (uint16_t i = 0; i < 255; ++i) {
+                    exp[i] = static_cast<byte>(x);
+                    log[x] = i;
+                    x <<= 1;
+                    if (x & 0x100)
+                        x ^= 0x11D;
+                }
+                for (uint16_t i = 255; i < 512; ++i)
+                    exp[i] = exp[i - 255];
+            }
+        };
+
+        const GaloisTables& gf()
+        {
+            static const GaloisTables tables;
+            return tables;
+        }
+
+        inline byte gf_mul(const GaloisTables& t, byte a, byte b)
+        {
+            if (a == 0 || b == 0)
+                return 0;
+            return t.exp[t.log[a] + t.log[b]];
+        }
+
+        inline byte gf_div(const GaloisTables& t, byte a, byte b)
+        {
+            if (a == 0)
+                return 0;
+            return t.exp[t.log[a] + 255 - t.log[b]];
+        }
+
+        inline byte gf_pow_alpha(const GaloisTables& t, int32_t e)
+        {
+            e %= 255;
+            if (e < 0)
+                e += 255;
+            return t.exp[static_cast<size_t>(e)];
+        }
+
+        /**
+         * Evaluate polynomial (lowest degree first) at x.
+         */
+        byte poly_eval_low(const GaloisTables& t, const std::vector<byte>& poly, byte x)
+        {
+            byte result = 0;
+            for (size_t i = poly.size(); i-- > 0;)
+                result = gf_mul(t, result, x) ^ poly[i];
+            return result;
+        }
+
+        template <typename Table>
+        Table mul_table(const GaloisTables& t, byte c)
+        {
+            Table table;
+            for (byte v = 0; v < 16; ++v) {
+                table.lo[v] = gf_mul(t, c, v);
+                table.hi[v] = gf_mul(t, c, static_cast<byte>(v << 4));
+            }
+            return table;
+        }
+    }
+
+    ReedSolomon::ReedSolomon(uint8_t parity) : parity(parity)
+    {
+        if (parity == 0 || parity > MAX_PARITY)
+            throw std::invalid_argument("ReedSolomon: parity must be in 1..128");
+
+        const GaloisTables& t = gf();
+        /*g(x) = (x - α^0)(x - α^1)...(x - α^(parity-1)), highest degree first*/
+        this->gen = {1};
+        for (uint8_t i = 0; i < parity; ++i) {
+            byte root = gf_pow_alpha(t, i);
+            std::vector<byte> next(this->gen.size() + 1, 0);
+            for (size_t j = 0; j < this->gen.size(); ++j) {
+                next[j] ^= this->gen[j];
+                next[j + 1] ^= gf_mul(t, this->gen[j], root);
+            }
+            this->gen = std::move(next);
+        }
+
+        this->gen_mul.reserve(parity);
+        this->root_mul.reserve(parity);
+        for (uint8_t j = 0; j < parity; ++j) {
+            this->gen_mul.push_back(mul_table<MulTable>(t, this->gen[j + 1u]));
+            this->root_mul.push_back(mul_table<MulTable>(t, gf_pow_alpha(t, j)));
+        }
+    }
+
+    uint64_t ReedSolomon::encoded_size(uint64_t size, uint8_t parity)
+    {
+        if (parity == 0 || size == 0)
+            return size;
+        uint64_t k = 255u - parity;
+        uint64_t codewords = (size + k - 1) / k;
+        return size + codewords * parity;
+    }
+
+    uint64_t ReedSolomon::interleaved_pos(uint64_t i, uint64_t j, uint64_t codewords, uint64_t last_len)
+    {
+        // Columns shorter than last_len hold a byte of every codeword, the rest skip the (shorter) last one.
+        if (j < last_len)
+            return j * codewords + i;
+        return last_len * codewords + (j - last_len) * (codewords - 1) + i;
+    }
+
+    void ReedSolomon::encode_block(const byte* data, uint32_t len, byte* parity_out) const
+    {
+        // LFSR division by g(x).
+        std::fill(parity_out, parity_out + this->parity, 0);
+        for (uint32_t i = 0; i < len; ++i) {
+            byte feedback = data[i] ^ parity_out[0];
+            std::copy(parity_out + 1, parity_out + this->parity, parity_out);
+            parity_out[this->parity - 1] = 0;
+            for (uint32_t j = 0; j < this->parity; ++j)
+                parity_out[j] ^= this->gen_mul[j](feedback);
+        }
+    }
+
+    std::optional<uint32_t> ReedSolomon::decode_block(byte* codeword, uint32_t len) const
+    {
+        /*Syndromes S_j = r(α^j), all Horner chains advanced together one received byte at a time*/
+        std::vector<byte> syndromes(this->parity, 0);
+        for (uint32_t i = 0; i < len; ++i)
+            for (uint32_t j = 0; j < this->parity; ++j)
+                syndromes[j] = this->root_mul[j](syndromes[j]) ^ codeword[i];
+        if (std::all_of(syndromes.begin(), syndromes.end(), [](byte s) { return s == 0; }))
+            return 0u;
+
+        const GaloisTables& t = gf();
+
+        /*Berlekamp-Massey: error locator Λ (lowest degree first)*/
+        std::vector<byte> lambda = {1};
+        std::vector<byte> prev = {1};
+        uint32_t errors = 0;
+        uint32_t shift = 1;
+        byte prev_discrepancy = 1;
+        for (uint32_t n = 0; n < this->parity; ++n) {
+            byte d = syndromes[n];
+            for (uint32_t i = 1; i <= errors && i < lambda.size(); ++i)
+                d ^= gf_mul(t, lambda[i], syndromes[n - i]);
+
+            if (d == 0) {
+                ++shift;
+                continue;
+            }
+
+            std::vector<byte> updated = lambda;
+            byte coef = gf_div(t, d, prev_discrepancy);
+            if (updated.size() < prev.size() + shift)
+                updated.resize(prev.size() + shift, 0);
+            for (size_t i = 0; i < prev.size(); ++i)
+                updated[i + shift] ^= gf_mul(t, coef, prev[i]);
+
+            if (2 * errors <= n) {
+                prev = lambda;
+                errors = n + 1 - errors;
+                prev_discrepancy = d;
+                shift = 1;
+            } else {
+                ++shift;
+            }
+            lambda = std::move(updated);
+        }
+        while (lambda.size() > 1 && lambda.back() == 0)
+            lambda.pop_back();
+        if (errors * 2 > this->parity || lambda.size() - 1 != errors)
+            return std::nullopt;
+
+        /*Chien search over real (shortened) positions*/
+        std::vector<uint32_t> positions;
+        for (uint32_t i = 0; i < len; ++i) {
+            int32_t power = static_cast<int32_t>(len - 1 - i);
+            if (poly_eval_low(t, lambda, gf_pow_alpha(t, -power)) == 0)
+                positions.push_back(i);
+        }
+        if (positions.size() != errors)
+            return std::nullopt;
+
+        /*Forney: Ω = S·Λ mod x^parity; e = X·Ω(X^-1) / Λ'(X^-1)*/
+        std::vector<byte> omega(this->parity, 0);
+        for (uint32_t i = 0; i < this->parity; ++i)
+            for (uint32_t j = 0; j < lambda.size() && i + j < this->parity; ++j)
+                omega[i + j] ^= gf_mul(t, syndromes[i], lambda[j]);
+
+        std::vector<byte> lambda_prime(lambda.size() > 1 ? lambda.size() - 1 : 1, 0);
+        for (size_t i = 1; i < lambda.size(); i += 2)
+            lambda_prime[i - 1] = lambda[i];
+
+        for (uint32_t pos : positions) {
+            int32_t power = static_cast<int32_t>(len - 1 - pos);
+            byte x = gf_pow_alpha(t, power);
+            byte x_inv = gf_pow_alpha(t, -power);
+            byte denominator = poly_eval_low(t, lambda_prime, x_inv);
+            if (denominator == 0)
+                return std::nullopt;
+            codeword[pos] ^= gf_mul(t, x, gf_div(t, poly_eval_low(t, omega, x_inv), denominator));
+        }
+        return errors;
+    }
+
+    std::vector<byte> ReedSolomon::encode(const std::vector<byte>& data) const
+    {
+        if (data.empty())
+            return {};
+
+        uint64_t k = this->data_per_codeword();
+        uint64_t codewords = (data.size() + k - 1) / k;
+        uint64_t last_len = data.size() - (codewords - 1) * k + this->parity;
+        std::vector<byte> coded(encoded_size(data.size(), this->parity));
+
+        Parallel::parallel_for(static_cast<size_t>(codewords), [&](size_t cw_begin, size_t cw_end) {
+            std::array<byte, 255> block{};
+            for (size_t i = cw_begin; i < cw_end; ++i) {
+                uint64_t offset = i * k;
+                auto data_len = static_cast<uint32_t>(std::min<uint64_t>(k, data.size() - offset));
+                std::copy(data.begin() + static_cast<std::ptrdiff_t>(offset),
+                          data.begin() + static_cast<std::ptrdiff_t>(offset + data_len), block.begin());
+                this->encode_block(block.data(), data_len, block.data() + data_len);
+
+                for (uint32_t j = 0; j < data_len + this->parity; ++j)
+                    coded[interleaved_pos(i, j, codewords, last_len)] = block[j];
+            }
+        }, 64);
+        return coded;
+    }
+
+    std::optional<std::vector<byte>> ReedSolomon::decode(const std::vector<byte>& coded, uint64_t data_size,
+                                                         uint64_t* corrected) const
+    {
+        if (coded.size() != encoded_size(data_size, this->parity))
+            return std::nullopt;
+        if (data_size == 0)
+            return std::vector<byte>{};
+
+        uint64_t k = this->data_per_codeword();
+        uint64_t codewords = (data_size + k - 1) / k;
+        uint64_t last_len = data_size - (codewords - 1) * k + this->parity;
+        std::vector<byte> data(data_size);
+        std::atomic<uint64_t> fixed{0};
+        std::atomic<bool> failed{false};
+
+        Parallel::parallel_for(static_cast<size_t>(codewords), [&](size_t cw_begin, size_t cw_end) {
+            std::array<byte, 255> block{};
+            uint64_t local_fixed = 0;
+            for (size_t i = cw_begin; i < cw_end; ++i) {
+                uint64_t offset = i * k;
+                auto data_len = static_cast<uint32_t>(std::min<uint64_t>(k, data_size - offset));
+                uint32_t len = data_len + this->parity;
+                for (uint32_t j = 0; j < len; ++j)
+                    block[j] = coded[interleaved_pos(i, j, codewords, last_len)];
+
+                auto result = this->decode_block(block.data(), len);
+                if (!result) {
+                    failed.store(true, std::memory_order_relaxed);
+                    return;
+                }
+                local_fixed += *result;
+                std::copy(block.begin(), block.begin() + data_len, data.begin() + static_cast<std::ptrdiff_t>(offset));
+            }
+            fixed.fetch_add(local_fixed, std::memory_order_relaxed);
+        }, 64);
+
+        if (failed.load())
+            return std::nullopt;
+        if (corrected)
+            *corrected = fixed.load();
+        return data;
+    }
+} // Yps
@@ -0,0 +1,108 @@
+#ifndef YPSHNS_ECC_HH
+#define YPSHNS_ECC_HH
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Reed-Solomon code over GF(256) (poly 0x11D, first consecutive root α^0).
+     * Stream is cut into codewords of (255 - parity) data bytes (last one shortened),
+     * codewords are interleaved byte-by-byte, so a burst of flipped bits spreads over many codewords.
+     * Codewords are independent: encode/decode run in parallel.
+     */
+    class ReedSolomon
+    {
+    private:
+        /**
+         * Product by a constant c as split nibble tables: c·v = lo[v & 15] ^ hi[v >> 4] (no log/exp, no branch)
+         */
+        struct MulTable
+        {
+            std::array<byte, 16> lo{};
+            std::array<byte, 16> hi{};
+
+            [[nodiscard]] byte operator()(byte v) const { return this->lo[v & 0x0F] ^ this->hi[v >> 4]; }
+        };
+
+        uint8_t parity;
+
+        /**
+         * Generator polynomial, highest degree first (gen[0] = 1)
+         */
+        std::vector<byte> gen;
+
+        /**
+         * gen_mul[j] multiplies by gen[j + 1] (encode_block LFSR taps)
+         */
+        std::vector<MulTable> gen_mul;
+
+        /**
+         * root_mul[j] multiplies by α^j (syndrome Horner steps)
+         */
+        std::vector<MulTable> root_mul;
+
+        /**
+         * Data bytes per full codeword
+         */
+        [[nodiscard]] uint32_t data_per_codeword() const { return 255u - this->parity; }
+
+        /**
+         * Position of byte j of codeword i inside interleaved stream.
+         */
+        static uint64_t interleaved_pos(uint64_t i, uint64_t j, uint64_t codewords, uint64_t last_len);
+
+        /**
+         * Systematic encode: parity of one codeword.
+         */
+        void encode_block(const byte* data, uint32_t len, byte* parity_out) const;
+
+        /**
+         * Correct one codeword in place.
+         * @return corrected symbols count or std::nullopt (uncorrectable)
+         */
+        std::optional<uint32_t> decode_block(byte* codeword, uint32_t len) const;
+
+    public:
+        /**
+         * Max parity symbols per codeword (corrects parity/2 byte errors per codeword)
+         */
+        static constexpr uint8_t MAX_PARITY = 128;
+
+        /**
+         * @param parity Parity bytes per codeword (1..MAX_PARITY)
+         */
+        explicit ReedSolomon(uint8_t parity);
+
+        /**
+         * Size of encoded stream.
+         * @param size Data size
+         * @param parity Parity bytes per codeword (0 - no ECC)
+         */
+        static uint64_t encoded_size(uint64_t size, uint8_t parity);
+
+        /**
+         * Add parity and interleave.
+         * @param data Bytes to protect
+         * @return encoded stream (encoded_size bytes)
+         */
+        [[nodiscard]] std::vector<byte> encode(const std::vector<byte>& data) const;
+
+        /**
+         * Deinterleave and correct.
+         * @param coded Encoded stream
+         * @param data_size Original data size
+         * @param corrected Out: number of corrected bytes (optional)
+         * @return data or std::nullopt, if some codeword is uncorrectable
+         */
+        [[nodiscard]] std::optional<std::vector<byte>> decode(const std::vector<byte>& coded, uint64_t data_size,
+                                                              uint64_t* corrected = nullptr) const;
+    };
+} // Yps
+
+#endif //YPSHNS_ECC_HH
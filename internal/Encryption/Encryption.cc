@@ -6,6 +6,10 @@
 
 #include "Encryption.hh"
 
+#include <Random/Random.hh>
+
+#include <openssl/crypto.h>  // For OPENSSL_cleanse
+
 namespace Yps
 {
     std::vector<byte> Encryption::encrypt(const std::vector<byte>& data)
@@ -28,19 +32,20 @@ namespace Yps
 
 
 
-    AES256Encryption::AES256Encryption()
-    {
-        this->key = std::vector<byte>(AuthorKey::getInstance().get_key().begin(), AuthorKey::getInstance().get_key().end());
-    }
+    AES256Encryption::AES256Encryption() = default;
 
-    std::vector<byte> AES256Encryption::generate_IV()
+    std::vector<byte> AES256Encryption::ensure_key()
     {
-        /*IV for AES-CBC - 128 bit*/
-        std::vector<byte> IV(16);
-        if (RAND_bytes(IV.data(), IV.size()) != 1)
-            throw std::runtime_error("Failed to generate random IV");
-        return IV;
+        if (this->key.empty()) {
+            auto author_key = AuthorKey::getInstance().get_key();
+            if (!author_key)
+                return {};  // Provider failed, caller reports empty key
+            this->key = std::vector<byte>(author_key->begin(), author_key->end());
+            OPENSSL_cleanse(author_key->data(), author_key->size());
+        }
+        return this->key;
     }
+
     AES256Encryption& AES256Encryption::getInstance()
     {
         static AES256Encryption instance;
@@ -49,11 +54,13 @@ namespace Yps
 
     void AES256Encryption::set_key(std::array<byte, SHA256_DIGEST_LENGTH> Akey)
     {
+        std::lock_guard<std::mutex> lock(this->mutex);
         this->key = std::vector<byte>(Akey.begin(), Akey.end());
     }
 
     void AES256Encryption::set_key(std::vector<byte> Akey)
     {
+        std::lock_guard<std::mutex> lock(this->mutex);
         this->key = std::move(Akey);
     }
 
@@ -61,67 +68,84 @@ namespace Yps
     {
         if (data.empty())
             throw std::invalid_argument("data is empty");
-        if (this->key.empty())
+        std::vector<byte> current;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            current = this->ensure_key();
+        }
+        if (current.empty())
             throw std::runtime_error("AES256Encryption: key is empty");
 
+        std::vector<byte> result(cipher_size(data.size()));
+        encrypt_with(current.data(), data.data(), data.size(), result.data());
+        OPENSSL_cleanse(current.data(), current.size());
+        return result;
+    }
 
+    std::vector<byte> AES256Encryption::decrypt(const std::vector<byte> &data)
+    {
+        if (data.empty())
+            throw std::invalid_argument("data is empty");
+        std::vector<byte> current;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            current = this->ensure_key();
+        }
+        if (current.empty())
+            throw std::runtime_error("AES256Encryption: key is empty");
+        try {
+            std::vector<byte> plain = decrypt_with(current.data(), data.data(), data.size());
+            OPENSSL_cleanse(current.data(), current.size());
+            return plain;
+        } catch (...) {
+            OPENSSL_cleanse(current.data(), current.size());
+            throw;
+        }
+    }
+
+    void AES256Encryption::encrypt_with(const byte* key, const byte* data, size_t size, byte* out)
+    {
         /*Init OpenSSL context*/
         EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
         if (!ctx)
             throw std::runtime_error("AES256Encryption: EVP_CIPHER_CTX_new failed");
 
-        /*IV generation*/
-        std::vector<byte> IV = AES256Encryption::generate_IV();
-        std::vector<byte> ciphertext(data.size() + IV.size());
+        /*IV generation: written in front of the ciphertext*/
+        Random::fill(out, 16);
+        byte* ciphertext = out + 16;
 
         int32_t len = 0;
-        int32_t ciphertext_len = 0;
 
         /*Init encryption*/
-        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, this->key.data(), IV.data()) != 1)
+        if (EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, out) != 1)
         {
             EVP_CIPHER_CTX_free(ctx);
             throw std::runtime_error("AES256Encryption: EVP_EncryptInit_ex failed");
         }
 
         /*Encryption*/
-        if (EVP_EncryptUpdate(ctx, ciphertext.data(), &len, data.data(), data.size()) != 1) {
+        if (EVP_EncryptUpdate(ctx, ciphertext, &len, data, static_cast<int32_t>(size)) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             throw std::runtime_error("Encryption failed");
         }
-        ciphertext_len = len;
 
-        /*Final*/
-        if (EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len) != 1) {
+        /*Final (PKCS#7 block)*/
+        if (EVP_EncryptFinal_ex(ctx, ciphertext + len, &len) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             throw std::runtime_error("Failed to finalize encryption");
         }
-        ciphertext_len += len;
 
         EVP_CIPHER_CTX_free(ctx);
-
-        /*Realsize vector*/
-        ciphertext.resize(ciphertext_len);
-
-        /*ADD IV*/
-        std::vector<byte> result;
-        result.reserve(ciphertext.size() + IV.size());
-        result.insert(result.end(), IV.begin(), IV.end());
-        result.insert(result.end(), ciphertext.begin(), ciphertext.end());
-
-        return result;
     }
 
-    std::vector<byte> AES256Encryption::decrypt(const std::vector<byte> &data)
+    std::vector<byte> AES256Encryption::decrypt_with(const byte* key, const byte* data, size_t size)
     {
-        if (data.empty())
-            throw std::invalid_argument("data is empty");
-        if (this->key.empty())
-            throw std::runtime_error("AES256Encryption: key is empty");
-
-        /*Get IV from data (first 16 bytes)*/
-        std::vector<byte> IV(data.begin(), data.begin() + 16);
-        std::vector<byte> ciphertext(data.begin() + 16, data.end());
+        /*IV is the first 16 bytes*/
+        if (size < 32 || size % 16 != 0)
+            throw std::invalid_argument("ciphertext size is invalid");
+        const byte* IV = data;
+        const byte* ciphertext = data + 16;
+        const size_t ciphertext_size = size - 16;
 
         /*Init OpenSSL context*/
         EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
@@ -129,18 +153,18 @@ namespace Yps
             throw std::runtime_error("Failed to create EVP context");
         }
 
-        std::vector<byte> plaintext(ciphertext.size());
+        std::vector<byte> plaintext(ciphertext_size);
         int32_t len = 0;
         int32_t plaintext_len = 0;
 
         /*Init decryption*/
-        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key.data(), IV.data()) != 1) {
+        if (EVP_DecryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, key, IV) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             throw std::runtime_error("Failed to initialize decryption");
         }
 
         /*Decryption*/
-        if (EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size()) != 1) {
+        if (EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext, static_cast<int32_t>(ciphertext_size)) != 1) {
             EVP_CIPHER_CTX_free(ctx);
             throw std::runtime_error("Decryption failed");
         }
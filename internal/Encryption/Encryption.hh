@@ -6,6 +6,7 @@
 #ifndef YPSHNS_ENCRYPTION_HH
 #define YPSHNS_ENCRYPTION_HH
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <defines.hh>
 #include <openssl/evp.h>
@@ -56,15 +57,22 @@ namespace Yps
         AES256Encryption();
 
         /**
-         * Secret key. Pre-defined in Constructor by AuthorKey. Can be changed.
+         * Secret key. Taken from AuthorKey on first use unless set before. Can be changed.
          */
         std::vector<byte> key;
 
         /**
-         * Generate IV for every encryption
-         * @return IV init vector
+         * Guards key: the instance is process-wide (library code uses encrypt_with/decrypt_with instead)
          */
-        static std::vector<byte> generate_IV();
+        std::mutex mutex;
+
+        /**
+         * Fetch AuthorKey if no key was set (avoids key derivation at construction)
+         * @return copy of the current key
+         * @note Caller holds mutex
+         */
+        std::vector<byte> ensure_key();
+
     public:
         /**
          * Forbidden copy and "=" constructor
@@ -99,6 +107,29 @@ namespace Yps
          * @return Decrypted data
          */
         std::vector<byte> decrypt(const std::vector<byte>& data);
+
+        /**
+         * Size of IV + PKCS#7-padded ciphertext for size plain bytes
+         */
+        static constexpr uint64_t cipher_size(uint64_t size) { return 16 + (size / 16 + 1) * 16; }
+
+        /**
+         * AES-256-CBC with an explicit key and a fresh IV (no shared state: safe on parallel workers)
+         * @param key 32-byte key
+         * @param data Plain bytes
+         * @param size Number of plain bytes (0 allowed)
+         * @param out Receives IV + ciphertext, cipher_size(size) bytes
+         */
+        static void encrypt_with(const byte* key, const byte* data, size_t size, byte* out);
+
+        /**
+         * Decryption with an explicit key
+         * @param key 32-byte key
+         * @param data IV + ciphertext
+         * @param size Bytes in data
+         * @return Decrypted data (throws on bad padding/size, as decrypt())
+         */
+        static std::vector<byte> decrypt_with(const byte* key, const byte* data, size_t size);
     };
 
 
@@ -9,8 +9,11 @@
 #include <memory>
 #include <algorithm>
 #include <defines.hh>
+#include <openssl/crypto.h>
 #include <openssl/sha.h>
 
+#include <KDF/KDF.hh>
+
 namespace Yps
 {
     enum class ContainerType
@@ -20,7 +23,7 @@ namespace Yps
 
     enum class Extension
     {
-        JPEG, PNG
+        JPEG, PNG, WAV, Y4M, PPM, PGM, BMP, TGA
     };
 
     enum class LsbMode {
@@ -29,8 +32,74 @@ namespace Yps
         NoUsed
     };
 
+    /**
+     * Bit kernel family (see BitKernels)
+     */
+    enum class KernelMode {
+        Fast,
+        Hardened
+    };
+
+    /**
+     * Where the encryption key comes from
+     */
+    enum class KeySource : uint8_t {
+        AuthorKey,  // AuthorKey provider (machine, env, file, ...)
+        Argon2id    // Passphrase + kdf_salt/kdf params from MetaData
+    };
+
+    /**
+     * Where the stream is written inside the carrier
+     */
+    enum class Placement : uint8_t {
+        Samples,  // LSBs of pixels/DCT coefficients/audio samples
+        Segment   // Private PNG chunk / JPEG APP15 segment (no decoding, visible to parsers)
+    };
+
+    /**
+     * Order in which payload slots are filled (metadata is always sequential)
+     */
+    enum class SlotOrder : uint8_t {
+        Sequential,  // From the first slot after metadata
+        Adaptive     // Textured pixels / busy DCT blocks only (PNG/JPEG, see CostMap)
+    };
+
+    /**
+     * First bytes of every embedded header
+     */
+    constexpr std::array<char, 4> META_MAGIC{'Y', 'H', 'N', 'S'};
+
+    /**
+     * Layout of MetaData and of the stream framing. Bumped on every incompatible change: extraction
+     * rejects other versions instead of misreading them.
+     */
+    constexpr uint8_t META_VERSION = 3;
+
+    /**
+     * Reed-Solomon parity bytes of the embedded header (corrects META_PARITY / 2 damaged bytes),
+     * independent of the payload's --ecc
+     */
+    constexpr uint8_t META_PARITY = 32;
+
+    /**
+     * Serialised MetaData (HnS::pack_meta): its fields in declaration order, little-endian, enums as one byte,
+     * no padding. Independent of the compiler's struct layout.
+     */
+    constexpr uint32_t META_WIRE_SIZE = 4 + 1 + 1 + 1 + 64 + 8 + 1 + 1 + 1 + 8 + 1 + 4 + 8 + 1 + 1 + 4 + 4 +
+                                        static_cast<uint32_t>(Argon2id::SALT_SIZE) + 4;
+
     struct MetaData
     {
+        /**
+         * META_MAGIC
+         */
+        std::array<char, 4> magic = META_MAGIC;
+
+        /**
+         * META_VERSION of the writer
+         */
+        uint8_t version{META_VERSION};
+
         /**
          * Type of container
          */
@@ -42,7 +111,7 @@ namespace Yps
         Extension ext;
 
         /**
-         * Name of plain(to embed) file (fixed-size to ensure POD for safe memcpy)
+         * Name of plain(to embed) file (fixed-size wire field)
          */
         char filename[64];
 
@@ -57,9 +126,149 @@ namespace Yps
         LsbMode lsb_mode{LsbMode::NoUsed};
 
         /**
-         * Size of meta_data
+         * 1 - payload leaves alpha samples untouched (alpha not fully opaque); metadata never uses alpha
+         */
+        uint8_t skip_alpha{};
+
+        /**
+         * Payload slot order (extraction rebuilds the same cost map from the carrier)
          */
-        const uint32_t meta_size = sizeof(MetaData);
+        SlotOrder slot_order{SlotOrder::Sequential};
+
+        /**
+         * Size of encrypted data before ECC
+         */
+        uint64_t payload_size{};
+
+        /**
+         * Reed-Solomon parity bytes per codeword (0 - no ECC)
+         */
+        uint8_t ecc_parity{};
+
+        /**
+         * Plain bytes per independently encrypted chunk (0 - one CBC stream, see ChunkedPayload)
+         */
+        uint32_t chunk_size{};
+
+        /**
+         * Size of plain data
+         */
+        uint64_t plain_size{};
+
+        /**
+         * Key derivation used for payload (salt and cost are public, passphrase is not stored)
+         */
+        KeySource key_source{KeySource::AuthorKey};
+        uint8_t kdf_lanes{};
+        uint32_t kdf_memory_kib{};
+        uint32_t kdf_passes{};
+        std::array<byte, Argon2id::SALT_SIZE> kdf_salt{};
+
+        /**
+         * Size of serialised meta_data
+         */
+        uint32_t meta_size{META_WIRE_SIZE};
+    };
+
+    static_assert(META_WIRE_SIZE <= 255u - META_PARITY, "MetaData must fit one Reed-Solomon codeword");
+
+    /**
+     * Bytes of the embedded header at the start of every stream (HnS::pack_meta / HnS::unpack_meta):
+     * META_WIRE_SIZE bytes of MetaData followed by META_PARITY bytes of parity; always written 1 bit per slot
+     */
+    constexpr uint64_t META_STREAM_SIZE = META_WIRE_SIZE + META_PARITY;
+
+
+    /**
+     * Tunable embedding parameters (shared by all containers)
+     */
+    struct EmbedOptions
+    {
+        /**
+         * Reed-Solomon parity bytes per 255-byte codeword (0 - no ECC).
+         * Corrects ecc_parity/2 damaged bytes per codeword at ecc_parity/255 capacity cost.
+         */
+        uint8_t ecc_parity{0};
+
+        /**
+         * Encrypt the payload in chunks of chunk_size plain bytes with a seek table (0 - one CBC stream).
+         * Lets HnS::extract_range decrypt only the chunks covering the requested range.
+         */
+        uint32_t chunk_size{0};
+
+        /**
+         * Maximum throughput or constant-time (no payload-dependent branches/lookups) kernels
+         */
+        KernelMode kernel_mode{KernelMode::Fast};
+
+        /**
+         * Embed into samples or into container segments (PNG/JPEG only; extract detects it)
+         */
+        Placement placement{Placement::Samples};
+
+        /**
+         * Fill slots sequentially or busy areas first (PNG/JPEG sample placement; extract reads it from MetaData)
+         */
+        SlotOrder slot_order{SlotOrder::Sequential};
+
+        /**
+         * Compare carrier and stego in memory after embed (PSNR, SSIM, DCT change ratio, size delta;
+         * PNG/JPEG sample placement). Result: HnS::get_report().
+         */
+        bool quality_report{false};
+
+        /**
+         * Keep decoded carriers (PNG samples, JPEG coefficients) in CarrierCache::shared(), keyed by file
+         * content: embedding many payloads into one template decodes it once (PNG/JPEG sample placement).
+         */
+        bool cache_carrier{false};
+
+        /**
+         * Passphrase for Argon2id key (fresh salt per embed, stored in MetaData).
+         * std::nullopt - key from AuthorKey. Required again for extraction.
+         */
+        std::optional<std::string> passphrase;
+
+        /**
+         * Argon2id cost for embed (extract uses the cost stored in MetaData)
+         */
+        Argon2Params kdf{};
+    };
+
+    /**
+     * Visual/size cost of one embed (EmbedOptions::quality_report)
+     */
+    struct EmbedReport
+    {
+        /**
+         * Peak signal-to-noise ratio of colour samples, dB (infinity if nothing changed).
+         * JPEG: over the coded YCbCr planes, from dequantized coefficient differences.
+         */
+        double psnr{};
+
+        /**
+         * Mean SSIM over non-overlapping 8x8 tiles (JPEG: DCT blocks) of every colour channel
+         */
+        double ssim{1.0};
+
+        /**
+         * Changed AC coefficients / all AC coefficients (JPEG only)
+         */
+        double dct_change_ratio{};
+
+        /**
+         * Carrier and output file sizes
+         */
+        uint64_t carrier_bytes{};
+        uint64_t output_bytes{};
+
+        /**
+         * Time spent in the quality stage (copy of the carrier + comparison), seconds
+         */
+        double seconds{};
+
+        [[nodiscard]] int64_t size_delta() const
+        { return static_cast<int64_t>(this->output_bytes) - static_cast<int64_t>(this->carrier_bytes); }
     };
 
 
@@ -76,6 +285,10 @@ namespace Yps
          * Encrypted Data
          */
         std::vector<byte> encrypt_data;
+        /**
+         * Encrypted Data after ECC (what is actually embedded after metadata)
+         */
+        std::vector<byte> coded_data;
 
         /**
          * Metadata to embed with plain data
@@ -87,12 +300,53 @@ namespace Yps
          */
         uint64_t max_capacity{};
 
+        /**
+         * Bytes repaired by ECC during the last extraction
+         */
+        uint64_t ecc_corrected{};
+
         /**
          * Key for cryptography
          */
         std::array<byte, SHA256_DIGEST_LENGTH> key;
     };
 
+    /**
+     * Payload keyed, encrypted and ECC-coded once for many carriers (HnS::prepare, broadcast embeds).
+     * Carrier-specific metadata (container, ext, filename, lsb_mode, skip_alpha, slot_order) is filled by each embed.
+     */
+    struct PreparedPayload
+    {
+        PreparedPayload() = default;
+        ~PreparedPayload() { OPENSSL_cleanse(this->key.data(), this->key.size()); }
+
+        PreparedPayload(const PreparedPayload&) = delete;
+        PreparedPayload& operator=(const PreparedPayload&) = delete;
+
+        std::vector<byte> plain_data;
+
+        /**
+         * Payload fields of the metadata (key source, KDF salt/cost, chunk/plain/payload/write sizes, ECC)
+         */
+        MetaData meta{};
+
+        /**
+         * Encrypted data after ECC, shared by every carrier (empty with fresh_iv)
+         */
+        std::vector<byte> coded_data;
+
+        /**
+         * Every carrier encrypts plain_data again under key with its own IV(s), so no two carriers hold the
+         * same ciphertext; the key (and KDF salt) are still derived once
+         */
+        bool fresh_iv{false};
+
+        /**
+         * Payload key (fresh_iv only, wiped on destruction)
+         */
+        std::array<byte, SHA256_DIGEST_LENGTH> key{};
+    };
+
 }
 
 #endif //YPSHNS_EMBEDDATA_HH
\ No newline at end of file
@@ -1,6 +1,18 @@
 #include "HnS.hh"
 
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include <ECC/ECC.hh>
+#include <Probe/Probe.hh>
+#include <Encryption.hh>
+#include <AuthorKey.hh>
+#include <Random/Random.hh>
+#include <openssl/crypto.h>
 
 namespace Yps
 {
@@ -37,5 +49,684 @@ std::optional<std::string> HnS::validate_path(const std::string& path)
 }
 
 
+std::optional<Extension> HnS::sniff_format(const byte* head, size_t size)
+{
+    auto starts_with = [head, size](const char* magic, size_t length) {
+        return size >= length && std::memcmp(head, magic, length) == 0;
+    };
+
+    if (starts_with("\x89PNG\r\n\x1A\n", 8))
+        return Extension::PNG;
+    if (starts_with("\xFF\xD8\xFF", 3))
+        return Extension::JPEG;
+    if (starts_with("RIFF", 4) && size >= 12 && std::memcmp(head + 8, "WAVE", 4) == 0)
+        return Extension::WAV;
+    if (starts_with("YUV4MPEG2 ", 10))
+        return Extension::Y4M;
+    if (size >= 3 && head[0] == 'P' && (head[1] == '6' || head[1] == '5') && std::isspace(head[2]))
+        return head[1] == '6' ? Extension::PPM : Extension::PGM;
+    if (starts_with("BM", 2))
+        return Extension::BMP;
+
+    /*TGA: no colormap, true-color/grayscale, matching depth*/
+    if (size >= 18 && head[1] == 0) {
+        byte type = head[2];
+        byte depth = head[16];
+        bool true_color = (type == 2 || type == 10) && (depth == 24 || depth == 32);
+        bool gray = (type == 3 || type == 11) && depth == 8;
+        bool has_size = (head[12] | head[13]) != 0 && (head[14] | head[15]) != 0;
+        if ((true_color || gray) && has_size)
+            return Extension::TGA;
+    }
+    return std::nullopt;
+}
+
+
+static const ReedSolomon& meta_codec()
+{
+    static const ReedSolomon codec(META_PARITY);
+    return codec;
+}
+
+
+namespace
+{
+    /**
+     * Little-endian writer of the MetaData wire format (see META_WIRE_SIZE)
+     */
+    struct WireWriter
+    {
+        byte* out;
+
+        template <typename T>
+        void put(T value)
+        {
+            const auto bits = static_cast<uint64_t>(value);
+            for (size_t i = 0; i < sizeof(T); ++i)
+                *this->out++ = static_cast<byte>(bits >> (8 * i));
+        }
+
+        template <typename E>
+        void put_enum(E value) { this->put(static_cast<uint8_t>(value)); }
+
+        void put_bytes(const void* data, size_t size)
+        {
+            std::memcpy(this->out, data, size);
+            this->out += size;
+        }
+    };
+
+    /**
+     * Little-endian reader of the MetaData wire format
+     */
+    struct WireReader
+    {
+        const byte* in;
+
+        template <typename T>
+        T get()
+        {
+            uint64_t bits = 0;
+            for (size_t i = 0; i < sizeof(T); ++i)
+                bits |= static_cast<uint64_t>(*this->in++) << (8 * i);
+            return static_cast<T>(bits);
+        }
+
+        template <typename E>
+        E get_enum() { return static_cast<E>(this->get<uint8_t>()); }
+
+        void get_bytes(void* data, size_t size)
+        {
+            std::memcpy(data, this->in, size);
+            this->in += size;
+        }
+    };
+}
+
+
+void HnS::pack_meta(const MetaData& meta, byte* out)
+{
+    std::vector<byte> raw(META_WIRE_SIZE);
+    WireWriter writer{raw.data()};
+    writer.put_bytes(meta.magic.data(), meta.magic.size());
+    writer.put(meta.version);
+    writer.put_enum(meta.container);
+    writer.put_enum(meta.ext);
+    writer.put_bytes(meta.filename, sizeof(meta.filename));
+    writer.put(meta.write_size);
+    writer.put_enum(meta.lsb_mode);
+    writer.put(meta.skip_alpha);
+    writer.put_enum(meta.slot_order);
+    writer.put(meta.payload_size);
+    writer.put(meta.ecc_parity);
+    writer.put(meta.chunk_size);
+    writer.put(meta.plain_size);
+    writer.put_enum(meta.key_source);
+    writer.put(meta.kdf_lanes);
+    writer.put(meta.kdf_memory_kib);
+    writer.put(meta.kdf_passes);
+    writer.put_bytes(meta.kdf_salt.data(), meta.kdf_salt.size());
+    writer.put(META_WIRE_SIZE);
+    if (writer.out != raw.data() + raw.size())
+        throw std::logic_error("HnS::pack_meta: META_WIRE_SIZE does not match the MetaData fields");
+
+    const std::vector<byte> coded = meta_codec().encode(raw);
+    std::copy(coded.begin(), coded.end(), out);
+}
+
+
+bool HnS::unpack_meta(const byte* in, MetaData& meta, bool quiet)
+{
+    auto raw = meta_codec().decode(std::vector<byte>(in, in + META_STREAM_SIZE), META_WIRE_SIZE);
+    // Uncorrectable: the code is systematic, so a header of another version still shows its magic in place.
+    WireReader reader{raw ? raw->data() : in};
+    reader.get_bytes(meta.magic.data(), meta.magic.size());
+    meta.version = reader.get<uint8_t>();
+    if (meta.magic != META_MAGIC)
+        return false;
+    if (meta.version != META_VERSION) {
+        if (!quiet)
+            std::cerr << CLI_RED << "Error: Unsupported metadata version " << static_cast<int>(meta.version)
+                      << " (this build reads version " << static_cast<int>(META_VERSION) << ")." << CLI_RESET << std::endl;
+        return false;
+    }
+    if (!raw)
+        return false;
+
+    meta.container = reader.get_enum<ContainerType>();
+    meta.ext = reader.get_enum<Extension>();
+    reader.get_bytes(meta.filename, sizeof(meta.filename));
+    meta.write_size = reader.get<uint64_t>();
+    meta.lsb_mode = reader.get_enum<LsbMode>();
+    meta.skip_alpha = reader.get<uint8_t>();
+    meta.slot_order = reader.get_enum<SlotOrder>();
+    meta.payload_size = reader.get<uint64_t>();
+    meta.ecc_parity = reader.get<uint8_t>();
+    meta.chunk_size = reader.get<uint32_t>();
+    meta.plain_size = reader.get<uint64_t>();
+    meta.key_source = reader.get_enum<KeySource>();
+    meta.kdf_lanes = reader.get<uint8_t>();
+    meta.kdf_memory_kib = reader.get<uint32_t>();
+    meta.kdf_passes = reader.get<uint32_t>();
+    reader.get_bytes(meta.kdf_salt.data(), meta.kdf_salt.size());
+    meta.meta_size = reader.get<uint32_t>();
+    return meta.meta_size == META_WIRE_SIZE;
+}
+
+
+void HnS::inspect(const byte*, uint64_t, Extension, ProbeReport& report) const
+{
+    report.error = "unsupported format";
+}
+
+
+std::optional<Extension> HnS::detect_format(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return std::nullopt;
+    byte head[SNIFF_BYTES];
+    in.read(reinterpret_cast<char*>(head), sizeof(head));
+    return sniff_format(head, static_cast<size_t>(in.gcount()));
+}
+
+
+std::optional<std::vector<byte>> HnS::read_file(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        return std::nullopt;
+
+    std::streamsize size = in.tellg();
+    if (size < 0)
+        return std::nullopt;
+    in.seekg(0, std::ios::beg);
+
+    std::vector<byte> data(static_cast<size_t>(size));
+    if (size > 0 && !in.read(reinterpret_cast<char*>(data.data()), size))
+        return std::nullopt;
+    return data;
+}
+
+
+bool HnS::write_file(const std::string& path, const std::vector<byte>& data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+
+bool HnS::select_embed_key()
+{
+    MetaData& meta = this->embed_data->meta;
+    if (!this->options.passphrase) {
+        meta.key_source = KeySource::AuthorKey;
+        auto key = AuthorKey::getInstance().get_key();
+        if (!key)
+            return false;
+        this->embed_data->key = *key;
+        OPENSSL_cleanse(key->data(), key->size());
+        return true;
+    }
+
+    Random::fill(meta.kdf_salt.data(), meta.kdf_salt.size());
+    meta.key_source = KeySource::Argon2id;
+    meta.kdf_memory_kib = this->options.kdf.memory_kib;
+    meta.kdf_passes = this->options.kdf.passes;
+    meta.kdf_lanes = this->options.kdf.lanes;
+
+    auto key = Argon2id::derive_key(*this->options.passphrase,
+                                    std::vector<byte>(meta.kdf_salt.begin(), meta.kdf_salt.end()), this->options.kdf);
+    if (!key)
+        return false;
+    this->embed_data->key = *key;
+    OPENSSL_cleanse(key->data(), key->size());
+    return true;
+}
+
+
+bool HnS::select_extract_key()
+{
+    const MetaData& meta = this->embed_data->meta;
+    switch (meta.key_source) {
+        case KeySource::AuthorKey: {
+            auto key = AuthorKey::getInstance().get_key();
+            if (!key)
+                return false;
+            this->embed_data->key = *key;
+            OPENSSL_cleanse(key->data(), key->size());
+            return true;
+        }
+        case KeySource::Argon2id:
+            break;
+        default:
+            std::cerr << CLI_RED << "Error: Unknown key source in metadata." << CLI_RESET << std::endl;
+            return false;
+    }
+
+    if (!this->options.passphrase) {
+        std::cerr << CLI_RED << "Error: Payload is passphrase-protected, set EmbedOptions::passphrase." << CLI_RESET << std::endl;
+        return false;
+    }
+    // Cost comes from an untrusted header: refuse absurd values instead of allocating them.
+    if (meta.kdf_lanes == 0 || meta.kdf_passes == 0 || meta.kdf_passes > Argon2id::MAX_PASSES ||
+        meta.kdf_memory_kib > Argon2id::MAX_MEMORY_KIB) {
+        std::cerr << CLI_RED << "Error: Invalid KDF parameters in metadata." << CLI_RESET << std::endl;
+        return false;
+    }
+
+    Argon2Params params;
+    params.memory_kib = meta.kdf_memory_kib;
+    params.passes = meta.kdf_passes;
+    params.lanes = meta.kdf_lanes;
+    auto key = Argon2id::derive_key(*this->options.passphrase,
+                                    std::vector<byte>(meta.kdf_salt.begin(), meta.kdf_salt.end()), params);
+    if (!key)
+        return false;
+    this->embed_data->key = *key;
+    OPENSSL_cleanse(key->data(), key->size());
+    return true;
+}
+
+
+bool HnS::encrypt_payload()
+{
+    MetaData& meta = this->embed_data->meta;
+    meta.plain_size = this->embed_data->plain_data.size();
+    meta.chunk_size = this->options.chunk_size;
+    if (meta.chunk_size > ChunkedPayload::MAX_CHUNK) {
+        std::cerr << CLI_RED << "HnS: Chunk size too large (max " << ChunkedPayload::MAX_CHUNK << "): "
+                  << meta.chunk_size << CLI_RESET << std::endl;
+        return false;
+    }
+
+    try {
+        if (meta.chunk_size == 0) {
+            // Stateless call: parallel embeds (broadcast, Batch) don't share the singleton's key.
+            const std::vector<byte>& plain = this->embed_data->plain_data;
+            if (plain.empty())
+                throw std::invalid_argument("data is empty");
+            this->embed_data->encrypt_data.resize(AES256Encryption::cipher_size(plain.size()));
+            AES256Encryption::encrypt_with(this->embed_data->key.data(), plain.data(), plain.size(),
+                                           this->embed_data->encrypt_data.data());
+        } else {
+            this->embed_data->encrypt_data = ChunkedPayload::encrypt(this->embed_data->plain_data, meta.chunk_size,
+                                                                     this->embed_data->key.data());
+        }
+    } catch (const std::exception& e) {
+        std::cerr << CLI_RED << "Error: Encryption failed: " << e.what() << CLI_RESET << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool HnS::encode_payload()
+{
+    MetaData& meta = this->embed_data->meta;
+    meta.payload_size = this->embed_data->encrypt_data.size();
+    meta.ecc_parity = this->options.ecc_parity;
+
+    if (meta.ecc_parity == 0) {
+        this->embed_data->coded_data = this->embed_data->encrypt_data;
+    } else {
+        if (meta.ecc_parity > ReedSolomon::MAX_PARITY) {
+            std::cerr << CLI_RED << "HnS: ECC parity too large (max " << static_cast<int>(ReedSolomon::MAX_PARITY)
+                      << "): " << static_cast<int>(meta.ecc_parity) << CLI_RESET << std::endl;
+            return false;
+        }
+        this->embed_data->coded_data = ReedSolomon(meta.ecc_parity).encode(this->embed_data->encrypt_data);
+    }
+
+    // write_size: coded + META_STREAM_SIZE (embedded header goes first).
+    meta.write_size = this->embed_data->coded_data.size() + META_STREAM_SIZE;
+    return true;
+}
+
+
+bool HnS::seal_payload()
+{
+    if (!this->prepared) {
+        if (!this->select_embed_key())
+            return false;
+        return this->encrypt_payload() && this->encode_payload();
+    }
 
-} // Yps
\ No newline at end of file
+    const PreparedPayload& payload = *this->prepared;
+    if (this->embed_data->plain_data != payload.plain_data) {
+        std::cerr << CLI_RED << "HnS: Data differs from the prepared payload." << CLI_RESET << std::endl;
+        return false;
+    }
+
+    // Payload fields only: the carrier ones are filled by the backend.
+    MetaData& meta = this->embed_data->meta;
+    meta.key_source = payload.meta.key_source;
+    meta.kdf_lanes = payload.meta.kdf_lanes;
+    meta.kdf_memory_kib = payload.meta.kdf_memory_kib;
+    meta.kdf_passes = payload.meta.kdf_passes;
+    meta.kdf_salt = payload.meta.kdf_salt;
+    if (payload.fresh_iv) {
+        this->embed_data->key = payload.key;
+        return this->encrypt_payload() && this->encode_payload();
+    }
+    meta.chunk_size = payload.meta.chunk_size;
+    meta.plain_size = payload.meta.plain_size;
+    meta.payload_size = payload.meta.payload_size;
+    meta.ecc_parity = payload.meta.ecc_parity;
+    meta.write_size = payload.meta.write_size;
+    this->embed_data->coded_data = payload.coded_data;
+    return true;
+}
+
+
+std::shared_ptr<const PreparedPayload> HnS::prepare(const std::vector<byte>& data, bool fresh_iv)
+{
+    this->embed_data = std::make_unique<EmbedData>();
+    this->embed_data->plain_data = data;
+    if (!this->select_embed_key() || !this->encrypt_payload() || !this->encode_payload())
+        return nullptr;
+
+    auto payload = std::make_shared<PreparedPayload>();
+    payload->plain_data = data;
+    payload->meta = this->embed_data->meta;
+    payload->fresh_iv = fresh_iv;
+    if (fresh_iv)
+        payload->key = this->embed_data->key;
+    else
+        payload->coded_data = std::move(this->embed_data->coded_data);
+    OPENSSL_cleanse(this->embed_data->key.data(), this->embed_data->key.size());
+    return payload;
+}
+
+
+bool HnS::check_chunking() const
+{
+    const MetaData& meta = this->embed_data->meta;
+    if (meta.chunk_size == 0)
+        return true;
+    // plain_size bounds encrypted_size() away from overflow; the rest must agree with it exactly.
+    if (meta.chunk_size > ChunkedPayload::MAX_CHUNK || meta.plain_size > meta.payload_size ||
+        ChunkedPayload::encrypted_size(meta.plain_size, meta.chunk_size) != meta.payload_size) {
+        std::cerr << CLI_RED << "Error: Invalid chunk layout in metadata." << CLI_RESET << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+bool HnS::repair_payload()
+{
+    const MetaData& meta = this->embed_data->meta;
+    if (meta.ecc_parity > ReedSolomon::MAX_PARITY ||
+        ReedSolomon::encoded_size(meta.payload_size, meta.ecc_parity) != this->embed_data->coded_data.size()) {
+        std::cerr << CLI_RED << "Error: Payload size does not match metadata." << CLI_RESET << std::endl;
+        return false;
+    }
+
+    this->embed_data->ecc_corrected = 0;
+    if (meta.ecc_parity == 0) {
+        this->embed_data->encrypt_data = this->embed_data->coded_data;
+    } else {
+        uint64_t corrected = 0;
+        auto repaired = ReedSolomon(meta.ecc_parity).decode(this->embed_data->coded_data, meta.payload_size, &corrected);
+        if (!repaired) {
+            std::cerr << CLI_RED << "Error: Embedded data damaged beyond ECC capacity." << CLI_RESET << std::endl;
+            return false;
+        }
+        this->embed_data->ecc_corrected = corrected;
+        this->embed_data->encrypt_data = std::move(*repaired);
+    }
+    return true;
+}
+
+
+std::optional<std::vector<byte>> HnS::decrypt_chunks(const StreamReader& read, uint64_t offset, uint64_t length)
+{
+    const MetaData& meta = this->embed_data->meta;
+    auto plain = ChunkedPayload::decrypt_range(read, meta.plain_size, meta.chunk_size,
+                                               this->embed_data->key.data(), offset, length);
+    if (!plain)
+        std::cerr << CLI_RED << "Error: Decryption failed (chunked payload)." << CLI_RESET << std::endl;
+    return plain;
+}
+
+
+bool HnS::decode_payload()
+{
+    const MetaData& meta = this->embed_data->meta;
+    if (!this->check_chunking() || !this->repair_payload() || !this->select_extract_key())
+        return false;
+
+    if (meta.chunk_size != 0) {
+        const std::vector<byte>& encrypted = this->embed_data->encrypt_data;
+        auto plain = this->decrypt_chunks(
+            [&encrypted](uint64_t offset, uint64_t size) -> std::optional<std::vector<byte>> {
+                if (offset > encrypted.size() || size > encrypted.size() - offset)
+                    return std::nullopt;
+                return std::vector<byte>(encrypted.begin() + offset, encrypted.begin() + offset + size);
+            },
+            0, meta.plain_size);
+        if (!plain)
+            return false;
+        this->embed_data->plain_data = std::move(*plain);
+        return true;
+    }
+
+    try {
+        // Stateless call, as in encrypt_payload: concurrent extracts don't share the singleton's key.
+        const std::vector<byte>& encrypted = this->embed_data->encrypt_data;
+        if (encrypted.empty())
+            throw std::invalid_argument("data is empty");
+        this->embed_data->plain_data = AES256Encryption::decrypt_with(this->embed_data->key.data(), encrypted.data(),
+                                                                      encrypted.size());
+    } catch (const std::exception& e) {
+        std::cerr << CLI_RED << "Error: Decryption failed: " << e.what() << CLI_RESET << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+std::optional<HnS::PlainReader> HnS::open_plain(const StreamReader& read)
+{
+    const MetaData& meta = this->embed_data->meta;
+    auto past_end = [](uint64_t offset, uint64_t size) {
+        if (offset <= size)
+            return false;
+        std::cerr << CLI_RED << "Error: Range starts past the end of data (" << size << " bytes)." << CLI_RESET << std::endl;
+        return true;
+    };
+    auto from_memory = [past_end](const std::vector<byte>& bytes) -> PlainReader {
+        return [&bytes, past_end](uint64_t offset, uint64_t length) -> std::optional<std::vector<byte>> {
+            if (past_end(offset, bytes.size()))
+                return std::nullopt;
+            const uint64_t end = offset + std::min<uint64_t>(length, bytes.size() - offset);
+            return std::vector<byte>(bytes.begin() + offset, bytes.begin() + end);
+        };
+    };
+
+    if (meta.write_size < META_STREAM_SIZE) {
+        std::cerr << CLI_RED << "Error: Invalid stream size in metadata." << CLI_RESET << std::endl;
+        return std::nullopt;
+    }
+    const uint64_t coded_size = meta.write_size - META_STREAM_SIZE;
+    auto read_all = [this, &read, coded_size]() {
+        auto coded = read(0, coded_size);
+        if (!coded) {
+            std::cerr << CLI_RED << "Error: Incomplete extraction of embedded stream." << CLI_RESET << std::endl;
+            return false;
+        }
+        this->embed_data->coded_data = std::move(*coded);
+        return true;
+    };
+
+    // One CBC stream: nothing to seek, decrypt everything now.
+    if (meta.chunk_size == 0) {
+        if (!read_all() || !this->decode_payload())
+            return std::nullopt;
+        return from_memory(this->embed_data->plain_data);
+    }
+    if (!this->check_chunking())
+        return std::nullopt;
+
+    StreamReader source;
+    if (meta.ecc_parity == 0) {
+        // Coded stream == encrypted payload: seek table and chunks are read straight from the carrier.
+        if (coded_size != meta.payload_size) {
+            std::cerr << CLI_RED << "Error: Payload size does not match metadata." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // Seek-table entries come from the carrier: never read past the stream they index.
+        source = [&read, coded_size](uint64_t at, uint64_t size) -> std::optional<std::vector<byte>> {
+            if (at > coded_size || size > coded_size - at)
+                return std::nullopt;
+            return read(at, size);
+        };
+    } else {
+        // ECC codewords are interleaved over the whole stream: repair all of it once.
+        if (!read_all() || !this->repair_payload())
+            return std::nullopt;
+        const std::vector<byte>& encrypted = this->embed_data->encrypt_data;
+        source = [&encrypted](uint64_t at, uint64_t size) -> std::optional<std::vector<byte>> {
+            if (at > encrypted.size() || size > encrypted.size() - at)
+                return std::nullopt;
+            return std::vector<byte>(encrypted.begin() + at, encrypted.begin() + at + size);
+        };
+    }
+    if (!this->select_extract_key())
+        return std::nullopt;
+
+    return [this, source, past_end](uint64_t offset, uint64_t length) -> std::optional<std::vector<byte>> {
+        const uint64_t plain_size = this->embed_data->meta.plain_size;
+        if (past_end(offset, plain_size))
+            return std::nullopt;
+        return this->decrypt_chunks(source, offset, std::min<uint64_t>(length, plain_size - offset));
+    };
+}
+
+
+bool HnS::patch_plain(const StreamReader& read, const StreamWriter& write, uint64_t offset,
+                      const std::vector<byte>& data)
+{
+    const MetaData& meta = this->embed_data->meta;
+    if (meta.chunk_size == 0 || meta.ecc_parity != 0) {
+        std::cerr << CLI_RED << "Error: In-place update needs a chunked payload without ECC (embed with --chunk, "
+                  << "no --ecc)." << CLI_RESET << std::endl;
+        return false;
+    }
+    if (!this->check_chunking())
+        return false;
+    if (meta.write_size < META_STREAM_SIZE || meta.write_size - META_STREAM_SIZE != meta.payload_size) {
+        std::cerr << CLI_RED << "Error: Payload size does not match metadata." << CLI_RESET << std::endl;
+        return false;
+    }
+    if (offset > meta.plain_size || data.size() > meta.plain_size - offset) {
+        std::cerr << CLI_RED << "Error: Update range passes the end of data (" << meta.plain_size << " bytes)."
+                  << CLI_RESET << std::endl;
+        return false;
+    }
+    if (!this->select_extract_key())
+        return false;
+
+    // Seek-table entries come from the carrier: never read past the stream they index.
+    const uint64_t coded_size = meta.payload_size;
+    auto bounded = [&read, coded_size](uint64_t at, uint64_t size) -> std::optional<std::vector<byte>> {
+        if (at > coded_size || size > coded_size - at)
+            return std::nullopt;
+        return read(at, size);
+    };
+    auto patch = ChunkedPayload::update(bounded, meta.plain_size, meta.chunk_size, this->embed_data->key.data(),
+                                        offset, data);
+    if (!patch) {
+        std::cerr << CLI_RED << "Error: Re-encryption failed (chunked payload)." << CLI_RESET << std::endl;
+        return false;
+    }
+    if (!patch->bytes.empty() && !write(patch->offset, patch->bytes)) {
+        std::cerr << CLI_RED << "Error: Failed to write updated chunks into carrier." << CLI_RESET << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+std::optional<std::vector<byte>> HnS::extract_query(const std::string& path, const PlainQuery& query)
+{
+    auto plain = this->extract(path);
+    if (!plain)
+        return std::nullopt;
+    const std::vector<byte>& bytes = *plain;
+    return query([&bytes](uint64_t offset, uint64_t length) -> std::optional<std::vector<byte>> {
+        if (offset > bytes.size()) {
+            std::cerr << CLI_RED << "Error: Range starts past the end of data (" << bytes.size() << " bytes)." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        const uint64_t end = offset + std::min<uint64_t>(length, bytes.size() - offset);
+        return std::vector<byte>(bytes.begin() + offset, bytes.begin() + end);
+    });
+}
+
+
+std::optional<std::vector<byte>> HnS::extract_range(const std::string& path, uint64_t offset, uint64_t length)
+{
+    return this->extract_query(path, [offset, length](const PlainReader& read) { return read(offset, length); });
+}
+
+
+std::optional<std::string> HnS::update(const std::string& path, uint64_t offset, const std::vector<byte>& data,
+                                       const std::string& out_path)
+{
+    (void)offset;
+    (void)data;
+    (void)out_path;
+    std::cerr << CLI_RED << "Error: In-place update is not supported for this container: " << path << CLI_RESET << std::endl;
+    return std::nullopt;
+}
+
+
+std::optional<std::string> HnS::embed_records(const std::vector<Record>& records, const std::string& path,
+                                              const std::string& out_path)
+{
+    auto payload = RecordArchive::pack(records);
+    if (!payload) {
+        std::cerr << CLI_RED << "HnS: Record names must be unique, non-empty and at most "
+                  << RecordArchive::MAX_NAME << " bytes." << CLI_RESET << std::endl;
+        return std::nullopt;
+    }
+    const uint32_t chunk_size = this->options.chunk_size;
+    if (chunk_size == 0)
+        this->options.chunk_size = RecordArchive::DEFAULT_CHUNK;
+    auto result = this->embed(*payload, path, out_path);
+    this->options.chunk_size = chunk_size;
+    return result;
+}
+
+
+std::optional<std::vector<RecordEntry>> HnS::list_records(const std::string& path)
+{
+    std::optional<std::vector<RecordEntry>> entries;
+    auto found = this->extract_query(path, [&entries](const PlainReader& read) -> std::optional<std::vector<byte>> {
+        entries = RecordArchive::read_index(read);
+        return entries ? std::optional<std::vector<byte>>(std::vector<byte>()) : std::nullopt;
+    });
+    if (!found) {
+        if (!entries)
+            std::cerr << CLI_RED << "Error: No record index in payload: " << path << CLI_RESET << std::endl;
+        return std::nullopt;
+    }
+    return entries;
+}
+
+
+std::optional<std::vector<byte>> HnS::extract_record(const std::string& path, const std::string& name)
+{
+    auto record = this->extract_query(path, [&name](const PlainReader& read) {
+        return RecordArchive::read_record(read, name);
+    });
+    if (!record)
+        std::cerr << CLI_RED << "Error: Record not found or unreadable: " << name << CLI_RESET << std::endl;
+    return record;
+}
+} // Yps
@@ -1,19 +1,119 @@
 #ifndef YPSHNS_HNS_HH
 #define YPSHNS_HNS_HH
 
+#include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 #include <filesystem>
 
+#include <memory>
+
 #include <defines.hh>
+#include <EmbedData.hh>
+#include <ChunkedPayload/ChunkedPayload.hh>
+#include <RecordArchive/RecordArchive.hh>
 
 namespace Yps
 {
+    struct ProbeReport;
+
     /**Interface for embed data*/
     class HnS
     {
     protected:
+        std::unique_ptr<EmbedData> embed_data;  // Context: plain/encrypt/meta/key.
+        EmbedOptions options;
+        std::optional<EmbedReport> report;  // Quality of last embed (options.quality_report)
+        std::shared_ptr<const PreparedPayload> prepared;  // Broadcast payload (set_prepared)
+
+        /**
+         * Choose encryption key for embed: Argon2id from options.passphrase with a fresh salt
+         * (recorded in meta) or AuthorKey.
+         * @return false, if derivation failed
+         */
+        bool select_embed_key();
+
+        /**
+         * Choose decryption key from meta.key_source (passphrase from options).
+         * @return false, if passphrase is missing or stored KDF parameters are invalid
+         */
+        bool select_extract_key();
+
+        /**
+         * Encrypt plain_data into encrypt_data with the selected key: one CBC stream or, with
+         * options.chunk_size, chunks + seek table (ChunkedPayload). Fills meta.chunk_size and meta.plain_size.
+         * @return false, if options are invalid or encryption failed
+         */
+        bool encrypt_payload();
+
+        /**
+         * Protect encrypt_data with ECC (options.ecc_parity) into coded_data.
+         * Fills meta.payload_size, meta.ecc_parity and meta.write_size.
+         * @return false, if options are invalid
+         */
+        bool encode_payload();
+
+        /**
+         * Key, encryption and ECC for embed_data->plain_data (select_embed_key, encrypt_payload,
+         * encode_payload), or only the copy of the prepared payload (set_prepared); fresh_iv re-encrypts it
+         * under the prepared key.
+         * @return false, if any step failed or plain_data is not the prepared payload
+         */
+        bool seal_payload();
+
+        /**
+         * Repair coded_data with ECC (meta.ecc_parity) and decrypt it into plain_data (key by select_extract_key).
+         * @return false, if data is uncorrectable or decryption failed
+         */
+        bool decode_payload();
+
+        /**
+         * Reads bytes [offset, offset + size) of coded_data straight from the carrier
+         */
+        using StreamReader = ChunkedPayload::Reader;
+
+        /**
+         * Overwrites bytes [offset, offset + bytes.size()) of coded_data in the carrier
+         */
+        using StreamWriter = std::function<bool(uint64_t offset, const std::vector<byte>& bytes)>;
+
+    public:
+        /**
+         * Reads plain bytes [offset, offset + length) (clipped to the end of data; offset past the end fails)
+         */
+        using PlainReader = RecordArchive::Reader;
+
+        /**
+         * Computes a result from ranged reads of the plain data (see extract_query)
+         */
+        using PlainQuery = std::function<std::optional<std::vector<byte>>(const PlainReader& read)>;
+
+    protected:
+
+        /**
+         * Random access to plain data for metadata in embed_data->meta: validates it and selects the key once.
+         * Chunked payloads without ECC read only the seek-table entries and chunks covering each request;
+         * with ECC the whole stream is read and repaired here (codewords are interleaved), later requests
+         * decrypt the covering chunks only. One-stream payloads are read and decrypted here whole.
+         * @param read Carrier access (must outlive the returned reader)
+         * @return reader of plain bytes or std::nullopt
+         */
+        std::optional<PlainReader> open_plain(const StreamReader& read);
+
+        /**
+         * Overwrite plain bytes [offset, offset + data.size()) of the payload described by embed_data->meta
+         * (validated, key selected here): only the chunks covering the range are read, re-encrypted and
+         * written back. Needs a chunked payload without ECC (codewords are interleaved over the whole stream).
+         * @param read Carrier access
+         * @param write Carrier update (called once, with the re-encrypted chunks)
+         * @param offset First byte of plain data
+         * @param data New bytes (the data size does not change)
+         * @return false, if the payload can't be updated in place, or reading/writing failed
+         */
+        bool patch_plain(const StreamReader& read, const StreamWriter& write, uint64_t offset,
+                         const std::vector<byte>& data);
+
         /**
          * Check path for validity.
          * @param path Path to file
@@ -21,10 +121,113 @@ namespace Yps
          */
         static std::optional<std::string> validate_path(const std::string& path);
 
+        /**
+         * Read whole file into memory.
+         * @param path Path to file
+         * @return file bytes or std::nullopt
+         */
+        static std::optional<std::vector<byte>> read_file(const std::string& path);
+
+        /**
+         * Write bytes to file (truncate).
+         * @param path Path to file
+         * @param data Bytes to write
+         * @return true on success
+         */
+        static bool write_file(const std::string& path, const std::vector<byte>& data);
+
+    private:
+        /**
+         * Chunked metadata (chunk_size, plain_size, payload_size) must describe a valid layout
+         */
+        [[nodiscard]] bool check_chunking() const;
+
+        /**
+         * coded_data -> encrypt_data (ECC decode if enabled); repaired bytes go to embed_data->ecc_corrected
+         */
+        bool repair_payload();
+
+        std::optional<std::vector<byte>> decrypt_chunks(const StreamReader& read, uint64_t offset, uint64_t length);
+
     public:
+        /**
+         * Bytes read from file start by detect_format
+         */
+        static constexpr size_t SNIFF_BYTES = 32;
+
+        /**
+         * Carrier format by magic bytes (file extension is not consulted).
+         * TGA has no signature: accepted last, if the 18-byte header is plausible.
+         * @param head First bytes of file (up to SNIFF_BYTES)
+         * @param size Number of bytes in head
+         * @return format or std::nullopt (unknown)
+         */
+        static std::optional<Extension> sniff_format(const byte* head, size_t size);
+
+        /**
+         * Write the embedded header of meta (Reed-Solomon coded with META_PARITY).
+         * @param meta Header
+         * @param out Receives META_STREAM_SIZE bytes
+         */
+        static void pack_meta(const MetaData& meta, byte* out);
+
+        /**
+         * Read an embedded header: damaged bytes are corrected, magic and version are checked, other versions
+         * are rejected (and reported unless quiet) rather than misread. Field values are validated by the caller.
+         * @param in META_STREAM_SIZE bytes read from the carrier
+         * @param meta Receives the header
+         * @param quiet Don't log an unsupported version (probing)
+         * @return false, if this is not an intact header of the supported version
+         */
+        static bool unpack_meta(const byte* in, MetaData& meta, bool quiet = false);
+
+        /**
+         * Read first SNIFF_BYTES of file and sniff them.
+         * @param path Path to file
+         * @return format or std::nullopt (missing file, unknown format)
+         */
+        static std::optional<Extension> detect_format(const std::string& path);
+
         /**Correct delete for children*/
         virtual ~HnS() = default;
 
+        /**
+         * Set embedding parameters for next embed() calls
+         * @param opts Options
+         */
+        void set_options(const EmbedOptions& opts) { this->options = opts; }
+
+        /**
+         * @return current embedding parameters
+         */
+        [[nodiscard]] const EmbedOptions& get_options() const { return this->options; }
+
+        /**
+         * @return quality of last successful embed or std::nullopt (not requested / not supported by container)
+         */
+        [[nodiscard]] const std::optional<EmbedReport>& get_report() const { return this->report; }
+
+        /**
+         * @return bytes repaired by ECC during the last extraction (0 - none or no ECC)
+         */
+        [[nodiscard]] uint64_t get_ecc_corrected() const { return this->embed_data ? this->embed_data->ecc_corrected : 0; }
+
+        /**
+         * Key, encrypt and ECC-code data once with the current options, for set_prepared() on many backends.
+         * @param data Payload
+         * @param fresh_iv Keep the key so every carrier gets its own ciphertext (see PreparedPayload::fresh_iv)
+         * @return prepared payload or nullptr, if failed
+         */
+        std::shared_ptr<const PreparedPayload> prepare(const std::vector<byte>& data, bool fresh_iv = false);
+
+        /**
+         * Embed the prepared payload in next embed() calls: their data must equal prepared->plain_data, and
+         * only the carrier-specific work (bit insertion, codec) is done per call. Options must be those it was
+         * prepared with. nullptr - back to keying and encrypting every embed.
+         * @param payload Result of prepare()
+         */
+        void set_prepared(std::shared_ptr<const PreparedPayload> payload) { this->prepared = std::move(payload); }
+
         /**
          * Embed data to some container
          * @param data Vector with data to embed
@@ -40,6 +243,74 @@ namespace Yps
          * @return vector with bytes or std::nullopt, if failed
          */
         virtual std::optional<std::vector<byte>> extract(const std::string& path) = 0;
+
+        /**
+         * Probe a carrier of a format this backend handles (Probe::inspect): geometry, capacity per LsbMode and
+         * whether it holds our header, without embedding or a key. The default reports the format as unsupported.
+         * Streaming formats touch only their headers and first samples, so a mapped file is read sparsely.
+         * @param file Whole carrier in memory (or mapped)
+         * @param size Carrier bytes
+         * @param format Sniffed format
+         * @param report Filled in (error set if the carrier can't be sized)
+         */
+        virtual void inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const;
+
+        /**
+         * Answer a query with ranged reads of the hidden data. Backends that can read the stream at an offset
+         * decode the carrier once and only touch carrier elements holding the requested parts; the default
+         * extracts everything and serves reads from memory.
+         * @param path Path to file with container
+         * @param query Reads what it needs and builds the result
+         * @return query result or std::nullopt, if extraction or the query failed
+         */
+        virtual std::optional<std::vector<byte>> extract_query(const std::string& path, const PlainQuery& query);
+
+        /**
+         * Get part of the data from modified file (extract_query with one read)
+         * @param path Path to file with container
+         * @param offset First byte of plain data
+         * @param length Number of bytes (clipped to the end of data)
+         * @return bytes or std::nullopt, if failed or offset is past the end
+         */
+        std::optional<std::vector<byte>> extract_range(const std::string& path, uint64_t offset, uint64_t length);
+
+        /**
+         * Overwrite part of the hidden data without embedding it again: only the chunks covering the range
+         * are re-encrypted and only the carrier elements holding them are rewritten (see patch_plain).
+         * The default reports that the container can't do that.
+         * @param path Path to file with container
+         * @param offset First byte of plain data
+         * @param data New bytes (offset + size must not pass the end of data)
+         * @param out_path Path to modified file (path itself: updated in place)
+         * @return out_path or std::nullopt, if failed or not supported
+         */
+        virtual std::optional<std::string> update(const std::string& path, uint64_t offset,
+                                                  const std::vector<byte>& data, const std::string& out_path);
+
+        /**
+         * Embed several named files in one pass: one archive payload (RecordArchive), one encryption and one
+         * carrier encode. Unchunked options get RecordArchive::DEFAULT_CHUNK so records stay separately readable.
+         * @param records Files to hide (unique names)
+         * @param path Path to file's container
+         * @param out_path Path to modified file
+         * @return out_path or std::nullopt, if failed
+         */
+        std::optional<std::string> embed_records(const std::vector<Record>& records, const std::string& path,
+                                                 const std::string& out_path);
+
+        /**
+         * @param path Path to file with container
+         * @return index of a multi-record payload or std::nullopt (not an archive, failed)
+         */
+        std::optional<std::vector<RecordEntry>> list_records(const std::string& path);
+
+        /**
+         * Extract one record: reads the archive header, index and that record only.
+         * @param path Path to file with container
+         * @param name Record name
+         * @return record bytes or std::nullopt (no such record, failed)
+         */
+        std::optional<std::vector<byte>> extract_record(const std::string& path, const std::string& name);
     };
 } // Yps
 
@@ -0,0 +1,125 @@
+#include "ImageAnalysis.hh"
+
+#include <Parallel/Parallel.hh>
+
+#include <limits>
+#include <mutex>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t MIN_PIXELS = 64 * 1024;
+
+        struct Partial
+        {
+            std::mutex mutex;
+            std::vector<std::array<uint64_t, 256>> histograms;
+            uint32_t alpha_and{std::numeric_limits<uint32_t>::max()};
+        };
+
+        /**
+         * One pass over pixels [begin, end): per-channel histograms and AND of all alpha samples.
+         * Channels < 3 count R pixels per step into separate tables, so consecutive increments
+         * never hit the same counter (no store-to-load stalls on flat images).
+         */
+        template <uint32_t Channels, typename Sample>
+        void sweep(const Sample* samples, size_t begin, size_t end, Partial& total)
+        {
+            constexpr uint32_t R = Channels == 1 ? 4 : Channels == 2 ? 2 : 1;
+            constexpr bool has_alpha = Channels == 2 || Channels == 4;
+
+            std::vector<std::array<uint64_t, 256>> hist(R * Channels, std::array<uint64_t, 256>{});
+            Sample alpha_and = std::numeric_limits<Sample>::max();
+
+            const Sample* p = samples + begin * Channels;
+            size_t pixel = begin;
+            for (; pixel + R <= end; pixel += R, p += R * Channels) {
+                for (uint32_t r = 0; r < R; ++r)
+                    for (uint32_t c = 0; c < Channels; ++c)
+                        ++hist[r * Channels + c][p[r * Channels + c] & 0xFF];
+                if constexpr (has_alpha)
+                    for (uint32_t r = 0; r < R; ++r)
+                        alpha_and &= p[r * Channels + Channels - 1];
+            }
+            for (; pixel < end; ++pixel, p += Channels) {
+                for (uint32_t c = 0; c < Channels; ++c)
+                    ++hist[c][p[c] & 0xFF];
+                if constexpr (has_alpha)
+                    alpha_and &= p[Channels - 1];
+            }
+
+            std::lock_guard<std::mutex> lock(total.mutex);
+            for (uint32_t t = 0; t < R * Channels; ++t)
+                for (size_t v = 0; v < 256; ++v)
+                    total.histograms[t % Channels][v] += hist[t][v];
+            total.alpha_and &= alpha_and;
+        }
+
+        template <uint32_t Channels, typename Sample>
+        void sweep_all(const void* samples, uint64_t pixels, Partial& total)
+        {
+            const auto* typed = static_cast<const Sample*>(samples);
+            Parallel::parallel_for(static_cast<size_t>(pixels), [&](size_t begin, size_t end) {
+                sweep<Channels, Sample>(typed, begin, end, total);
+            }, MIN_PIXELS);
+        }
+
+        template <typename Sample>
+        void dispatch(uint32_t channels, const void* samples, uint64_t pixels, Partial& total)
+        {
+            switch (channels) {
+                case 1: sweep_all<1, Sample>(samples, pixels, total); break;
+                case 2: sweep_all<2, Sample>(samples, pixels, total); break;
+                case 3: sweep_all<3, Sample>(samples, pixels, total); break;
+                case 4: sweep_all<4, Sample>(samples, pixels, total); break;
+                default: break;
+            }
+        }
+
+        /**
+         * Largest stream with image_samples_needed(stream) <= samples (needed samples grow with stream size).
+         */
+        uint64_t max_stream(uint64_t samples, LsbMode mode, const BitKernels::PixelFormat& format)
+        {
+            uint64_t lo = 0, hi = samples / 4 + 1;  // 2 bits per sample at most
+            while (lo < hi) {
+                uint64_t mid = lo + (hi - lo + 1) / 2;
+                if (BitKernels::image_samples_needed(mid, mode, format) <= samples)
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+            return lo;
+        }
+    }
+
+    ImageStats ImageAnalysis::analyze(const void* samples, uint32_t width, uint32_t height, uint32_t channels,
+                                      uint32_t bits_per_sample)
+    {
+        ImageStats stats;
+        stats.format = {channels, bits_per_sample, false};
+        stats.pixels = static_cast<uint64_t>(width) * height;
+        stats.samples = stats.pixels * channels;
+        if (!samples || channels < 1 || channels > 4 || (bits_per_sample != 8 && bits_per_sample != 16))
+            return stats;
+
+        Partial total;
+        total.histograms.assign(channels, std::array<uint64_t, 256>{});
+        if (bits_per_sample == 16)
+            dispatch<uint16_t>(channels, samples, stats.pixels, total);
+        else
+            dispatch<byte>(channels, samples, stats.pixels, total);
+        stats.histograms = std::move(total.histograms);
+
+        // Alpha that is not fully opaque is left untouched by the payload.
+        const uint32_t opaque = bits_per_sample == 16 ? 0xFFFF : 0xFF;
+        stats.alpha_opaque = stats.format.has_alpha() && (total.alpha_and & opaque) == opaque;
+        stats.format.skip_alpha = stats.format.has_alpha() && !stats.alpha_opaque;
+
+        stats.usable_samples = stats.format.skip_alpha ? stats.pixels * (channels - 1) : stats.samples;
+        stats.capacity[static_cast<size_t>(LsbMode::OneBit)] = max_stream(stats.samples, LsbMode::OneBit, stats.format);
+        stats.capacity[static_cast<size_t>(LsbMode::TwoBits)] = max_stream(stats.samples, LsbMode::TwoBits, stats.format);
+        return stats;
+    }
+} // Yps
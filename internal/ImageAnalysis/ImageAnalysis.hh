@@ -0,0 +1,77 @@
+#ifndef YPSHNS_IMAGEANALYSIS_HH
+#define YPSHNS_IMAGEANALYSIS_HH
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <BitKernels/BitKernels.hh>
+
+namespace Yps
+{
+    /**
+     * Everything embed planning needs from a decoded image, gathered in one sweep.
+     */
+    struct ImageStats
+    {
+        /**
+         * Image format (skip_alpha set when alpha is present but not fully opaque)
+         */
+        BitKernels::PixelFormat format;
+
+        uint64_t pixels{};
+        uint64_t samples{};
+
+        /**
+         * Alpha present and every alpha sample is 255 / 65535
+         */
+        bool alpha_opaque{false};
+
+        /**
+         * Per-channel histogram of the sample byte that carries LSBs (the sample itself for 8-bit,
+         * the low byte for 16-bit)
+         */
+        std::vector<std::array<uint64_t, 256>> histograms;
+
+        /**
+         * Samples the payload may use (alpha excluded when skipped)
+         */
+        uint64_t usable_samples{};
+
+        /**
+         * Largest stream (meta + coded) that fits, per mode (index: LsbMode::OneBit, LsbMode::TwoBits)
+         */
+        std::array<uint64_t, 2> capacity{};
+
+        /**
+         * @return largest stream for mode (0 for LsbMode::NoUsed)
+         */
+        [[nodiscard]] uint64_t capacity_for(LsbMode mode) const
+        {
+            return mode == LsbMode::NoUsed ? 0 : this->capacity[static_cast<size_t>(mode)];
+        }
+    };
+
+    /**
+     * Fused analysis pass over decoded interleaved samples: alpha check, histograms and capacity.
+     * The sweep is split on whole pixels with Parallel::parallel_for; the inner loop is specialized
+     * on channel count and sample width and has no data-dependent branches.
+     */
+    class ImageAnalysis
+    {
+    public:
+        /**
+         * @param samples Decoded samples (stb order, native-endian 16-bit samples)
+         * @param width/height Image size in pixels
+         * @param channels 1..4 (2 and 4 carry alpha last)
+         * @param bits_per_sample 8 or 16
+         * @return statistics (empty histograms for unsupported formats)
+         */
+        static ImageStats analyze(const void* samples, uint32_t width, uint32_t height, uint32_t channels,
+                                  uint32_t bits_per_sample);
+    };
+} // Yps
+
+#endif //YPSHNS_IMAGEANALYSIS_HH
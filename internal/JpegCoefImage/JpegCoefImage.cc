@@ -0,0 +1,795 @@
+#include "JpegCoefImage.hh"
+
+#include <Parallel/Parallel.hh>
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>   // For free() of jpeg_mem_dest buffers
+#include <cstring>   // For std::memcpy
+
+namespace Yps
+{
+    namespace
+    {
+        uint16_t read_be16(const std::vector<byte>& buf, size_t pos)
+        {
+            return static_cast<uint16_t>((buf[pos] << 8) | buf[pos + 1]);
+        }
+
+        bool is_sof(byte marker)
+        {
+            // C4 = DHT, C8 = JPG, CC = DAC share the range.
+            return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        }
+
+        JDIMENSION round_up(JDIMENSION value, JDIMENSION multiple)
+        {
+            return ((value + multiple - 1) / multiple) * multiple;
+        }
+
+        /*Zigzag position -> natural order index (T.81 Figure A.6)*/
+        constexpr std::array<uint8_t, DCTSIZE2> ZIGZAG = {
+             0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+            12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+            35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+            58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+        uint32_t magnitude_bits(int32_t value)
+        {
+            uint32_t magnitude = static_cast<uint32_t>(value < 0 ? -value : value);
+            uint32_t bits = 0;
+            for (; magnitude != 0; magnitude >>= 1)
+                ++bits;
+            return bits;
+        }
+
+        /**
+         * Optimal Huffman table with codes of at most 16 bits for symbol counts (T.81 Annex K.2, as libjpeg's
+         * optimize_coding). Every symbol valid in baseline (DC categories 0-11; AC EOB, ZRL, run/size 1-10)
+         * gets a count of at least one, so coefficients changed later still have a code.
+         */
+        void optimal_table(std::array<long, 257> freq, bool dc, JHUFF_TBL& table)
+        {
+            if (dc) {
+                for (int symbol = 0; symbol <= 11; ++symbol)
+                    ++freq[symbol];
+            } else {
+                ++freq[0x00];
+                ++freq[0xF0];
+                for (int run = 0; run < 16; ++run)
+                    for (int size = 1; size <= 10; ++size)
+                        ++freq[(run << 4) | size];
+            }
+            freq[256] = 1;  // Reserved: no code is all ones
+
+            std::array<int, 257> codesize{};
+            std::array<int, 257> others;
+            others.fill(-1);
+            while (true) {
+                int c1 = -1, c2 = -1;
+                long v = 1000000000L;
+                for (int i = 0; i <= 256; ++i)
+                    if (freq[i] && freq[i] <= v) {
+                        v = freq[i];
+                        c1 = i;
+                    }
+                v = 1000000000L;
+                for (int i = 0; i <= 256; ++i)
+                    if (freq[i] && freq[i] <= v && i != c1) {
+                        v = freq[i];
+                        c2 = i;
+                    }
+                if (c2 < 0)
+                    break;
+                freq[c1] += freq[c2];
+                freq[c2] = 0;
+                for (++codesize[c1]; others[c1] >= 0; ++codesize[c1])
+                    c1 = others[c1];
+                others[c1] = c2;
+                for (++codesize[c2]; others[c2] >= 0; ++codesize[c2])
+                    c2 = others[c2];
+            }
+
+            std::array<int, 33> bits{};
+            for (int i = 0; i <= 256; ++i)
+                if (codesize[i])
+                    ++bits[std::min(codesize[i], 32)];
+            /*Limit code length to 16 bits*/
+            for (int i = 32; i > 16; --i) {
+                while (bits[i] > 0) {
+                    int j = i - 2;
+                    while (bits[j] == 0)
+                        --j;
+                    bits[i] -= 2;
+                    bits[i - 1]++;
+                    bits[j + 1] += 2;
+                    bits[j]--;
+                }
+            }
+            int longest = 16;
+            while (bits[longest] == 0)
+                --longest;
+            bits[longest]--;  // Drop the reserved code
+
+            table.bits[0] = 0;
+            for (int i = 1; i <= 16; ++i)
+                table.bits[i] = static_cast<UINT8>(bits[i]);
+            int p = 0;
+            for (int length = 1; length <= 32; ++length)
+                for (int symbol = 0; symbol <= 255; ++symbol)
+                    if (codesize[symbol] == length)
+                        table.huffval[p++] = static_cast<UINT8>(symbol);
+            table.sent_table = FALSE;
+        }
+
+        void copy_table(const JHUFF_TBL* source, JHUFF_TBL*& target, j_common_ptr cinfo)
+        {
+            if (!source)
+                return;
+            if (!target)
+                target = jpeg_alloc_huff_table(cinfo);
+            std::memcpy(target->bits, source->bits, sizeof(target->bits));
+            std::memcpy(target->huffval, source->huffval, sizeof(target->huffval));
+            target->sent_table = FALSE;
+        }
+    }
+
+    std::optional<JpegCoefImage::Layout> JpegCoefImage::scan_layout(const std::vector<byte>& file)
+    {
+        if (file.size() < 4 || file[0] != 0xFF || file[1] != 0xD8)
+            return std::nullopt;
+
+        Layout layout;
+        size_t pos = 2;
+        bool have_sof = false;
+
+        /*Marker segments up to SOS*/
+        while (true)
+        {
+            if (pos + 4 > file.size() || file[pos] != 0xFF)
+                return std::nullopt;
+            while (pos + 1 < file.size() && file[pos + 1] == 0xFF)  // Fill bytes.
+                ++pos;
+            if (pos + 4 > file.size())
+                return std::nullopt;
+
+            byte marker = file[pos + 1];
+            if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))  // Standalone markers.
+            {
+                pos += 2;
+                continue;
+            }
+            if (marker == 0xD9)  // EOI before any scan.
+                return std::nullopt;
+
+            size_t length = read_be16(file, pos + 2);
+            if (length < 2 || pos + 2 + length > file.size())
+                return std::nullopt;
+
+            if (is_sof(marker))
+            {
+                layout.sof_offset = pos;
+                layout.sof_marker = marker;
+                have_sof = true;
+            }
+            else if (marker == 0xDD && length >= 4)
+            {
+                layout.restart_interval = read_be16(file, pos + 4);
+            }
+            else if (marker == 0xDA)
+            {
+                layout.sos_offset = pos;
+                layout.sos_end = pos + 2 + length;
+                break;
+            }
+            pos += 2 + length;
+        }
+        if (!have_sof)
+            return std::nullopt;
+
+        /*Entropy-coded data of first scan: split on RSTn, stop at any other marker*/
+        size_t begin = layout.sos_end;
+        size_t i = begin;
+        while (i + 1 < file.size())
+        {
+            if (file[i] != 0xFF)
+            {
+                ++i;
+                continue;
+            }
+            byte next = file[i + 1];
+            if (next == 0x00)  // Stuffed byte.
+            {
+                i += 2;
+            }
+            else if (next >= 0xD0 && next <= 0xD7)
+            {
+                layout.intervals.emplace_back(begin, i);
+                i += 2;
+                begin = i;
+            }
+            else if (next == 0xFF)  // Fill byte before marker.
+            {
+                ++i;
+            }
+            else
+            {
+                layout.intervals.emplace_back(begin, i);
+                layout.ends_with_eoi = (next == 0xD9);
+                return layout;
+            }
+        }
+
+        // Truncated scan: keep what we have, libjpeg will pad it.
+        layout.intervals.emplace_back(begin, file.size());
+        return layout;
+    }
+
+    void JpegCoefImage::patch_height(std::vector<byte>& jpeg, size_t sof_offset, uint32_t height)
+    {
+        // FF Cx | length(2) | precision(1) | height(2) | width(2) ...
+        jpeg[sof_offset + 5] = static_cast<byte>((height >> 8) & 0xFF);
+        jpeg[sof_offset + 6] = static_cast<byte>(height & 0xFF);
+    }
+
+    std::vector<byte> JpegCoefImage::make_band(const std::vector<byte>& file, const Layout& layout,
+                                               size_t first, size_t last, uint32_t band_height)
+    {
+        size_t entropy_bytes = 0;
+        for (size_t j = first; j < last; ++j)
+            entropy_bytes += layout.intervals[j].second - layout.intervals[j].first + 2;
+
+        std::vector<byte> band;
+        band.reserve(layout.sos_end + entropy_bytes + 2);
+        band.insert(band.end(), file.begin(), file.begin() + static_cast<std::ptrdiff_t>(layout.sos_end));
+        patch_height(band, layout.sof_offset, band_height);
+
+        // Restart markers renumbered from RST0 — libjpeg checks the sequence.
+        for (size_t j = first; j < last; ++j)
+        {
+            if (j != first)
+            {
+                band.push_back(0xFF);
+                band.push_back(static_cast<byte>(0xD0 + ((j - first - 1) & 7)));
+            }
+            band.insert(band.end(), file.begin() + static_cast<std::ptrdiff_t>(layout.intervals[j].first),
+                        file.begin() + static_cast<std::ptrdiff_t>(layout.intervals[j].second));
+        }
+        band.push_back(0xFF);
+        band.push_back(0xD9);
+        return band;
+    }
+
+    JDIMENSION JpegCoefImage::blocks_per_mcu_row(size_t ci) const
+    {
+        return this->components.size() == 1 ? 1 : static_cast<JDIMENSION>(this->components[ci].v_samp);
+    }
+
+    std::pair<uint32_t, uint32_t> JpegCoefImage::mcu_geometry() const
+    {
+        if (this->components.size() == 1)
+            return {this->components[0].height_in_blocks, static_cast<uint32_t>(DCTSIZE * this->max_v_samp / this->components[0].v_samp)};
+
+        uint32_t mcu_height = static_cast<uint32_t>(DCTSIZE * this->max_v_samp);
+        return {(this->image_height + mcu_height - 1) / mcu_height, mcu_height};
+    }
+
+    uint32_t JpegCoefImage::mcus_per_row() const
+    {
+        if (this->components.size() == 1)
+            return this->components[0].width_in_blocks;
+        int32_t max_h = 1;
+        for (const auto& comp : this->components)
+            max_h = std::max(max_h, comp.h_samp);
+        uint32_t mcu_width = static_cast<uint32_t>(DCTSIZE * max_h);
+        return (this->image_width + mcu_width - 1) / mcu_width;
+    }
+
+    std::vector<JpegCoefImage::SymbolCounts> JpegCoefImage::count_symbols(uint32_t rows_per_interval) const
+    {
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        (void)mcu_height;
+        const uint32_t mcus = this->mcus_per_row();
+        const bool single = this->components.size() == 1;
+
+        std::vector<SymbolCounts> counts(this->components.size());
+        Parallel::parallel_for(this->components.size(), [&](size_t ci_begin, size_t ci_end) {
+            for (size_t ci = ci_begin; ci < ci_end; ++ci) {
+                const JpegComponentCoefs& comp = this->components[ci];
+                SymbolCounts& count = counts[ci];
+                const JDIMENSION h = single ? 1 : static_cast<JDIMENSION>(comp.h_samp);
+                const JDIMENSION v = single ? 1 : static_cast<JDIMENSION>(comp.v_samp);
+                int32_t last_dc = 0;
+                /*Blocks in MCU order; dummy blocks past the edges repeat the DC and have no AC*/
+                for (uint32_t row = 0; row < mcu_rows; ++row) {
+                    if (row % rows_per_interval == 0)
+                        last_dc = 0;
+                    for (uint32_t mcu = 0; mcu < mcus; ++mcu)
+                        for (JDIMENSION y = 0; y < v; ++y)
+                            for (JDIMENSION x = 0; x < h; ++x) {
+                                const JDIMENSION by = row * v + y;
+                                const JDIMENSION bx = mcu * h + x;
+                                if (by >= comp.height_in_blocks || bx >= comp.width_in_blocks) {
+                                    ++count.dc[0];
+                                    ++count.ac[0x00];
+                                    continue;
+                                }
+                                const JCOEF* block = comp.block_row(by) + static_cast<size_t>(bx) * DCTSIZE2;
+                                ++count.dc[magnitude_bits(block[0] - last_dc)];
+                                last_dc = block[0];
+                                uint32_t run = 0;
+                                for (size_t k = 1; k < DCTSIZE2; ++k) {
+                                    const JCOEF value = block[ZIGZAG[k]];
+                                    if (value == 0) {
+                                        ++run;
+                                        continue;
+                                    }
+                                    for (; run > 15; run -= 16)
+                                        ++count.ac[0xF0];
+                                    ++count.ac[std::min<uint32_t>((run << 4) | magnitude_bits(value), 255)];
+                                    run = 0;
+                                }
+                                if (run > 0)
+                                    ++count.ac[0x00];
+                            }
+                }
+            }
+        });
+        return counts;
+    }
+
+    std::optional<JpegCoefImage> JpegCoefImage::decode(const std::vector<byte>& file)
+    {
+        try {
+            return decode_file(file);
+        } catch (const JpegError& e) {
+            std::cerr << CLI_RED << "Error: JPEG decode failed: " << e.what() << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    std::optional<JpegCoefImage> JpegCoefImage::decode_file(const std::vector<byte>& file)
+    {
+        auto layout = scan_layout(file);
+        if (!layout) {
+            std::cerr << CLI_RED << "Error: Not a JPEG stream (markers)." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        JpegCoefImage result;
+        result.header.assign(file.begin(), file.begin() + static_cast<std::ptrdiff_t>(layout->sos_end));
+
+        /*Header-only pass: geometry without entropy decoding*/
+        uint32_t comps_in_scan = 0;
+        {
+            JpegDecompressRAII probe;
+            jpeg_mem_src(&probe.cinfo, result.header.data(), static_cast<unsigned long>(result.header.size()));
+            if (jpeg_read_header(&probe.cinfo, TRUE) != JPEG_HEADER_OK) {
+                std::cerr << CLI_RED << "Error: JPEG header read failed." << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            result.image_width = probe.cinfo.image_width;
+            result.image_height = probe.cinfo.image_height;
+            result.max_v_samp = probe.cinfo.max_v_samp_factor;
+            result.progressive = probe.cinfo.progressive_mode;
+            comps_in_scan = static_cast<uint32_t>(probe.cinfo.comps_in_scan);
+
+            result.components.resize(static_cast<size_t>(probe.cinfo.num_components));
+            for (int ci = 0; ci < probe.cinfo.num_components; ++ci) {
+                const jpeg_component_info* comp = probe.cinfo.comp_info + ci;
+                JpegComponentCoefs& dst = result.components[static_cast<size_t>(ci)];
+                dst.width_in_blocks = comp->width_in_blocks;
+                dst.height_in_blocks = comp->height_in_blocks;
+                dst.h_samp = comp->h_samp_factor;
+                dst.v_samp = comp->v_samp_factor;
+                if (const JQUANT_TBL* table = probe.cinfo.quant_tbl_ptrs[comp->quant_tbl_no])
+                    std::copy(table->quantval, table->quantval + DCTSIZE2, dst.quant.begin());
+                dst.coefs.assign(static_cast<size_t>(dst.block_count()) * DCTSIZE2, 0);
+            }
+        }
+
+        /*Parallel path: single sequential Huffman scan, restart intervals aligned to MCU rows*/
+        bool huffman_sequential = (layout->sof_marker == 0xC0 || layout->sof_marker == 0xC1);
+        if (huffman_sequential && layout->ends_with_eoi && layout->restart_interval > 0 &&
+            comps_in_scan == result.components.size() && Parallel::thread_count() > 1)
+        {
+            auto [mcu_rows, mcu_height] = result.mcu_geometry();
+            (void)mcu_height;
+            const uint32_t mcus_per_row = result.mcus_per_row();
+
+            if (mcus_per_row > 0 && layout->restart_interval % mcus_per_row == 0) {
+                uint32_t rows_per_interval = layout->restart_interval / mcus_per_row;
+                size_t expected = (mcu_rows + rows_per_interval - 1) / rows_per_interval;
+                if (layout->intervals.size() == expected && expected > 1 &&
+                    result.decode_segmented(file, *layout, rows_per_interval))
+                {
+                    result.segmented = true;
+                    return result;
+                }
+            }
+        }
+
+        if (!result.decode_sequential(file))
+            return std::nullopt;
+        return result;
+    }
+
+    bool JpegCoefImage::decode_sequential(const std::vector<byte>& file)
+    {
+        JpegDecompressRAII decompress;
+        jpeg_mem_src(&decompress.cinfo, file.data(), static_cast<unsigned long>(file.size()));
+        if (jpeg_read_header(&decompress.cinfo, TRUE) != JPEG_HEADER_OK) {
+            std::cerr << CLI_RED << "Error: JPEG header read failed." << CLI_RESET << std::endl;
+            return false;
+        }
+
+        jvirt_barray_ptr* coef_arrays = jpeg_read_coefficients(&decompress.cinfo);
+        if (!coef_arrays) {
+            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients." << CLI_RESET << std::endl;
+            return false;
+        }
+
+        for (size_t ci = 0; ci < this->components.size(); ++ci) {
+            JpegComponentCoefs& comp = this->components[ci];
+            size_t row_bytes = static_cast<size_t>(comp.width_in_blocks) * sizeof(JBLOCK);
+            for (JDIMENSION row = 0; row < comp.height_in_blocks; ++row) {
+                JBLOCKARRAY block_array = (*decompress.cinfo.mem->access_virt_barray)
+                    ((j_common_ptr) &decompress.cinfo, coef_arrays[ci], row, 1, FALSE);
+                if (block_array == nullptr) {
+                    std::cerr << CLI_RED << "Error: Failed to access DCT block row " << row << "." << CLI_RESET << std::endl;
+                    jpeg_finish_decompress(&decompress.cinfo);
+                    return false;
+                }
+                std::memcpy(comp.block_row(row), block_array[0], row_bytes);
+            }
+        }
+
+        jpeg_finish_decompress(&decompress.cinfo);
+        return true;
+    }
+
+    bool JpegCoefImage::decode_segmented(const std::vector<byte>& file, const Layout& layout, uint32_t rows_per_interval)
+    {
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        size_t intervals = layout.intervals.size();
+        size_t bands = std::min<size_t>(Parallel::thread_count(), intervals);
+
+        std::vector<char> ok(bands, 0);
+        Parallel::parallel_for(bands, [&](size_t band_begin, size_t band_end) {
+            for (size_t band = band_begin; band < band_end; ++band) {
+                size_t first = intervals * band / bands;
+                size_t last = intervals * (band + 1) / bands;
+                uint32_t first_row = static_cast<uint32_t>(first) * rows_per_interval;
+                uint32_t last_row = std::min<uint32_t>(static_cast<uint32_t>(last) * rows_per_interval, mcu_rows);
+                uint32_t band_height = std::min(last_row * mcu_height, this->image_height) - first_row * mcu_height;
+
+                // Band buffer must outlive decompress (mem source reads it lazily).
+                // A libjpeg error fails the band only: decode() falls back to the sequential path.
+                std::vector<byte> band_file = make_band(file, layout, first, last, band_height);
+                try {
+                    JpegDecompressRAII decompress;
+                    jpeg_mem_src(&decompress.cinfo, band_file.data(), static_cast<unsigned long>(band_file.size()));
+                    if (jpeg_read_header(&decompress.cinfo, TRUE) != JPEG_HEADER_OK)
+                        continue;
+                    jvirt_barray_ptr* coef_arrays = jpeg_read_coefficients(&decompress.cinfo);
+                    if (!coef_arrays)
+                        continue;
+
+                    bool band_ok = true;
+                    for (size_t ci = 0; ci < this->components.size() && band_ok; ++ci) {
+                        JpegComponentCoefs& comp = this->components[ci];
+                        const jpeg_component_info* band_comp = decompress.cinfo.comp_info + ci;
+                        JDIMENSION row_offset = first_row * this->blocks_per_mcu_row(ci);
+                        if (band_comp->width_in_blocks != comp.width_in_blocks ||
+                            row_offset + band_comp->height_in_blocks > comp.height_in_blocks) {
+                            band_ok = false;
+                            break;
+                        }
+                        size_t row_bytes = static_cast<size_t>(comp.width_in_blocks) * sizeof(JBLOCK);
+                        for (JDIMENSION row = 0; row < band_comp->height_in_blocks; ++row) {
+                            JBLOCKARRAY block_array = (*decompress.cinfo.mem->access_virt_barray)
+                                ((j_common_ptr) &decompress.cinfo, coef_arrays[ci], row, 1, FALSE);
+                            if (block_array == nullptr) {
+                                band_ok = false;
+                                break;
+                            }
+                            std::memcpy(comp.block_row(row_offset + row), block_array[0], row_bytes);
+                        }
+                    }
+                    jpeg_finish_decompress(&decompress.cinfo);
+                    ok[band] = band_ok ? 1 : 0;
+                } catch (const JpegError&) {
+                    ok[band] = 0;
+                }
+            }
+        });
+
+        return std::all_of(ok.begin(), ok.end(), [](char v) { return v != 0; });
+    }
+
+    std::optional<std::vector<byte>> JpegCoefImage::encode_band(uint32_t first_row, uint32_t last_row,
+                                                                uint32_t rows_per_interval,
+                                                                const std::vector<SymbolCounts>* counts) const
+    {
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        (void)mcu_rows;
+        uint32_t band_height = std::min(last_row * mcu_height, this->image_height) - first_row * mcu_height;
+
+        // libjpeg allocates out_buffer on the first write: freed here on success and on error.
+        unsigned char* out_buffer = nullptr;
+        unsigned long out_size = 0;
+        try {
+            // Critical parameters come from header-only decompress of the source markers.
+            JpegDecompressRAII source;
+            jpeg_mem_src(&source.cinfo, this->header.data(), static_cast<unsigned long>(this->header.size()));
+            if (jpeg_read_header(&source.cinfo, TRUE) != JPEG_HEADER_OK)
+                return std::nullopt;
+
+            JpegCompressRAII compress;
+            jpeg_mem_dest(&compress.cinfo, &out_buffer, &out_size);
+
+            jpeg_copy_critical_parameters(&source.cinfo, &compress.cinfo);
+            compress.cinfo.image_height = band_height;
+
+            // Force baseline to avoid Huffman corruption (no progressive/arith).
+            compress.cinfo.progressive_mode = FALSE;
+            compress.cinfo.arith_code = FALSE;
+            // Bands are spliced into one scan: every band gets the same tables, optimized for the whole image.
+            compress.cinfo.optimize_coding = FALSE;
+            compress.cinfo.restart_in_rows = static_cast<int>(rows_per_interval);
+
+            auto common = reinterpret_cast<j_common_ptr>(&compress.cinfo);
+            if (counts) {
+                std::array<SymbolCounts, NUM_HUFF_TBLS> tables{};
+                std::array<bool, NUM_HUFF_TBLS> dc_used{}, ac_used{};
+                for (size_t ci = 0; ci < this->components.size(); ++ci) {
+                    const jpeg_component_info& info = compress.cinfo.comp_info[ci];
+                    for (size_t s = 0; s < 257; ++s) {
+                        tables[info.dc_tbl_no].dc[s] += (*counts)[ci].dc[s];
+                        tables[info.ac_tbl_no].ac[s] += (*counts)[ci].ac[s];
+                    }
+                    dc_used[info.dc_tbl_no] = true;
+                    ac_used[info.ac_tbl_no] = true;
+                }
+                for (int t = 0; t < NUM_HUFF_TBLS; ++t) {
+                    if (dc_used[t]) {
+                        if (!compress.cinfo.dc_huff_tbl_ptrs[t])
+                            compress.cinfo.dc_huff_tbl_ptrs[t] = jpeg_alloc_huff_table(common);
+                        optimal_table(tables[t].dc, true, *compress.cinfo.dc_huff_tbl_ptrs[t]);
+                    }
+                    if (ac_used[t]) {
+                        if (!compress.cinfo.ac_huff_tbl_ptrs[t])
+                            compress.cinfo.ac_huff_tbl_ptrs[t] = jpeg_alloc_huff_table(common);
+                        optimal_table(tables[t].ac, false, *compress.cinfo.ac_huff_tbl_ptrs[t]);
+                    }
+                }
+            } else {
+                for (int t = 0; t < NUM_HUFF_TBLS; ++t) {
+                    copy_table(source.cinfo.dc_huff_tbl_ptrs[t], compress.cinfo.dc_huff_tbl_ptrs[t], common);
+                    copy_table(source.cinfo.ac_huff_tbl_ptrs[t], compress.cinfo.ac_huff_tbl_ptrs[t], common);
+                }
+            }
+
+            std::vector<jvirt_barray_ptr> coef_arrays(this->components.size());
+            std::vector<JDIMENSION> band_rows(this->components.size());
+            for (size_t ci = 0; ci < this->components.size(); ++ci) {
+                const JpegComponentCoefs& comp = this->components[ci];
+                JDIMENSION per_mcu = this->blocks_per_mcu_row(ci);
+                JDIMENSION row_begin = first_row * per_mcu;
+                JDIMENSION row_end = std::min<JDIMENSION>(last_row * per_mcu, comp.height_in_blocks);
+                band_rows[ci] = row_end - row_begin;
+                coef_arrays[ci] = (*compress.cinfo.mem->request_virt_barray)
+                    ((j_common_ptr) &compress.cinfo, JPOOL_IMAGE, TRUE,
+                     round_up(comp.width_in_blocks, static_cast<JDIMENSION>(comp.h_samp)),
+                     round_up(band_rows[ci], static_cast<JDIMENSION>(comp.v_samp)),
+                     static_cast<JDIMENSION>(comp.v_samp));
+            }
+
+            // Arrays are realized here; fill them before finish (same order as jpegtran).
+            jpeg_write_coefficients(&compress.cinfo, coef_arrays.data());
+
+            for (size_t ci = 0; ci < this->components.size(); ++ci) {
+                const JpegComponentCoefs& comp = this->components[ci];
+                JDIMENSION row_offset = first_row * this->blocks_per_mcu_row(ci);
+                size_t row_bytes = static_cast<size_t>(comp.width_in_blocks) * sizeof(JBLOCK);
+                for (JDIMENSION row = 0; row < band_rows[ci]; ++row) {
+                    JBLOCKARRAY block_array = (*compress.cinfo.mem->access_virt_barray)
+                        ((j_common_ptr) &compress.cinfo, coef_arrays[ci], row, 1, TRUE);
+                    std::memcpy(block_array[0], comp.block_row(row_offset + row), row_bytes);
+                }
+            }
+
+            jpeg_finish_compress(&compress.cinfo);
+
+            std::vector<byte> result(out_buffer, out_buffer + out_size);
+            std::free(out_buffer);
+            return result;
+        } catch (const JpegError& e) {
+            std::free(out_buffer);
+            std::cerr << CLI_RED << "Error: JPEG encode failed: " << e.what() << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    std::optional<std::vector<byte>> JpegCoefImage::encode() const
+    {
+        if (this->components.empty() || this->header.empty())
+            return std::nullopt;
+
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        (void)mcu_height;
+        const uint32_t rows_per_interval = std::max<uint32_t>(1, (mcu_rows + RESTART_INTERVALS - 1) / RESTART_INTERVALS);
+        const uint32_t intervals = (mcu_rows + rows_per_interval - 1) / rows_per_interval;
+        size_t bands = std::max<size_t>(1, std::min<size_t>(Parallel::thread_count(), intervals));
+        const std::vector<SymbolCounts> counts = this->count_symbols(rows_per_interval);
+
+        /*Bands start on restart interval boundaries*/
+        std::vector<std::optional<std::vector<byte>>> encoded(bands);
+        Parallel::parallel_for(bands, [&](size_t band_begin, size_t band_end) {
+            for (size_t band = band_begin; band < band_end; ++band) {
+                auto first_row = static_cast<uint32_t>(intervals * band / bands) * rows_per_interval;
+                auto last_row = std::min(static_cast<uint32_t>(intervals * (band + 1) / bands) * rows_per_interval, mcu_rows);
+                encoded[band] = this->encode_band(first_row, last_row, rows_per_interval, &counts);
+            }
+        });
+
+        for (const auto& band : encoded)
+            if (!band)
+                return std::nullopt;
+        if (bands == 1)
+            return std::move(encoded[0]);
+
+        /*Splice: headers of first band, then every band's intervals with continuous RST numbering*/
+        auto first_layout = scan_layout(*encoded[0]);
+        if (!first_layout)
+            return std::nullopt;
+
+        std::vector<byte> result;
+        size_t total = 0;
+        for (const auto& band : encoded)
+            total += band->size();
+        result.reserve(total);
+        result.insert(result.end(), encoded[0]->begin(), encoded[0]->begin() + static_cast<std::ptrdiff_t>(first_layout->sos_end));
+        patch_height(result, first_layout->sof_offset, this->image_height);
+
+        uint32_t restart_number = 0;
+        bool first_interval = true;
+        for (const auto& band : encoded) {
+            auto layout = scan_layout(*band);
+            if (!layout || !layout->ends_with_eoi) {
+                std::cerr << CLI_RED << "Error: Malformed JPEG band while splicing." << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            for (const auto& [begin, end] : layout->intervals) {
+                if (!first_interval) {
+                    result.push_back(0xFF);
+                    result.push_back(static_cast<byte>(0xD0 + (restart_number++ & 7)));
+                }
+                first_interval = false;
+                result.insert(result.end(), band->begin() + static_cast<std::ptrdiff_t>(begin),
+                              band->begin() + static_cast<std::ptrdiff_t>(end));
+            }
+        }
+        result.push_back(0xFF);
+        result.push_back(0xD9);
+        return result;
+    }
+
+    std::vector<char> JpegCoefImage::mcu_rows_of(uint64_t first_block, uint64_t last_block) const
+    {
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        (void)mcu_height;
+        std::vector<char> rows(mcu_rows, 0);
+
+        uint64_t comp_first = 0;
+        for (size_t ci = 0; ci < this->components.size(); ++ci) {
+            const JpegComponentCoefs& comp = this->components[ci];
+            const uint64_t comp_last = comp_first + comp.block_count();
+            if (first_block < comp_last && last_block > comp_first && comp.width_in_blocks > 0) {
+                const uint64_t from = std::max(first_block, comp_first) - comp_first;
+                const uint64_t to = std::min(last_block, comp_last) - comp_first;
+                const uint64_t per_mcu = this->blocks_per_mcu_row(ci);
+                const uint64_t row_begin = from / comp.width_in_blocks / per_mcu;
+                const uint64_t row_end = std::min<uint64_t>((to - 1) / comp.width_in_blocks / per_mcu + 1, mcu_rows);
+                for (uint64_t row = row_begin; row < row_end; ++row)
+                    rows[static_cast<size_t>(row)] = 1;
+            }
+            comp_first = comp_last;
+        }
+        return rows;
+    }
+
+    std::optional<std::vector<byte>> JpegCoefImage::encode_rows(const std::vector<byte>& file,
+                                                                const std::vector<char>& rows) const
+    {
+        auto [mcu_rows, mcu_height] = this->mcu_geometry();
+        (void)mcu_height;
+        auto layout = scan_layout(file);
+        const uint32_t mcus = this->mcus_per_row();
+        if (this->components.empty() || this->header.empty() || rows.size() != mcu_rows || !layout ||
+            !layout->ends_with_eoi || mcus == 0 || layout->restart_interval == 0 || layout->restart_interval % mcus != 0)
+            return std::nullopt;
+        const uint32_t rows_per_interval = layout->restart_interval / mcus;
+        const uint32_t intervals = (mcu_rows + rows_per_interval - 1) / rows_per_interval;
+        if (layout->intervals.size() != intervals)
+            return std::nullopt;
+
+        /*Intervals holding flagged rows*/
+        std::vector<char> dirty(intervals, 0);
+        for (uint32_t row = 0; row < mcu_rows; ++row)
+            if (rows[row])
+                dirty[row / rows_per_interval] = 1;
+
+        /*Runs of dirty intervals, long runs cut so that every thread gets a band*/
+        const size_t flagged = static_cast<size_t>(std::count(dirty.begin(), dirty.end(), 1));
+        if (flagged == 0)
+            return file;
+        const uint32_t band_intervals = static_cast<uint32_t>(
+            std::max<size_t>(1, (flagged + Parallel::thread_count() - 1) / Parallel::thread_count()));
+        std::vector<std::pair<uint32_t, uint32_t>> runs;
+        for (uint32_t interval = 0; interval < intervals; ++interval) {
+            if (!dirty[interval])
+                continue;
+            if (runs.empty() || runs.back().second != interval || runs.back().second - runs.back().first == band_intervals)
+                runs.emplace_back(interval, interval + 1);
+            else
+                ++runs.back().second;
+        }
+
+        // The file's own Huffman tables (encode() gives every symbol a code) keep its header valid.
+        std::vector<std::optional<std::vector<byte>>> encoded(runs.size());
+        Parallel::parallel_for(runs.size(), [&](size_t band_begin, size_t band_end) {
+            for (size_t band = band_begin; band < band_end; ++band)
+                encoded[band] = this->encode_band(runs[band].first * rows_per_interval,
+                                                  std::min(runs[band].second * rows_per_interval, mcu_rows),
+                                                  rows_per_interval, nullptr);
+        });
+
+        /*Splice: bands replace the restart intervals of their rows, markers between them are renumbered*/
+        std::vector<byte> result;
+        result.reserve(file.size());
+        size_t copied = 0;
+        for (size_t band = 0; band < runs.size(); ++band) {
+            if (!encoded[band])
+                return std::nullopt;
+            const std::vector<byte>& bytes = *encoded[band];
+            auto band_layout = scan_layout(bytes);
+            if (!band_layout || !band_layout->ends_with_eoi ||
+                band_layout->intervals.size() != runs[band].second - runs[band].first)
+                return std::nullopt;
+
+            // Same tables and restart interval as the file: its headers are what this band would get at full height.
+            if (band == 0) {
+                std::vector<byte> band_header(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(band_layout->sos_end));
+                patch_height(band_header, band_layout->sof_offset, this->image_height);
+                if (band_header.size() != layout->sos_end ||
+                    !std::equal(band_header.begin(), band_header.end(), file.begin()))
+                    return std::nullopt;
+            }
+
+            const size_t first = runs[band].first;
+            result.insert(result.end(), file.begin() + static_cast<std::ptrdiff_t>(copied),
+                          file.begin() + static_cast<std::ptrdiff_t>(layout->intervals[first].first));
+            for (size_t k = 0; k < band_layout->intervals.size(); ++k) {
+                if (k != 0) {
+                    result.push_back(0xFF);
+                    result.push_back(static_cast<byte>(0xD0 + ((first + k - 1) & 7)));
+                }
+                const auto [begin, end] = band_layout->intervals[k];
+                result.insert(result.end(), bytes.begin() + static_cast<std::ptrdiff_t>(begin),
+                              bytes.begin() + static_cast<std::ptrdiff_t>(end));
+            }
+            copied = layout->intervals[runs[band].second - 1].second;
+        }
+        result.insert(result.end(), file.begin() + static_cast<std::ptrdiff_t>(copied), file.end());
+        return result;
+    }
+
+    uint64_t JpegCoefImage::ac_capacity_bits() const
+    {
+        uint64_t bits = 0;
+        for (const auto& comp : this->components)
+            bits += comp.block_count() * (DCTSIZE2 - 1);
+        return bits;
+    }
+} // Yps
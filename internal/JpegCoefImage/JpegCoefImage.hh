@@ -0,0 +1,260 @@
+#ifndef YPSHNS_JPEGCOEFIMAGE_HH
+#define YPSHNS_JPEGCOEFIMAGE_HH
+
+#include <cstdio>     // jpeglib.h needs FILE
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <jpeglib.h>  // libjpeg-turbo
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Fatal libjpeg error. The default error_exit calls exit(), which would end the whole process from a
+     * pool worker: both RAII wrappers install raise() instead, callers turn it into std::nullopt.
+     */
+    class JpegError : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+
+        [[noreturn]] static void raise(j_common_ptr cinfo) {
+            char message[JMSG_LENGTH_MAX];
+            (*cinfo->err->format_message)(cinfo, message);
+            throw JpegError(message);
+        }
+    };
+
+    // RAII for jpeg_decompress_struct (auto-cleanup).
+    class JpegDecompressRAII {
+    public:
+        jpeg_decompress_struct cinfo;
+        jpeg_error_mgr jerr;
+        explicit JpegDecompressRAII() {
+            cinfo.err = jpeg_std_error(&jerr);
+            jerr.error_exit = &JpegError::raise;
+            jpeg_create_decompress(&cinfo);
+        }
+        ~JpegDecompressRAII() noexcept { jpeg_destroy_decompress(&cinfo); }
+        JpegDecompressRAII(const JpegDecompressRAII&) = delete;
+        JpegDecompressRAII& operator=(const JpegDecompressRAII&) = delete;
+    };
+
+    // RAII for jpeg_compress_struct.
+    class JpegCompressRAII {
+    public:
+        jpeg_compress_struct cinfo;
+        jpeg_error_mgr jerr;
+        explicit JpegCompressRAII() {
+            cinfo.err = jpeg_std_error(&jerr);
+            jerr.error_exit = &JpegError::raise;
+            jpeg_create_compress(&cinfo);
+        }
+        ~JpegCompressRAII() noexcept { jpeg_destroy_compress(&cinfo); }
+        JpegCompressRAII(const JpegCompressRAII&) = delete;
+        JpegCompressRAII& operator=(const JpegCompressRAII&) = delete;
+    };
+
+    /**
+     * Quantized DCT blocks of one component, stored row-major (block rows → blocks → DCTSIZE2 coefs).
+     */
+    struct JpegComponentCoefs
+    {
+        JDIMENSION width_in_blocks{};
+        JDIMENSION height_in_blocks{};
+        int32_t h_samp{1};
+        int32_t v_samp{1};
+
+        /**
+         * Quantization table (natural order, as coefs); all zero if the header had none
+         */
+        std::array<UINT16, DCTSIZE2> quant{};
+
+        /**
+         * height_in_blocks * width_in_blocks * DCTSIZE2 coefficients
+         */
+        std::vector<JCOEF> coefs;
+
+        [[nodiscard]] uint64_t block_count() const
+        { return static_cast<uint64_t>(width_in_blocks) * height_in_blocks; }
+
+        JCOEF* block_row(JDIMENSION row)
+        { return coefs.data() + static_cast<size_t>(row) * width_in_blocks * DCTSIZE2; }
+
+        [[nodiscard]] const JCOEF* block_row(JDIMENSION row) const
+        { return coefs.data() + static_cast<size_t>(row) * width_in_blocks * DCTSIZE2; }
+    };
+
+    /**
+     * Whole-image DCT coefficient buffer decoupled from libjpeg objects.
+     * Baseline files with MCU-row aligned restart markers are entropy-decoded in parallel
+     * (one libjpeg instance per group of restart intervals). Output is always written
+     * baseline with optimized Huffman tables shared by the whole image and a restart marker
+     * every few MCU rows, encoded in parallel bands and spliced.
+     */
+    class JpegCoefImage
+    {
+    public:
+        /**
+         * Restart intervals encode() aims for: MCU rows are grouped so that bands, segmented decode and
+         * encode_rows() still find this many independent segments, without a marker on every row.
+         */
+        static constexpr uint32_t RESTART_INTERVALS = 64;
+
+    private:
+        /**
+         * Huffman symbol counts of one component: DC magnitude categories and AC run/size symbols
+         */
+        struct SymbolCounts
+        {
+            std::array<long, 257> dc{};
+            std::array<long, 257> ac{};
+        };
+
+        /**
+         * Byte layout of the marker stream (up to the end of the first scan).
+         */
+        struct Layout
+        {
+            size_t sof_offset{};        // Offset of FF Cx marker
+            byte sof_marker{};
+            size_t sos_offset{};        // Offset of FF DA marker
+            size_t sos_end{};           // First entropy-coded byte
+            uint32_t restart_interval{};
+            /**
+             * Entropy-coded spans [begin, end) between restart markers
+             */
+            std::vector<std::pair<size_t, size_t>> intervals;
+            bool ends_with_eoi{false};
+        };
+
+        /**
+         * Markers up to (and including) the first SOS — enough for jpeg_copy_critical_parameters.
+         */
+        std::vector<byte> header;
+
+        uint32_t image_width{};
+        uint32_t image_height{};
+        int32_t max_v_samp{1};
+        bool progressive{false};
+        bool segmented{false};
+
+        /**
+         * Walk markers and split first scan on restart markers.
+         * @param file Whole JPEG file
+         * @return layout or std::nullopt (not a JPEG / truncated)
+         */
+        static std::optional<Layout> scan_layout(const std::vector<byte>& file);
+
+        /**
+         * Rewrite SOF height field in place.
+         */
+        static void patch_height(std::vector<byte>& jpeg, size_t sof_offset, uint32_t height);
+
+        /**
+         * Build standalone JPEG from restart intervals [first, last) of source.
+         */
+        static std::vector<byte> make_band(const std::vector<byte>& file, const Layout& layout,
+                                           size_t first, size_t last, uint32_t band_height);
+
+        /**
+         * decode() body (libjpeg errors propagate as JpegError).
+         */
+        static std::optional<JpegCoefImage> decode_file(const std::vector<byte>& file);
+
+        /**
+         * Sequential decode (progressive, arithmetic, unaligned restarts).
+         */
+        bool decode_sequential(const std::vector<byte>& file);
+
+        /**
+         * Parallel decode over restart interval groups.
+         */
+        bool decode_segmented(const std::vector<byte>& file, const Layout& layout, uint32_t rows_per_interval);
+
+        /**
+         * Rows of blocks per MCU row in component ci (1 for non-interleaved scans).
+         */
+        [[nodiscard]] JDIMENSION blocks_per_mcu_row(size_t ci) const;
+
+        /**
+         * Total MCU rows and their height in pixels for a single interleaved (or 1-component) scan.
+         */
+        [[nodiscard]] std::pair<uint32_t, uint32_t> mcu_geometry() const;
+
+        /**
+         * MCUs per MCU row of a single interleaved (or 1-component) scan.
+         */
+        [[nodiscard]] uint32_t mcus_per_row() const;
+
+        /**
+         * Count the symbols a baseline encode with this restart spacing emits, per component.
+         */
+        [[nodiscard]] std::vector<SymbolCounts> count_symbols(uint32_t rows_per_interval) const;
+
+        /**
+         * Encode MCU rows [first_row, last_row) as standalone baseline JPEG.
+         * @param rows_per_interval MCU rows per restart interval
+         * @param counts Build optimized tables from these (every band gets the same ones);
+         *               nullptr - reuse the Huffman tables of the source header
+         */
+        [[nodiscard]] std::optional<std::vector<byte>> encode_band(uint32_t first_row, uint32_t last_row,
+                                                                   uint32_t rows_per_interval,
+                                                                   const std::vector<SymbolCounts>* counts) const;
+
+    public:
+        std::vector<JpegComponentCoefs> components;
+
+        /**
+         * Decode JPEG file from memory.
+         * @param file Whole JPEG file
+         * @return coefficients or std::nullopt
+         */
+        static std::optional<JpegCoefImage> decode(const std::vector<byte>& file);
+
+        /**
+         * Encode coefficients as baseline JPEG: Huffman tables optimized for these coefficients (every
+         * symbol keeps a code, so encode_rows() can reuse them), restart marker every
+         * ceil(MCU rows / RESTART_INTERVALS) MCU rows.
+         * @return JPEG file bytes or std::nullopt
+         */
+        [[nodiscard]] std::optional<std::vector<byte>> encode() const;
+
+        /**
+         * MCU rows holding global blocks [first_block, last_block) (BitKernels DCT order: components in turn,
+         * blocks row-major).
+         * @return one flag per MCU row
+         */
+        [[nodiscard]] std::vector<char> mcu_rows_of(uint64_t first_block, uint64_t last_block) const;
+
+        /**
+         * Re-encode the restart intervals holding flagged MCU rows only and splice them into file, an encode()
+         * output with this geometry (its Huffman tables and restart spacing are reused). Other intervals are copied.
+         * @param file Earlier output
+         * @param rows One flag per MCU row (see mcu_rows_of)
+         * @return JPEG file bytes or std::nullopt (file is not such an output, encode failed)
+         */
+        [[nodiscard]] std::optional<std::vector<byte>> encode_rows(const std::vector<byte>& file,
+                                                                   const std::vector<char>& rows) const;
+
+        /**
+         * AC capacity (63 coefficients per block, DC skipped).
+         */
+        [[nodiscard]] uint64_t ac_capacity_bits() const;
+
+        /**
+         * @return true, if source was progressive (output is forced baseline)
+         */
+        [[nodiscard]] bool is_progressive() const { return this->progressive; }
+
+        /**
+         * @return true, if source was decoded in parallel restart segments
+         */
+        [[nodiscard]] bool is_segmented() const { return this->segmented; }
+    };
+} // Yps
+
+#endif //YPSHNS_JPEGCOEFIMAGE_HH
@@ -0,0 +1,493 @@
+#include "KDF.hh"
+
+#include <Cache/LruCache.hh>
+#include <Parallel/Parallel.hh>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr std::array<uint64_t, 8> BLAKE2B_IV = {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+
+        constexpr uint8_t BLAKE2B_SIGMA[12][16] = {
+            {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+            {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+            {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+            {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+            {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+            {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+            {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+            {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+            {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+            {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+            {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+            {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3}
+        };
+
+        inline uint64_t rotr64(uint64_t x, uint32_t n)
+        { return (x >> n) | (x << (64 - n)); }
+
+        inline uint64_t load_le64(const byte* p)
+        {
+            uint64_t v = 0;
+            for (int32_t i = 7; i >= 0; --i)
+                v = (v << 8) | p[i];
+            return v;
+        }
+
+        inline void store_le64(byte* p, uint64_t v)
+        {
+            for (int32_t i = 0; i < 8; ++i)
+                p[i] = static_cast<byte>(v >> (8 * i));
+        }
+
+        inline void store_le32(byte* p, uint32_t v)
+        {
+            for (int32_t i = 0; i < 4; ++i)
+                p[i] = static_cast<byte>(v >> (8 * i));
+        }
+
+
+        /*Argon2 internals*/
+
+        constexpr uint32_t BLOCK_WORDS = 128;           // 1 KiB block
+        constexpr uint32_t SYNC_POINTS = 4;             // Slices per pass
+        constexpr uint32_t ARGON2_VERSION = 0x13;
+        constexpr uint32_t ARGON2_ID = 2;
+
+        using Block = std::array<uint64_t, BLOCK_WORDS>;
+
+        /**
+         * BlaMka multiply-add: a + b + 2 * lo32(a) * lo32(b)
+         */
+        inline uint64_t blamka(uint64_t a, uint64_t b)
+        { return a + b + 2 * (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL); }
+
+        inline void gb(uint64_t& a, uint64_t& b, uint64_t& c, uint64_t& d)
+        {
+            a = blamka(a, b); d = rotr64(d ^ a, 32);
+            c = blamka(c, d); b = rotr64(b ^ c, 24);
+            a = blamka(a, b); d = rotr64(d ^ a, 16);
+            c = blamka(c, d); b = rotr64(b ^ c, 63);
+        }
+
+        /**
+         * Permutation P over 16 words given by index.
+         */
+        inline void permute(Block& v, const uint32_t (&i)[16])
+        {
+            gb(v[i[0]], v[i[4]], v[i[8]], v[i[12]]);
+            gb(v[i[1]], v[i[5]], v[i[9]], v[i[13]]);
+            gb(v[i[2]], v[i[6]], v[i[10]], v[i[14]]);
+            gb(v[i[3]], v[i[7]], v[i[11]], v[i[15]]);
+            gb(v[i[0]], v[i[5]], v[i[10]], v[i[15]]);
+            gb(v[i[1]], v[i[6]], v[i[11]], v[i[12]]);
+            gb(v[i[2]], v[i[7]], v[i[8]], v[i[13]]);
+            gb(v[i[3]], v[i[4]], v[i[9]], v[i[14]]);
+        }
+
+        /**
+         * Compression G: next = P(prev ^ ref) ^ (prev ^ ref) [^ next, when with_xor]
+         */
+        void fill_block(const Block& prev, const Block& ref, Block& next, bool with_xor)
+        {
+            Block r;
+            for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+                r[i] = prev[i] ^ ref[i];
+            Block tmp = r;
+            if (with_xor)
+                for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+                    tmp[i] ^= next[i];
+
+            for (uint32_t row = 0; row < 8; ++row) {
+                uint32_t b = 16 * row;
+                const uint32_t idx[16] = {b, b + 1, b + 2, b + 3, b + 4, b + 5, b + 6, b + 7,
+                                          b + 8, b + 9, b + 10, b + 11, b + 12, b + 13, b + 14, b + 15};
+                permute(r, idx);
+            }
+            for (uint32_t col = 0; col < 8; ++col) {
+                uint32_t b = 2 * col;
+                const uint32_t idx[16] = {b, b + 1, b + 16, b + 17, b + 32, b + 33, b + 48, b + 49,
+                                          b + 64, b + 65, b + 80, b + 81, b + 96, b + 97, b + 112, b + 113};
+                permute(r, idx);
+            }
+
+            for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+                next[i] = tmp[i] ^ r[i];
+        }
+
+        /**
+         * Variable-length hash H' (RFC 9106, 3.3).
+         */
+        void blake2b_long(byte* out, uint32_t out_len, const byte* in, size_t in_len)
+        {
+            if (out_len <= Blake2b::MAX_OUT) {
+                Blake2b h(out_len);
+                h.update_le32(out_len);
+                h.update(in, in_len);
+                h.final(out);
+                return;
+            }
+
+            std::array<byte, Blake2b::MAX_OUT> v{};
+            Blake2b first;
+            first.update_le32(out_len);
+            first.update(in, in_len);
+            first.final(v.data());
+            std::memcpy(out, v.data(), 32);
+            out += 32;
+            uint32_t remaining = out_len - 32;
+
+            while (remaining > Blake2b::MAX_OUT) {
+                Blake2b next;
+                next.update(v.data(), v.size());
+                next.final(v.data());
+                std::memcpy(out, v.data(), 32);
+                out += 32;
+                remaining -= 32;
+            }
+            Blake2b last(remaining);
+            last.update(v.data(), v.size());
+            last.final(out);
+        }
+
+        void block_from_bytes(Block& block, const byte* bytes)
+        {
+            for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+                block[i] = load_le64(bytes + 8 * i);
+        }
+
+        /**
+         * Memory matrix of one derivation.
+         */
+        struct Instance
+        {
+            std::vector<Block> memory;
+            uint32_t lanes{};
+            uint32_t lane_length{};
+            uint32_t segment_length{};
+            uint32_t passes{};
+
+            /**
+             * Reference block column inside ref lane (RFC 9106, 3.4.1.2).
+             */
+            [[nodiscard]] uint32_t index_alpha(uint32_t pass, uint32_t slice, uint32_t index,
+                                               uint32_t pseudo_rand, bool same_lane) const
+            {
+                uint32_t area;
+                if (pass == 0) {
+                    if (slice == 0)
+                        area = index - 1;
+                    else if (same_lane)
+                        area = slice * this->segment_length + index - 1;
+                    else
+                        area = slice * this->segment_length - (index == 0 ? 1 : 0);
+                } else {
+                    if (same_lane)
+                        area = this->lane_length - this->segment_length + index - 1;
+                    else
+                        area = this->lane_length - this->segment_length - (index == 0 ? 1 : 0);
+                }
+
+                uint64_t relative = pseudo_rand;
+                relative = (relative * relative) >> 32;
+                relative = area - 1 - ((static_cast<uint64_t>(area) * relative) >> 32);
+
+                uint32_t start = 0;
+                if (pass != 0)
+                    start = (slice == SYNC_POINTS - 1) ? 0 : (slice + 1) * this->segment_length;
+                return static_cast<uint32_t>((start + relative) % this->lane_length);
+            }
+
+            void fill_segment(uint32_t pass, uint32_t lane, uint32_t slice)
+            {
+                // Argon2id: data-independent addressing for the first half of the first pass.
+                bool independent = pass == 0 && slice < SYNC_POINTS / 2;
+                Block zero{}, input{}, address{};
+                if (independent) {
+                    input[0] = pass;
+                    input[1] = lane;
+                    input[2] = slice;
+                    input[3] = this->memory.size();
+                    input[4] = this->passes;
+                    input[5] = ARGON2_ID;
+                }
+                auto next_addresses = [&]() {
+                    ++input[6];
+                    fill_block(zero, input, address, false);
+                    fill_block(zero, address, address, false);
+                };
+
+                uint32_t start_index = 0;
+                if (pass == 0 && slice == 0) {
+                    start_index = 2;  // First two blocks come from H0
+                    if (independent)
+                        next_addresses();
+                }
+
+                uint64_t curr = static_cast<uint64_t>(lane) * this->lane_length + slice * this->segment_length + start_index;
+                uint64_t prev = (curr % this->lane_length == 0) ? curr + this->lane_length - 1 : curr - 1;
+
+                for (uint32_t i = start_index; i < this->segment_length; ++i, ++curr, ++prev) {
+                    if (curr % this->lane_length == 1)
+                        prev = curr - 1;
+
+                    uint64_t pseudo_rand;
+                    if (independent) {
+                        if (i % BLOCK_WORDS == 0)
+                            next_addresses();
+                        pseudo_rand = address[i % BLOCK_WORDS];
+                    } else {
+                        pseudo_rand = this->memory[prev][0];
+                    }
+
+                    uint32_t ref_lane = static_cast<uint32_t>((pseudo_rand >> 32) % this->lanes);
+                    if (pass == 0 && slice == 0)
+                        ref_lane = lane;
+                    uint32_t ref_index = this->index_alpha(pass, slice, i, static_cast<uint32_t>(pseudo_rand),
+                                                           ref_lane == lane);
+
+                    const Block& ref = this->memory[static_cast<uint64_t>(ref_lane) * this->lane_length + ref_index];
+                    fill_block(this->memory[prev], ref, this->memory[curr], pass != 0);
+                }
+            }
+        };
+    }
+
+
+    Blake2b::Blake2b(size_t out_len) : out_len(out_len)
+    {
+        if (out_len == 0 || out_len > MAX_OUT)
+            throw std::invalid_argument("Blake2b: digest length must be in 1..64");
+        this->h = BLAKE2B_IV;
+        this->h[0] ^= 0x01010000ULL ^ out_len;
+    }
+
+    void Blake2b::compress(const byte* block, bool last)
+    {
+        uint64_t m[16];
+        for (uint32_t i = 0; i < 16; ++i)
+            m[i] = load_le64(block + 8 * i);
+
+        uint64_t v[16];
+        for (uint32_t i = 0; i < 8; ++i) {
+            v[i] = this->h[i];
+            v[i + 8] = BLAKE2B_IV[i];
+        }
+        v[12] ^= this->counter[0];
+        v[13] ^= this->counter[1];
+        if (last)
+            v[14] = ~v[14];
+
+        auto g = [&](uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint64_t x, uint64_t y) {
+            v[a] = v[a] + v[b] + x; v[d] = rotr64(v[d] ^ v[a], 32);
+            v[c] = v[c] + v[d];     v[b] = rotr64(v[b] ^ v[c], 24);
+            v[a] = v[a] + v[b] + y; v[d] = rotr64(v[d] ^ v[a], 16);
+            v[c] = v[c] + v[d];     v[b] = rotr64(v[b] ^ v[c], 63);
+        };
+        for (const auto& s : BLAKE2B_SIGMA) {
+            g(0, 4, 8, 12, m[s[0]], m[s[1]]);
+            g(1, 5, 9, 13, m[s[2]], m[s[3]]);
+            g(2, 6, 10, 14, m[s[4]], m[s[5]]);
+            g(3, 7, 11, 15, m[s[6]], m[s[7]]);
+            g(0, 5, 10, 15, m[s[8]], m[s[9]]);
+            g(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            g(2, 7, 8, 13, m[s[12]], m[s[13]]);
+            g(3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (uint32_t i = 0; i < 8; ++i)
+            this->h[i] ^= v[i] ^ v[i + 8];
+    }
+
+    void Blake2b::update(const void* data, size_t size)
+    {
+        const auto* in = static_cast<const byte*>(data);
+        while (size > 0) {
+            // Keep the last block buffered: it must be compressed with the final flag.
+            if (this->buffered == this->buffer.size()) {
+                this->counter[0] += this->buffer.size();
+                if (this->counter[0] < this->buffer.size())
+                    ++this->counter[1];
+                this->compress(this->buffer.data(), false);
+                this->buffered = 0;
+            }
+            size_t take = std::min(size, this->buffer.size() - this->buffered);
+            std::memcpy(this->buffer.data() + this->buffered, in, take);
+            this->buffered += take;
+            in += take;
+            size -= take;
+        }
+    }
+
+    void Blake2b::update_le32(uint32_t value)
+    {
+        byte le[4];
+        store_le32(le, value);
+        this->update(le, sizeof(le));
+    }
+
+    void Blake2b::final(byte* out)
+    {
+        this->counter[0] += this->buffered;
+        if (this->counter[0] < this->buffered)
+            ++this->counter[1];
+        std::fill(this->buffer.begin() + static_cast<std::ptrdiff_t>(this->buffered), this->buffer.end(), 0);
+        this->compress(this->buffer.data(), true);
+
+        byte full[MAX_OUT];
+        for (uint32_t i = 0; i < 8; ++i)
+            store_le64(full + 8 * i, this->h[i]);
+        std::memcpy(out, full, this->out_len);
+        OPENSSL_cleanse(full, sizeof(full));
+        OPENSSL_cleanse(this->buffer.data(), this->buffer.size());
+    }
+
+
+    std::optional<std::vector<byte>> Argon2id::derive(const std::string& password, const std::vector<byte>& salt,
+                                                      const Argon2Params& params, uint32_t tag_len,
+                                                      const std::vector<byte>& secret,
+                                                      const std::vector<byte>& associated)
+    {
+        uint32_t lanes = params.lanes;
+        if (lanes == 0 || params.passes == 0 || tag_len < 4 || salt.size() < 8 ||
+            params.memory_kib < 8ULL * lanes) {
+            std::cerr << CLI_RED << "Argon2id: invalid parameters" << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        /*H0 over all inputs*/
+        byte h0[Blake2b::MAX_OUT + 8];
+        {
+            Blake2b h;
+            h.update_le32(lanes);
+            h.update_le32(tag_len);
+            h.update_le32(params.memory_kib);
+            h.update_le32(params.passes);
+            h.update_le32(ARGON2_VERSION);
+            h.update_le32(ARGON2_ID);
+            h.update_le32(static_cast<uint32_t>(password.size()));
+            h.update(password.data(), password.size());
+            h.update_le32(static_cast<uint32_t>(salt.size()));
+            h.update(salt.data(), salt.size());
+            h.update_le32(static_cast<uint32_t>(secret.size()));
+            h.update(secret.data(), secret.size());
+            h.update_le32(static_cast<uint32_t>(associated.size()));
+            h.update(associated.data(), associated.size());
+            h.final(h0);
+        }
+
+        Instance inst;
+        inst.lanes = lanes;
+        inst.passes = params.passes;
+        uint32_t memory_blocks = params.memory_kib - params.memory_kib % (SYNC_POINTS * lanes);
+        inst.segment_length = memory_blocks / (SYNC_POINTS * lanes);
+        inst.lane_length = inst.segment_length * SYNC_POINTS;
+        inst.memory.resize(static_cast<size_t>(inst.lane_length) * lanes);
+
+        /*First two columns: B[i][j] = H'(H0 || LE32(j) || LE32(i))*/
+        byte block_bytes[BLOCK_WORDS * 8];
+        for (uint32_t lane = 0; lane < lanes; ++lane)
+            for (uint32_t j = 0; j < 2; ++j) {
+                store_le32(h0 + Blake2b::MAX_OUT, j);
+                store_le32(h0 + Blake2b::MAX_OUT + 4, lane);
+                blake2b_long(block_bytes, sizeof(block_bytes), h0, sizeof(h0));
+                block_from_bytes(inst.memory[static_cast<size_t>(lane) * inst.lane_length + j], block_bytes);
+            }
+        OPENSSL_cleanse(h0, sizeof(h0));
+
+        /*Lanes are independent inside a slice; slices are the sync points*/
+        for (uint32_t pass = 0; pass < params.passes; ++pass)
+            for (uint32_t slice = 0; slice < SYNC_POINTS; ++slice)
+                Parallel::parallel_for(lanes, [&](size_t begin, size_t end) {
+                    for (size_t lane = begin; lane < end; ++lane)
+                        inst.fill_segment(pass, static_cast<uint32_t>(lane), slice);
+                });
+
+        /*C = XOR of last column; tag = H'(C)*/
+        Block final_block = inst.memory[inst.lane_length - 1];
+        for (uint32_t lane = 1; lane < lanes; ++lane) {
+            const Block& last = inst.memory[static_cast<size_t>(lane) * inst.lane_length + inst.lane_length - 1];
+            for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+                final_block[i] ^= last[i];
+        }
+        for (uint32_t i = 0; i < BLOCK_WORDS; ++i)
+            store_le64(block_bytes + 8 * i, final_block[i]);
+
+        std::vector<byte> tag(tag_len);
+        blake2b_long(tag.data(), tag_len, block_bytes, sizeof(block_bytes));
+
+        OPENSSL_cleanse(block_bytes, sizeof(block_bytes));
+        OPENSSL_cleanse(final_block.data(), sizeof(Block));
+        OPENSSL_cleanse(inst.memory.data(), inst.memory.size() * sizeof(Block));
+        return tag;
+    }
+
+
+    namespace
+    {
+        using KeyArray = std::array<byte, SHA256_DIGEST_LENGTH>;
+
+        LruCache<std::string, KeyArray>& key_cache()
+        {
+            static LruCache<std::string, KeyArray> cache(64);
+            return cache;
+        }
+    }
+
+    std::optional<KeyArray> Argon2id::derive_key(const std::string& password, const std::vector<byte>& salt,
+                                                 const Argon2Params& params)
+    {
+        std::string material = password;
+        material.push_back('\0');
+        material.append(salt.begin(), salt.end());
+        material += ":" + std::to_string(params.memory_kib) + ":" + std::to_string(params.passes) + ":" +
+                    std::to_string(params.lanes);
+        std::string id = process_keyed_digest(material);
+        OPENSSL_cleanse(material.data(), material.size());
+
+        return key_cache().get_or_compute(id, [&]() -> std::optional<KeyArray> {
+            auto tag = derive(password, salt, params, SHA256_DIGEST_LENGTH);
+            if (!tag)
+                return std::nullopt;
+            KeyArray key{};
+            std::copy(tag->begin(), tag->end(), key.begin());
+            OPENSSL_cleanse(tag->data(), tag->size());
+            return key;
+        });
+    }
+
+    void Argon2id::clear_cache()
+    {
+        key_cache().clear([](KeyArray& key) { OPENSSL_cleanse(key.data(), key.size()); });
+    }
+
+
+    std::string process_keyed_digest(const std::string& material)
+    {
+        static const std::array<byte, 32> process_secret = [] {
+            std::array<byte, 32> secret{};
+            if (RAND_bytes(secret.data(), static_cast<int32_t>(secret.size())) != 1)
+                throw std::runtime_error("Failed to generate cache secret");
+            return secret;
+        }();
+
+        unsigned char mac[EVP_MAX_MD_SIZE];
+        uint32_t mac_len = 0;
+        HMAC(EVP_sha256(), process_secret.data(), static_cast<int32_t>(process_secret.size()),
+             reinterpret_cast<const unsigned char*>(material.data()), material.size(), mac, &mac_len);
+        return std::string(reinterpret_cast<const char*>(mac), mac_len);
+    }
+} // Yps
@@ -0,0 +1,120 @@
+#ifndef YPSHNS_KDF_HH
+#define YPSHNS_KDF_HH
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <openssl/sha.h>
+
+namespace Yps
+{
+    /**
+     * BLAKE2b (RFC 7693) with variable digest length, as required by Argon2's H'.
+     * OpenSSL 3.0 only exposes the fixed 64-byte variant.
+     */
+    class Blake2b
+    {
+    private:
+        std::array<uint64_t, 8> h{};
+        std::array<byte, 128> buffer{};
+        uint64_t counter[2]{0, 0};
+        size_t buffered{0};
+        size_t out_len;
+
+        void compress(const byte* block, bool last);
+
+    public:
+        static constexpr size_t MAX_OUT = 64;
+
+        /**
+         * @param out_len Digest length 1..64
+         */
+        explicit Blake2b(size_t out_len = MAX_OUT);
+
+        void update(const void* data, size_t size);
+
+        /**
+         * Add little-endian 32-bit integer
+         */
+        void update_le32(uint32_t value);
+
+        /**
+         * Write out_len bytes to out
+         */
+        void final(byte* out);
+    };
+
+    /**
+     * Argon2id cost parameters (stored in MetaData together with the salt)
+     */
+    struct Argon2Params
+    {
+        /**
+         * Memory in KiB (rounded down to 8 * lanes)
+         */
+        uint32_t memory_kib{64 * 1024};
+        uint32_t passes{3};
+
+        /**
+         * Independent memory lanes, filled in parallel (part of the result: changing it changes the key)
+         */
+        uint8_t lanes{4};
+    };
+
+    /**
+     * Argon2id v1.3 (RFC 9106). Lanes of each slice are filled in parallel (Parallel::parallel_for).
+     */
+    class Argon2id
+    {
+    public:
+        static constexpr size_t SALT_SIZE = 16;
+
+        /**
+         * Upper bounds accepted from untrusted headers (4 GiB, 64 passes)
+         */
+        static constexpr uint32_t MAX_MEMORY_KIB = 4u * 1024 * 1024;
+        static constexpr uint32_t MAX_PASSES = 64;
+
+        /**
+         * Derive tag
+         * @param password Password bytes
+         * @param salt Salt (>= 8 bytes)
+         * @param params Cost parameters
+         * @param tag_len Output length (>= 4)
+         * @param secret Optional secret value K
+         * @param associated Optional associated data X
+         * @return tag or std::nullopt (invalid parameters)
+         */
+        static std::optional<std::vector<byte>> derive(const std::string& password, const std::vector<byte>& salt,
+                                                       const Argon2Params& params, uint32_t tag_len,
+                                                       const std::vector<byte>& secret = {},
+                                                       const std::vector<byte>& associated = {});
+
+        /**
+         * 256-bit key through process-wide LRU cache keyed by (password, salt, params).
+         * Batches sharing one salt run the KDF only once.
+         * @return key or std::nullopt (invalid parameters)
+         */
+        static std::optional<std::array<byte, SHA256_DIGEST_LENGTH>> derive_key(const std::string& password,
+                                                                               const std::vector<byte>& salt,
+                                                                               const Argon2Params& params);
+
+        /**
+         * Wipe cached keys
+         */
+        static void clear_cache();
+    };
+
+    /**
+     * HMAC-SHA256 of material under a random per-process key.
+     * Cache ids built from secrets this way are useless outside the process.
+     * @return 32 raw bytes as string
+     */
+    std::string process_keyed_digest(const std::string& material);
+} // Yps
+
+#endif //YPSHNS_KDF_HH
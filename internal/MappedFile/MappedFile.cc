@@ -0,0 +1,100 @@
+#include "MappedFile.hh"
+
+#include <utility>
+
+namespace Yps
+{
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            this->release();
+            this->data_ = std::exchange(other.data_, nullptr);
+            this->size_ = std::exchange(other.size_, 0);
+            this->writable = other.writable;
+        #ifdef _WIN32
+            this->file = std::exchange(other.file, INVALID_HANDLE_VALUE);
+            this->mapping = std::exchange(other.mapping, nullptr);
+        #else
+            this->fd = std::exchange(other.fd, -1);
+        #endif
+        }
+        return *this;
+    }
+
+    void MappedFile::release() noexcept
+    {
+    #ifdef _WIN32
+        if (this->data_)
+            UnmapViewOfFile(this->data_);
+        if (this->mapping)
+            CloseHandle(this->mapping);
+        if (this->file != INVALID_HANDLE_VALUE)
+            CloseHandle(this->file);
+        this->mapping = nullptr;
+        this->file = INVALID_HANDLE_VALUE;
+    #else
+        if (this->data_)
+            munmap(this->data_, this->size_);
+        if (this->fd >= 0)
+            close(this->fd);
+        this->fd = -1;
+    #endif
+        this->data_ = nullptr;
+        this->size_ = 0;
+    }
+
+    std::optional<MappedFile> MappedFile::open(const std::string& path, bool writable)
+    {
+        MappedFile mapped;
+        mapped.writable = writable;
+    #ifdef _WIN32
+        mapped.file = CreateFileA(path.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                                  FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (mapped.file == INVALID_HANDLE_VALUE)
+            return std::nullopt;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mapped.file, &size) || size.QuadPart == 0)
+            return std::nullopt;
+        mapped.mapping = CreateFileMappingA(mapped.file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (!mapped.mapping)
+            return std::nullopt;
+        void* view = MapViewOfFile(mapped.mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+            return std::nullopt;
+        mapped.size_ = static_cast<uint64_t>(size.QuadPart);
+        mapped.data_ = static_cast<byte*>(view);
+    #else
+        mapped.fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (mapped.fd < 0)
+            return std::nullopt;
+        struct stat st{};
+        if (fstat(mapped.fd, &st) != 0 || st.st_size <= 0)
+            return std::nullopt;
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                          MAP_SHARED, mapped.fd, 0);
+        if (view == MAP_FAILED)
+            return std::nullopt;
+        mapped.size_ = static_cast<uint64_t>(st.st_size);
+        mapped.data_ = static_cast<byte*>(view);
+        // One sequential pass over the raster: let the kernel read ahead.
+        madvise(view, mapped.size_, MADV_SEQUENTIAL);
+    #endif
+        return mapped;
+    }
+
+    bool MappedFile::flush()
+    {
+        if (!this->data_ || !this->writable)
+            return true;
+    #ifdef _WIN32
+        return FlushViewOfFile(this->data_, 0) && FlushFileBuffers(this->file);
+    #else
+        return msync(this->data_, this->size_, MS_SYNC) == 0;
+    #endif
+    }
+} // Yps
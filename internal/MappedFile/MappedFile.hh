@@ -0,0 +1,69 @@
+#ifndef YPSHNS_MAPPEDFILE_HH
+#define YPSHNS_MAPPEDFILE_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include <defines.hh>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Yps
+{
+    /**
+     * Whole file mapped into memory (RAII, move-only).
+     * Writable mappings are shared: stores go straight to the file.
+     */
+    class MappedFile
+    {
+    private:
+        byte* data_{nullptr};
+        uint64_t size_{0};
+        bool writable{false};
+    #ifdef _WIN32
+        HANDLE file{INVALID_HANDLE_VALUE};
+        HANDLE mapping{nullptr};
+    #else
+        int fd{-1};
+    #endif
+
+        MappedFile() = default;
+        void release() noexcept;
+
+    public:
+        ~MappedFile() { this->release(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * Map existing file
+         * @param path Path to file
+         * @param writable Map read-write (changes are written back)
+         * @return mapping or std::nullopt (missing/empty file, mmap failed)
+         */
+        static std::optional<MappedFile> open(const std::string& path, bool writable);
+
+        [[nodiscard]] byte* data() { return this->data_; }
+        [[nodiscard]] const byte* data() const { return this->data_; }
+        [[nodiscard]] uint64_t size() const { return this->size_; }
+
+        /**
+         * Write dirty pages back synchronously
+         * @return false, if sync failed
+         */
+        bool flush();
+    };
+} // Yps
+
+#endif //YPSHNS_MAPPEDFILE_HH
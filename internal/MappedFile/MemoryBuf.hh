@@ -0,0 +1,49 @@
+#ifndef YPSHNS_MEMORYBUF_HH
+#define YPSHNS_MEMORYBUF_HH
+
+#include <ios>
+#include <streambuf>
+#include <vector>
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Read-only seekable view of a byte buffer: stream parsers run on files already in memory
+     * or mapped (scan, probe) without a copy. The buffer must outlive the view.
+     */
+    class MemoryBuf : public std::streambuf
+    {
+    public:
+        MemoryBuf(const byte* data, size_t size)
+        {
+            char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+            this->setg(begin, begin, begin + size);
+        }
+
+        explicit MemoryBuf(const std::vector<byte>& data) : MemoryBuf(data.data(), data.size()) {}
+
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+        {
+            if (!(which & std::ios_base::in))
+                return pos_type(off_type(-1));
+            const off_type base = dir == std::ios_base::beg ? 0
+                                : dir == std::ios_base::cur ? this->gptr() - this->eback()
+                                                            : this->egptr() - this->eback();
+            const off_type target = base + off;
+            if (target < 0 || target > this->egptr() - this->eback())
+                return pos_type(off_type(-1));
+            this->setg(this->eback(), this->eback() + target, this->egptr());
+            return pos_type(target);
+        }
+
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+        {
+            return this->seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+} // Yps
+
+#endif //YPSHNS_MEMORYBUF_HH
@@ -0,0 +1,143 @@
+#include "Parallel.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace Yps
+{
+    namespace
+    {
+        std::atomic<uint32_t> configured_threads{0};
+
+        thread_local const ThreadPool* current_pool = nullptr;
+
+        /**
+         * Ranges of one parallel_for, claimed by the caller and pool tasks alike
+         */
+        struct ForkJoin
+        {
+            std::atomic<size_t> next{0};
+            size_t done{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr error;
+        };
+    }
+
+    uint32_t Parallel::thread_count()
+    {
+        uint32_t count = configured_threads.load(std::memory_order_relaxed);
+        if (count == 0)
+            count = std::max(1u, std::thread::hardware_concurrency());
+        return count;
+    }
+
+    void Parallel::set_thread_count(uint32_t count)
+    {
+        configured_threads.store(count, std::memory_order_relaxed);
+    }
+
+    void Parallel::parallel_for(size_t n, const std::function<void(size_t, size_t)>& fn, size_t min_chunk)
+    {
+        if (n == 0)
+            return;
+        min_chunk = std::max<size_t>(1, min_chunk);
+
+        const size_t ranges = std::min<size_t>(thread_count(), (n + min_chunk - 1) / min_chunk);
+        if (ranges <= 1)
+        {
+            fn(0, n);
+            return;
+        }
+
+        /*Even split; first `rest` ranges get one extra item*/
+        const size_t base = n / ranges;
+        const size_t rest = n % ranges;
+        auto range_begin = [base, rest](size_t r) { return r * base + std::min(r, rest); };
+
+        /*Ranges are claimed, not assigned: the caller takes every range no pool task has started,
+          so it never waits on queued work and nested calls from pool workers can't deadlock.
+          fn is only touched for claimed ranges, all finished before return.*/
+        auto join = std::make_shared<ForkJoin>();
+        const auto* body = &fn;
+        auto claim = [join, body, ranges, range_begin]()
+        {
+            for (size_t r = join->next.fetch_add(1); r < ranges; r = join->next.fetch_add(1))
+            {
+                std::exception_ptr error;
+                try {
+                    (*body)(range_begin(r), range_begin(r + 1));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(join->mutex);
+                if (error && !join->error)
+                    join->error = error;
+                if (++join->done == ranges)
+                    join->finished.notify_all();
+            }
+        };
+
+        ThreadPool& pool = ThreadPool::shared();
+        const size_t helpers = std::min(ranges - 1, pool.size());
+        for (size_t h = 0; h < helpers; ++h)
+            pool.submit(claim);
+
+        claim();
+        std::unique_lock<std::mutex> lock(join->mutex);
+        join->finished.wait(lock, [&join, ranges] { return join->done == ranges; });
+        if (join->error)
+            std::rethrow_exception(join->error);
+    }
+
+
+    ThreadPool::ThreadPool(uint32_t threads)
+    {
+        if (threads == 0)
+            threads = Parallel::thread_count();
+        this->workers.reserve(threads);
+        for (uint32_t i = 0; i < threads; ++i)
+            this->workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->available.notify_all();
+        for (auto& t : this->workers)
+            t.join();
+    }
+
+    void ThreadPool::worker_loop()
+    {
+        current_pool = this;
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->available.wait(lock, [this] { return this->stopping || !this->tasks.empty(); });
+                if (this->tasks.empty())
+                    return;  // Stopping and drained
+                task = std::move(this->tasks.front());
+                this->tasks.pop();
+            }
+            task();
+        }
+    }
+
+    ThreadPool& ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    bool ThreadPool::in_worker() const
+    {
+        return current_pool == this;
+    }
+} // Yps
@@ -0,0 +1,111 @@
+#ifndef YPSHNS_PARALLEL_HH
+#define YPSHNS_PARALLEL_HH
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace Yps
+{
+    /**
+     * Minimal fork-join helpers shared by the codecs and bit kernels.
+     */
+    class Parallel
+    {
+    public:
+        /**
+         * Number of worker threads used by parallel_for.
+         * @return configured count, or hardware concurrency when not set
+         */
+        static uint32_t thread_count();
+
+        /**
+         * Override number of worker threads (0 = hardware concurrency).
+         * @param count Thread count
+         */
+        static void set_thread_count(uint32_t count);
+
+        /**
+         * Split [0, n) into up to thread_count() contiguous ranges and run fn(begin, end) on each,
+         * on ThreadPool::shared() and the calling thread.
+         * @param n Number of items
+         * @param fn Worker for range [begin, end)
+         * @param min_chunk Minimal range length (small jobs stay in calling thread)
+         * @note Blocks until all ranges are done; the first exception thrown by fn is rethrown.
+         *       Safe to nest and to call from pool workers: the caller runs every range the pool
+         *       hasn't picked up yet instead of waiting for it.
+         */
+        static void parallel_for(size_t n, const std::function<void(size_t, size_t)>& fn, size_t min_chunk = 1);
+    };
+
+    /**
+     * Fixed set of worker threads fed from one FIFO queue, for pipelines
+     * that keep submitting independent tasks (frames, files).
+     */
+    class ThreadPool
+    {
+    private:
+        std::vector<std::thread> workers;
+        std::queue<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable available;
+        bool stopping{false};
+
+        void worker_loop();
+
+    public:
+        /**
+         * @param threads Worker count (0 = Parallel::thread_count())
+         */
+        explicit ThreadPool(uint32_t threads = 0);
+
+        /**
+         * Finish queued tasks and join workers
+         */
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * Process-wide pool sized by Parallel::thread_count() at first use
+         */
+        static ThreadPool& shared();
+
+        /**
+         * @return true, if called from a worker of this pool (waiting on its futures there could deadlock)
+         */
+        [[nodiscard]] bool in_worker() const;
+
+        [[nodiscard]] size_t size() const { return this->workers.size(); }
+
+        /**
+         * Queue task
+         * @param fn Callable without arguments
+         * @return future with fn's result (exceptions are rethrown by get())
+         */
+        template <typename F>
+        auto submit(F&& fn) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+        {
+            using R = std::invoke_result_t<std::decay_t<F>>;
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+            std::future<R> result = task->get_future();
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->tasks.emplace([task]() { (*task)(); });
+            }
+            this->available.notify_one();
+            return result;
+        }
+    };
+} // Yps
+
+#endif //YPSHNS_PARALLEL_HH
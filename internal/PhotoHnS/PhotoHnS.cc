@@ -6,706 +6,960 @@
 #include <stb_image_write.h>
 
 #include <iostream>
+#include <iomanip>     // For std::setprecision
 #include <filesystem>  // For filename()
 #include <cstdio>      // For FILE*
 #include <stdexcept>   // For runtime_error
 #include <cstring>     // For std::memcpy, std::strncpy
+#include <chrono>
+#include <climits>     // For INT_MAX
+
+#include <BitKernels/BitKernels.hh>
+#include <CostMap/CostMap.hh>
+#include <ImageAnalysis/ImageAnalysis.hh>
+#include <Probe/Probe.hh>
+#include <Quality/Quality.hh>
+#include <RawHnS/RawHnS.hh>
+#include <SegmentHnS/SegmentHnS.hh>
 
 namespace Yps
 {
-    bool PhotoHnS::has_usable_alpha(const byte *image, int32_t width, int32_t height, int32_t channels)
+    namespace
     {
-        if (channels != 4)
-            return false;
-        // Check alpha channel (every 4th byte) for full opacity (255).
-        // Use uint32_t for i to avoid overflow in large images.
-        for (uint32_t i = 3; i < static_cast<uint32_t>(width) * height * channels; i += channels)
-            if (image[i] != 255)
-                return false;
-        return true;
+        /**
+         * Coded-stream reader over an extracted stream (metadata prefix skipped).
+         */
+        ChunkedPayload::Reader stream_slicer(const std::vector<byte>& stream)
+        {
+            return [&stream](uint64_t offset, uint64_t size) -> std::optional<std::vector<byte>> {
+                const uint64_t coded = stream.size() - META_STREAM_SIZE;
+                if (offset > coded || size > coded - offset)
+                    return std::nullopt;
+                auto first = stream.begin() + META_STREAM_SIZE + offset;
+                return std::vector<byte>(first, first + size);
+            };
+        }
+
+        void probe_png(const byte* file, uint64_t file_size, ProbeReport& report)
+        {
+            if (file_size > static_cast<uint64_t>(INT_MAX)) {
+                report.error = "file too large";
+                return;
+            }
+            const int32_t size = static_cast<int32_t>(file_size);
+            int32_t width = 0, height = 0, channels = 0;
+            const bool wide = stbi_is_16_bit_from_memory(file, size) != 0;
+            void* pixels = wide ? static_cast<void*>(stbi_load_16_from_memory(file, size, &width, &height, &channels, 0))
+                                : static_cast<void*>(stbi_load_from_memory(file, size, &width, &height, &channels, 0));
+            if (!pixels) {
+                report.error = "decode failed";
+                return;
+            }
+            auto free_image = [](void* p) noexcept { stbi_image_free(p); };
+            std::unique_ptr<void, decltype(free_image)> image_guard(pixels, free_image);
+
+            const uint32_t depth = wide ? 16 : 8;
+            report.width = width;
+            report.height = height;
+            report.channels = channels;
+            report.bits_per_sample = depth;
+
+            const ImageStats stats = ImageAnalysis::analyze(pixels, width, height, channels, depth);
+            report.capacity[0] = Probe::payload_capacity(stats.capacity_for(LsbMode::OneBit));
+            report.capacity[1] = Probe::payload_capacity(stats.capacity_for(LsbMode::TwoBits));
+
+            const BitKernels::PixelFormat format{static_cast<uint32_t>(channels), depth, false};
+            report.has_payload = Probe::plausible_meta(
+                BitKernels::image_extract(pixels, stats.samples, format, META_STREAM_SIZE, LsbMode::OneBit, KernelMode::Fast),
+                Extension::PNG);
+        }
+
+        void probe_jpeg(const std::vector<byte>& file, ProbeReport& report)
+        {
+            auto coefs = JpegCoefImage::decode(file);
+            if (!coefs || coefs->components.empty()) {
+                report.error = "decode failed";
+                return;
+            }
+            report.width = coefs->components[0].width_in_blocks * DCTSIZE;
+            report.height = coefs->components[0].height_in_blocks * DCTSIZE;
+            report.channels = static_cast<uint32_t>(coefs->components.size());
+            report.bits_per_sample = 8;
+            report.capacity[0] = Probe::payload_capacity(coefs->ac_capacity_bits() / 8);
+            report.has_payload = Probe::plausible_meta(BitKernels::dct_extract(*coefs, META_STREAM_SIZE, KernelMode::Fast),
+                                                       Extension::JPEG);
+        }
     }
 
     std::optional<std::string> PhotoHnS::embed(const std::vector<byte>& data, const std::string& path, const std::string& out_path)
+    {
+        // Format by magic bytes (extension is not trusted).
+        auto format = detect_format(path);
+        this->report.reset();
+
+        // Uncompressed bitmaps need no codec: modified in place by RawHnS.
+        if (format && RawHnS::supports(*format)) {
+            RawHnS raw;
+            raw.set_options(this->options);
+            return raw.embed(data, path, out_path);
+        }
+
+        // Segment placement splices bytes, no pixel/DCT decoding.
+        if (this->options.placement == Placement::Segment) {
+            if (!format || !SegmentHnS::supports(*format)) {
+                std::cerr << CLI_RED << "PhotoHnS::embed(): Segment placement needs PNG or JPEG: " << path << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            SegmentHnS segment;
+            segment.set_options(this->options);
+            return segment.embed(data, path, out_path);
+        }
+        if (format != Extension::PNG && format != Extension::JPEG) {
+            std::cerr << CLI_RED << "PhotoHnS::embed(): Missing file or unsupported format: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        // Whole carrier in memory: codecs decode from and encode to buffers.
+        auto carrier = read_file(path);
+        if (!carrier) {
+            std::cerr << CLI_RED << "PhotoHnS::embed(): Failed to read carrier: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        auto output = this->embed_carrier(data, *carrier, *format, path, out_path);
+        if (!output)
+            return std::nullopt;
+        if (!write_file(out_path, *output)) {
+            std::cerr << CLI_RED << "Error: Failed to write output: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        return out_path;
+    }
+
+    std::optional<std::vector<byte>> PhotoHnS::embed_memory(const std::vector<byte>& data, const std::vector<byte>& carrier,
+                                                            const std::string& name)
+    {
+        this->report.reset();
+        auto format = sniff_format(carrier.data(), std::min(carrier.size(), SNIFF_BYTES));
+        if (format != Extension::PNG && format != Extension::JPEG) {
+            std::cerr << CLI_RED << "PhotoHnS::embed_memory(): PNG or JPEG carrier expected: " << name << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        if (this->options.placement == Placement::Segment) {
+            std::cerr << CLI_RED << "PhotoHnS::embed_memory(): Segment placement needs files: " << name << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        return this->embed_carrier(data, carrier, *format, name, name);
+    }
+
+    std::optional<std::vector<byte>> PhotoHnS::embed_carrier(const std::vector<byte>& data, const std::vector<byte>& carrier,
+                                                             Extension format, const std::string& name,
+                                                             const std::string& out_name)
     {
         // Initialize EmbedData (reset if needed).
-        if (!this->embed_data)
-            this->embed_data = std::make_unique<EmbedData>();
-        else
-            this->embed_data = std::make_unique<EmbedData>();  // Automatic reset via move.
+        this->embed_data = std::make_unique<EmbedData>();
 
         // Fill metadata (only filename, not full path — safer).
         this->embed_data->plain_data = data;
         this->embed_data->meta.container = ContainerType::PHOTO;
         // Use strncpy to safely copy into fixed-size char array; truncate if too long.
-        std::string filename_str = std::filesystem::path(path).filename().string();
+        std::string filename_str = std::filesystem::path(name).filename().string();
         if (filename_str.size() >= 64) {
             std::cerr << CLI_RED << "PhotoHnS::embed(): Filename too long (max 63 chars): " << filename_str << CLI_RESET << std::endl;
             return std::nullopt;
         }
         std::strncpy(this->embed_data->meta.filename, filename_str.c_str(), 63);
         this->embed_data->meta.filename[63] = '\0';  // Ensure null-termination.
-        this->embed_data->key = AuthorKey::getInstance().get_key();
-
-        // Encryption (key from AuthorKey).
-        AES256Encryption::getInstance().set_key(this->embed_data->key);
-        this->embed_data->encrypt_data = AES256Encryption::getInstance().encrypt(this->embed_data->plain_data);
-
-        // write_size: encrypt + sizeof(MetaData) (temporary; for raw copy).
-        this->embed_data->meta.write_size = this->embed_data->encrypt_data.size() + sizeof(MetaData);
+        this->carrier_path = name;
 
-        // Path validation.
-        auto ext_opt = validate_path(path);
-        if (!ext_opt) {
-            std::cerr << CLI_RED << "PhotoHnS::embed(): Invalid path: " << path << CLI_RESET << std::endl;
+        // Key (AuthorKey or Argon2id(passphrase, fresh salt)), encryption (one CBC stream or chunks + seek table),
+        // ECC (sets write_size); a prepared broadcast payload is only copied.
+        if (!this->seal_payload())
             return std::nullopt;
-        }
-        std::string filetype = ext_opt.value();
 
         // Support PNG and JPEG.
-        if (filetype == "png") {
+        this->embed_data->meta.slot_order = this->options.slot_order;
+        if (format == Extension::PNG) {
             this->embed_data->meta.ext = Extension::PNG;
             this->embed_data->meta.lsb_mode = LsbMode::NoUsed;  // Will be set in png_in.
-            return this->png_in(out_path);
-        } else if (filetype == "jpg" || filetype == "jpeg") {
-            this->embed_data->meta.ext = Extension::JPEG;
-            this->embed_data->meta.lsb_mode = LsbMode::OneBit;  // Only 1-bit mode for DCT.
-            return this->jpg_in(out_path);
+            return this->png_in(carrier, out_name);
         }
-
-        std::cerr << CLI_RED << "PhotoHnS::embed(): Unsupported extension: " << filetype << CLI_RESET << std::endl;
-        return std::nullopt;
+        this->embed_data->meta.ext = Extension::JPEG;
+        this->embed_data->meta.lsb_mode = LsbMode::OneBit;  // Only 1-bit mode for DCT.
+        return this->jpg_in(carrier, out_name);
     }
 
-    std::optional<std::string> PhotoHnS::png_in(const std::string &out_path)
+    std::optional<std::vector<byte>> PhotoHnS::png_in(const std::vector<byte>& carrier, const std::string& out_path)
     {
-        // Load image (RAII: free at end).
+        // Load image at its own bit depth: stbi_load would drop 16-bit PNGs to 8 bits (RAII: free at end).
         int32_t width, height, channels;
-        byte* image = stbi_load(this->embed_data->meta.filename, &width, &height, &channels, 0);
-        if (!image) {
+        void* pixels = nullptr;
+        bool wide = false;
+        auto free_image = [](void* p) noexcept { stbi_image_free(p); };
+        std::unique_ptr<void, decltype(free_image)> image_guard(nullptr, free_image);
+
+        // Cached template: embed into a private copy of its samples (the cached decode stays clean).
+        CarrierCache::Entry cached;
+        std::vector<byte> copy;
+        if (this->options.cache_carrier) {
+            cached = CarrierCache::shared().get_or_decode(carrier, [&] { return decode_png(carrier); });
+            if (cached) {
+                width = cached->width;
+                height = cached->height;
+                channels = cached->channels;
+                wide = cached->wide;
+                copy = cached->samples;
+                pixels = copy.data();
+            }
+        } else {
+            wide = load_samples(carrier, width, height, channels, pixels);
+            image_guard.reset(pixels);
+        }
+        if (!pixels) {
             std::cerr << CLI_RED << "Error: Failed to load PNG: " << this->embed_data->meta.filename << CLI_RESET << std::endl;
             return std::nullopt;
         }
 
-        auto free_image = [](byte* p) noexcept { stbi_image_free(p); };
-        std::unique_ptr<byte, decltype(free_image)> image_guard(image, free_image);
-
-        // Capacity calculation (image bytes = bits for 1-bit LSB).
-        uint64_t img_bytes = static_cast<uint64_t>(width) * height * channels;
-        uint64_t data_bytes = this->embed_data->encrypt_data.size() + sizeof(MetaData);
-        uint64_t total_bits = data_bytes * 8ULL;
+        // One sweep: alpha opacity (not fully opaque alpha is left untouched), histograms, capacity per mode.
+        uint64_t samples = static_cast<uint64_t>(width) * height * channels;
+        const ImageStats stats = cached ? cached->stats
+                                        : ImageAnalysis::analyze(pixels, width, height, channels, wide ? 16 : 8);
+        const BitKernels::PixelFormat& format = stats.format;
+        this->embed_data->meta.skip_alpha = format.skip_alpha ? 1 : 0;
+        uint64_t data_bytes = this->embed_data->meta.write_size;
 
-        // Mode selection (strict <= for safety).
+        // Mode selection (metadata always 1-bit). Adaptive payload is placed in whole pixels.
+        const bool adaptive = this->embed_data->meta.slot_order == SlotOrder::Adaptive;
+        auto fits = [&](LsbMode candidate) {
+            if (adaptive)
+                return BitKernels::image_adaptive_pixels_needed(data_bytes, candidate, format) <= stats.pixels;
+            return data_bytes <= stats.capacity_for(candidate);
+        };
         LsbMode mode = LsbMode::NoUsed;
-        if (total_bits <= img_bytes) {
+        if (fits(LsbMode::OneBit)) {
             mode = LsbMode::OneBit;
-        } else if (total_bits <= img_bytes * 2ULL) {  // Simplified; optionally subtract meta*8.
-            std::cout << CLI_YELLOW << "Warning: Using LsbMode::TwoBits — artifacts may be visible." << CLI_RESET << std::endl;
+        } else if (fits(LsbMode::TwoBits)) {
+            // Bit 1 of a 16-bit sample is 256x below an 8-bit LSB: warn for 8-bit only.
+            if (!wide)
+                std::cout << CLI_YELLOW << "Warning: Using LsbMode::TwoBits — artifacts may be visible." << CLI_RESET << std::endl;
             mode = LsbMode::TwoBits;
         } else {
-            std::cerr << CLI_RED << "Error: Insufficient capacity in PNG (needed " << total_bits
-                      << " bits, available ~" << img_bytes * 2 << ")." << CLI_RESET << std::endl;
+            std::cerr << CLI_RED << "Error: Insufficient capacity in PNG (needed " << data_bytes
+                      << " bytes, available " << stats.capacity_for(LsbMode::TwoBits) << ")." << CLI_RESET << std::endl;
             return std::nullopt;
         }
         this->embed_data->meta.lsb_mode = mode;
 
         // Prepare full_data: metadata followed by encrypted data.
         std::vector<byte> full_data(data_bytes);
-        MetaData* m = &this->embed_data->meta;
-        std::copy(reinterpret_cast<const byte*>(m), reinterpret_cast<const byte*>(m) + sizeof(MetaData), full_data.begin());
-        std::copy(this->embed_data->encrypt_data.begin(), this->embed_data->encrypt_data.end(),
-                  full_data.begin() + sizeof(MetaData));
-
-        // Embedding with bounds checks.
-        switch (mode) {
-            case LsbMode::OneBit:
-                this->lsb_one_bit(image, full_data, img_bytes);
-                break;
-            case LsbMode::TwoBits:
-                this->lsb_two_bit(image, full_data, img_bytes);
-                break;
-            default:
-                return std::nullopt;
+        HnS::pack_meta(this->embed_data->meta, full_data.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  full_data.begin() + META_STREAM_SIZE);
+
+        // Quality stage: keep the carrier samples for comparison with the stego image.
+        const auto quality_start = std::chrono::steady_clock::now();
+        std::vector<byte> original;
+        if (this->options.quality_report)
+            original.assign(static_cast<const byte*>(pixels), static_cast<const byte*>(pixels) + samples * (wide ? 2 : 1));
+        double quality_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - quality_start).count();
+
+        // Embedding with bounds checks (kernel family from options); adaptive: busy pixels first.
+        bool embedded = false;
+        if (adaptive) {
+            auto activity = CostMap::pixel_activity(pixels, width, height, format);
+            embedded = activity && BitKernels::image_embed_adaptive(pixels, samples, format, *activity, full_data, mode,
+                                                                    this->options.kernel_mode);
+        } else {
+            embedded = BitKernels::image_embed(pixels, samples, format, full_data, mode, this->options.kernel_mode);
+        }
+        if (!embedded) {
+            std::cerr << CLI_RED << "Internal: Capacity mismatch in PNG embed." << CLI_RESET << std::endl;
+            return std::nullopt;
         }
 
-        // Save (stride=0 auto).
-        int success = stbi_write_png(out_path.c_str(), width, height, channels, image, 0);
-        if (!success) {
-            std::cerr << CLI_RED << "Error: Failed to write PNG: " << out_path << CLI_RESET << std::endl;
+        // Encode at the input bit depth.
+        auto encoded = encode_png(pixels, width, height, channels, wide);
+        if (!encoded) {
+            std::cerr << CLI_RED << "Error: Failed to encode PNG: " << out_path << CLI_RESET << std::endl;
             return std::nullopt;
         }
 
         std::cout << CLI_GREEN << "Embedded " << data_bytes << " bytes into " << out_path << " (mode: "
-                  << static_cast<int>(mode) << ")." << CLI_RESET << std::endl;
-        return out_path;
+                  << static_cast<int>(mode) << ", " << (wide ? 16 : 8) << "-bit)." << CLI_RESET << std::endl;
+
+        if (this->options.quality_report) {
+            const auto compare_start = std::chrono::steady_clock::now();
+            EmbedReport quality;
+            Quality::compare_pixels(original.data(), pixels, width, height, format, quality);
+            quality.carrier_bytes = carrier.size();
+            quality.output_bytes = encoded->size();
+            quality.seconds = quality_seconds +
+                              std::chrono::duration<double>(std::chrono::steady_clock::now() - compare_start).count();
+            this->report = quality;
+            print_report(quality);
+        }
+        return encoded;
+    }
+
+    bool PhotoHnS::load_samples(const std::vector<byte>& file, int32_t& width, int32_t& height, int32_t& channels,
+                                void*& pixels)
+    {
+        pixels = nullptr;
+        if (file.size() > static_cast<size_t>(INT32_MAX))
+            return false;  // stb takes int sizes
+        const int32_t size = static_cast<int32_t>(file.size());
+        const bool wide = stbi_is_16_bit_from_memory(file.data(), size) != 0;
+        pixels = wide ? static_cast<void*>(stbi_load_16_from_memory(file.data(), size, &width, &height, &channels, 0))
+                      : static_cast<void*>(stbi_load_from_memory(file.data(), size, &width, &height, &channels, 0));
+        return wide;
+    }
+
+    std::optional<DecodedCarrier> PhotoHnS::decode_png(const std::vector<byte>& file)
+    {
+        int32_t width, height, channels;
+        void* pixels = nullptr;
+        const bool wide = load_samples(file, width, height, channels, pixels);
+        if (!pixels)
+            return std::nullopt;
+
+        DecodedCarrier decoded;
+        decoded.width = width;
+        decoded.height = height;
+        decoded.channels = channels;
+        decoded.wide = wide;
+        const size_t bytes = static_cast<size_t>(width) * height * channels * (wide ? 2 : 1);
+        decoded.samples.assign(static_cast<const byte*>(pixels), static_cast<const byte*>(pixels) + bytes);
+        stbi_image_free(pixels);
+        decoded.stats = ImageAnalysis::analyze(decoded.samples.data(), width, height, channels, wide ? 16 : 8);
+        return decoded;
+    }
+
+    std::optional<std::vector<byte>> PhotoHnS::encode_png(const void* pixels, int32_t width, int32_t height,
+                                                          int32_t channels, bool wide)
+    {
+        if (wide)
+            return encode_png16(width, height, channels, static_cast<const uint16_t*>(pixels));
+
+        // stride=0: auto.
+        int32_t png_size = 0;
+        byte* png = stbi_write_png_to_mem(static_cast<const byte*>(pixels), 0, width, height, channels, &png_size);
+        if (!png)
+            return std::nullopt;
+        std::vector<byte> encoded(png, png + png_size);
+        STBIW_FREE(png);
+        return encoded;
+    }
+
+    void PhotoHnS::print_report(const EmbedReport& quality)
+    {
+        std::cout << CLI_GREEN << "Quality: PSNR " << std::fixed << std::setprecision(2) << quality.psnr << " dB, SSIM "
+                  << std::setprecision(5) << quality.ssim;
+        if (quality.dct_change_ratio > 0)
+            std::cout << ", DCT changed " << std::setprecision(3) << quality.dct_change_ratio * 100 << "%";
+        std::cout << ", size " << std::showpos << quality.size_delta() << std::noshowpos << " bytes ("
+                  << std::setprecision(3) << quality.seconds * 1000 << " ms)." << std::defaultfloat << CLI_RESET << std::endl;
     }
 
-    std::optional<std::string> PhotoHnS::jpg_in(const std::string &out_path)
+    std::optional<std::vector<byte>> PhotoHnS::encode_png16(int32_t width, int32_t height, int32_t channels,
+                                                            const uint16_t* samples)
+    {
+        static const byte color_type[5] = {0, 0, 4, 2, 6};  // Gray, gray+alpha, RGB, RGBA
+        const int32_t pixel_bytes = channels * 2;
+        const uint64_t row_bytes = static_cast<uint64_t>(width) * pixel_bytes;
+        if (channels < 1 || channels > 4 || (row_bytes + 1) * height > static_cast<uint64_t>(INT32_MAX))
+            return std::nullopt;  // stb deflate takes int sizes
+
+        // PNG stores samples big-endian.
+        std::vector<byte> raster(static_cast<size_t>(row_bytes * height));
+        for (size_t i = 0; i < raster.size() / 2; ++i) {
+            raster[2 * i] = static_cast<byte>(samples[i] >> 8);
+            raster[2 * i + 1] = static_cast<byte>(samples[i]);
+        }
+
+        // Per row: the filter with the smallest sum of absolute residuals (stb heuristic, bpp = 2 * channels).
+        std::vector<byte> filtered(static_cast<size_t>((row_bytes + 1) * height));
+        std::vector<signed char> line(static_cast<size_t>(row_bytes));
+        for (int32_t y = 0; y < height; ++y) {
+            int32_t best_filter = 0;
+            int64_t best_estimate = INT64_MAX;
+            for (int32_t filter = 0; filter < 5; ++filter) {
+                stbiw__encode_png_line(raster.data(), static_cast<int>(row_bytes), width, height, y, pixel_bytes, filter, line.data());
+                int64_t estimate = 0;
+                for (signed char v : line)
+                    estimate += std::abs(static_cast<int32_t>(v));
+                if (estimate < best_estimate) {
+                    best_estimate = estimate;
+                    best_filter = filter;
+                }
+            }
+            stbiw__encode_png_line(raster.data(), static_cast<int>(row_bytes), width, height, y, pixel_bytes, best_filter, line.data());
+            byte* dst = filtered.data() + y * (row_bytes + 1);
+            dst[0] = static_cast<byte>(best_filter);
+            std::memcpy(dst + 1, line.data(), line.size());
+        }
+
+        int32_t zlib_size = 0;
+        byte* zlib = stbi_zlib_compress(filtered.data(), static_cast<int>(filtered.size()), &zlib_size,
+                                        stbi_write_png_compression_level);
+        if (!zlib)
+            return std::nullopt;
+        std::unique_ptr<byte, decltype(&free)> zlib_guard(zlib, &free);
+
+        std::vector<byte> out;
+        out.reserve(static_cast<size_t>(zlib_size) + 64);
+        auto put_be32 = [](byte* p, uint32_t v) {
+            p[0] = static_cast<byte>(v >> 24); p[1] = static_cast<byte>(v >> 16);
+            p[2] = static_cast<byte>(v >> 8);  p[3] = static_cast<byte>(v);
+        };
+        auto put_chunk = [&](const char* type, const byte* data, uint32_t size) {
+            std::vector<byte> chunk(12 + size);
+            put_be32(chunk.data(), size);
+            std::memcpy(chunk.data() + 4, type, 4);
+            if (size > 0)
+                std::memcpy(chunk.data() + 8, data, size);
+            put_be32(chunk.data() + 8 + size, stbiw__crc32(chunk.data() + 4, static_cast<int>(size + 4)));
+            out.insert(out.end(), chunk.begin(), chunk.end());
+        };
+
+        static const byte signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+        byte header[13] = {};
+        put_be32(header, static_cast<uint32_t>(width));
+        put_be32(header + 4, static_cast<uint32_t>(height));
+        header[8] = 16;  // Bit depth
+        header[9] = color_type[channels];
+        out.insert(out.end(), signature, signature + sizeof(signature));
+        put_chunk("IHDR", header, sizeof(header));
+        put_chunk("IDAT", zlib, static_cast<uint32_t>(zlib_size));
+        put_chunk("IEND", nullptr, 0);
+        return out;
+    }
+
+    std::optional<std::vector<byte>> PhotoHnS::jpg_in(const std::vector<byte>& carrier, const std::string& out_path)
     {
         // Prepare full_data: metadata + encrypted data.
         uint64_t data_bytes = this->embed_data->meta.write_size;
         std::vector<byte> full_data(data_bytes);
-        MetaData* m = &this->embed_data->meta;
-        std::copy(reinterpret_cast<const byte*>(m), reinterpret_cast<const byte*>(m) + sizeof(MetaData), full_data.begin());
-        std::copy(this->embed_data->encrypt_data.begin(), this->embed_data->encrypt_data.end(),
-                  full_data.begin() + sizeof(MetaData));
+        HnS::pack_meta(this->embed_data->meta, full_data.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  full_data.begin() + META_STREAM_SIZE);
 
         uint64_t total_bits = data_bytes * 8ULL;
         if (total_bits == 0) return std::nullopt;  // Edge case.
 
-        // RAII for decompress (manual finish — see below).
-        JpegDecompressRAII decompress;
-        FILE* infile = std::fopen(this->embed_data->meta.filename, "rb");
-        if (!infile) {
-            std::cerr << CLI_RED << "Error: Failed to open JPEG: " << this->embed_data->meta.filename << CLI_RESET << std::endl;
-            return std::nullopt;
+        // Decode DCT coefficients (restart segments in parallel when present); cached template: a private copy.
+        std::optional<JpegCoefImage> coefs;
+        if (this->options.cache_carrier) {
+            auto cached = CarrierCache::shared().get_or_decode(carrier, [&]() -> std::optional<DecodedCarrier> {
+                auto decoded = JpegCoefImage::decode(carrier);
+                if (!decoded)
+                    return std::nullopt;
+                DecodedCarrier entry;
+                entry.format = Extension::JPEG;
+                entry.coefs = std::move(decoded);
+                return entry;
+            });
+            if (cached)
+                coefs = cached->coefs;
+        } else {
+            coefs = JpegCoefImage::decode(carrier);
         }
-        auto close_infile = [](FILE* f) { std::fclose(f); };
-        std::unique_ptr<FILE, decltype(close_infile)> infile_guard(infile, close_infile);
-
-        // Set up input source and read header.
-        jpeg_stdio_src(&decompress.cinfo, infile);
-        if (jpeg_read_header(&decompress.cinfo, TRUE) == JPEG_SUSPENDED) {
-            std::cerr << CLI_RED << "Error: JPEG header read suspended." << CLI_RESET << std::endl;
+        if (!coefs) {
+            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients." << CLI_RESET << std::endl;
             return std::nullopt;
         }
 
-        // Log progressive and force baseline (enforced on compress side).
-        if (decompress.cinfo.progressive_mode) {
+        // Log progressive and force baseline (enforced on encode side).
+        if (coefs->is_progressive()) {
             std::cout << CLI_YELLOW << "Input is progressive JPEG; forcing baseline output." << CLI_RESET << std::endl;
         }
 
-        // Read DCT coefficients (keep decompress alive until transcoding end).
-        jvirt_barray_ptr* coef_arrays = jpeg_read_coefficients(&decompress.cinfo);
-        if (!coef_arrays) {
-            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients." << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);  // Safe cleanup.
-            return std::nullopt;
-        }
-
-        // Calculate capacity (AC: 63 bits per block, skip DC).
-        uint64_t ac_capacity_bits = 0;
-        for (int ci = 0; ci < decompress.cinfo.num_components; ++ci) {
-            jpeg_component_info* comp = decompress.cinfo.comp_info + ci;
-            ac_capacity_bits += static_cast<uint64_t>(comp->height_in_blocks) * comp->width_in_blocks * 63ULL;
-        }
-        if (total_bits > ac_capacity_bits) {
-            std::cerr << CLI_RED << "Error: Insufficient capacity in JPEG (needed " << total_bits
+        // Calculate capacity (AC: 63 bits per block, skip DC; adaptive payload in whole blocks).
+        const bool adaptive = this->embed_data->meta.slot_order == SlotOrder::Adaptive;
+        uint64_t ac_capacity_bits = coefs->ac_capacity_bits();
+        uint64_t needed_bits = adaptive ? BitKernels::dct_adaptive_blocks_needed(data_bytes) * (DCTSIZE2 - 1) : total_bits;
+        if (needed_bits > ac_capacity_bits) {
+            std::cerr << CLI_RED << "Error: Insufficient capacity in JPEG (needed " << needed_bits
                       << " bits, available " << ac_capacity_bits << ")." << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);
             return std::nullopt;
         }
         std::cout << CLI_YELLOW << "JPEG capacity check: " << ac_capacity_bits << " AC bits available." << CLI_RESET << std::endl;
 
-        // Embed LSB in AC (modifies coef_arrays via access_virt_barray).
-        this->dct_lsb_embed(coef_arrays, decompress.cinfo, full_data);
-
-        // RAII for compress (manual finish below).
-        JpegCompressRAII compress;
-        FILE* outfile = std::fopen(out_path.c_str(), "wb");
-        if (!outfile) {
-            std::cerr << CLI_RED << "Error: Failed to open output: " << out_path << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);  // Cleanup on fail.
+        // Quality stage: keep the carrier coefficients for comparison with the stego ones.
+        const auto quality_start = std::chrono::steady_clock::now();
+        std::optional<JpegCoefImage> original;
+        if (this->options.quality_report)
+            original = *coefs;
+        double quality_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - quality_start).count();
+
+        // Embed LSB in AC (adaptive: busy blocks first).
+        bool embedded = adaptive ? BitKernels::dct_embed_adaptive(*coefs, *CostMap::block_activity(*coefs), full_data,
+                                                                  this->options.kernel_mode)
+                                 : BitKernels::dct_embed(*coefs, full_data, this->options.kernel_mode);
+        if (!embedded) {
+            std::cerr << CLI_RED << "Internal: Capacity mismatch in JPEG embed." << CLI_RESET << std::endl;
             return std::nullopt;
         }
-        auto close_outfile = [](FILE* f) { std::fclose(f); };
-        std::unique_ptr<FILE, decltype(close_outfile)> outfile_guard(outfile, close_outfile);
 
-        jpeg_stdio_dest(&compress.cinfo, outfile);
+        // Baseline re-encode with restart markers (bands encoded in parallel, then spliced).
+        auto encoded = coefs->encode();
+        if (!encoded) {
+            std::cerr << CLI_RED << "Error: Failed to encode JPEG: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
 
-        // Copy critical parameters — do this while decompress is still valid.
-        jpeg_copy_critical_parameters(&decompress.cinfo, &compress.cinfo);
+        std::cout << CLI_GREEN << "Embedded " << data_bytes << " bytes into JPEG DCT (" << out_path << ")." << CLI_RESET << std::endl;
 
-        // Force baseline to avoid Huffman corruption (no progressive/arith).
-        compress.cinfo.progressive_mode = FALSE;
-        compress.cinfo.arith_code = FALSE;
-        compress.cinfo.optimize_coding = FALSE;  // Stable Huffman tables.
+        if (original) {
+            const auto compare_start = std::chrono::steady_clock::now();
+            EmbedReport quality;
+            Quality::compare_dct(*original, *coefs, quality);
+            quality.carrier_bytes = carrier.size();
+            quality.output_bytes = encoded->size();
+            quality.seconds = quality_seconds +
+                              std::chrono::duration<double>(std::chrono::steady_clock::now() - compare_start).count();
+            this->report = quality;
+            print_report(quality);
+        }
+        return encoded;
+    }
 
-        // Pass modified coef_arrays to write_coefficients (no field assign).
-        jpeg_write_coefficients(&compress.cinfo, coef_arrays);  // Full call: cinfo + arrays.
+    std::optional<std::string> PhotoHnS::png_out(const void* image, int32_t width, int32_t height,
+                                                 const BitKernels::PixelFormat& format, MetaData& meta,
+                                                 const std::string& path)
+    {
+        uint64_t data_bytes = meta.write_size;
+        uint64_t samples = static_cast<uint64_t>(width) * height * format.channels;
+
+        // Sequential slots can be entered at any stream offset: a query reads only the groups it covers.
+        if (this->query && meta.slot_order == SlotOrder::Sequential) {
+            const LsbMode mode = meta.lsb_mode;
+            if (BitKernels::image_samples_needed(data_bytes, mode, format) > samples) {
+                std::cerr << CLI_RED << "Error: Incomplete extraction (mode: " << static_cast<int>(mode)
+                          << ", needed " << data_bytes * 8ULL << " bits)." << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            auto read = [&](uint64_t offset, uint64_t size) {
+                return BitKernels::image_extract_range(image, samples, format, META_STREAM_SIZE + offset, size, mode,
+                                                       this->options.kernel_mode);
+            };
+            if (!this->decode_stream(read))
+                return std::nullopt;
+            return path;
+        }
 
-        // Finish compress (writes trailer, but does not free arrays — shared).
-        jpeg_finish_compress(&compress.cinfo);  // Errors via err_mgr.
+        // Whole stream (metadata prefix included) with the kernel family used for embedding.
+        std::optional<std::vector<byte>> full_data;
+        if (meta.slot_order == SlotOrder::Adaptive) {
+            // Same cost map as embed: it ignores the bits embedding changed.
+            if (auto activity = CostMap::pixel_activity(image, width, height, format))
+                full_data = BitKernels::image_extract_adaptive(image, samples, format, *activity, data_bytes,
+                                                               meta.lsb_mode, this->options.kernel_mode);
+        } else {
+            full_data = BitKernels::image_extract(image, samples, format, data_bytes, meta.lsb_mode, this->options.kernel_mode);
+        }
+        if (!full_data) {
+            std::cerr << CLI_RED << "Error: Incomplete extraction (mode: " << static_cast<int>(meta.lsb_mode)
+                      << ", needed " << data_bytes * 8ULL << " bits)." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
 
-        // Now safe to finish decompress (free arrays after compress).
-        jpeg_finish_decompress(&decompress.cinfo);
+        // ECC repair + decrypt (metadata prefix skipped).
+        if (!this->decode_stream(stream_slicer(*full_data)))
+            return std::nullopt;
 
-        std::cout << CLI_GREEN << "Embedded " << data_bytes << " bytes into JPEG DCT (" << out_path << ")." << CLI_RESET << std::endl;
-        return out_path;
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes (mode: "
+                  << static_cast<int>(meta.lsb_mode) << ")." << CLI_RESET << std::endl;
+        return path;
     }
 
-    void PhotoHnS::lsb_one_bit(byte* image, const std::vector<byte>& data, uint64_t img_bytes)
+    std::optional<std::string> PhotoHnS::jpg_out(const std::vector<byte>& file, const std::string& path)
     {
-        // 1 bit per image byte, MSB-first.
-        uint64_t total_bits = data.size() * 8ULL;
-        if (total_bits > img_bytes) {
-            throw std::runtime_error("Internal: Capacity mismatch in lsb_one_bit");  // Should not happen.
+        // Read coefficients (DCT blocks).
+        auto coefs = JpegCoefImage::decode(file);
+        if (!coefs) {
+            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients in extract." << CLI_RESET << std::endl;
+            return std::nullopt;
         }
 
-        uint64_t bit_idx = 0;
-        for (uint64_t i = 0; i < total_bits; ++i) {
-            if (i >= img_bytes) break;  // Extra safety.
+        // Extract metadata first (small, from first AC coefficients).
+        if (!this->read_jpg_meta(*coefs))
+            return std::nullopt;
 
-            byte current_byte = data[bit_idx / 8];
-            int bit_pos_in_byte = bit_idx % 8;
-            byte bit = (current_byte >> (7 - bit_pos_in_byte)) & 1;
-            image[i] = (image[i] & 0xFE) | bit;
-            ++bit_idx;
+        // Sequential query: only the AC coefficients of the needed stream bytes.
+        uint64_t full_bytes = this->embed_data->meta.write_size;
+        if (this->query && this->embed_data->meta.slot_order == SlotOrder::Sequential) {
+            if (full_bytes * 8ULL > coefs->ac_capacity_bits()) {
+                std::cerr << CLI_RED << "Error: Failed to extract full JPEG data." << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            auto read = [&](uint64_t offset, uint64_t size) {
+                return BitKernels::dct_extract_range(*coefs, META_STREAM_SIZE + offset, size, this->options.kernel_mode);
+            };
+            if (!this->decode_stream(read))
+                return std::nullopt;
+            return path;
         }
-    }
 
-    void PhotoHnS::lsb_two_bit(byte* image, const std::vector<byte>& data, uint64_t img_bytes)
-    {
-        uint64_t total_bits = data.size() * 8ULL;
-        uint64_t meta_bits = sizeof(MetaData) * 8ULL;  // Bits for metadata (raw sizeof).
-        uint64_t bit_idx = 0;
-        uint64_t img_idx = 0;
-
-        // First part: metadata in 1-bit mode (safe, no overflow).
-        for (; bit_idx < meta_bits && img_idx < img_bytes; ++img_idx) {
-            byte current_byte = data[bit_idx / 8];
-            int bit_pos_in_byte = bit_idx % 8;
-            byte bit = (current_byte >> (7 - bit_pos_in_byte)) & 1;
-            image[img_idx] = (image[img_idx] & 0xFE) | bit;
-            ++bit_idx;
+        // Now extract full data using write_size from metadata.
+        auto full_opt = this->embed_data->meta.slot_order == SlotOrder::Adaptive
+                            ? BitKernels::dct_extract_adaptive(*coefs, *CostMap::block_activity(*coefs), full_bytes,
+                                                               this->options.kernel_mode)
+                            : BitKernels::dct_extract(*coefs, full_bytes, this->options.kernel_mode);
+        if (!full_opt || full_opt->size() != full_bytes) {
+            std::cerr << CLI_RED << "Error: Failed to extract full JPEG data." << CLI_RESET << std::endl;
+            return std::nullopt;
         }
 
-        // Second part: remainder in 2-bit mode (pairs of bits, MSB-first).
-        for (; bit_idx < total_bits && img_idx < img_bytes; ++img_idx) {
-            if (bit_idx + 1 >= total_bits) break;  // Odd bits — stop.
+        // ECC repair + decrypt (metadata prefix skipped).
+        if (!this->decode_stream(stream_slicer(*full_opt)))
+            return std::nullopt;
 
-            byte current_byte = data[bit_idx / 8];
-            int bit_pos_in_byte = bit_idx % 8;
-            byte bits = (current_byte >> (6 - bit_pos_in_byte)) & 0x03;  // 2 bits.
-            image[img_idx] = (image[img_idx] & 0xFC) | bits;
-            bit_idx += 2;
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from JPEG DCT." << CLI_RESET << std::endl;
+        return path;
+    }
+
+    bool PhotoHnS::read_jpg_meta(const JpegCoefImage& coefs)
+    {
+        auto meta_opt = BitKernels::dct_extract(coefs, META_STREAM_SIZE, this->options.kernel_mode);
+        if (!meta_opt || meta_opt->size() != META_STREAM_SIZE) {
+            std::cerr << CLI_RED << "Error: Failed to extract JPEG metadata." << CLI_RESET << std::endl;
+            return false;
         }
 
-        if (bit_idx < total_bits) {
-            std::cerr << CLI_YELLOW << "Warning: Incomplete embed in TwoBits (used " << bit_idx << "/" << total_bits << " bits)." << CLI_RESET << std::endl;
+        // Validate extracted metadata.
+        if (!HnS::unpack_meta(meta_opt->data(), this->embed_data->meta) ||
+            this->embed_data->meta.container != ContainerType::PHOTO ||
+            this->embed_data->meta.ext != Extension::JPEG ||
+            this->embed_data->meta.write_size < META_STREAM_SIZE ||
+            this->embed_data->meta.slot_order > SlotOrder::Adaptive) {
+            std::cerr << CLI_RED << "Error: Invalid extracted metadata for JPEG." << CLI_RESET << std::endl;
+            return false;
         }
+        return true;
     }
 
-    void PhotoHnS::dct_lsb_embed(jvirt_barray_ptr* coef_arrays, const jpeg_decompress_struct& cinfo,
-                                 const std::vector<byte>& data)
+    std::optional<std::vector<byte>> PhotoHnS::extract(const std::string& path)
     {
-        uint64_t bit_idx = 0;
-        uint64_t total_bits = data.size() * 8ULL;
-
-        // Iteration: components → block rows → blocks → AC coeffs (skip DC=0).
-        for (int ci = 0; ci < cinfo.num_components && bit_idx < total_bits; ++ci) {
-            jpeg_component_info* comp = cinfo.comp_info + ci;
-
-            for (JDIMENSION blk_row = 0; blk_row < comp->height_in_blocks && bit_idx < total_bits; ++blk_row) {
-                // Access row (write mode: TRUE — modify in-place).
-                JBLOCKARRAY block_array = (JBLOCKARRAY) (*cinfo.mem->access_virt_barray)
-                    ((j_common_ptr) &cinfo, coef_arrays[ci], blk_row, 1, TRUE);  // TRUE for write.
-                if (block_array == nullptr) {
-                    std::cerr << CLI_RED << "Error: Failed to access DCT block row " << blk_row << " for embedding." << CLI_RESET << std::endl;
-                    return;  // Abort gracefully.
-                }
-                JBLOCKROW block_row = block_array[0];
-
-                for (JDIMENSION blk_col = 0; blk_col < comp->width_in_blocks && bit_idx < total_bits; ++blk_col) {
-                    JBLOCK* block = block_row + blk_col;
-
-                    for (int k = 1; k < DCTSIZE2 && bit_idx < total_bits; ++k) {  // Skip DC (k=0).
-                        // LSB embed: clear bit, set to data_bit (MSB-first).
-                        uint64_t byte_idx = bit_idx / 8ULL;
-                        int bit_offset = bit_idx % 8;
-                        byte data_bit = (data[byte_idx] >> (7 - bit_offset)) & 1;
+        // Step 0: Initialize context (fresh instance may extract without prior embed).
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
 
-                        JCOEF& coef = (*block)[k];
-                        coef = (coef & ~1) | static_cast<JCOEF>(data_bit);  // Set LSB.
+        // Step 0.1: Key is chosen after metadata is read (AuthorKey or passphrase + stored salt).
 
-                        // Clamp for DCT-range (avoid overflow in Huffman).
-                        if (coef > 1023) coef = 1023;
-                        else if (coef < -1024) coef = -1024;
+        // Step 0.2: Format by magic bytes: exactly one parser runs, the extension is not trusted.
+        auto format = detect_format(path);
+        if (!format) {
+            std::cerr << CLI_RED << "Error: Missing file or unknown format: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        if (RawHnS::supports(*format)) {
+            RawHnS raw;
+            raw.set_options(this->options);
+            return raw.extract(path);
+        }
+        if (*format != Extension::PNG && *format != Extension::JPEG) {
+            std::cerr << CLI_RED << "Error: Not a photo container: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
 
-                        ++bit_idx;
-                    }
-                }
-            }
+        // Step 0.3: Segment placement is detected from chunk/marker headers only.
+        if (SegmentHnS::has_segments(path)) {
+            SegmentHnS segment;
+            segment.set_options(this->options);
+            return segment.extract(path);
         }
 
-        if (bit_idx < total_bits) {
-            std::cerr << CLI_YELLOW << "Warning: Partial embed (" << bit_idx << "/" << total_bits << " bits)." << CLI_RESET << std::endl;
+        auto file = read_file(path);
+        if (!file) {
+            std::cerr << CLI_RED << "Error: Failed to read file: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
         }
+        return this->extract_carrier(*file, *format, path);
     }
 
-    std::optional<std::string> PhotoHnS::png_out(byte* image, MetaData& meta, const std::string& path)
+    std::optional<std::vector<byte>> PhotoHnS::extract_query(const std::string& path, const PlainQuery& query)
     {
-        // Prepare full_data with metadata prefix.
-        uint64_t data_bytes = meta.write_size;
-        std::vector<byte> full_data(data_bytes, 0);
-        std::copy(reinterpret_cast<const byte*>(&meta), reinterpret_cast<const byte*>(&meta) + sizeof(MetaData),
-                  full_data.begin());
-
-        uint64_t total_bits = data_bytes * 8ULL;
-        uint64_t meta_bits = sizeof(MetaData) * 8ULL;
-        bool success = true;
-
-        // Start extraction after metadata bits (image indices align with bit positions for 1-bit, adjusted for 2-bit).
-        // Note: Use total_bits as upper bound (assumes sufficient capacity from embed; real img_bytes larger).
-        uint64_t img_idx = meta_bits;
-        uint64_t bit_pos = meta_bits;
-
-        if (meta.lsb_mode == LsbMode::OneBit) {
-            // 1 bit per image byte, MSB-first.
-            for (; bit_pos < total_bits && img_idx < total_bits; ++img_idx, ++bit_pos) {
-                if (img_idx >= total_bits) { success = false; break; }  // Safety.
-
-                byte bit = image[img_idx] & 0x01;
-                uint64_t byte_idx = bit_pos / 8ULL;
-                if (byte_idx >= full_data.size()) { success = false; break; }
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
 
-                int bit_offset = bit_pos % 8;
-                full_data[byte_idx] |= (bit << (7 - bit_offset));
-            }
-        } else if (meta.lsb_mode == LsbMode::TwoBits) {
-            // 2 bits per image byte (after metadata in 1-bit); img_idx advances per pair.
-            for (; bit_pos + 1 < total_bits && img_idx < total_bits; ++img_idx, bit_pos += 2) {
-                if (img_idx >= total_bits) { success = false; break; }
-
-                byte bits = image[img_idx] & 0x03;
-                uint64_t byte_idx = bit_pos / 8ULL;
-                if (byte_idx >= full_data.size()) { success = false; break; }
-
-                int bit_offset = bit_pos % 8;
-                int shift = 6 - bit_offset;  // Matches embed: shifts for 6,4,2,0 aligning to MSB.
-                full_data[byte_idx] |= (static_cast<byte>(bits) << shift);
-            }
-        } else {
-            std::cerr << CLI_RED << "Error: Unsupported LsbMode: " << static_cast<int>(meta.lsb_mode) << CLI_RESET << std::endl;
-            return std::nullopt;
+        auto format = detect_format(path);
+        if (format && RawHnS::supports(*format)) {
+            RawHnS raw;
+            raw.set_options(this->options);
+            return raw.extract_query(path, query);
         }
+        // Segments carry a few bytes per chunk/marker: whole extract is as cheap as a query.
+        if (!format || (*format != Extension::PNG && *format != Extension::JPEG) || SegmentHnS::has_segments(path))
+            return HnS::extract_query(path, query);
 
-        if (!success || bit_pos < total_bits) {
-            std::cerr << CLI_RED << "Error: Incomplete extraction (mode: " << static_cast<int>(meta.lsb_mode)
-                      << ", extracted " << bit_pos << "/" << total_bits << " bits)." << CLI_RESET << std::endl;
+        auto file = read_file(path);
+        if (!file) {
+            std::cerr << CLI_RED << "Error: Failed to read file: " << path << CLI_RESET << std::endl;
             return std::nullopt;
         }
-
-        // Extract encrypted data (metadata already in full_data).
-        std::vector<byte> encrypt_data(full_data.begin() + sizeof(MetaData), full_data.end());
-        this->embed_data->encrypt_data = std::move(encrypt_data);
-
-        // Decrypt.
-        AES256Encryption::getInstance().set_key(this->embed_data->key);
-        this->embed_data->plain_data = AES256Encryption::getInstance().decrypt(this->embed_data->encrypt_data);
-
-        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes (mode: "
-                  << static_cast<int>(meta.lsb_mode) << ")." << CLI_RESET << std::endl;
-        return path;
+        this->query = &query;
+        auto result = this->extract_carrier(*file, *format, path);
+        this->query = nullptr;
+        return result;
     }
 
-    std::optional<std::string> PhotoHnS::jpg_out(const std::string& path)
+    bool PhotoHnS::decode_stream(const StreamReader& read)
     {
-        // RAII decompress.
-        JpegDecompressRAII decompress;
-        FILE* infile = std::fopen(path.c_str(), "rb");
-        if (!infile) {
-            std::cerr << CLI_RED << "Error: Failed to open JPEG: " << path << CLI_RESET << std::endl;
-            return std::nullopt;
+        if (this->query) {
+            auto plain = this->open_plain(read);
+            if (!plain)
+                return false;
+            auto result = (*this->query)(*plain);
+            if (!result)
+                return false;
+            this->embed_data->plain_data = std::move(*result);
+            return true;
         }
-        auto close_infile = [](FILE* f) { std::fclose(f); };
-        std::unique_ptr<FILE, decltype(close_infile)> infile_guard(infile, close_infile);
+        auto coded = read(0, this->embed_data->meta.write_size - META_STREAM_SIZE);
+        if (!coded)
+            return false;
+        this->embed_data->coded_data = std::move(*coded);
+        return this->decode_payload();
+    }
 
-        // Set up standard input source and read header.
-        jpeg_stdio_src(&decompress.cinfo, infile);
-        if (jpeg_read_header(&decompress.cinfo, TRUE) == JPEG_SUSPENDED) {
-            std::cerr << CLI_RED << "Error: JPEG header read suspended in extract." << CLI_RESET << std::endl;
-            return std::nullopt;
-        }
+    std::optional<std::vector<byte>> PhotoHnS::extract_memory(const std::vector<byte>& file)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
 
-        // Read coefficients (DCT blocks).
-        jvirt_barray_ptr* coef_arrays = jpeg_read_coefficients(&decompress.cinfo);
-        if (!coef_arrays) {
-            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients in extract." << CLI_RESET << std::endl;
+        auto format = sniff_format(file.data(), std::min(file.size(), SNIFF_BYTES));
+        if (format != Extension::PNG && format != Extension::JPEG) {
+            std::cerr << CLI_RED << "PhotoHnS::extract_memory(): PNG or JPEG expected." << CLI_RESET << std::endl;
             return std::nullopt;
         }
+        return this->extract_carrier(file, *format, "<memory>");
+    }
 
-        // Extract metadata first (small, from first AC coefficients).
-        auto meta_opt = this->dct_lsb_extract(coef_arrays, decompress.cinfo, sizeof(MetaData));
-        if (!meta_opt || meta_opt->size() != sizeof(MetaData)) {
-            std::cerr << CLI_RED << "Error: Failed to extract JPEG metadata." << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);
-            return std::nullopt;
+    bool PhotoHnS::read_png_meta(const void* pixels, uint64_t samples, BitKernels::PixelFormat& format,
+                                 const std::string& path)
+    {
+        // LSB 1-bit from first non-alpha samples, MSB-first.
+        auto meta_bytes = BitKernels::image_extract(pixels, samples, format, META_STREAM_SIZE, LsbMode::OneBit,
+                                                    this->options.kernel_mode);
+        if (!meta_bytes) {
+            std::cerr << CLI_RED << "Error: Image too small for metadata: " << path << CLI_RESET << std::endl;
+            return false;
         }
-        std::memcpy(&this->embed_data->meta, meta_opt->data(), sizeof(MetaData));
+        MetaData extracted_meta{};
+        if (!HnS::unpack_meta(meta_bytes->data(), extracted_meta) || extracted_meta.container != ContainerType::PHOTO || extracted_meta.ext != Extension::PNG ||
+            extracted_meta.write_size < META_STREAM_SIZE || extracted_meta.skip_alpha > 1 ||
+            (extracted_meta.skip_alpha && !format.has_alpha()) || extracted_meta.slot_order > SlotOrder::Adaptive) {
+            std::cerr << CLI_RED << "Error: No valid metadata in PNG pixels: " << path << CLI_RESET << std::endl;
+            return false;
+        }
+        this->embed_data->meta = extracted_meta;
+        this->embed_data->meta.filename[63] = '\0';  // Ensure null-termination after copy.
+        format.skip_alpha = this->embed_data->meta.skip_alpha != 0;
+        return true;
+    }
 
-        // Validate extracted metadata.
-        if (this->embed_data->meta.container != ContainerType::PHOTO ||
-            this->embed_data->meta.ext != Extension::JPEG ||
-            this->embed_data->meta.write_size < sizeof(MetaData)) {
-            std::cerr << CLI_RED << "Error: Invalid extracted metadata for JPEG." << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);
-            return std::nullopt;
+    std::optional<std::vector<byte>> PhotoHnS::extract_carrier(const std::vector<byte>& file, Extension format,
+                                                               const std::string& path)
+    {
+        // Step 1: JPEG - DCT coefficients (no pixel decode).
+        if (format == Extension::JPEG) {
+            if (!jpg_out(file, path))
+                return std::nullopt;
+            return this->embed_data->plain_data;
         }
 
-        // Now extract full data using write_size from metadata.
-        uint64_t full_bytes = this->embed_data->meta.write_size;
-        auto full_opt = this->dct_lsb_extract(coef_arrays, decompress.cinfo, full_bytes);
-        if (!full_opt || full_opt->size() != full_bytes) {
-            std::cerr << CLI_RED << "Error: Failed to extract full JPEG data." << CLI_RESET << std::endl;
-            jpeg_finish_decompress(&decompress.cinfo);
+        // Step 2: PNG - samples at the file's bit depth (8 or 16).
+        int32_t width = 0, height = 0, channels = 0;
+        void* pixels = nullptr;
+        const bool wide = load_samples(file, width, height, channels, pixels);
+        if (!pixels) {
+            std::cerr << CLI_RED << "Error: Failed to load image: " << path << " (stbi)." << CLI_RESET << std::endl;
             return std::nullopt;
         }
+        auto free_image = [](void* p) noexcept { stbi_image_free(p); };
+        std::unique_ptr<void, decltype(free_image)> image_guard(pixels, free_image);
+        uint64_t samples = static_cast<uint64_t>(width) * height * channels;
 
-        // Extract encrypted data (skip metadata prefix).
-        uint64_t encrypt_bytes = full_bytes - sizeof(MetaData);
-        std::vector<byte> encrypt_data(full_opt->begin() + sizeof(MetaData), full_opt->end());
-        this->embed_data->encrypt_data = std::move(encrypt_data);
-
-        // Decrypt.
-        AES256Encryption::getInstance().set_key(this->embed_data->key);
-        this->embed_data->plain_data = AES256Encryption::getInstance().decrypt(this->embed_data->encrypt_data);
+        // Step 3: Metadata (LSB 1-bit from first non-alpha samples, MSB-first).
+        BitKernels::PixelFormat pixel_format{static_cast<uint32_t>(channels), wide ? 16u : 8u, false};
+        if (!this->read_png_meta(pixels, samples, pixel_format, path))
+            return std::nullopt;
 
-        jpeg_finish_decompress(&decompress.cinfo);
+        // Step 4: Payload; decrypted in png_out (after ECC repair).
+        if (!png_out(pixels, width, height, pixel_format, this->embed_data->meta, path))
+            return std::nullopt;
 
-        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from JPEG DCT." << CLI_RESET << std::endl;
-        return path;
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from PNG pixels." << CLI_RESET << std::endl;
+        return this->embed_data->plain_data;
     }
 
-    std::optional<std::vector<byte>> PhotoHnS::dct_lsb_extract(jvirt_barray_ptr* coef_arrays,
-                                                               const jpeg_decompress_struct& cinfo,
-                                                               uint64_t num_bytes) const
+    std::optional<std::string> PhotoHnS::update(const std::string& path, uint64_t offset, const std::vector<byte>& data,
+                                                const std::string& out_path)
     {
-        if (num_bytes == 0) return std::vector<byte>{};
-        uint64_t total_bits = num_bytes * 8ULL;
-        std::vector<byte> data(num_bytes, 0);
-        uint64_t bit_idx = 0;
-
-        // Iteration same as embed: over components, block rows, blocks, AC coefficients.
-        // Access virtual arrays row-by-row for reading (read mode: FALSE).
-        for (int ci = 0; ci < cinfo.num_components && bit_idx < total_bits; ++ci) {
-            jpeg_component_info* comp = cinfo.comp_info + ci;
-
-            for (JDIMENSION blk_row = 0; blk_row < comp->height_in_blocks && bit_idx < total_bits; ++blk_row) {
-                // Access one row of blocks (read-only); safety check for NULL.
-                JBLOCKARRAY block_array = (JBLOCKARRAY) (*cinfo.mem->access_virt_barray)
-                    ((j_common_ptr) &cinfo, coef_arrays[ci], blk_row, 1, FALSE);
-                if (block_array == nullptr) {
-                    std::cerr << CLI_RED << "Error: Failed to access DCT block row " << blk_row << " for extraction (component " << ci << ")." << CLI_RESET << std::endl;
-                    return std::nullopt;  // Abort extraction safely.
-                }
-                JBLOCKROW block_row = block_array[0];  // Single row.
-
-                for (JDIMENSION blk_col = 0; blk_col < comp->width_in_blocks && bit_idx < total_bits; ++blk_col) {
-                    JBLOCK* block = block_row + blk_col;  // Pointer to JBLOCK (JCOEF[64]).
-
-                    for (int k = 1; k < DCTSIZE2 && bit_idx < total_bits; ++k) {
-                        // LSB from coefficient.
-                        const JCOEF& coef = (*block)[k];
-                        byte bit = static_cast<byte>(coef & 1);
-
-                        uint64_t byte_idx = bit_idx / 8ULL;
-                        if (byte_idx >= num_bytes) break;
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
 
-                        int bit_offset = bit_idx % 8;
-                        data[byte_idx] |= (bit << (7 - bit_offset));
-                        ++bit_idx;
-                    }
-                }
-            }
+        auto format = detect_format(path);
+        if (format && RawHnS::supports(*format)) {
+            RawHnS raw;
+            raw.set_options(this->options);
+            return raw.update(path, offset, data, out_path);
         }
+        if (!format || (*format != Extension::PNG && *format != Extension::JPEG) || SegmentHnS::has_segments(path))
+            return HnS::update(path, offset, data, out_path);
 
-        if (bit_idx < total_bits) {
-            std::cerr << CLI_RED << "Error: Incomplete DCT extraction (" << bit_idx << "/" << total_bits << " bits)." << CLI_RESET << std::endl;
+        auto file = read_file(path);
+        if (!file) {
+            std::cerr << CLI_RED << "Error: Failed to read file: " << path << CLI_RESET << std::endl;
             return std::nullopt;
         }
-
-        return data;
-    }
-
-    std::optional<std::vector<byte>> PhotoHnS::extract(const std::string& path)
-    {
-        // Step 0: Initialize context (fail if none).
-        if (!this->embed_data) {
-            std::cerr << CLI_RED << "Error: No EmbedData context in extract." << CLI_RESET << std::endl;
+        auto output = *format == Extension::PNG ? this->png_update(*file, offset, data, path)
+                                                : this->jpg_update(*file, offset, data, path);
+        if (!output)
             return std::nullopt;
-        }
-
-        // Step 0.1: Set key (singleton, once — avoid duplicates).
-        this->embed_data->key = AuthorKey::getInstance().get_key();
-
-        // Step 0.2: Validate path and type (adaptive by ext).
-        auto ext_opt = validate_path(path);
-        if (!ext_opt) {
-            std::cerr << CLI_RED << "Error: Invalid path for extraction: " << path << CLI_RESET << std::endl;
+        if (!write_file(out_path, *output)) {
+            std::cerr << CLI_RED << "Error: Failed to write output: " << out_path << CLI_RESET << std::endl;
             return std::nullopt;
         }
-        std::string filetype = ext_opt.value();
-        bool is_jpeg = (filetype == "jpg" || filetype == "jpeg");
-        bool skip_pixel_mode = is_jpeg;  // For JPEG: direct DCT, no stbi_load().
+        std::cout << CLI_GREEN << "Updated " << data.size() << " bytes at offset " << offset << " in " << out_path
+                  << "." << CLI_RESET << std::endl;
+        return out_path;
+    }
 
-        // Step 1: Attempt pixel loading (only for PNG).
-        struct StbiDeleter {
-            void operator()(byte* p) const noexcept { stbi_image_free(p); }
-        };
-        std::unique_ptr<byte, StbiDeleter> image_guard;  // RAII: auto-free.
+    std::optional<std::vector<byte>> PhotoHnS::png_update(const std::vector<byte>& file, uint64_t offset,
+                                                          const std::vector<byte>& data, const std::string& path)
+    {
         int32_t width = 0, height = 0, channels = 0;
-        byte* image = nullptr;
-        uint64_t img_bytes = 0;
-        bool is_loadable = false;
-
-        if (!skip_pixel_mode) {  // PNG: Load pixels.
-            image = stbi_load(path.c_str(), &width, &height, &channels, 0);
-            is_loadable = (image != nullptr);
-            if (is_loadable) {
-                image_guard.reset(image);
-                img_bytes = static_cast<uint64_t>(width) * height * channels;
-            }
-        } else {
-            is_loadable = false;  // For JPEG: Simulate fail, proceed to fallback.
+        void* pixels = nullptr;
+        const bool wide = load_samples(file, width, height, channels, pixels);
+        if (!pixels) {
+            std::cerr << CLI_RED << "Error: Failed to load image: " << path << " (stbi)." << CLI_RESET << std::endl;
+            return std::nullopt;
         }
+        auto free_image = [](void* p) noexcept { stbi_image_free(p); };
+        std::unique_ptr<void, decltype(free_image)> image_guard(pixels, free_image);
+        uint64_t samples = static_cast<uint64_t>(width) * height * channels;
 
-        if (!is_loadable) {
-            // Silent for JPEG (no cerr); error only for PNG (real fail).
-            if (!skip_pixel_mode) {
-                std::cerr << CLI_RED << "Error: Failed to load image: " << path << " (stbi)." << CLI_RESET << std::endl;
+        BitKernels::PixelFormat format{static_cast<uint32_t>(channels), wide ? 16u : 8u, false};
+        if (!this->read_png_meta(pixels, samples, format, path))
+            return std::nullopt;
+        const MetaData& meta = this->embed_data->meta;
+        const LsbMode mode = meta.lsb_mode;
+        const KernelMode kernel = this->options.kernel_mode;
+
+        if (meta.slot_order == SlotOrder::Sequential) {
+            // Stream bytes at fixed samples: the re-encrypted chunks replace the samples they occupy.
+            if (BitKernels::image_samples_needed(meta.write_size, mode, format) > samples) {
+                std::cerr << CLI_RED << "Error: Incomplete embedded stream in PNG: " << path << CLI_RESET << std::endl;
                 return std::nullopt;
             }
-            // For JPEG: Quietly skip (fallback will handle).
-        }
-
-        // Step 2: Extract metadata (from pixels if loaded).
-        MetaData extracted_meta{};  // Local for validation.
-        bool meta_from_pixels = false;
-        bool dct_fallback_used = false;  // Flag: fallback processed?
-        if (is_loadable && img_bytes >= sizeof(MetaData) * 8ULL) {
-            // LSB 1-bit from first bytes (MSB-first).
-            size_t meta_byte_size = sizeof(MetaData);
-            std::vector<byte> meta_bytes(meta_byte_size, 0);
-            size_t bit_pos = 0;
-            for (size_t i = 0; i < meta_byte_size * 8ULL; ++i) {
-                if (i >= img_bytes) break;  // Bounds-check.
-
-                byte bit = image[i] & 0x01;
-                size_t byte_idx = bit_pos / 8;
-                size_t bit_offset = bit_pos % 8;
-                meta_bytes[byte_idx] |= (bit << (7 - bit_offset));
-                ++bit_pos;
-            }
-
-            // Copy to extracted_meta.
-            std::memcpy(&extracted_meta, meta_bytes.data(), sizeof(MetaData));
-
-            // Validation: If PHOTO — use pixels.
-            if (extracted_meta.container == ContainerType::PHOTO) {
-                meta_from_pixels = true;
-                // Manual copy (operator= deleted due to const meta_size).
-                this->embed_data->meta.container = extracted_meta.container;
-                this->embed_data->meta.ext = extracted_meta.ext;
-                std::strncpy(this->embed_data->meta.filename, extracted_meta.filename, 63);
-                this->embed_data->meta.filename[63] = '\0';  // Ensure null-termination after copy.
-                this->embed_data->meta.write_size = extracted_meta.write_size;
-                this->embed_data->meta.lsb_mode = extracted_meta.lsb_mode;
-                // meta_size — const, ignore (always sizeof(MetaData)).
-            } else {
-                meta_from_pixels = false;
-                std::cerr << CLI_YELLOW << "Pixel metadata invalid (not PHOTO), trying JPEG DCT..." << CLI_RESET << std::endl;
-                image_guard.reset();  // Free pixels early.
-            }
-        } else if (!is_loadable) {
-            meta_from_pixels = false;  // For JPEG: fallback.
-        }
-
-        // Step 3: Fallback to DCT for JPEG (if not meta_from_pixels).
-        if (!meta_from_pixels) {
-            dct_fallback_used = true;
-            JpegDecompressRAII decompress;
-            FILE* infile = std::fopen(path.c_str(), "rb");
-            if (!infile) {
-                std::cerr << CLI_RED << "Error: Failed to open for JPEG fallback: " << path << CLI_RESET << std::endl;
+            auto read = [&](uint64_t at, uint64_t size) {
+                return BitKernels::image_extract_range(pixels, samples, format, META_STREAM_SIZE + at, size, mode, kernel);
+            };
+            auto write = [&](uint64_t at, const std::vector<byte>& bytes) {
+                return BitKernels::image_embed_range(pixels, samples, format, META_STREAM_SIZE + at, bytes, mode, kernel);
+            };
+            if (!this->patch_plain(read, write, offset, data))
                 return std::nullopt;
-            }
-            auto close_infile = [](FILE* f) { std::fclose(f); };
-            std::unique_ptr<FILE, decltype(close_infile)> infile_guard(infile, close_infile);
-
-            jpeg_stdio_src(&decompress.cinfo, infile);
-            if (jpeg_read_header(&decompress.cinfo, TRUE) == JPEG_SUSPENDED) {
-                std::cerr << CLI_RED << "Error: JPEG header suspended in fallback." << CLI_RESET << std::endl;
+        } else {
+            // Adaptive slots follow the cost map: patch the whole stream and place it again.
+            auto activity = CostMap::pixel_activity(pixels, width, height, format);
+            auto stream = activity ? BitKernels::image_extract_adaptive(pixels, samples, format, *activity,
+                                                                        meta.write_size, mode, kernel)
+                                   : std::nullopt;
+            if (!stream) {
+                std::cerr << CLI_RED << "Error: Incomplete embedded stream in PNG: " << path << CLI_RESET << std::endl;
                 return std::nullopt;
             }
-
-            jvirt_barray_ptr* coef_arrays = jpeg_read_coefficients(&decompress.cinfo);
-            if (!coef_arrays) {
-                std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients for fallback." << CLI_RESET << std::endl;
+            auto write = [&stream](uint64_t at, const std::vector<byte>& bytes) {
+                std::copy(bytes.begin(), bytes.end(), stream->begin() + static_cast<std::ptrdiff_t>(META_STREAM_SIZE + at));
+                return true;
+            };
+            if (!this->patch_plain(stream_slicer(*stream), write, offset, data) ||
+                !BitKernels::image_embed_adaptive(pixels, samples, format, *activity, *stream, mode, kernel))
                 return std::nullopt;
-            }
+        }
+
+        // Deflate has no random access: the raster is encoded again, only the rewritten samples differ.
+        auto encoded = encode_png(pixels, width, height, channels, wide);
+        if (!encoded)
+            std::cerr << CLI_RED << "Error: Failed to encode PNG: " << path << CLI_RESET << std::endl;
+        return encoded;
+    }
 
-            // Extract meta from DCT (1-bit LSB).
-            auto meta_dct_opt = this->dct_lsb_extract(coef_arrays, decompress.cinfo, sizeof(MetaData));
-            if (!meta_dct_opt || meta_dct_opt->size() != sizeof(MetaData)) {
-                std::cerr << CLI_RED << "Error: Failed to extract JPEG metadata from DCT." << CLI_RESET << std::endl;
-                jpeg_finish_decompress(&decompress.cinfo);
+    std::optional<std::vector<byte>> PhotoHnS::jpg_update(const std::vector<byte>& file, uint64_t offset,
+                                                          const std::vector<byte>& data, const std::string& path)
+    {
+        auto coefs = JpegCoefImage::decode(file);
+        if (!coefs) {
+            std::cerr << CLI_RED << "Error: Failed to read JPEG coefficients: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        if (!this->read_jpg_meta(*coefs))
+            return std::nullopt;
+        const MetaData& meta = this->embed_data->meta;
+        const KernelMode kernel = this->options.kernel_mode;
+        constexpr uint64_t per_block = DCTSIZE2 - 1;
+
+        std::vector<char> rows = coefs->mcu_rows_of(0, 0);
+        if (meta.slot_order == SlotOrder::Sequential) {
+            if (meta.write_size * 8ULL > coefs->ac_capacity_bits()) {
+                std::cerr << CLI_RED << "Error: Incomplete embedded stream in JPEG: " << path << CLI_RESET << std::endl;
                 return std::nullopt;
             }
-            std::memcpy(&this->embed_data->meta, meta_dct_opt->data(), sizeof(MetaData));
-
-            // Validate DCT meta.
-            if (this->embed_data->meta.container != ContainerType::PHOTO ||
-                this->embed_data->meta.ext != Extension::JPEG ||
-                this->embed_data->meta.write_size < sizeof(MetaData)) {
-                std::cerr << CLI_RED << "Error: Invalid JPEG metadata from DCT." << CLI_RESET << std::endl;
-                jpeg_finish_decompress(&decompress.cinfo);
+            auto read = [&](uint64_t at, uint64_t size) {
+                return BitKernels::dct_extract_range(*coefs, META_STREAM_SIZE + at, size, kernel);
+            };
+            // Only the MCU rows of the blocks holding the rewritten bits are encoded again.
+            auto write = [&](uint64_t at, const std::vector<byte>& bytes) {
+                const uint64_t first_bit = (META_STREAM_SIZE + at) * 8ULL;
+                const uint64_t end_bit = first_bit + bytes.size() * 8ULL;
+                rows = coefs->mcu_rows_of(first_bit / per_block, (end_bit + per_block - 1) / per_block);
+                return BitKernels::dct_embed_range(*coefs, META_STREAM_SIZE + at, bytes, kernel);
+            };
+            if (!this->patch_plain(read, write, offset, data))
                 return std::nullopt;
-            }
-
-            // Full extraction from DCT.
-            uint64_t full_bytes = this->embed_data->meta.write_size;
-            auto full_dct_opt = this->dct_lsb_extract(coef_arrays, decompress.cinfo, full_bytes);
-            if (!full_dct_opt || full_dct_opt->size() != full_bytes) {
-                std::cerr << CLI_RED << "Error: Incomplete full extraction from JPEG DCT." << CLI_RESET << std::endl;
-                jpeg_finish_decompress(&decompress.cinfo);
+        } else {
+            // Adaptive slots follow the block activity: patch the whole stream and place it again.
+            auto activity = CostMap::block_activity(*coefs);
+            auto stream = activity ? BitKernels::dct_extract_adaptive(*coefs, *activity, meta.write_size, kernel)
+                                   : std::nullopt;
+            if (!stream) {
+                std::cerr << CLI_RED << "Error: Incomplete embedded stream in JPEG: " << path << CLI_RESET << std::endl;
                 return std::nullopt;
             }
-
-            // Encrypt_data (skip meta).
-            uint64_t encrypt_bytes = full_bytes - sizeof(MetaData);
-            std::vector<byte> encrypt_data(full_dct_opt->begin() + sizeof(MetaData), full_dct_opt->end());
-            this->embed_data->encrypt_data = std::move(encrypt_data);
-
-            jpeg_finish_decompress(&decompress.cinfo);
-
-            // Decrypt (key already set).
-            AES256Encryption::getInstance().set_key(this->embed_data->key);
-            this->embed_data->plain_data = AES256Encryption::getInstance().decrypt(this->embed_data->encrypt_data);
-
-            std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from JPEG DCT." << CLI_RESET << std::endl;
-            return this->embed_data->plain_data;
-        }
-
-        // Step 4: Meta valid from pixels — branch by ext (switch for symmetry).
-        if (dct_fallback_used) {
-            return this->embed_data->plain_data;  // Fallback already processed.
-        }
-        std::optional<std::string> result;
-        switch (this->embed_data->meta.ext) {
-            case Extension::PNG:
-                result = png_out(image, this->embed_data->meta, path);
-                break;
-            case Extension::JPEG:
-                // Rare case: JPEG with valid pixel meta — fallback to DCT.
-                std::cerr << CLI_YELLOW << "Warning: JPEG detected via pixels; using DCT fallback." << CLI_RESET << std::endl;
-                image_guard.reset();
-                result = jpg_out(path);
-                break;
-            default:
-                std::cerr << CLI_YELLOW << "Warning: Unsupported extension in metadata." << CLI_RESET << std::endl;
+            auto write = [&stream](uint64_t at, const std::vector<byte>& bytes) {
+                std::copy(bytes.begin(), bytes.end(), stream->begin() + static_cast<std::ptrdiff_t>(META_STREAM_SIZE + at));
+                return true;
+            };
+            if (!this->patch_plain(stream_slicer(*stream), write, offset, data) ||
+                !BitKernels::dct_embed_adaptive(*coefs, *activity, *stream, kernel))
                 return std::nullopt;
+            rows = coefs->mcu_rows_of(0, coefs->ac_capacity_bits() / per_block);
         }
 
-        if (!result.has_value()) {
-            return std::nullopt;
+        // Restart intervals without rewritten rows keep their entropy-coded bytes.
+        auto encoded = coefs->encode_rows(file, rows);
+        if (!encoded) {
+            std::cout << CLI_YELLOW << "JPEG rows can't be spliced (foreign encoder): encoding every row." << CLI_RESET << std::endl;
+            encoded = coefs->encode();
         }
+        if (!encoded)
+            std::cerr << CLI_RED << "Error: Failed to encode JPEG: " << path << CLI_RESET << std::endl;
+        return encoded;
+    }
 
-        // Step 5: Decrypt (for PNG, key already set).
-        AES256Encryption::getInstance().set_key(this->embed_data->key);
-        this->embed_data->plain_data = AES256Encryption::getInstance().decrypt(this->embed_data->encrypt_data);
 
-        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from PNG pixels." << CLI_RESET << std::endl;
-        return this->embed_data->plain_data;
+    void PhotoHnS::inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const
+    {
+        if (RawHnS::supports(format)) {
+            RawHnS().inspect(file, size, format, report);
+            return;
+        }
+        if (format == Extension::PNG)
+            probe_png(file, size, report);
+        else if (format == Extension::JPEG)
+            probe_jpeg(std::vector<byte>(file, file + size), report);  // JpegCoefImage decodes from a vector
+        else
+            HnS::inspect(file, size, format, report);
     }
-
 } // Yps
\ No newline at end of file
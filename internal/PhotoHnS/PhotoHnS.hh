@@ -5,126 +5,182 @@
 #include <HnS.hh>
 #include <EmbedData.hh>
 #include <Encryption.hh>
-#include <jpeglib.h>  // libjpeg-turbo
+#include <JpegCoefImage/JpegCoefImage.hh>
+#include <BitKernels/BitKernels.hh>
+#include <CarrierCache/CarrierCache.hh>
 #include <array>
 #include <algorithm>  // Для std::clamp
-#include <iomanip>    // Для std::hex в debug
 
 namespace Yps
 {
-    // RAII для jpeg_decompress_struct (авто-cleanup).
-    class JpegDecompressRAII {
-    public:
-        jpeg_decompress_struct cinfo;
-        jpeg_error_mgr jerr;
-        explicit JpegDecompressRAII() noexcept {
-            jpeg_create_decompress(&cinfo);
-            cinfo.err = jpeg_std_error(&jerr);
-        }
-        ~JpegDecompressRAII() noexcept { jpeg_destroy_decompress(&cinfo); }
-        JpegDecompressRAII(const JpegDecompressRAII&) = delete;
-        JpegDecompressRAII& operator=(const JpegDecompressRAII&) = delete;
-    };
-
-    // RAII для jpeg_compress_struct.
-    class JpegCompressRAII {
-    public:
-        jpeg_compress_struct cinfo;
-        jpeg_error_mgr jerr;
-        explicit JpegCompressRAII() noexcept {
-            jpeg_create_compress(&cinfo);
-            cinfo.err = jpeg_std_error(&jerr);
-        }
-        ~JpegCompressRAII() noexcept { jpeg_destroy_compress(&cinfo); }
-        JpegCompressRAII(const JpegCompressRAII&) = delete;
-        JpegCompressRAII& operator=(const JpegCompressRAII&) = delete;
-    };
-
     class PhotoHnS : public HnS
     {
     private:
         /**
-         * Проверка альфа-канала в PNG: Полная непрозрачность (255) для встраивания без артефактов.
-         * @param image Сырые байты изображения.
-         * @param width/height/ channels Размеры.
-         * @return true, если альфа usable (все 255).
+         * Общая часть embed/embed_memory: метаданные, ключ, шифрование, ECC, затем png_in/jpg_in.
+         * @param data Данные для скрытия.
+         * @param carrier Файл-контейнер в памяти.
+         * @param format PNG или JPEG (по сигнатуре).
+         * @param name Имя контейнера (в метаданные и логи).
+         * @param out_name Имя результата (логи).
+         * @return байты результата или nullopt.
+         */
+        std::optional<std::vector<byte>> embed_carrier(const std::vector<byte>& data, const std::vector<byte>& carrier,
+                                                       Extension format, const std::string& name,
+                                                       const std::string& out_name);
+
+        /**
+         * Общая часть extract/extract_memory для PNG/JPEG с LSB в сэмплах/коэффициентах.
+         * @param file Файл в памяти.
+         * @param format PNG или JPEG (по сигнатуре).
+         * @param path Для логов.
+         * @return plain_data или nullopt.
+         */
+        std::optional<std::vector<byte>> extract_carrier(const std::vector<byte>& file, Extension format,
+                                                         const std::string& path);
+
+        /**
+         * Декодирование PNG из памяти с сохранением глубины (stbi_load_16_from_memory для 16 бит).
+         * @param file Файл в памяти.
+         * @param width/height/channels Размеры.
+         * @param pixels Сэмплы (stbi_image_free) или nullptr при ошибке.
+         * @return true, если сэмплы 16-битные.
          */
-        static bool has_usable_alpha(const byte* image, int32_t width, int32_t height, int32_t channels);
+        static bool load_samples(const std::vector<byte>& file, int32_t& width, int32_t& height, int32_t& channels,
+                                 void*& pixels);
 
         /**
-         * Embed в PNG: LSB в пикселях (1/2 бита на байт).
-         * @param out_path Выходной файл.
-         * @return out_path или nullopt (fail).
+         * Декодирование PNG для CarrierCache: сэмплы (load_samples) в собственном буфере и их ImageStats.
+         * @param file Файл в памяти.
+         * @return декодированный контейнер или nullopt.
          */
-        std::optional<std::string> png_in(const std::string& out_path);
+        static std::optional<DecodedCarrier> decode_png(const std::vector<byte>& file);
 
         /**
-         * Extract из PNG: LSB из пикселей.
-         * @param image Загруженные байты (stb).
+         * Embed в PNG: LSB в сэмплах (1/2 бита на сэмпл).
+         * 8-битные PNG декодируются в 8 бит, 16-битные — с сохранением глубины 16 бит.
+         * @param carrier PNG в памяти.
+         * @param out_path Имя результата (логи).
+         * @return PNG-файл результата или nullopt (fail).
+         */
+        std::optional<std::vector<byte>> png_in(const std::vector<byte>& carrier, const std::string& out_path);
+
+        /**
+         * Extract из PNG: LSB из сэмплов (последовательно или по карте стоимости, см. meta.slot_order).
+         * @param image Загруженные сэмплы (stb).
+         * @param width/height Размеры (bounds, карта стоимости).
+         * @param format Каналы, глубина, skip_alpha из meta.
          * @param meta Извлечённые метаданные.
          * @param path Для логов.
          * @return path или nullopt.
          */
-        std::optional<std::string> png_out(byte* image, MetaData& meta, const std::string& path);
+        std::optional<std::string> png_out(const void* image, int32_t width, int32_t height,
+                                           const BitKernels::PixelFormat& format, MetaData& meta,
+                                           const std::string& path);
 
         /**
-         * Embed в JPEG: LSB в AC-DCT-коэффициентах (low-freq, robust to re-compress).
-         * @param out_path Выходной файл.
-         * @return out_path или nullopt.
+         * Кодирование 16-битного PNG (stbi_write_png пишет только 8 бит): те же фильтры и deflate, что в stb.
+         * @param width/height/channels Размеры (channels 1..4).
+         * @param samples Сэмплы в нативном порядке байт.
+         * @return PNG-файл или nullopt, если кодирование не удалось.
          */
-        std::optional<std::string> jpg_in(const std::string& out_path);
+        static std::optional<std::vector<byte>> encode_png16(int32_t width, int32_t height, int32_t channels,
+                                                             const uint16_t* samples);
 
         /**
-         * Extract из JPEG: LSB из AC-DCT-коэффициентов.
-         * @param path Входной файл (direct DCT-access).
-         * @return path или nullopt.
+         * Кодирование сэмплов в PNG исходной глубины (stb для 8 бит, encode_png16 для 16 бит).
+         * @param pixels Сэмплы.
+         * @param width/height/channels Размеры.
+         * @param wide true для 16-битных сэмплов.
+         * @return PNG-файл или nullopt.
+         */
+        static std::optional<std::vector<byte>> encode_png(const void* pixels, int32_t width, int32_t height,
+                                                           int32_t channels, bool wide);
+
+        /**
+         * Метаданные из PNG-сэмплов (1 бит, первые неальфа-сэмплы) в embed_data->meta с проверкой.
+         * @param pixels Сэмплы (stb).
+         * @param samples Число сэмплов.
+         * @param format Каналы и глубина; skip_alpha берётся из метаданных.
+         * @param path Для логов.
+         * @return false, если валидных метаданных нет.
+         */
+        bool read_png_meta(const void* pixels, uint64_t samples, BitKernels::PixelFormat& format,
+                           const std::string& path);
+
+        /**
+         * Метаданные из первых AC-коэффициентов JPEG в embed_data->meta с проверкой.
+         * @param coefs Коэффициенты.
+         * @return false, если валидных метаданных нет.
+         */
+        bool read_jpg_meta(const JpegCoefImage& coefs);
+
+        /**
+         * Update PNG: перешифрованные чанки пишутся только в свои сэмплы (SlotOrder::Sequential), затем
+         * повторное кодирование (deflate не допускает частичной записи).
+         * @param file PNG в памяти.
+         * @param offset Первый байт plain-данных.
+         * @param data Новые байты.
+         * @param path Для логов.
+         * @return PNG-файл результата или nullopt.
+         */
+        std::optional<std::vector<byte>> png_update(const std::vector<byte>& file, uint64_t offset,
+                                                    const std::vector<byte>& data, const std::string& path);
+
+        /**
+         * Update JPEG: перешифрованные чанки пишутся только в свои AC-коэффициенты, заново кодируются только
+         * затронутые MCU-строки (restart-интервалы остальных копируются из файла).
+         * @param file JPEG в памяти.
+         * @param offset Первый байт plain-данных.
+         * @param data Новые байты.
+         * @param path Для логов.
+         * @return JPEG-файл результата или nullopt.
          */
-        std::optional<std::string> jpg_out(const std::string& path);
+        std::optional<std::vector<byte>> jpg_update(const std::vector<byte>& file, uint64_t offset,
+                                                    const std::vector<byte>& data, const std::string& path);
 
         /**
-         * LSB 1-бит на байт изображения (MSB-first, для PNG pixels).
-         * @param image Модифицируется in-place.
-         * @param data Данные для embed (const-ref).
-         * @param img_bytes Общий размер для bounds.
+         * Печать EmbedReport (options.quality_report) после embed.
+         * @param quality PSNR/SSIM/доля изменённых DCT/размер.
          */
-        void lsb_one_bit(byte* image, const std::vector<byte>& data, uint64_t img_bytes);
+        static void print_report(const EmbedReport& quality);
 
         /**
-         * LSB 2-бита на байт (meta в 1-bit, остальное 2-bit; для PNG ёмкости).
-         * @param image Модифицируется in-place.
-         * @param data Данные.
-         * @param img_bytes Bounds.
+         * Embed в JPEG: LSB в AC-DCT-коэффициентах (low-freq, robust to re-compress).
+         * @param carrier JPEG в памяти.
+         * @param out_path Имя результата (логи).
+         * @return JPEG-файл результата или nullopt.
          */
-        void lsb_two_bit(byte* image, const std::vector<byte>& data, uint64_t img_bytes);
+        std::optional<std::vector<byte>> jpg_in(const std::vector<byte>& carrier, const std::string& out_path);
 
         /**
-         * DCT-LSB embed: 1-бит в low-freq AC-коэффициентах (skip DC).
-         * @param coef_arrays DCT-блоки (jvirt_barray_ptr*).
-         * @param cinfo Decompress info (для loops).
-         * @param data Данные (meta + encrypt).
+         * Extract из JPEG: LSB из AC-DCT-коэффициентов.
+         * @param file JPEG в памяти (direct DCT-access).
+         * @param path Для логов.
+         * @return path или nullopt.
          */
-        void dct_lsb_embed(jvirt_barray_ptr* coef_arrays, const jpeg_decompress_struct& cinfo,
-                           const std::vector<byte>& data);
+        std::optional<std::string> jpg_out(const std::vector<byte>& file, const std::string& path);
+
+        std::string carrier_path;               // Имя контейнера текущего embed (логи).
 
         /**
-         * DCT-LSB extract: 1-бит из AC-коэффициентов (MSB-first).
-         * @param coef_arrays DCT-блоки.
-         * @param cinfo Decompress info.
-         * @param data_bytes Ожидаемый размер (meta + encrypt).
-         * @return full_data или nullopt (incomplete).
+         * Запрос extract_query: png_out/jpg_out отвечают на него вместо полного extract.
          */
-        std::optional<std::vector<byte>> dct_lsb_extract(jvirt_barray_ptr* coef_arrays,
-                                                        const jpeg_decompress_struct& cinfo,
-                                                        uint64_t data_bytes) const;
+        const PlainQuery* query{nullptr};
 
-        std::unique_ptr<EmbedData> embed_data;  // Контекст: plain/encrypt/meta/key.
+        /**
+         * plain_data из coded-потока: весь (decode_payload) или результат query (open_plain).
+         * @param read Чтение coded-потока из контейнера.
+         * @return false при ошибке.
+         */
+        bool decode_stream(const StreamReader& read);
 
     public:
         ~PhotoHnS() = default;
         PhotoHnS() = default;
 
         /**
-         * Embed данных в фото (PNG/JPEG auto-detect).
+         * Embed данных в фото (PNG/JPEG/PPM/PGM/BMP/TGA по сигнатуре файла).
          * @param data Данные для скрытия.
          * @param path Входное фото.
          * @param out_path Выходное (модифицированное).
@@ -134,11 +190,62 @@ namespace Yps
                                          const std::string& out_path) override;
 
         /**
-         * Extract данных из фото (PNG/JPEG по meta).
+         * Extract данных из фото (формат по сигнатуре, один разбор файла).
          * @param path Файл с embedded данными.
          * @return plain_data или nullopt (fail: no meta/invalid).
          */
         std::optional<std::vector<byte>> extract(const std::string& path) override;
+
+        /**
+         * Запрос к частям данных (HnS::extract_query): контейнер декодируется один раз, PNG/JPEG собирают биты
+         * только нужных групп/коэффициентов (при SlotOrder::Sequential), RAW-форматы читают только нужные байты
+         * отображённого файла; Placement::Segment — через полный extract.
+         * @param path Файл с embedded данными.
+         * @param query Запрос (диапазоны, индекс записей).
+         * @return результат запроса или nullopt.
+         */
+        std::optional<std::vector<byte>> extract_query(const std::string& path, const PlainQuery& query) override;
+
+        /**
+         * Частичное обновление скрытых данных (HnS::update): перешифровываются только чанки диапазона, в контейнере
+         * меняются только их сэмплы/коэффициенты; JPEG заново кодирует лишь затронутые MCU-строки, RAW-форматы
+         * правят байты отображённого файла. Нужны чанки без ECC; Placement::Segment не поддерживается.
+         * @param path Файл с embedded данными.
+         * @param offset Первый байт plain-данных.
+         * @param data Новые байты (размер данных не меняется).
+         * @param out_path Выходной файл (может совпадать с path).
+         * @return out_path или nullopt.
+         */
+        std::optional<std::string> update(const std::string& path, uint64_t offset, const std::vector<byte>& data,
+                                          const std::string& out_path) override;
+
+        /**
+         * Проба контейнера в памяти (HnS::inspect): PNG — сэмплы, JPEG — DCT-коэффициенты (только OneBit),
+         * RAW-форматы — через RawHnS. Геометрия, ёмкость и наличие наших метаданных без ключа.
+         * @param file Файл целиком (в памяти или отображённый).
+         * @param size Размер файла.
+         * @param format Формат по сигнатуре.
+         * @param report Отчёт (error, если размер контейнера не определить).
+         */
+        void inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const override;
+
+        /**
+         * Embed без файлов: PNG/JPEG в памяти -> PNG/JPEG в памяти (LSB в сэмплах/коэффициентах;
+         * Placement::Segment и RAW-форматы — только через embed()). Для пакетных конвейеров с асинхронным I/O.
+         * @param data Данные для скрытия.
+         * @param carrier Файл-контейнер в памяти.
+         * @param name Имя контейнера (в метаданные и логи).
+         * @return файл результата или nullopt.
+         */
+        std::optional<std::vector<byte>> embed_memory(const std::vector<byte>& data, const std::vector<byte>& carrier,
+                                                      const std::string& name);
+
+        /**
+         * Extract без файлов (PNG/JPEG, LSB в сэмплах/коэффициентах).
+         * @param file Файл в памяти.
+         * @return plain_data или nullopt.
+         */
+        std::optional<std::vector<byte>> extract_memory(const std::vector<byte>& file);
     };
 } // Yps
 
@@ -0,0 +1,87 @@
+#include "Probe.hh"
+
+#include <HnS.hh>
+#include <MappedFile/MappedFile.hh>
+#include <Registry/Registry.hh>
+#include <SegmentHnS/SegmentHnS.hh>
+
+#include <algorithm>
+#include <cstring>   // For std::memchr
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr uint64_t AES_BLOCK = 16;  // AES-256-CBC: IV + PKCS#7 padded blocks
+
+        /**
+         * Container type extract expects for a carrier format
+         */
+        ContainerType container_of(Extension ext)
+        {
+            switch (ext) {
+                case Extension::WAV:
+                    return ContainerType::AUDIO;
+                case Extension::Y4M:
+                    return ContainerType::VIDEO;
+                default:
+                    return ContainerType::PHOTO;
+            }
+        }
+    }
+
+    uint64_t Probe::payload_capacity(uint64_t stream_bytes)
+    {
+        // Ciphertext = IV + (plain / 16 + 1) blocks.
+        if (stream_bytes < META_STREAM_SIZE + 2 * AES_BLOCK)
+            return 0;
+        const uint64_t blocks = (stream_bytes - META_STREAM_SIZE) / AES_BLOCK - 1;
+        return blocks * AES_BLOCK - 1;
+    }
+
+    bool Probe::plausible_meta(const std::optional<std::vector<byte>>& bytes, Extension ext)
+    {
+        if (!bytes || bytes->size() != META_STREAM_SIZE)
+            return false;
+        MetaData meta{};
+        return HnS::unpack_meta(bytes->data(), meta, true) && meta.container == container_of(ext) && meta.ext == ext &&
+               meta.write_size >= META_STREAM_SIZE &&
+               (meta.lsb_mode == LsbMode::OneBit || meta.lsb_mode == LsbMode::TwoBits) &&
+               meta.slot_order <= SlotOrder::Adaptive &&
+               std::memchr(meta.filename, '\0', sizeof(meta.filename)) != nullptr;
+    }
+
+    ProbeReport Probe::inspect(const byte* file, uint64_t size)
+    {
+        ProbeReport report;
+        report.format = HnS::sniff_format(file, std::min<uint64_t>(size, HnS::SNIFF_BYTES));
+        if (!report.format) {
+            report.error = "unknown format";
+            return report;
+        }
+        // The backend that embeds a format also sizes it.
+        if (auto backend = BackendRegistry::getInstance().create(*report.format))
+            backend->inspect(file, size, *report.format, report);
+        else
+            report.error = "unsupported format";
+        if (SegmentHnS::supports(*report.format))
+            report.has_segments = SegmentHnS::has_segments(file, size);
+        return report;
+    }
+
+    ProbeReport Probe::inspect(const std::vector<byte>& file)
+    {
+        return inspect(file.data(), file.size());
+    }
+
+    ProbeReport Probe::inspect_file(const std::string& path)
+    {
+        auto mapping = MappedFile::open(path, false);
+        if (!mapping) {
+            ProbeReport report;
+            report.error = "read failed";
+            return report;
+        }
+        return inspect(mapping->data(), mapping->size());
+    }
+} // Yps
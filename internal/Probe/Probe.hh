@@ -0,0 +1,99 @@
+#ifndef YPSHNS_PROBE_HH
+#define YPSHNS_PROBE_HH
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+
+namespace Yps
+{
+    /**
+     * What a carrier is and how much it can hold
+     */
+    struct ProbeReport
+    {
+        std::optional<Extension> format;
+
+        /**
+         * Carrier geometry (PNG/raw bitmaps: pixels; JPEG: pixels of the first component, channels = components;
+         * Y4M: frame size; WAV: channels and sample width only)
+         */
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t channels{};
+        uint32_t bits_per_sample{};
+
+        /**
+         * Largest plain payload per LsbMode (OneBit, TwoBits) with default options: sequential slots,
+         * AES-256-CBC, no ECC. JPEG and Y4M have OneBit only.
+         */
+        std::array<uint64_t, 2> capacity{};
+
+        /**
+         * YpsHnS metadata found in samples/coefficients (plaintext header, no key needed)
+         */
+        bool has_payload{false};
+
+        /**
+         * YpsHnS PNG chunks / JPEG APP15 segments
+         */
+        bool has_segments{false};
+
+        /**
+         * Non-empty if the file could not be probed (unknown or unsupported format, decode failed)
+         */
+        std::string error;
+    };
+
+    /**
+     * Carrier inspection without embedding: format by magic bytes, geometry, capacity and
+     * presence of our own headers. Each format is sized by its BackendRegistry backend (HnS::inspect);
+     * formats without one are reported as unsupported.
+     */
+    class Probe
+    {
+    public:
+        /**
+         * @param file Whole carrier in memory (or mapped)
+         * @param size Carrier bytes
+         * @return report (error set if not probed)
+         */
+        static ProbeReport inspect(const byte* file, uint64_t size);
+
+        /**
+         * @param file Whole carrier in memory
+         * @return report (error set if not probed)
+         */
+        static ProbeReport inspect(const std::vector<byte>& file);
+
+        /**
+         * Probe a file through a read-only mapping: WAV, Y4M and raw bitmaps fault in only their headers
+         * and first samples, PNG/JPEG are decoded whole.
+         * @param path Path to carrier
+         * @return report (error "read failed" if the file can't be mapped)
+         */
+        static ProbeReport inspect_file(const std::string& path);
+
+        /**
+         * Plain payload that fits a stream of stream_bytes (metadata included) with default options.
+         * @param stream_bytes Embeddable bytes
+         * @return payload bytes (0 if not even the metadata fits)
+         */
+        static uint64_t payload_capacity(uint64_t stream_bytes);
+
+        /**
+         * Checks of a plaintext YpsHnS header, as extract does before decoding anything.
+         * @param bytes META_STREAM_SIZE bytes read from the carrier
+         * @param ext Carrier format
+         * @return true, if the header is plausible
+         */
+        static bool plausible_meta(const std::optional<std::vector<byte>>& bytes, Extension ext);
+    };
+} // Yps
+
+#endif //YPSHNS_PROBE_HH
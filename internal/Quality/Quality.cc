@@ -0,0 +1,217 @@
+#include "Quality.hh"
+
+#include <Parallel/Parallel.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t MIN_PIXELS = 64 * 1024;
+        constexpr size_t MIN_BLOCKS = 4 * 1024;
+
+        /**
+         * Running totals of the comparison (merged under mutex)
+         */
+        struct Totals
+        {
+            std::mutex mutex;
+            double ssim_sum{};
+            uint64_t windows{};
+            double squared_error{};
+            uint64_t samples{};
+            uint64_t changed{};
+
+            void add(double ssim_sum, uint64_t windows, double squared_error, uint64_t samples, uint64_t changed)
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->ssim_sum += ssim_sum;
+                this->windows += windows;
+                this->squared_error += squared_error;
+                this->samples += samples;
+                this->changed += changed;
+            }
+        };
+
+        /**
+         * SSIM of one window from its moments (population variance), stabilized by c1/c2.
+         */
+        inline double window_ssim(double mean_a, double mean_b, double var_a, double var_b, double cov,
+                                  double c1, double c2)
+        {
+            return ((2 * mean_a * mean_b + c1) * (2 * cov + c2)) /
+                   ((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+        }
+
+        /**
+         * Tile rows [tile_begin, tile_end): per row of pixels, sums of every tile column and colour channel
+         * are accumulated into contiguous arrays, then turned into SSIM and squared error every TILE rows.
+         */
+        template <uint32_t Channels, typename Sample>
+        void tile_rows(const Sample* a, const Sample* b, uint32_t width, uint32_t height, size_t tile_begin,
+                       size_t tile_end, double peak, Totals& totals)
+        {
+            constexpr uint32_t colour = (Channels == 2 || Channels == 4) ? Channels - 1 : Channels;
+            constexpr uint32_t T = Quality::TILE;
+            const double c1 = (0.01 * peak) * (0.01 * peak), c2 = (0.03 * peak) * (0.03 * peak);
+            const uint32_t tiles_x = (width + T - 1) / T;
+
+            // Sums per (tile column, channel): a, b, a^2, b^2, ab. 16-bit squares fit 64 bits for 64 pixels.
+            std::vector<uint64_t> sa(tiles_x * colour), sb(sa.size()), saa(sa.size()), sbb(sa.size()), sab(sa.size());
+            double ssim_sum = 0, squared_error = 0;
+            uint64_t windows = 0;
+
+            for (size_t ty = tile_begin; ty < tile_end; ++ty) {
+                std::fill(sa.begin(), sa.end(), 0); std::fill(sb.begin(), sb.end(), 0);
+                std::fill(saa.begin(), saa.end(), 0); std::fill(sbb.begin(), sbb.end(), 0);
+                std::fill(sab.begin(), sab.end(), 0);
+
+                const size_t y_end = std::min<size_t>((ty + 1) * T, height);
+                for (size_t y = ty * T; y < y_end; ++y) {
+                    const Sample* pa = a + y * width * Channels;
+                    const Sample* pb = b + y * width * Channels;
+                    for (uint32_t tx = 0; tx < tiles_x; ++tx) {
+                        const uint32_t x_end = std::min(width, (tx + 1) * T);
+                        for (uint32_t c = 0; c < colour; ++c) {
+                            uint64_t s_a = 0, s_b = 0, s_aa = 0, s_bb = 0, s_ab = 0;  // Locals: no aliasing with samples
+                            for (uint32_t x = tx * T; x < x_end; ++x) {
+                                const uint64_t va = pa[x * Channels + c], vb = pb[x * Channels + c];
+                                s_a += va;
+                                s_b += vb;
+                                s_aa += va * va;
+                                s_bb += vb * vb;
+                                s_ab += va * vb;
+                            }
+                            const size_t i = tx * colour + c;
+                            sa[i] += s_a; sb[i] += s_b; saa[i] += s_aa; sbb[i] += s_bb; sab[i] += s_ab;
+                        }
+                    }
+                }
+
+                const uint32_t rows = static_cast<uint32_t>(y_end - ty * T);
+                for (uint32_t tx = 0; tx < tiles_x; ++tx) {
+                    const uint32_t cols = std::min(T, width - tx * T);
+                    const double n = static_cast<double>(rows) * cols;
+                    for (uint32_t c = 0; c < colour; ++c) {
+                        const size_t i = tx * colour + c;
+                        // sum (a - b)^2 = sum a^2 + sum b^2 - 2 sum ab, exact in modular arithmetic.
+                        squared_error += static_cast<double>(saa[i] + sbb[i] - 2 * sab[i]);
+                        const double mean_a = sa[i] / n, mean_b = sb[i] / n;
+                        ssim_sum += window_ssim(mean_a, mean_b, saa[i] / n - mean_a * mean_a,
+                                                sbb[i] / n - mean_b * mean_b, sab[i] / n - mean_a * mean_b, c1, c2);
+                        ++windows;
+                    }
+                }
+            }
+
+            const uint64_t samples = static_cast<uint64_t>(std::min<size_t>(tile_end * T, height) - tile_begin * T) *
+                                     width * colour;
+            totals.add(ssim_sum, windows, squared_error, samples, 0);
+        }
+
+        template <uint32_t Channels, typename Sample>
+        void compare_all(const void* original, const void* stego, uint32_t width, uint32_t height, double peak,
+                         Totals& totals)
+        {
+            const auto* a = static_cast<const Sample*>(original);
+            const auto* b = static_cast<const Sample*>(stego);
+            const size_t tiles_y = (height + Quality::TILE - 1) / Quality::TILE;
+            Parallel::parallel_for(tiles_y, [&](size_t begin, size_t end) {
+                tile_rows<Channels, Sample>(a, b, width, height, begin, end, peak, totals);
+            }, std::max<size_t>(1, MIN_PIXELS / (static_cast<size_t>(width) * Quality::TILE)));
+        }
+
+        template <typename Sample>
+        void dispatch(uint32_t channels, const void* original, const void* stego, uint32_t width, uint32_t height,
+                      double peak, Totals& totals)
+        {
+            switch (channels) {
+                case 1: compare_all<1, Sample>(original, stego, width, height, peak, totals); break;
+                case 2: compare_all<2, Sample>(original, stego, width, height, peak, totals); break;
+                case 3: compare_all<3, Sample>(original, stego, width, height, peak, totals); break;
+                case 4: compare_all<4, Sample>(original, stego, width, height, peak, totals); break;
+                default: break;
+            }
+        }
+    }
+
+    double Quality::psnr(double mse, double peak)
+    {
+        if (mse <= 0)
+            return std::numeric_limits<double>::infinity();
+        return 10.0 * std::log10(peak * peak / mse);
+    }
+
+    void Quality::compare_pixels(const void* original, const void* stego, uint32_t width, uint32_t height,
+                                 const BitKernels::PixelFormat& format, EmbedReport& report)
+    {
+        if (!original || !stego || width == 0 || height == 0 || format.channels < 1 || format.channels > 4 ||
+            (format.bits_per_sample != 8 && format.bits_per_sample != 16))
+            return;
+
+        const bool wide = format.bits_per_sample == 16;
+        const double peak = wide ? 65535.0 : 255.0;
+        Totals totals;
+        if (wide)
+            dispatch<uint16_t>(format.channels, original, stego, width, height, peak, totals);
+        else
+            dispatch<byte>(format.channels, original, stego, width, height, peak, totals);
+
+        report.psnr = psnr(totals.squared_error / static_cast<double>(totals.samples), peak);
+        report.ssim = totals.windows ? totals.ssim_sum / static_cast<double>(totals.windows) : 1.0;
+    }
+
+    void Quality::compare_dct(const JpegCoefImage& original, const JpegCoefImage& stego, EmbedReport& report)
+    {
+        if (original.components.size() != stego.components.size())
+            return;
+
+        // Orthonormal 8x8 DCT (JPEG scaling): sum of pixel^2 = sum of coef^2, block mean = DC / 8 (+128 level shift).
+        constexpr double peak = 255.0, n = DCTSIZE2;
+        const double c1 = (0.01 * peak) * (0.01 * peak), c2 = (0.03 * peak) * (0.03 * peak);
+        Totals totals;
+        for (size_t ci = 0; ci < original.components.size(); ++ci) {
+            const JpegComponentCoefs& ca = original.components[ci];
+            const JpegComponentCoefs& cb = stego.components[ci];
+            if (ca.coefs.size() != cb.coefs.size())
+                return;
+
+            std::array<double, DCTSIZE2> q{};
+            for (int k = 0; k < DCTSIZE2; ++k)
+                q[k] = ca.quant[k] ? ca.quant[k] : 1.0;
+
+            Parallel::parallel_for(static_cast<size_t>(ca.block_count()), [&](size_t begin, size_t end) {
+                double ssim_sum = 0, squared_error = 0;
+                uint64_t changed = 0;
+                for (size_t blk = begin; blk < end; ++blk) {
+                    const JCOEF* a = ca.coefs.data() + blk * DCTSIZE2;
+                    const JCOEF* b = cb.coefs.data() + blk * DCTSIZE2;
+                    double energy_a = 0, energy_b = 0, cross = 0, error = 0;
+                    for (int k = 1; k < DCTSIZE2; ++k) {
+                        const double va = a[k] * q[k], vb = b[k] * q[k];
+                        energy_a += va * va;
+                        energy_b += vb * vb;
+                        cross += va * vb;
+                        error += (va - vb) * (va - vb);
+                        changed += a[k] != b[k];
+                    }
+                    const double dc_a = a[0] * q[0], dc_b = b[0] * q[0];
+                    error += (dc_a - dc_b) * (dc_a - dc_b);
+                    squared_error += error;
+                    ssim_sum += window_ssim(dc_a / 8 + 128, dc_b / 8 + 128, energy_a / n, energy_b / n, cross / n, c1, c2);
+                }
+                totals.add(ssim_sum, end - begin, squared_error, (end - begin) * DCTSIZE2, changed);
+            }, MIN_BLOCKS);
+        }
+
+        report.psnr = psnr(totals.samples ? totals.squared_error / static_cast<double>(totals.samples) : 0.0, peak);
+        report.ssim = totals.windows ? totals.ssim_sum / static_cast<double>(totals.windows) : 1.0;
+        report.dct_change_ratio = totals.windows
+                                  ? static_cast<double>(totals.changed) / static_cast<double>(totals.windows * (DCTSIZE2 - 1))
+                                  : 0.0;
+    }
+} // Yps
@@ -0,0 +1,54 @@
+#ifndef YPSHNS_QUALITY_HH
+#define YPSHNS_QUALITY_HH
+
+#include <cstdint>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+#include <BitKernels/BitKernels.hh>
+#include <JpegCoefImage/JpegCoefImage.hh>
+
+namespace Yps
+{
+    /**
+     * In-memory carrier/stego comparison for EmbedReport. One pass over both buffers accumulates
+     * integer tile sums (sum a, b, a^2, b^2, ab) from which SSIM and the squared error follow;
+     * tile rows are processed in parallel. JPEG is measured in the DCT domain: the 8x8 DCT is
+     * orthonormal, so block mean, variance, covariance and squared error come straight from
+     * dequantized coefficients without decoding pixels.
+     */
+    class Quality
+    {
+    public:
+        /**
+         * Tile side in pixels (= DCTSIZE, so PNG and JPEG SSIM use the same windows)
+         */
+        static constexpr uint32_t TILE = 8;
+
+        /**
+         * PSNR and SSIM of colour channels (alpha excluded); edge tiles may be partial.
+         * @param original/stego Decoded samples of the same format and size (stb order, native-endian 16-bit)
+         * @param width/height Image size in pixels
+         * @param format Image format
+         * @param report Receives psnr and ssim
+         */
+        static void compare_pixels(const void* original, const void* stego, uint32_t width, uint32_t height,
+                                   const BitKernels::PixelFormat& format, EmbedReport& report);
+
+        /**
+         * PSNR, SSIM (per block) and DCT change ratio of two coefficient images with the same geometry.
+         * @param original/stego Quantized DCT blocks
+         * @param report Receives psnr, ssim and dct_change_ratio
+         */
+        static void compare_dct(const JpegCoefImage& original, const JpegCoefImage& stego, EmbedReport& report);
+
+        /**
+         * @param mse Mean squared error
+         * @param peak Largest sample value
+         * @return PSNR in dB (infinity if mse = 0)
+         */
+        static double psnr(double mse, double peak);
+    };
+} // Yps
+
+#endif //YPSHNS_QUALITY_HH
@@ -0,0 +1,200 @@
+#include "Random.hh"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t KEY_SIZE = 32;
+
+        /**
+         * Mode shared by all threads. epoch changes on every set_seed, so thread generators notice.
+         */
+        struct GlobalState
+        {
+            std::mutex mutex;
+            std::atomic<uint64_t> epoch{1};
+            bool deterministic{false};
+            uint64_t seed{};
+            uint64_t next_stream{};
+        };
+
+        GlobalState& global()
+        {
+            static GlobalState state;
+            return state;
+        }
+
+        int64_t current_pid()
+        {
+        #ifndef _WIN32
+            return static_cast<int64_t>(getpid());
+        #else
+            return 0;
+        #endif
+        }
+
+        class Generator
+        {
+        private:
+            EVP_CIPHER_CTX* ctx{nullptr};
+            std::array<byte, KEY_SIZE> key{};
+            std::array<byte, Random::BUFFER_SIZE> buffer{};
+            size_t position{Random::BUFFER_SIZE};
+            uint64_t since_reseed{0};
+            uint64_t epoch{0};
+            int64_t pid{-1};
+            bool deterministic{false};
+
+            void seed()
+            {
+                GlobalState& g = global();
+                std::lock_guard<std::mutex> lock(g.mutex);
+                this->epoch = g.epoch.load();
+                this->deterministic = g.deterministic;
+                if (this->deterministic) {
+                    byte material[2 * sizeof(uint64_t)];
+                    uint64_t stream = g.next_stream++;
+                    std::memcpy(material, &g.seed, sizeof(uint64_t));
+                    std::memcpy(material + sizeof(uint64_t), &stream, sizeof(uint64_t));
+                    SHA256(material, sizeof(material), this->key.data());
+                } else if (RAND_bytes(this->key.data(), static_cast<int32_t>(this->key.size())) != 1) {
+                    throw std::runtime_error("Random: failed to seed from OS");
+                }
+                this->pid = current_pid();
+                this->since_reseed = 0;
+                this->position = this->buffer.size();
+            }
+
+            /**
+             * Keystream of AES-256-CTR(key, 0); first KEY_SIZE bytes replace the key (forward secrecy).
+             */
+            void refill()
+            {
+                bool stale = this->epoch != global().epoch.load(std::memory_order_acquire);
+                bool forked = this->pid != current_pid();
+                bool worn = !this->deterministic && this->since_reseed >= Random::RESEED_INTERVAL;
+                if (stale || forked || worn)
+                    this->seed();
+
+                static const std::array<byte, Random::BUFFER_SIZE> zeros{};
+                static const std::array<byte, 16> iv{};
+                int32_t len = 0;
+                if (EVP_EncryptInit_ex(this->ctx, EVP_aes_256_ctr(), nullptr, this->key.data(), iv.data()) != 1 ||
+                    EVP_EncryptUpdate(this->ctx, this->buffer.data(), &len, zeros.data(),
+                                      static_cast<int32_t>(zeros.size())) != 1)
+                    throw std::runtime_error("Random: AES-CTR failed");
+
+                std::memcpy(this->key.data(), this->buffer.data(), KEY_SIZE);
+                OPENSSL_cleanse(this->buffer.data(), KEY_SIZE);
+                this->position = KEY_SIZE;
+            }
+
+        public:
+            Generator()
+            {
+                this->ctx = EVP_CIPHER_CTX_new();
+                if (!this->ctx)
+                    throw std::runtime_error("Random: EVP_CIPHER_CTX_new failed");
+            }
+
+            ~Generator()
+            {
+                EVP_CIPHER_CTX_free(this->ctx);
+                OPENSSL_cleanse(this->key.data(), this->key.size());
+                OPENSSL_cleanse(this->buffer.data(), this->buffer.size());
+            }
+
+            Generator(const Generator&) = delete;
+            Generator& operator=(const Generator&) = delete;
+
+            void fill(byte* out, size_t size)
+            {
+                // A mode switch or a fork must apply to the very next draw, not after the buffer drains:
+                // a child must never serve bytes its parent has buffered (and may serve too).
+                if (this->epoch != global().epoch.load(std::memory_order_acquire) || this->pid != current_pid()) {
+                    OPENSSL_cleanse(this->buffer.data(), this->buffer.size());
+                    this->position = this->buffer.size();
+                }
+
+                while (size > 0) {
+                    if (this->position == this->buffer.size())
+                        this->refill();
+                    size_t take = std::min(size, this->buffer.size() - this->position);
+                    std::memcpy(out, this->buffer.data() + this->position, take);
+                    OPENSSL_cleanse(this->buffer.data() + this->position, take);  // Served bytes are never reused
+                    this->position += take;
+                    this->since_reseed += take;
+                    out += take;
+                    size -= take;
+                }
+            }
+
+            void reset()
+            {
+                this->epoch = 0;
+                this->position = this->buffer.size();
+            }
+        };
+
+        Generator& thread_generator()
+        {
+            thread_local Generator generator;
+            return generator;
+        }
+    }
+
+
+    void Random::fill(byte* out, size_t size)
+    {
+        thread_generator().fill(out, size);
+    }
+
+    std::vector<byte> Random::bytes(size_t size)
+    {
+        std::vector<byte> out(size);
+        fill(out.data(), size);
+        return out;
+    }
+
+    uint64_t Random::next_u64()
+    {
+        uint64_t value = 0;
+        fill(reinterpret_cast<byte*>(&value), sizeof(value));
+        return value;
+    }
+
+    void Random::set_seed(std::optional<uint64_t> seed)
+    {
+        GlobalState& g = global();
+        std::lock_guard<std::mutex> lock(g.mutex);
+        g.deterministic = seed.has_value();
+        g.seed = seed.value_or(0);
+        g.next_stream = 0;
+        g.epoch.fetch_add(1, std::memory_order_release);
+    }
+
+    bool Random::is_deterministic()
+    {
+        GlobalState& g = global();
+        std::lock_guard<std::mutex> lock(g.mutex);
+        return g.deterministic;
+    }
+
+    void Random::reseed()
+    {
+        thread_generator().reset();
+    }
+} // Yps
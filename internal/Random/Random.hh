@@ -0,0 +1,82 @@
+#ifndef YPSHNS_RANDOM_HH
+#define YPSHNS_RANDOM_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Per-thread buffered CSPRNG for IVs, salts and embedding seeds.
+     * Each thread owns an AES-256-CTR generator (key erasure after every refill),
+     * seeded from the OS (RAND_bytes) and reseeded every RESEED_INTERVAL bytes or after fork.
+     * No lock is taken on the hot path.
+     *
+     * Deterministic mode (set_seed) replaces OS seeding with SHA256(seed, stream index):
+     * the n-th thread to draw after set_seed gets the n-th stream, so single-threaded
+     * tests and benchmarks are reproducible. Never use it for real payloads.
+     */
+    class Random
+    {
+    public:
+        /**
+         * Bytes generated per refill
+         */
+        static constexpr size_t BUFFER_SIZE = 4096;
+
+        /**
+         * Output bytes between OS reseeds
+         */
+        static constexpr uint64_t RESEED_INTERVAL = 1ULL << 20;
+
+        /**
+         * Fill buffer with random bytes
+         * @param out Destination
+         * @param size Number of bytes
+         * @throw std::runtime_error, if OS entropy or AES is unavailable
+         */
+        static void fill(byte* out, size_t size);
+
+        /**
+         * @param size Number of bytes
+         * @return vector with random bytes
+         */
+        static std::vector<byte> bytes(size_t size);
+
+        template <size_t N>
+        static std::array<byte, N> array()
+        {
+            std::array<byte, N> out{};
+            fill(out.data(), N);
+            return out;
+        }
+
+        /**
+         * @return random 64-bit value (e.g. permutation seed)
+         */
+        static uint64_t next_u64();
+
+        /**
+         * Switch all threads to deterministic streams (seed) or back to OS seeding (std::nullopt).
+         * Takes effect on each thread's next draw.
+         */
+        static void set_seed(std::optional<uint64_t> seed);
+
+        /**
+         * @return true, if deterministic mode is active
+         */
+        static bool is_deterministic();
+
+        /**
+         * Drop current thread's generator state (next draw reseeds)
+         */
+        static void reseed();
+    };
+} // Yps
+
+#endif //YPSHNS_RANDOM_HH
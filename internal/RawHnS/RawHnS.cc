@@ -0,0 +1,533 @@
+#include "RawHnS.hh"
+
+#include <BitKernels/BitKernels.hh>
+#include <MappedFile/MappedFile.hh>
+#include <Probe/Probe.hh>
+
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+namespace Yps
+{
+    namespace
+    {
+        uint32_t le16(const byte* p) { return p[0] | (static_cast<uint32_t>(p[1]) << 8); }
+
+        uint32_t le32(const byte* p)
+        { return le16(p) | (le16(p + 2) << 16); }
+
+        /**
+         * Next PNM header integer (skips whitespace and # comments).
+         */
+        std::optional<uint64_t> pnm_number(const byte* file, uint64_t size, uint64_t& pos)
+        {
+            while (pos < size) {
+                if (file[pos] == '#') {
+                    while (pos < size && file[pos] != '\n')
+                        ++pos;
+                } else if (std::isspace(file[pos])) {
+                    ++pos;
+                } else {
+                    break;
+                }
+            }
+            if (pos >= size || !std::isdigit(file[pos]))
+                return std::nullopt;
+            uint64_t value = 0;
+            while (pos < size && std::isdigit(file[pos]) && value < (1ULL << 32))
+                value = value * 10 + (file[pos++] - '0');
+            return value;
+        }
+    }
+
+    uint64_t RawHnS::RasterLayout::slots() const
+    {
+        uint64_t total = 0;
+        for (const auto& region : this->regions)
+            total += region.second / this->stride;
+        return total;
+    }
+
+    bool RawHnS::supports(Extension format)
+    {
+        return format == Extension::PPM || format == Extension::PGM || format == Extension::BMP ||
+               format == Extension::TGA;
+    }
+
+    std::optional<RawHnS::RasterLayout> RawHnS::parse_pnm(const byte* file, uint64_t size)
+    {
+        if (size < 3 || file[0] != 'P' || (file[1] != '6' && file[1] != '5'))
+            return std::nullopt;
+        uint64_t pos = 2;
+        auto width = pnm_number(file, size, pos);
+        auto height = pnm_number(file, size, pos);
+        auto maxval = pnm_number(file, size, pos);
+        // Exactly one whitespace byte separates maxval from the raster.
+        if (!width || !height || !maxval || *maxval == 0 || *maxval > 65535 || pos >= size || !std::isspace(file[pos]))
+            return std::nullopt;
+        ++pos;
+
+        RasterLayout layout;
+        layout.ext = file[1] == '6' ? Extension::PPM : Extension::PGM;
+        uint64_t channels = file[1] == '6' ? 3 : 1;
+        uint64_t sample_bytes = *maxval < 256 ? 1 : 2;
+        uint64_t raster = *width * *height * channels * sample_bytes;
+        if (raster == 0 || raster > size - pos)
+            return std::nullopt;
+        layout.regions.emplace_back(pos, raster);
+        if (sample_bytes == 2) {
+            layout.stride = 2;
+            layout.slot_offset = 1;  // Big-endian: low byte second
+        }
+        layout.width = static_cast<uint32_t>(*width);
+        layout.height = static_cast<uint32_t>(*height);
+        layout.channels = static_cast<uint32_t>(channels);
+        layout.bits_per_sample = static_cast<uint32_t>(sample_bytes * 8);
+        return layout;
+    }
+
+    std::optional<RawHnS::RasterLayout> RawHnS::parse_bmp(const byte* file, uint64_t size)
+    {
+        if (size < 54 || file[0] != 'B' || file[1] != 'M')
+            return std::nullopt;
+        uint64_t offset = le32(file + 10);
+        uint32_t dib_size = le32(file + 14);
+        auto width = static_cast<int32_t>(le32(file + 18));
+        auto height = static_cast<int32_t>(le32(file + 22));
+        uint32_t bit_count = le16(file + 28);
+        uint32_t compression = le32(file + 30);
+        bool supported = (bit_count == 24 && compression == 0) ||
+                         (bit_count == 32 && (compression == 0 || compression == 3));
+        if (dib_size < 40 || width <= 0 || height == 0 || !supported)
+            return std::nullopt;
+
+        uint64_t rows = static_cast<uint64_t>(height < 0 ? -static_cast<int64_t>(height) : height);
+        uint64_t row_bytes = static_cast<uint64_t>(width) * (bit_count / 8);
+        uint64_t row_stride = (row_bytes + 3) & ~3ULL;  // Rows padded to 4 bytes
+        if (offset > size || row_stride * rows > size - offset)
+            return std::nullopt;
+
+        RasterLayout layout;
+        layout.ext = Extension::BMP;
+        if (row_stride == row_bytes) {
+            layout.regions.emplace_back(offset, row_bytes * rows);
+        } else {
+            // Padding bytes are not pixels: skip them row by row.
+            layout.regions.reserve(static_cast<size_t>(rows));
+            for (uint64_t r = 0; r < rows; ++r)
+                layout.regions.emplace_back(offset + r * row_stride, row_bytes);
+        }
+        layout.width = static_cast<uint32_t>(width);
+        layout.height = static_cast<uint32_t>(rows);
+        layout.channels = bit_count / 8;
+        return layout;
+    }
+
+    std::optional<RawHnS::RasterLayout> RawHnS::parse_tga(const byte* file, uint64_t size)
+    {
+        if (size < 18)
+            return std::nullopt;
+        uint32_t id_length = file[0];
+        uint32_t colormap_type = file[1];
+        uint32_t image_type = file[2];
+        uint64_t width = le16(file + 12);
+        uint64_t height = le16(file + 14);
+        uint32_t depth = file[16];
+        bool supported = colormap_type == 0 &&
+                         ((image_type == 2 && (depth == 24 || depth == 32)) || (image_type == 3 && depth == 8));
+        if (!supported || width == 0 || height == 0)
+            return std::nullopt;
+
+        uint64_t offset = 18 + id_length;
+        uint64_t raster = width * height * (depth / 8);
+        if (offset > size || raster > size - offset)
+            return std::nullopt;
+
+        RasterLayout layout;
+        layout.ext = Extension::TGA;
+        layout.regions.emplace_back(offset, raster);
+        layout.width = static_cast<uint32_t>(width);
+        layout.height = static_cast<uint32_t>(height);
+        layout.channels = depth / 8;
+        return layout;
+    }
+
+    std::optional<RawHnS::RasterLayout> RawHnS::parse(const byte* file, uint64_t size, Extension format)
+    {
+        switch (format) {
+            case Extension::PPM:
+            case Extension::PGM:
+                return parse_pnm(file, size);
+            case Extension::BMP:
+                return parse_bmp(file, size);
+            case Extension::TGA:
+                return parse_tga(file, size);
+            default:
+                return std::nullopt;
+        }
+    }
+
+    bool RawHnS::process(byte* file, const RasterLayout& layout, byte* stream, uint64_t stream_bytes,
+                         LsbMode mode, bool embed) const
+    {
+        const uint64_t meta_bytes = std::min<uint64_t>(stream_bytes, META_STREAM_SIZE);
+        const uint64_t needed = BitKernels::slots_needed(stream_bytes, mode);
+        KernelMode kernel = this->options.kernel_mode;
+
+        auto run = [&](byte* base, size_t stride) {
+            byte* payload_base = base + meta_bytes * 8ULL * stride;
+            uint64_t payload_slots = needed - meta_bytes * 8ULL;
+            if (embed)
+                return BitKernels::strided_embed(base, meta_bytes * 8ULL, stride, stream, meta_bytes, LsbMode::OneBit, kernel) &&
+                       BitKernels::strided_embed(payload_base, payload_slots, stride, stream + meta_bytes,
+                                                 stream_bytes - meta_bytes, mode, kernel);
+            return BitKernels::strided_extract(base, meta_bytes * 8ULL, stride, stream, meta_bytes, LsbMode::OneBit, kernel) &&
+                   BitKernels::strided_extract(payload_base, payload_slots, stride, stream + meta_bytes,
+                                               stream_bytes - meta_bytes, mode, kernel);
+        };
+
+        if (layout.regions.size() == 1)
+            return run(file + layout.regions[0].first + layout.slot_offset, layout.stride);
+
+        // Padded BMP rows: gather the needed rows into one buffer, run, scatter back.
+        std::vector<byte> scratch(static_cast<size_t>(needed));
+        uint64_t filled = 0;
+        for (const auto& [offset, length] : layout.regions) {
+            if (filled == needed)
+                break;
+            uint64_t take = std::min(length, needed - filled);
+            std::memcpy(scratch.data() + filled, file + offset, static_cast<size_t>(take));
+            filled += take;
+        }
+        if (!run(scratch.data(), 1))
+            return false;
+        if (embed) {
+            filled = 0;
+            for (const auto& [offset, length] : layout.regions) {
+                if (filled == needed)
+                    break;
+                uint64_t take = std::min(length, needed - filled);
+                std::memcpy(file + offset, scratch.data() + filled, static_cast<size_t>(take));
+                filled += take;
+            }
+        }
+        return true;
+    }
+
+    std::optional<std::string> RawHnS::embed(const std::vector<byte>& data, const std::string& path,
+                                             const std::string& out_path)
+    {
+        namespace fs = std::filesystem;
+
+        auto format = detect_format(path);
+        if (!format || !supports(*format)) {
+            std::cerr << CLI_RED << "RawHnS::embed(): Invalid path or unsupported format: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        this->embed_data = std::make_unique<EmbedData>();
+        this->embed_data->plain_data = data;
+        this->embed_data->meta.container = ContainerType::PHOTO;
+        std::string filename_str = fs::path(path).filename().string();
+        if (filename_str.size() >= 64) {
+            std::cerr << CLI_RED << "RawHnS::embed(): Filename too long (max 63 chars): " << filename_str << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::strncpy(this->embed_data->meta.filename, filename_str.c_str(), 63);
+        this->embed_data->meta.filename[63] = '\0';
+
+        // Key, encryption, ECC (sets write_size).
+        if (!this->seal_payload())
+            return std::nullopt;
+
+        // Output starts as a byte copy of the carrier; only sample LSBs change afterwards.
+        bool in_place = false;
+        try {
+            in_place = fs::exists(out_path) && fs::equivalent(path, out_path);
+            if (!in_place)
+                fs::copy_file(path, out_path, fs::copy_options::overwrite_existing);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << CLI_RED << "RawHnS::embed(): Failed to copy carrier: " << e.what() << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // Only a copy made here is removed: in place, out_path is the user's carrier.
+        auto fail = [&out_path, in_place](const std::string& message) -> std::optional<std::string> {
+            std::cerr << CLI_RED << message << CLI_RESET << std::endl;
+            std::error_code ignored;
+            if (!in_place)
+                fs::remove(out_path, ignored);
+            return std::nullopt;
+        };
+
+        auto mapped = MappedFile::open(out_path, true);
+        if (!mapped)
+            return fail("RawHnS::embed(): Failed to map " + out_path);
+        auto layout = parse(mapped->data(), mapped->size(), *format);
+        if (!layout)
+            return fail("RawHnS::embed(): Unsupported variant or truncated file: " + path);
+
+        MetaData& meta = this->embed_data->meta;
+        meta.ext = layout->ext;
+        uint64_t slots = layout->slots();
+        if (BitKernels::slots_needed(meta.write_size, LsbMode::OneBit) <= slots)
+            meta.lsb_mode = LsbMode::OneBit;
+        else if (BitKernels::slots_needed(meta.write_size, LsbMode::TwoBits) <= slots)
+            meta.lsb_mode = LsbMode::TwoBits;
+        else
+            return fail("Error: Data too large for image (" + std::to_string(meta.write_size) + " bytes, " +
+                        std::to_string(slots) + " sample bytes).");
+
+        std::vector<byte> stream(meta.write_size);
+        HnS::pack_meta(meta, stream.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  stream.begin() + META_STREAM_SIZE);
+        if (!this->process(mapped->data(), *layout, stream.data(), stream.size(), meta.lsb_mode, true))
+            return fail("RawHnS::embed(): Embedding failed");
+
+        std::cout << CLI_GREEN << "Embedded " << meta.write_size << " bytes into " << out_path
+                  << " (mode: " << static_cast<int>(meta.lsb_mode) << ")." << CLI_RESET << std::endl;
+        return out_path;
+    }
+
+    bool RawHnS::read_stream(const byte* file, const RasterLayout& layout, byte* out, uint64_t offset,
+                             uint64_t count, LsbMode mode) const
+    {
+        const uint64_t per_byte = mode == LsbMode::TwoBits ? 4 : 8;
+        const uint64_t first_slot = BitKernels::slots_needed(offset, mode);
+        const uint64_t slots = count * per_byte;
+        if (layout.regions.size() == 1) {
+            const byte* base = file + layout.regions[0].first + layout.slot_offset + first_slot * layout.stride;
+            return BitKernels::strided_extract(base, slots, layout.stride, out, count, mode,
+                                               this->options.kernel_mode);
+        }
+
+        // Padded BMP rows (stride 1): gather the slots of the range only.
+        std::vector<byte> scratch(static_cast<size_t>(slots));
+        uint64_t skip = first_slot, filled = 0;
+        for (const auto& [region, length] : layout.regions) {
+            if (filled == slots)
+                break;
+            if (skip >= length) {
+                skip -= length;
+                continue;
+            }
+            uint64_t take = std::min(length - skip, slots - filled);
+            std::memcpy(scratch.data() + filled, file + region + skip, static_cast<size_t>(take));
+            filled += take;
+            skip = 0;
+        }
+        return filled == slots &&
+               BitKernels::strided_extract(scratch.data(), slots, 1, out, count, mode, this->options.kernel_mode);
+    }
+
+    bool RawHnS::write_stream(byte* file, const RasterLayout& layout, const byte* data, uint64_t offset,
+                              uint64_t count, LsbMode mode) const
+    {
+        const uint64_t per_byte = mode == LsbMode::TwoBits ? 4 : 8;
+        const uint64_t first_slot = BitKernels::slots_needed(offset, mode);
+        const uint64_t slots = count * per_byte;
+        if (layout.regions.size() == 1) {
+            byte* base = file + layout.regions[0].first + layout.slot_offset + first_slot * layout.stride;
+            return BitKernels::strided_embed(base, slots, layout.stride, data, count, mode, this->options.kernel_mode);
+        }
+
+        // Padded BMP rows (stride 1): gather the slots of the range, embed, scatter them back.
+        std::vector<std::pair<byte*, uint64_t>> runs;
+        uint64_t skip = first_slot, filled = 0;
+        for (const auto& [region, length] : layout.regions) {
+            if (filled == slots)
+                break;
+            if (skip >= length) {
+                skip -= length;
+                continue;
+            }
+            uint64_t take = std::min(length - skip, slots - filled);
+            runs.emplace_back(file + region + skip, take);
+            filled += take;
+            skip = 0;
+        }
+        if (filled != slots)
+            return false;
+        std::vector<byte> scratch(static_cast<size_t>(slots));
+        filled = 0;
+        for (const auto& [at, take] : runs) {
+            std::memcpy(scratch.data() + filled, at, static_cast<size_t>(take));
+            filled += take;
+        }
+        if (!BitKernels::strided_embed(scratch.data(), slots, 1, data, count, mode, this->options.kernel_mode))
+            return false;
+        filled = 0;
+        for (const auto& [at, take] : runs) {
+            std::memcpy(at, scratch.data() + filled, static_cast<size_t>(take));
+            filled += take;
+        }
+        return true;
+    }
+
+    bool RawHnS::read_meta(byte* file, const RasterLayout& layout, const std::string& path)
+    {
+        uint64_t slots = layout.slots();
+        if (slots < META_STREAM_SIZE * 8ULL) {
+            std::cerr << CLI_RED << "Error: Image too small for metadata: " << path << CLI_RESET << std::endl;
+            return false;
+        }
+        std::vector<byte> stream(META_STREAM_SIZE);
+        this->process(file, layout, stream.data(), stream.size(), LsbMode::OneBit, false);
+        MetaData& meta = this->embed_data->meta;
+        if (!HnS::unpack_meta(stream.data(), meta) || meta.container != ContainerType::PHOTO || meta.ext != layout.ext ||
+            meta.write_size < META_STREAM_SIZE ||
+            (meta.lsb_mode != LsbMode::OneBit && meta.lsb_mode != LsbMode::TwoBits) ||
+            BitKernels::slots_needed(meta.write_size, meta.lsb_mode) > slots) {
+            std::cerr << CLI_RED << "Error: No valid metadata in image: " << path << CLI_RESET << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<std::vector<byte>> RawHnS::extract(const std::string& path)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        auto mapped = MappedFile::open(path, false);
+        auto format = mapped ? sniff_format(mapped->data(), std::min<uint64_t>(mapped->size(), SNIFF_BYTES))
+                             : std::nullopt;
+        auto layout = format ? parse(mapped->data(), mapped->size(), *format) : std::nullopt;
+        if (!layout) {
+            std::cerr << CLI_RED << "Error: Unsupported raw image: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // Extraction only reads through the pointer (mapping is read-only).
+        byte* file = const_cast<byte*>(static_cast<const MappedFile&>(*mapped).data());
+        if (!this->read_meta(file, *layout, path))
+            return std::nullopt;
+
+        const MetaData& meta = this->embed_data->meta;
+        std::vector<byte> stream(meta.write_size);
+        if (!this->process(file, *layout, stream.data(), stream.size(), meta.lsb_mode, false)) {
+            std::cerr << CLI_RED << "Error: Incomplete extraction from image: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        this->embed_data->coded_data.assign(stream.begin() + META_STREAM_SIZE, stream.end());
+        if (!this->decode_payload())
+            return std::nullopt;
+
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from raw image." << CLI_RESET << std::endl;
+        return this->embed_data->plain_data;
+    }
+
+    std::optional<std::vector<byte>> RawHnS::extract_query(const std::string& path, const PlainQuery& query)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        auto mapped = MappedFile::open(path, false);
+        auto format = mapped ? sniff_format(mapped->data(), std::min<uint64_t>(mapped->size(), SNIFF_BYTES))
+                             : std::nullopt;
+        auto layout = format ? parse(mapped->data(), mapped->size(), *format) : std::nullopt;
+        if (!layout) {
+            std::cerr << CLI_RED << "Error: Unsupported raw image: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        byte* file = const_cast<byte*>(static_cast<const MappedFile&>(*mapped).data());
+        if (!this->read_meta(file, *layout, path))
+            return std::nullopt;
+
+        // Bounds: read_meta checked that the whole stream fits the slots.
+        const LsbMode mode = this->embed_data->meta.lsb_mode;
+        StreamReader read = [&](uint64_t at, uint64_t size) -> std::optional<std::vector<byte>> {
+            std::vector<byte> bytes(static_cast<size_t>(size));
+            if (!this->read_stream(file, *layout, bytes.data(), META_STREAM_SIZE + at, size, mode))
+                return std::nullopt;
+            return bytes;
+        };
+        auto plain = this->open_plain(read);
+        if (!plain)
+            return std::nullopt;
+        auto result = query(*plain);
+        if (result)
+            std::cout << CLI_GREEN << "Extracted " << result->size() << " bytes from raw image." << CLI_RESET << std::endl;
+        return result;
+    }
+
+    std::optional<std::string> RawHnS::update(const std::string& path, uint64_t offset, const std::vector<byte>& data,
+                                              const std::string& out_path)
+    {
+        namespace fs = std::filesystem;
+
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        // Output starts as a byte copy of the stego file (nothing to copy when updating in place).
+        bool in_place = false;
+        try {
+            in_place = fs::exists(out_path) && fs::equivalent(path, out_path);
+            if (!in_place)
+                fs::copy_file(path, out_path, fs::copy_options::overwrite_existing);
+        } catch (const fs::filesystem_error& e) {
+            std::cerr << CLI_RED << "RawHnS::update(): Failed to copy file: " << e.what() << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        auto fail = [&out_path, in_place]() -> std::optional<std::string> {
+            std::error_code ignored;
+            if (!in_place)
+                fs::remove(out_path, ignored);
+            return std::nullopt;
+        };
+
+        auto mapped = MappedFile::open(out_path, true);
+        auto format = mapped ? sniff_format(mapped->data(), std::min<uint64_t>(mapped->size(), SNIFF_BYTES))
+                             : std::nullopt;
+        auto layout = format ? parse(mapped->data(), mapped->size(), *format) : std::nullopt;
+        if (!layout) {
+            std::cerr << CLI_RED << "Error: Unsupported raw image: " << path << CLI_RESET << std::endl;
+            return fail();
+        }
+        byte* file = mapped->data();
+        if (!this->read_meta(file, *layout, path))
+            return fail();
+
+        // Bounds: read_meta checked that the whole stream fits the slots.
+        const LsbMode mode = this->embed_data->meta.lsb_mode;
+        StreamReader read = [&](uint64_t at, uint64_t size) -> std::optional<std::vector<byte>> {
+            std::vector<byte> bytes(static_cast<size_t>(size));
+            if (!this->read_stream(file, *layout, bytes.data(), META_STREAM_SIZE + at, size, mode))
+                return std::nullopt;
+            return bytes;
+        };
+        StreamWriter write = [&](uint64_t at, const std::vector<byte>& bytes) {
+            return this->write_stream(file, *layout, bytes.data(), META_STREAM_SIZE + at, bytes.size(), mode);
+        };
+        if (!this->patch_plain(read, write, offset, data))
+            return fail();
+
+        std::cout << CLI_GREEN << "Updated " << data.size() << " bytes at offset " << offset << " in " << out_path
+                  << "." << CLI_RESET << std::endl;
+        return out_path;
+    }
+
+    void RawHnS::inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const
+    {
+        auto layout = parse(file, size, format);
+        if (!layout) {
+            report.error = "unsupported variant";
+            return;
+        }
+        report.width = layout->width;
+        report.height = layout->height;
+        report.channels = layout->channels;
+        report.bits_per_sample = layout->bits_per_sample;
+
+        const uint64_t slots = layout->slots();
+        report.capacity[0] = Probe::payload_capacity(BitKernels::max_stream(slots, LsbMode::OneBit));
+        report.capacity[1] = Probe::payload_capacity(BitKernels::max_stream(slots, LsbMode::TwoBits));
+        if (slots < META_STREAM_SIZE * 8ULL)
+            return;
+        std::vector<byte> stream(META_STREAM_SIZE);
+        // Extraction only reads the carrier.
+        byte* carrier = const_cast<byte*>(file);
+        if (this->process(carrier, *layout, stream.data(), stream.size(), LsbMode::OneBit, false))
+            report.has_payload = Probe::plausible_meta(stream, format);
+    }
+} // Yps
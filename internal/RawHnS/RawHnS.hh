@@ -0,0 +1,160 @@
+#ifndef YPSHNS_RAWHNS_HH
+#define YPSHNS_RAWHNS_HH
+
+#include <memory>
+#include <HnS.hh>
+#include <EmbedData.hh>
+#include <Encryption.hh>
+
+namespace Yps
+{
+    /**
+     * Uncompressed bitmaps (binary PPM/PGM, BMP 24/32-bit, TGA uncompressed 8/24/32-bit):
+     * no codec, the output file is a copy of the input that is mmap'ed and modified in place.
+     * Pixel layout as in PhotoHnS::png_in (meta 1-bit, payload 1 or 2 bits per sample byte).
+     * Padded BMP rows and 16-bit PPM/PGM samples (big-endian, LSB in the second byte) are handled.
+     */
+    class RawHnS : public HnS
+    {
+    private:
+        /**
+         * Where sample bytes live inside the file
+         */
+        struct RasterLayout
+        {
+            Extension ext{};
+
+            /**
+             * [offset, length) runs of sample bytes in stream order (one per BMP row if rows are padded)
+             */
+            std::vector<std::pair<uint64_t, uint64_t>> regions;
+
+            /**
+             * Slot every stride bytes, slot_offset bytes into a sample (16-bit PNM: stride 2, offset 1)
+             */
+            size_t stride{1};
+            size_t slot_offset{0};
+
+            /**
+             * Geometry for Probe (channels = samples per pixel)
+             */
+            uint32_t width{};
+            uint32_t height{};
+            uint32_t channels{};
+            uint32_t bits_per_sample{8};
+
+            [[nodiscard]] uint64_t slots() const;
+        };
+
+        static std::optional<RasterLayout> parse_pnm(const byte* file, uint64_t size);
+        static std::optional<RasterLayout> parse_bmp(const byte* file, uint64_t size);
+        static std::optional<RasterLayout> parse_tga(const byte* file, uint64_t size);
+
+        /**
+         * Parse layout of a sniffed format.
+         * @return layout or std::nullopt (unsupported variant, truncated)
+         */
+        static std::optional<RasterLayout> parse(const byte* file, uint64_t size, Extension format);
+
+        /**
+         * Embed or extract stream (meta + payload) in place.
+         * @param file Mapped file
+         * @param layout Sample layout
+         * @param stream Source (embed) or destination (extract)
+         * @param stream_bytes Stream size
+         * @param mode Payload mode (meta always 1-bit)
+         * @param embed Direction
+         * @return false, if kernel failed
+         */
+        bool process(byte* file, const RasterLayout& layout, byte* stream, uint64_t stream_bytes,
+                     LsbMode mode, bool embed) const;
+
+        /**
+         * Extract payload bytes [offset, offset + count) of the stream (offset >= META_STREAM_SIZE):
+         * only the sample bytes holding them are touched.
+         * @param file Mapped file
+         * @param layout Sample layout
+         * @param out Destination
+         * @param mode Payload mode
+         * @return false, if kernel failed
+         */
+        bool read_stream(const byte* file, const RasterLayout& layout, byte* out, uint64_t offset, uint64_t count,
+                         LsbMode mode) const;
+
+        /**
+         * Embed payload bytes [offset, offset + count) of the stream (offset >= META_STREAM_SIZE):
+         * only the sample bytes holding them are touched.
+         * @param file Mapped file
+         * @param layout Sample layout
+         * @param data Source
+         * @param mode Payload mode
+         * @return false, if kernel failed
+         */
+        bool write_stream(byte* file, const RasterLayout& layout, const byte* data, uint64_t offset, uint64_t count,
+                          LsbMode mode) const;
+
+        /**
+         * Read and validate metadata into embed_data->meta.
+         * @param file Mapped file
+         * @param layout Sample layout
+         * @param path For logs
+         * @return false, if no valid metadata
+         */
+        bool read_meta(byte* file, const RasterLayout& layout, const std::string& path);
+
+    public:
+        ~RawHnS() = default;
+        RawHnS() = default;
+
+        /**
+         * @return true, if format (see HnS::sniff_format) is handled by RawHnS
+         */
+        static bool supports(Extension format);
+
+        /**
+         * Embed data into raw bitmap (copy + in-place mmap)
+         * @param data Data to hide
+         * @param path Input .ppm/.pgm/.bmp/.tga
+         * @param out_path Output file (same format)
+         * @return out_path or std::nullopt
+         */
+        std::optional<std::string> embed(const std::vector<byte>& data, const std::string& path,
+                                         const std::string& out_path) override;
+
+        /**
+         * Extract data from raw bitmap (read-only mapping)
+         * @param path File with embedded data
+         * @return plain_data or std::nullopt
+         */
+        std::optional<std::vector<byte>> extract(const std::string& path) override;
+
+        /**
+         * Answer a query over the hidden data: with chunked payload (and no ECC) only the mapped pages
+         * holding the seek-table entries and chunks it reads are touched
+         * @param path File with embedded data
+         * @param query Ranged reads of the data (see HnS::extract_query)
+         * @return query result or std::nullopt
+         */
+        std::optional<std::vector<byte>> extract_query(const std::string& path, const PlainQuery& query) override;
+
+        /**
+         * Update part of the hidden data (HnS::update): out_path is a copy of path (or path itself) mapped
+         * writable, and only the sample bytes of the re-encrypted chunks are rewritten
+         * @param path File with embedded data
+         * @param offset First byte of plain data
+         * @param data New bytes
+         * @param out_path Output file (same format)
+         * @return out_path or std::nullopt
+         */
+        std::optional<std::string> update(const std::string& path, uint64_t offset, const std::vector<byte>& data,
+                                          const std::string& out_path) override;
+
+        /**
+         * Probe a raw bitmap: geometry from its header, capacity from its sample bytes, header check on the first
+         * META_STREAM_SIZE * 8 of them (HnS::inspect)
+         */
+        void inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const override;
+    };
+} // Yps
+
+#endif //YPSHNS_RAWHNS_HH
@@ -0,0 +1,125 @@
+#include "RecordArchive.hh"
+
+#include <cstring>   // For std::memcpy
+#include <unordered_set>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr byte MAGIC[4] = {'Y', 'P', 'S', 'R'};
+        constexpr uint64_t ENTRY_FIXED = 8 + 8 + 2;
+
+        void store_le(byte* out, uint64_t value, uint32_t bytes)
+        {
+            for (uint32_t i = 0; i < bytes; ++i)
+                out[i] = static_cast<byte>(value >> (8 * i));
+        }
+
+        uint64_t load_le(const byte* in, uint32_t bytes)
+        {
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < bytes; ++i)
+                value |= static_cast<uint64_t>(in[i]) << (8 * i);
+            return value;
+        }
+
+        std::optional<std::vector<byte>> read_exact(const RecordArchive::Reader& read, uint64_t offset, uint64_t length)
+        {
+            auto bytes = read(offset, length);
+            if (!bytes || bytes->size() != length)
+                return std::nullopt;
+            return bytes;
+        }
+    }
+
+    std::optional<std::vector<byte>> RecordArchive::pack(const std::vector<Record>& records)
+    {
+        if (records.size() > UINT32_MAX)
+            return std::nullopt;
+        std::unordered_set<std::string> names;
+        uint64_t index_size = 0, data_size = 0;
+        for (const Record& record : records) {
+            if (record.name.empty() || record.name.size() > MAX_NAME || !names.insert(record.name).second)
+                return std::nullopt;
+            index_size += ENTRY_FIXED + record.name.size();
+            data_size += record.data.size();
+        }
+        if (index_size > MAX_INDEX)
+            return std::nullopt;
+
+        std::vector<byte> out(static_cast<size_t>(HEADER_SIZE + index_size + data_size));
+        std::memcpy(out.data(), MAGIC, sizeof(MAGIC));
+        store_le(out.data() + 4, records.size(), 4);
+        store_le(out.data() + 8, index_size, 8);
+
+        byte* entry = out.data() + HEADER_SIZE;
+        uint64_t offset = HEADER_SIZE + index_size;
+        for (const Record& record : records) {
+            store_le(entry, offset, 8);
+            store_le(entry + 8, record.data.size(), 8);
+            store_le(entry + 16, record.name.size(), 2);
+            std::memcpy(entry + ENTRY_FIXED, record.name.data(), record.name.size());
+            entry += ENTRY_FIXED + record.name.size();
+            if (!record.data.empty())
+                std::memcpy(out.data() + offset, record.data.data(), record.data.size());
+            offset += record.data.size();
+        }
+        return out;
+    }
+
+    bool RecordArchive::is_archive(const byte* head, size_t size)
+    {
+        return size >= HEADER_SIZE && std::memcmp(head, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    std::optional<std::vector<RecordEntry>> RecordArchive::read_index(const Reader& read)
+    {
+        auto header = read_exact(read, 0, HEADER_SIZE);
+        if (!header || !is_archive(header->data(), header->size()))
+            return std::nullopt;
+        const uint64_t count = load_le(header->data() + 4, 4);
+        const uint64_t index_size = load_le(header->data() + 8, 8);
+        if (index_size > MAX_INDEX || count * ENTRY_FIXED > index_size)
+            return std::nullopt;
+
+        auto index = read_exact(read, HEADER_SIZE, index_size);
+        if (!index)
+            return std::nullopt;
+
+        // Entries come from the carrier: every one must lie inside the index, data after it.
+        std::vector<RecordEntry> entries;
+        entries.reserve(static_cast<size_t>(count));
+        uint64_t pos = 0;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (index_size - pos < ENTRY_FIXED)
+                return std::nullopt;
+            const byte* entry = index->data() + pos;
+            RecordEntry record;
+            record.offset = load_le(entry, 8);
+            record.size = load_le(entry + 8, 8);
+            const uint64_t name_size = load_le(entry + 16, 2);
+            pos += ENTRY_FIXED;
+            if (name_size == 0 || name_size > MAX_NAME || index_size - pos < name_size ||
+                record.offset < HEADER_SIZE + index_size || record.offset + record.size < record.offset)
+                return std::nullopt;
+            record.name.assign(reinterpret_cast<const char*>(index->data() + pos), static_cast<size_t>(name_size));
+            pos += name_size;
+            entries.push_back(std::move(record));
+        }
+        if (pos != index_size)
+            return std::nullopt;
+        return entries;
+    }
+
+    std::optional<std::vector<byte>> RecordArchive::read_record(const Reader& read, const std::string& name)
+    {
+        auto entries = read_index(read);
+        if (!entries)
+            return std::nullopt;
+        for (const RecordEntry& entry : *entries)
+            if (entry.name == name)
+                return read_exact(read, entry.offset, entry.size);
+        return std::nullopt;
+    }
+} // Yps
@@ -0,0 +1,90 @@
+#ifndef YPSHNS_RECORDARCHIVE_HH
+#define YPSHNS_RECORDARCHIVE_HH
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+
+namespace Yps
+{
+    /**
+     * Named file stored in a multi-record payload
+     */
+    struct Record
+    {
+        std::string name;
+        std::vector<byte> data;
+    };
+
+    /**
+     * Index entry: record bytes are [offset, offset + size) of the plain payload
+     */
+    struct RecordEntry
+    {
+        std::string name;
+        uint64_t offset{};
+        uint64_t size{};
+    };
+
+    /**
+     * Several named files in one plain payload, index first, so a record is found and read with
+     * three ranged reads (header, index, record):
+     *   header: "YPSR", uint32 record count, uint64 index size (little-endian);
+     *   index:  per record uint64 offset, uint64 size, uint16 name length, name bytes;
+     *   data:   records back to back.
+     * Combined with a chunked payload (EmbedOptions::chunk_size) only the chunks of the header,
+     * index and wanted record are read from the carrier and decrypted.
+     */
+    class RecordArchive
+    {
+    public:
+        /**
+         * Reads plain bytes [offset, offset + length) (clipped to the payload)
+         */
+        using Reader = std::function<std::optional<std::vector<byte>>(uint64_t offset, uint64_t length)>;
+
+        static constexpr uint64_t HEADER_SIZE = 16;
+        static constexpr size_t MAX_NAME = 1024;
+
+        /**
+         * Largest index accepted from a carrier
+         */
+        static constexpr uint64_t MAX_INDEX = 64ULL << 20;
+
+        /**
+         * Chunk size used by HnS::embed_records when options leave the payload unchunked
+         */
+        static constexpr uint32_t DEFAULT_CHUNK = 64 * 1024;
+
+        /**
+         * Serialize records into one payload (single allocation, records copied once).
+         * @param records Files (unique, non-empty names up to MAX_NAME bytes)
+         * @return payload or std::nullopt (invalid/duplicate names, index too large)
+         */
+        static std::optional<std::vector<byte>> pack(const std::vector<Record>& records);
+
+        /**
+         * @return true, if plain payload starts with an archive header
+         */
+        static bool is_archive(const byte* head, size_t size);
+
+        /**
+         * Read and validate the index.
+         * @param read Source of plain bytes
+         * @return entries or std::nullopt (not an archive, truncated or inconsistent index)
+         */
+        static std::optional<std::vector<RecordEntry>> read_index(const Reader& read);
+
+        /**
+         * Read one record by name (header, index, then the record's bytes only).
+         * @return record bytes or std::nullopt (no such record, read failed)
+         */
+        static std::optional<std::vector<byte>> read_record(const Reader& read, const std::string& name);
+    };
+} // Yps
+
+#endif //YPSHNS_RECORDARCHIVE_HH
@@ -0,0 +1,49 @@
+#include "Registry.hh"
+
+#include <AudioHnS/AudioHnS.hh>
+#include <PhotoHnS/PhotoHnS.hh>
+#include <VideoHnS/VideoHnS.hh>
+
+namespace Yps
+{
+    BackendRegistry::BackendRegistry()
+    {
+        // PhotoHnS forwards raw bitmaps and segment placement itself.
+        Factory photo = [] { return std::make_unique<PhotoHnS>(); };
+        for (Extension format : {Extension::PNG, Extension::JPEG, Extension::PPM, Extension::PGM,
+                                 Extension::BMP, Extension::TGA})
+            this->factories.emplace(format, photo);
+        this->factories.emplace(Extension::WAV, [] { return std::make_unique<AudioHnS>(); });
+        this->factories.emplace(Extension::Y4M, [] { return std::make_unique<VideoHnS>(); });
+    }
+
+    BackendRegistry& BackendRegistry::getInstance()
+    {
+        static BackendRegistry instance;
+        return instance;
+    }
+
+    void BackendRegistry::register_backend(Extension format, Factory factory)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->factories[format] = std::move(factory);
+    }
+
+    std::unique_ptr<HnS> BackendRegistry::create(Extension format) const
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->factories.find(format);
+        return it == this->factories.end() ? nullptr : it->second();
+    }
+
+    std::optional<BackendRegistry::Match> BackendRegistry::open(const std::string& path) const
+    {
+        auto format = HnS::detect_format(path);
+        if (!format)
+            return std::nullopt;
+        auto backend = this->create(*format);
+        if (!backend)
+            return std::nullopt;
+        return Match{*format, std::move(backend)};
+    }
+} // Yps
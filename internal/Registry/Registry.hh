@@ -0,0 +1,69 @@
+#ifndef YPSHNS_REGISTRY_HH
+#define YPSHNS_REGISTRY_HH
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <HnS.hh>
+#include <EmbedData.hh>
+
+namespace Yps
+{
+    /**
+     * Format -> backend factory. Callers sniff the file once (HnS::detect_format)
+     * and get the backend that parses it, instead of dispatching on the extension.
+     * Defaults: PNG/JPEG/PPM/PGM/BMP/TGA - PhotoHnS, WAV - AudioHnS, Y4M - VideoHnS.
+     */
+    class BackendRegistry
+    {
+    public:
+        using Factory = std::function<std::unique_ptr<HnS>()>;
+
+        /**
+         * Sniffed file with its backend
+         */
+        struct Match
+        {
+            Extension format;
+            std::unique_ptr<HnS> backend;
+        };
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map<Extension, Factory> factories;
+
+        BackendRegistry();
+
+    public:
+        BackendRegistry(const BackendRegistry&) = delete;
+        BackendRegistry& operator=(const BackendRegistry&) = delete;
+
+        static BackendRegistry& getInstance();
+
+        /**
+         * Register (or replace) backend of a format
+         * @param format Sniffed format
+         * @param factory Creates a fresh backend
+         */
+        void register_backend(Extension format, Factory factory);
+
+        /**
+         * @param format Sniffed format
+         * @return new backend or nullptr (no backend registered)
+         */
+        [[nodiscard]] std::unique_ptr<HnS> create(Extension format) const;
+
+        /**
+         * Sniff file and create its backend
+         * @param path Path to carrier
+         * @return format + backend or std::nullopt (missing file, unknown format)
+         */
+        [[nodiscard]] std::optional<Match> open(const std::string& path) const;
+    };
+} // Yps
+
+#endif //YPSHNS_REGISTRY_HH
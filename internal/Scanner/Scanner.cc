@@ -0,0 +1,388 @@
+#include "Scanner.hh"
+
+#include <HnS.hh>
+#include <BitKernels/BitKernels.hh>
+#include <ImageAnalysis/ImageAnalysis.hh>
+#include <JpegCoefImage/JpegCoefImage.hh>
+#include <Parallel/Parallel.hh>
+#include <Probe/Probe.hh>
+#include <SegmentHnS/SegmentHnS.hh>
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t MIN_ROWS = 16;
+        constexpr size_t MIN_BLOCKS = 4 * 1024;
+        constexpr uint64_t MIN_PAIR = 10;        // Pairs with fewer samples are skipped (chi-square needs e >= 5)
+        constexpr int32_t DCT_RANGE = 1024;      // AC coefficients in [-1024, 1023]
+
+        /**
+         * Regularized upper incomplete gamma Q(a, x): series below a + 1, continued fraction above.
+         */
+        double gamma_q(double a, double x)
+        {
+            if (x <= 0)
+                return 1.0;
+            const double log_prefix = -x + a * std::log(x) - std::lgamma(a);
+            if (x < a + 1) {
+                double ap = a, sum = 1.0 / a, term = sum;
+                for (int n = 0; n < 1000; ++n) {
+                    ap += 1;
+                    term *= x / ap;
+                    sum += term;
+                    if (std::fabs(term) < std::fabs(sum) * 1e-12)
+                        break;
+                }
+                return std::clamp(1.0 - sum * std::exp(log_prefix), 0.0, 1.0);
+            }
+            constexpr double tiny = 1e-300;
+            double b = x + 1 - a, c = 1 / tiny, d = 1 / b, h = d;
+            for (int i = 1; i < 1000; ++i) {
+                const double an = -i * (i - a);
+                b += 2;
+                d = an * d + b;
+                if (std::fabs(d) < tiny) d = tiny;
+                c = b + an / c;
+                if (std::fabs(c) < tiny) c = tiny;
+                d = 1 / d;
+                const double delta = d * c;
+                h *= delta;
+                if (std::fabs(delta - 1) < 1e-12)
+                    break;
+            }
+            return std::clamp(std::exp(log_prefix) * h, 0.0, 1.0);
+        }
+
+        /**
+         * Regular/singular group counts for mask M = [0 1 1 0] and -M, on the image and on the image
+         * with every LSB flipped.
+         */
+        struct RsCounts
+        {
+            uint64_t groups{};
+            int64_t regular[4]{};   // M, -M, M flipped, -M flipped
+            int64_t singular[4]{};
+
+            void add(const RsCounts& other)
+            {
+                this->groups += other.groups;
+                for (int i = 0; i < 4; ++i) {
+                    this->regular[i] += other.regular[i];
+                    this->singular[i] += other.singular[i];
+                }
+            }
+        };
+
+        inline int32_t smoothness(int32_t a0, int32_t a1, int32_t a2, int32_t a3)
+        {
+            return std::abs(a1 - a0) + std::abs(a2 - a1) + std::abs(a3 - a2);
+        }
+
+        inline int32_t flip_pos(int32_t x) { return x ^ 1; }               // 2k <-> 2k + 1
+        inline int32_t flip_neg(int32_t x) { return ((x + 1) ^ 1) - 1; }   // 2k <-> 2k - 1
+
+        /**
+         * RS counts over rows [row_begin, row_end): non-overlapping groups of 4 horizontal samples per colour channel.
+         */
+        template <typename Sample>
+        void rs_rows(const Sample* samples, uint32_t width, uint32_t channels, uint32_t colour, size_t row_begin,
+                     size_t row_end, RsCounts& counts)
+        {
+            for (size_t y = row_begin; y < row_end; ++y) {
+                const Sample* row = samples + y * width * channels;
+                for (uint32_t c = 0; c < colour; ++c) {
+                    for (uint32_t x = 0; x + 4 <= width; x += 4) {
+                        const int32_t a0 = row[x * channels + c], a1 = row[(x + 1) * channels + c];
+                        const int32_t a2 = row[(x + 2) * channels + c], a3 = row[(x + 3) * channels + c];
+                        const int32_t b0 = a0 ^ 1, b1 = a1 ^ 1, b2 = a2 ^ 1, b3 = a3 ^ 1;
+
+                        const int32_t f = smoothness(a0, a1, a2, a3);
+                        const int32_t fm = smoothness(a0, flip_pos(a1), flip_pos(a2), a3);
+                        const int32_t fn = smoothness(a0, flip_neg(a1), flip_neg(a2), a3);
+                        const int32_t g = smoothness(b0, b1, b2, b3);
+                        const int32_t gm = smoothness(b0, flip_pos(b1), flip_pos(b2), b3);
+                        const int32_t gn = smoothness(b0, flip_neg(b1), flip_neg(b2), b3);
+
+                        counts.regular[0] += fm > f;  counts.singular[0] += fm < f;
+                        counts.regular[1] += fn > f;  counts.singular[1] += fn < f;
+                        counts.regular[2] += gm > g;  counts.singular[2] += gm < g;
+                        counts.regular[3] += gn > g;  counts.singular[3] += gn < g;
+                    }
+                }
+                counts.groups += static_cast<uint64_t>(width / 4) * colour;
+            }
+        }
+
+        /**
+         * Embedding rate from RS counts: root of 2(d1 + d0)x^2 + (d-0 - d-1 - d1 - 3d0)x + d0 - d-0 = 0
+         * with the smaller magnitude, p = x / (x - 1/2).
+         */
+        double rs_estimate(const RsCounts& counts)
+        {
+            if (counts.groups == 0)
+                return 0.0;
+            const double n = static_cast<double>(counts.groups);
+            const double d0 = (counts.regular[0] - counts.singular[0]) / n;
+            const double dn0 = (counts.regular[1] - counts.singular[1]) / n;
+            const double d1 = (counts.regular[2] - counts.singular[2]) / n;
+            const double dn1 = (counts.regular[3] - counts.singular[3]) / n;
+
+            const double a = 2 * (d1 + d0), b = dn0 - dn1 - d1 - 3 * d0, c = d0 - dn0;
+            double x = 0;
+            if (std::fabs(a) < 1e-12) {
+                x = std::fabs(b) < 1e-12 ? 0 : -c / b;
+            } else {
+                const double root = std::sqrt(std::max(0.0, b * b - 4 * a * c));
+                const double x1 = (-b + root) / (2 * a), x2 = (-b - root) / (2 * a);
+                x = std::fabs(x1) < std::fabs(x2) ? x1 : x2;
+            }
+            const double p = x / (x - 0.5);
+            return std::isfinite(p) ? std::clamp(p, 0.0, 1.0) + 0.0 : 0.0;  // + 0.0: no -0
+        }
+
+        uint32_t usable_pairs(const std::vector<uint64_t>& histogram)
+        {
+            uint32_t pairs = 0;
+            for (size_t i = 0; i + 1 < histogram.size(); i += 2)
+                pairs += histogram[i] + histogram[i + 1] >= MIN_PAIR;
+            return pairs;
+        }
+
+        /**
+         * Cumulative chi-square over bands. Leading bands with fewer than 2 usable pairs (flat sky,
+         * black borders) are merged into the first measured prefix. chi_square is p of that prefix,
+         * chi_extent the fraction covered by the leading run with p > 0.5.
+         * @param band_histogram Adds histogram of band b to the cumulative histogram (complete on return)
+         */
+        template <typename Fn>
+        void cumulative_chi_square(uint32_t bands, std::vector<uint64_t>& histogram, ScanReport& report, Fn&& band_histogram)
+        {
+            bool measured = false, leading = true;
+            for (uint32_t b = 0; b < bands; ++b) {
+                band_histogram(b, histogram);  // Always: callers use the full histogram afterwards
+                if (!leading || (!measured && usable_pairs(histogram) < 2))
+                    continue;
+                const double p = Scanner::pov_p_value(histogram.data(), histogram.size());
+                if (!measured)
+                    report.chi_square = p;
+                measured = true;
+                leading = p > 0.5;
+                if (leading)
+                    report.chi_extent = static_cast<double>(b + 1) / bands;
+            }
+        }
+
+        void scan_pixels(const std::string& path, Extension format, ScanReport& report)
+        {
+            int32_t width = 0, height = 0, channels = 0;
+            const bool wide = stbi_is_16_bit(path.c_str()) != 0;
+            void* pixels = wide ? static_cast<void*>(stbi_load_16(path.c_str(), &width, &height, &channels, 0))
+                                : static_cast<void*>(stbi_load(path.c_str(), &width, &height, &channels, 0));
+            if (!pixels) {
+                report.error = "decode failed";
+                return;
+            }
+            auto free_image = [](void* p) noexcept { stbi_image_free(p); };
+            std::unique_ptr<void, decltype(free_image)> image_guard(pixels, free_image);
+
+            const uint32_t depth = wide ? 16 : 8;
+            const uint32_t colour = (channels == 2 || channels == 4) ? channels - 1 : channels;
+            const size_t row_bytes = static_cast<size_t>(width) * channels * (depth / 8);
+
+            // Chi-square on colour channels (low byte of 16-bit samples), bands of rows in raster order.
+            std::vector<uint64_t> histogram(256, 0);
+            const uint32_t bands = std::min<uint32_t>(Scanner::SEGMENTS, height);
+            cumulative_chi_square(bands, histogram, report, [&](uint32_t b, std::vector<uint64_t>& hist) {
+                const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(height) * b / bands);
+                const uint32_t last = static_cast<uint32_t>(static_cast<uint64_t>(height) * (b + 1) / bands);
+                const ImageStats stats = ImageAnalysis::analyze(static_cast<const byte*>(pixels) + first * row_bytes,
+                                                                width, last - first, channels, depth);
+                for (uint32_t c = 0; c < colour; ++c)
+                    for (size_t v = 0; v < 256; ++v)
+                        hist[v] += stats.histograms[c][v];
+            });
+
+            RsCounts counts;
+            std::mutex mutex;
+            Parallel::parallel_for(height, [&](size_t begin, size_t end) {
+                RsCounts local;
+                if (wide)
+                    rs_rows(static_cast<const uint16_t*>(pixels), width, channels, colour, begin, end, local);
+                else
+                    rs_rows(static_cast<const byte*>(pixels), width, channels, colour, begin, end, local);
+                std::lock_guard<std::mutex> lock(mutex);
+                counts.add(local);
+            }, MIN_ROWS);
+            report.rs = rs_estimate(counts);
+
+            if (format == Extension::PNG) {
+                const BitKernels::PixelFormat pixel_format{static_cast<uint32_t>(channels), depth, false};
+                const uint64_t samples = static_cast<uint64_t>(width) * height * channels;
+                report.own_payload = Probe::plausible_meta(BitKernels::image_extract(pixels, samples, pixel_format,
+                                                                                     META_STREAM_SIZE, LsbMode::OneBit,
+                                                                                     KernelMode::Fast),
+                                                           Extension::PNG);
+            }
+        }
+
+        /**
+         * Add histogram of AC coefficients of global blocks [first, last) (DCT order) to hist (offset DCT_RANGE).
+         */
+        void ac_histogram(const JpegCoefImage& image, uint64_t first, uint64_t last, std::vector<uint64_t>& hist)
+        {
+            std::mutex mutex;
+            uint64_t comp_first = 0;
+            for (const auto& comp : image.components) {
+                const uint64_t from = std::max(first, comp_first), to = std::min(last, comp_first + comp.block_count());
+                if (from < to) {
+                    const JCOEF* base = comp.coefs.data() + (from - comp_first) * DCTSIZE2;
+                    Parallel::parallel_for(static_cast<size_t>(to - from), [&](size_t begin, size_t end) {
+                        std::vector<uint64_t> local(2 * DCT_RANGE, 0);
+                        for (size_t b = begin; b < end; ++b) {
+                            const JCOEF* block = base + b * DCTSIZE2;
+                            for (int k = 1; k < DCTSIZE2; ++k)
+                                ++local[std::clamp<int32_t>(block[k], -DCT_RANGE, DCT_RANGE - 1) + DCT_RANGE];
+                        }
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for (size_t v = 0; v < local.size(); ++v)
+                            hist[v] += local[v];
+                    }, MIN_BLOCKS);
+                }
+                comp_first += comp.block_count();
+            }
+        }
+
+        void scan_jpeg(const std::string& path, ScanReport& report)
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::vector<byte> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            auto coefs = JpegCoefImage::decode(file);
+            if (!coefs) {
+                report.error = "decode failed";
+                return;
+            }
+
+            uint64_t blocks = 0;
+            for (const auto& comp : coefs->components)
+                blocks += comp.block_count();
+
+            // Chi-square on AC coefficients (pairs 2k, 2k + 1 in two's complement), bands in DCT order.
+            std::vector<uint64_t> histogram(2 * DCT_RANGE, 0);
+            const uint32_t bands = static_cast<uint32_t>(std::min<uint64_t>(Scanner::SEGMENTS, blocks));
+            cumulative_chi_square(bands, histogram, report, [&](uint32_t b, std::vector<uint64_t>& hist) {
+                ac_histogram(*coefs, blocks * b / bands, blocks * (b + 1) / bands, hist);
+            });
+
+            uint64_t difference = 0, total = 0;
+            for (int32_t k = 1; k <= 4; ++k) {
+                const uint64_t pos = histogram[DCT_RANGE + k], neg = histogram[DCT_RANGE - k];
+                difference += pos > neg ? pos - neg : neg - pos;
+                total += pos + neg;
+            }
+            report.dct = total ? static_cast<double>(difference) / static_cast<double>(total) : 0.0;
+
+            report.own_payload = Probe::plausible_meta(BitKernels::dct_extract(*coefs, META_STREAM_SIZE, KernelMode::Fast),
+                                                       Extension::JPEG);
+        }
+    }
+
+    double Scanner::pov_p_value(const uint64_t* histogram, size_t bins)
+    {
+        double chi = 0;
+        uint32_t pairs = 0;
+        for (size_t i = 0; i + 1 < bins; i += 2) {
+            const uint64_t sum = histogram[i] + histogram[i + 1];
+            if (sum < MIN_PAIR)
+                continue;
+            const double expected = static_cast<double>(sum) / 2;
+            const double diff = static_cast<double>(histogram[i]) - expected;
+            chi += diff * diff / expected;
+            ++pairs;
+        }
+        if (pairs < 2)
+            return 0.0;
+        return gamma_q((pairs - 1) / 2.0, chi / 2);
+    }
+
+    ScanReport Scanner::scan_file(const std::string& path)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        ScanReport report;
+        report.path = path;
+        report.format = HnS::detect_format(path);
+        if (!report.format) {
+            report.error = "unknown format";
+        } else if (*report.format == Extension::JPEG) {
+            scan_jpeg(path, report);
+        } else if (*report.format == Extension::PNG || *report.format == Extension::PPM ||
+                   *report.format == Extension::PGM || *report.format == Extension::BMP ||
+                   *report.format == Extension::TGA) {
+            scan_pixels(path, *report.format, report);
+        } else {
+            report.error = "not an image";
+        }
+
+        if (report.error.empty()) {
+            report.own_segments = SegmentHnS::supports(*report.format) && SegmentHnS::has_segments(path);
+            report.score = std::max({report.chi_square, report.rs, report.dct});
+            if (report.own_payload || report.own_segments)
+                report.score = 1.0;
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return report;
+    }
+
+    std::vector<ScanReport> Scanner::scan(const std::vector<std::string>& paths, bool recursive)
+    {
+        namespace fs = std::filesystem;
+        std::vector<std::string> files;
+        for (const auto& path : paths) {
+            std::error_code ec;
+            if (!fs::is_directory(path, ec)) {
+                files.push_back(path);
+                continue;
+            }
+            std::vector<std::string> found;
+            auto collect = [&](auto iterator) {
+                for (const auto& entry : iterator)
+                    if (entry.is_regular_file(ec))
+                        found.push_back(entry.path().string());
+            };
+            if (recursive)
+                collect(fs::recursive_directory_iterator(path, fs::directory_options::skip_permission_denied, ec));
+            else
+                collect(fs::directory_iterator(path, fs::directory_options::skip_permission_denied, ec));
+            std::sort(found.begin(), found.end());
+            files.insert(files.end(), found.begin(), found.end());
+        }
+
+        // One task per file; on a worker of the shared pool run inline (waiting on the same pool could deadlock).
+        std::vector<ScanReport> reports;
+        reports.reserve(files.size());
+        if (ThreadPool::shared().in_worker()) {
+            for (const auto& file : files)
+                reports.push_back(scan_file(file));
+            return reports;
+        }
+        std::vector<std::future<ScanReport>> pending;
+        pending.reserve(files.size());
+        for (const auto& file : files)
+            pending.push_back(ThreadPool::shared().submit([file]() { return scan_file(file); }));
+        for (auto& result : pending)
+            reports.push_back(result.get());
+        return reports;
+    }
+} // Yps
@@ -0,0 +1,110 @@
+#ifndef YPSHNS_SCANNER_HH
+#define YPSHNS_SCANNER_HH
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <defines.hh>
+#include <EmbedData.hh>
+
+namespace Yps
+{
+    /**
+     * Suspicion scores of one carrier (every score in [0, 1], higher = more likely to carry a payload)
+     */
+    struct ScanReport
+    {
+        std::string path;
+        std::optional<Extension> format;
+
+        /**
+         * Pair-of-values chi-square p-value over the first 1/SEGMENTS of the carrier in embedding order
+         * (samples in raster order, AC coefficients in DCT order): near 1 when LSBs were replaced there.
+         */
+        double chi_square{};
+
+        /**
+         * Fraction of the carrier (from its start) over which the cumulative chi-square p stays above 0.5:
+         * estimated length of a sequential payload.
+         */
+        double chi_extent{};
+
+        /**
+         * RS analysis: estimated fraction of samples with replaced LSBs (images only)
+         */
+        double rs{};
+
+        /**
+         * AC histogram asymmetry sum|h(k) - h(-k)| / sum(h(k) + h(-k)), k = 1..4 (JPEG only):
+         * natural AC histograms are symmetric, LSB replacement pairs k with k^1 and breaks it.
+         */
+        double dct{};
+
+        /**
+         * YpsHnS metadata in the sample/coefficient LSBs (plaintext header, no key needed)
+         */
+        bool own_payload{false};
+
+        /**
+         * YpsHnS PNG chunks / JPEG APP15 segments (Placement::Segment)
+         */
+        bool own_segments{false};
+
+        /**
+         * Combined suspicion: max of the detectors, 1 for own payloads
+         */
+        double score{};
+
+        /**
+         * Non-empty if the file was not scanned (unreadable, not an image)
+         */
+        std::string error;
+
+        /**
+         * Decode + detectors time
+         */
+        double seconds{};
+    };
+
+    /**
+     * Statistical steganalysis of image libraries: chi-square attack (Westfeld-Pfitzmann),
+     * RS analysis (Fridrich-Goljan-Du) and DCT histogram checks, plus detection of YpsHnS's own
+     * headers. Histograms come from ImageAnalysis (one sweep per band); files are scanned in
+     * parallel on the shared ThreadPool.
+     */
+    class Scanner
+    {
+    public:
+        /**
+         * Cumulative chi-square steps (the carrier is split into this many bands)
+         */
+        static constexpr uint32_t SEGMENTS = 32;
+
+        /**
+         * Scan one file (format by magic bytes: PNG, JPEG, PPM/PGM, BMP, TGA).
+         * @param path File
+         * @return report (error set if not scanned)
+         */
+        static ScanReport scan_file(const std::string& path);
+
+        /**
+         * Scan files and directories in parallel (one task per file, results in input/walk order).
+         * @param paths Files or directories
+         * @param recursive Descend into subdirectories
+         * @return reports
+         */
+        static std::vector<ScanReport> scan(const std::vector<std::string>& paths, bool recursive);
+
+        /**
+         * Pair-of-values chi-square p-value: P(X > chi^2) for pairs (2k, 2k+1) with enough samples.
+         * @param histogram Counts, bins = even
+         * @param bins Number of bins
+         * @return p in [0, 1] (0 if fewer than 2 usable pairs)
+         */
+        static double pov_p_value(const uint64_t* histogram, size_t bins);
+    };
+} // Yps
+
+#endif //YPSHNS_SCANNER_HH
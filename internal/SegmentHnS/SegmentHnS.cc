@@ -0,0 +1,315 @@
+#include "SegmentHnS.hh"
+
+#include <MappedFile/MemoryBuf.hh>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr byte PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        constexpr std::array<uint32_t, 256> make_crc_table()
+        {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int32_t k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            return table;
+        }
+
+        constexpr std::array<uint32_t, 256> CRC_TABLE = make_crc_table();
+
+        /**
+         * PNG CRC-32, continued from crc (start with 0).
+         */
+        uint32_t crc32(uint32_t crc, const byte* data, uint64_t size)
+        {
+            crc = ~crc;
+            for (uint64_t i = 0; i < size; ++i)
+                crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        bool read_at(std::istream& in, uint64_t offset, void* out, uint64_t size)
+        {
+            in.clear();
+            in.seekg(static_cast<std::streamoff>(offset));
+            return static_cast<bool>(in.read(static_cast<char*>(out), static_cast<std::streamsize>(size)));
+        }
+
+        uint32_t be32(const byte* p)
+        {
+            return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+                   (static_cast<uint32_t>(p[2]) << 8) | p[3];
+        }
+
+        void put_be32(std::ostream& out, uint32_t value)
+        {
+            const char bytes[4] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                                   static_cast<char>(value >> 8), static_cast<char>(value)};
+            out.write(bytes, 4);
+        }
+    }
+
+    bool SegmentHnS::supports(Extension format)
+    {
+        return format == Extension::PNG || format == Extension::JPEG;
+    }
+
+    std::optional<SegmentHnS::SegmentMap> SegmentHnS::scan(std::istream& in, uint64_t size)
+    {
+        byte head[8];
+        if (size < sizeof(head) || !read_at(in, 0, head, sizeof(head)))
+            return std::nullopt;
+
+        SegmentMap map;
+        if (std::memcmp(head, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0) {
+            map.ext = Extension::PNG;
+            uint64_t pos = sizeof(PNG_SIGNATURE);
+            while (pos + 12 <= size) {
+                byte chunk[8];
+                if (!read_at(in, pos, chunk, sizeof(chunk)))
+                    return std::nullopt;
+                uint64_t length = be32(chunk);
+                uint64_t end = pos + 12 + length;
+                if (length > PNG_MAX_PIECE || end > size)
+                    return std::nullopt;
+                if (std::memcmp(chunk + 4, "IEND", 4) == 0) {
+                    map.insert_at = pos;
+                    return map;
+                }
+                if (std::memcmp(chunk + 4, PNG_TYPE, 4) == 0) {
+                    byte crc[4];
+                    if (!read_at(in, pos + 8 + length, crc, sizeof(crc)))
+                        return std::nullopt;
+                    map.pieces.push_back({pos, end, pos + 8, length, be32(crc)});
+                }
+                pos = end;
+            }
+            return std::nullopt;  // No IEND
+        }
+
+        if (head[0] != 0xFF || head[1] != 0xD8)
+            return std::nullopt;
+        map.ext = Extension::JPEG;
+        bool insert_found = false;
+        uint64_t pos = 2;
+        while (pos + 2 <= size) {
+            byte marker[2];
+            if (!read_at(in, pos, marker, sizeof(marker)) || marker[0] != 0xFF)
+                return std::nullopt;
+            if (marker[1] == 0xFF) {  // Fill byte
+                ++pos;
+                continue;
+            }
+            if (marker[1] == 0xDA || marker[1] == 0xD9) {  // SOS/EOI: no more APPn
+                if (!insert_found)
+                    map.insert_at = pos;
+                return map;
+            }
+            if (marker[1] == 0x01 || (marker[1] >= 0xD0 && marker[1] <= 0xD7)) {  // Standalone
+                pos += 2;
+                continue;
+            }
+
+            byte len[2];
+            if (pos + 4 > size || !read_at(in, pos + 2, len, sizeof(len)))
+                return std::nullopt;
+            uint64_t length = (static_cast<uint64_t>(len[0]) << 8) | len[1];
+            uint64_t end = pos + 2 + length;
+            if (length < 2 || end > size)
+                return std::nullopt;
+
+            bool is_app = marker[1] >= 0xE0 && marker[1] <= 0xEF;
+            if (!is_app && !insert_found) {
+                map.insert_at = pos;
+                insert_found = true;
+            }
+            if (marker[1] == 0xEF && length - 2 >= sizeof(JPEG_ID)) {
+                char id[sizeof(JPEG_ID)];
+                if (!read_at(in, pos + 4, id, sizeof(id)))
+                    return std::nullopt;
+                if (std::memcmp(id, JPEG_ID, sizeof(JPEG_ID)) == 0)
+                    map.pieces.push_back({pos, end, pos + 4 + sizeof(JPEG_ID), length - 2 - sizeof(JPEG_ID), 0});
+            }
+            pos = end;
+        }
+        return std::nullopt;  // No SOS
+    }
+
+    bool SegmentHnS::has_segments(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return false;
+        auto size = static_cast<uint64_t>(in.tellg());
+        auto map = scan(in, size);
+        return map && !map->pieces.empty();
+    }
+
+    bool SegmentHnS::has_segments(const byte* file, uint64_t size)
+    {
+        MemoryBuf buffer(file, size);
+        std::istream in(&buffer);
+        auto map = scan(in, size);
+        return map && !map->pieces.empty();
+    }
+
+    std::optional<std::string> SegmentHnS::embed(const std::vector<byte>& data, const std::string& path,
+                                                 const std::string& out_path)
+    {
+        this->embed_data = std::make_unique<EmbedData>();
+        this->embed_data->plain_data = data;
+        this->embed_data->meta.container = ContainerType::PHOTO;
+        std::string filename_str = std::filesystem::path(path).filename().string();
+        if (filename_str.size() >= 64) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Filename too long (max 63 chars): " << filename_str << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::strncpy(this->embed_data->meta.filename, filename_str.c_str(), 63);
+        this->embed_data->meta.filename[63] = '\0';
+
+        // Structure first: nothing is encrypted for a file we cannot splice.
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Failed to open " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        auto size = static_cast<uint64_t>(in.tellg());
+        auto map = scan(in, size);
+        if (!map) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Malformed PNG/JPEG structure: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::vector<byte> file(static_cast<size_t>(size));
+        if (!read_at(in, 0, file.data(), size)) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Failed to read " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        MetaData& meta = this->embed_data->meta;
+        meta.ext = map->ext;
+        meta.lsb_mode = LsbMode::NoUsed;  // Bytes are stored whole
+
+        // Key, encryption, ECC (sets write_size).
+        if (!this->seal_payload())
+            return std::nullopt;
+
+        std::vector<byte> stream(meta.write_size);
+        HnS::pack_meta(meta, stream.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  stream.begin() + META_STREAM_SIZE);
+
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Failed to create " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // Copy [first, last) of the input, leaving out segments of a previous embed.
+        auto copy_range = [&](uint64_t first, uint64_t last) {
+            for (const Piece& piece : map->pieces) {
+                if (piece.end <= first || piece.begin >= last)
+                    continue;
+                out.write(reinterpret_cast<const char*>(file.data() + first), static_cast<std::streamsize>(piece.begin - first));
+                first = piece.end;
+            }
+            out.write(reinterpret_cast<const char*>(file.data() + first), static_cast<std::streamsize>(last - first));
+        };
+
+        copy_range(0, map->insert_at);
+        uint64_t max_piece = map->ext == Extension::PNG ? PNG_MAX_PIECE : JPEG_MAX_PIECE;
+        for (uint64_t offset = 0; offset < stream.size(); offset += max_piece) {
+            uint64_t length = std::min<uint64_t>(max_piece, stream.size() - offset);
+            const byte* piece = stream.data() + offset;
+            if (map->ext == Extension::PNG) {
+                put_be32(out, static_cast<uint32_t>(length));
+                out.write(PNG_TYPE, sizeof(PNG_TYPE));
+                out.write(reinterpret_cast<const char*>(piece), static_cast<std::streamsize>(length));
+                uint32_t crc = crc32(0, reinterpret_cast<const byte*>(PNG_TYPE), sizeof(PNG_TYPE));
+                put_be32(out, crc32(crc, piece, length));
+            } else {
+                uint64_t segment_length = 2 + sizeof(JPEG_ID) + length;
+                const char header[4] = {static_cast<char>(0xFF), static_cast<char>(0xEF),
+                                        static_cast<char>(segment_length >> 8), static_cast<char>(segment_length)};
+                out.write(header, sizeof(header));
+                out.write(JPEG_ID, sizeof(JPEG_ID));
+                out.write(reinterpret_cast<const char*>(piece), static_cast<std::streamsize>(length));
+            }
+        }
+        copy_range(map->insert_at, size);
+
+        if (!out.flush()) {
+            std::cerr << CLI_RED << "SegmentHnS::embed(): Failed to write " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::cout << CLI_GREEN << "Embedded " << meta.write_size << " bytes into "
+                  << (map->ext == Extension::PNG ? "PNG chunks" : "JPEG APP15 segments") << " of " << out_path
+                  << "." << CLI_RESET << std::endl;
+        return out_path;
+    }
+
+    std::optional<std::vector<byte>> SegmentHnS::extract(const std::string& path)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cerr << CLI_RED << "Error: Invalid path for extraction: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        auto size = static_cast<uint64_t>(in.tellg());
+        auto map = scan(in, size);
+        if (!map || map->pieces.empty()) {
+            std::cerr << CLI_RED << "Error: No embedded segments in " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        // Pieces are bounded by the file size (checked in scan).
+        uint64_t total = 0;
+        for (const Piece& piece : map->pieces)
+            total += piece.length;
+        std::vector<byte> stream(static_cast<size_t>(total));
+        uint64_t filled = 0;
+        for (const Piece& piece : map->pieces) {
+            byte* dst = stream.data() + filled;
+            if (!read_at(in, piece.data, dst, piece.length)) {
+                std::cerr << CLI_RED << "Error: Truncated segment in " << path << CLI_RESET << std::endl;
+                return std::nullopt;
+            }
+            if (map->ext == Extension::PNG) {
+                uint32_t crc = crc32(0, reinterpret_cast<const byte*>(PNG_TYPE), sizeof(PNG_TYPE));
+                if (crc32(crc, dst, piece.length) != piece.crc) {
+                    std::cerr << CLI_RED << "Error: CRC mismatch in PNG chunk at offset " << piece.begin << CLI_RESET << std::endl;
+                    return std::nullopt;
+                }
+            }
+            filled += piece.length;
+        }
+
+        MetaData& meta = this->embed_data->meta;
+        if (stream.size() < META_STREAM_SIZE) {
+            std::cerr << CLI_RED << "Error: Segments too short for metadata: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        if (!HnS::unpack_meta(stream.data(), meta) || meta.container != ContainerType::PHOTO || meta.ext != map->ext || meta.write_size != stream.size()) {
+            std::cerr << CLI_RED << "Error: Invalid segment metadata in " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        this->embed_data->coded_data.assign(stream.begin() + META_STREAM_SIZE, stream.end());
+        if (!this->decode_payload())
+            return std::nullopt;
+
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from segments." << CLI_RESET << std::endl;
+        return this->embed_data->plain_data;
+    }
+} // Yps
@@ -0,0 +1,112 @@
+#ifndef YPSHNS_SEGMENTHNS_HH
+#define YPSHNS_SEGMENTHNS_HH
+
+#include <istream>
+#include <memory>
+#include <HnS.hh>
+#include <EmbedData.hh>
+#include <Encryption.hh>
+
+namespace Yps
+{
+    /**
+     * Metadata-segment placement for PNG/JPEG (Placement::Segment): the stream (MetaData + coded payload)
+     * is spliced into private container segments, pixels and DCT coefficients are never decoded.
+     * PNG  - ancillary, private, safe-to-copy "ypHs" chunks (CRC-32 checked) before IEND.
+     * JPEG - APP15 segments tagged "YpsHnS\0" after the leading APPn run (JFIF/Exif stay first).
+     * Streams longer than one segment are split; pieces are concatenated in file order.
+     * Not hidden from parsers: intended for provenance, not for steganographic secrecy.
+     */
+    class SegmentHnS : public HnS
+    {
+    private:
+        /**
+         * Chunk type of PNG segments
+         */
+        static constexpr char PNG_TYPE[4] = {'y', 'p', 'H', 's'};
+
+        /**
+         * Identifier at start of JPEG APP15 segments
+         */
+        static constexpr char JPEG_ID[7] = {'Y', 'p', 's', 'H', 'n', 'S', '\0'};
+
+        /**
+         * Max payload bytes per segment (PNG chunk length limit; JPEG 16-bit length minus length field and id)
+         */
+        static constexpr uint64_t PNG_MAX_PIECE = 0x7FFFFFFFULL;
+        static constexpr uint64_t JPEG_MAX_PIECE = 0xFFFFULL - 2 - sizeof(JPEG_ID);
+
+        /**
+         * One of our segments inside the file
+         */
+        struct Piece
+        {
+            uint64_t begin{};   // Whole segment [begin, end)
+            uint64_t end{};
+            uint64_t data{};    // Stream bytes [data, data + length)
+            uint64_t length{};
+            uint32_t crc{};     // PNG only: stored CRC-32 of type + data
+        };
+
+        /**
+         * Result of walking the chunk/marker list (no image data is read)
+         */
+        struct SegmentMap
+        {
+            Extension ext{};
+            uint64_t insert_at{};       // Where new segments go (PNG: IEND, JPEG: first non-APPn marker)
+            std::vector<Piece> pieces;  // Existing segments in file order
+        };
+
+        /**
+         * Walk PNG chunks or JPEG markers up to IEND/SOS, seeking over segment bodies.
+         * @param in Stream at any position
+         * @param size File size
+         * @return map or std::nullopt (not PNG/JPEG, malformed structure)
+         */
+        static std::optional<SegmentMap> scan(std::istream& in, uint64_t size);
+
+    public:
+        ~SegmentHnS() = default;
+        SegmentHnS() = default;
+
+        /**
+         * @return true, if format (see HnS::sniff_format) can carry segments
+         */
+        static bool supports(Extension format);
+
+        /**
+         * Cheap detection for extract(): only chunk/marker headers are read.
+         * @param path Path to PNG/JPEG
+         * @return true, if file holds at least one of our segments
+         */
+        static bool has_segments(const std::string& path);
+
+        /**
+         * Same as has_segments(path) for a file already in memory (or mapped).
+         * @param file Whole PNG/JPEG
+         * @param size File bytes
+         * @return true, if file holds at least one of our segments
+         */
+        static bool has_segments(const byte* file, uint64_t size);
+
+        /**
+         * Embed data as segments (existing segments of ours are replaced)
+         * @param data Data to hide
+         * @param path Input PNG/JPEG
+         * @param out_path Output file (byte copy of input plus segments)
+         * @return out_path or std::nullopt
+         */
+        std::optional<std::string> embed(const std::vector<byte>& data, const std::string& path,
+                                         const std::string& out_path) override;
+
+        /**
+         * Extract data from segments (reads only the segments)
+         * @param path File with segments
+         * @return plain_data or std::nullopt
+         */
+        std::optional<std::vector<byte>> extract(const std::string& path) override;
+    };
+} // Yps
+
+#endif //YPSHNS_SEGMENTHNS_HH
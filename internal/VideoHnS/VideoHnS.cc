@@ -0,0 +1,366 @@
+#include "VideoHnS.hh"
+
+#include <BitKernels/BitKernels.hh>
+#include <MappedFile/MemoryBuf.hh>
+#include <Parallel/Parallel.hh>
+#include <Probe/Probe.hh>
+
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace Yps
+{
+    namespace
+    {
+        constexpr size_t MAX_LINE = 4096;
+
+        std::optional<std::string> read_line(std::istream& in)
+        {
+            std::string line;
+            char c;
+            while (in.get(c)) {
+                line.push_back(c);
+                if (c == '\n')
+                    return line;
+                if (line.size() > MAX_LINE)
+                    return std::nullopt;
+            }
+            return std::nullopt;
+        }
+    }
+
+    std::optional<VideoHnS::Y4mLayout> VideoHnS::parse_header(std::istream& in)
+    {
+        auto line = read_line(in);
+        if (!line || line->rfind("YUV4MPEG2 ", 0) != 0)
+            return std::nullopt;
+
+        Y4mLayout layout;
+        layout.header_size = line->size();
+        layout.colorspace = "420jpeg";  // Default per spec
+        std::istringstream tokens(line->substr(10));
+        std::string token;
+        while (tokens >> token) {
+            switch (token[0]) {
+                case 'W': layout.width = static_cast<uint32_t>(std::strtoul(token.c_str() + 1, nullptr, 10)); break;
+                case 'H': layout.height = static_cast<uint32_t>(std::strtoul(token.c_str() + 1, nullptr, 10)); break;
+                case 'C': layout.colorspace = token.substr(1); break;
+                default: break;  // F, I, A, X: irrelevant for layout
+            }
+        }
+        if (layout.width == 0 || layout.height == 0)
+            return std::nullopt;
+
+        uint64_t luma = static_cast<uint64_t>(layout.width) * layout.height;
+        uint64_t half_w = (layout.width + 1) / 2;
+        uint64_t half_h = (layout.height + 1) / 2;
+        const std::string& cs = layout.colorspace;
+        if (cs == "420jpeg" || cs == "420paldv" || cs == "420mpeg2" || cs == "420")
+            layout.frame_size = luma + 2 * half_w * half_h;
+        else if (cs == "422")
+            layout.frame_size = luma + 2 * half_w * layout.height;
+        else if (cs == "444")
+            layout.frame_size = 3 * luma;
+        else if (cs == "444alpha")
+            layout.frame_size = 4 * luma;
+        else if (cs == "mono")
+            layout.frame_size = luma;
+        else
+            return std::nullopt;  // High bit depth (420p10, ...) not supported
+        return layout;
+    }
+
+    std::optional<std::string> VideoHnS::read_frame_header(std::istream& in)
+    {
+        auto line = read_line(in);
+        if (!line || line->rfind("FRAME", 0) != 0)
+            return std::nullopt;
+        return line;
+    }
+
+    std::optional<std::vector<uint64_t>> VideoHnS::index_frames(std::istream& in, const Y4mLayout& layout,
+                                                                uint64_t count)
+    {
+        // Count may come from an untrusted header: bound it by file size before reserving.
+        in.clear();
+        in.seekg(0, std::ios::end);
+        auto file_size = static_cast<uint64_t>(in.tellg());
+        if (file_size < layout.header_size || count > (file_size - layout.header_size) / layout.frame_size)
+            return std::nullopt;
+
+        std::vector<uint64_t> offsets;
+        offsets.reserve(static_cast<size_t>(count));
+        in.seekg(static_cast<std::streamoff>(layout.header_size), std::ios::beg);
+        uint64_t position = layout.header_size;
+        for (uint64_t f = 0; f < count; ++f) {
+            auto header = read_frame_header(in);
+            if (!header)
+                return std::nullopt;
+            position += header->size();
+            offsets.push_back(position);
+            position += layout.frame_size;
+            in.seekg(static_cast<std::streamoff>(position), std::ios::beg);
+        }
+        // Last frame must be complete.
+        if (file_size < position)
+            return std::nullopt;
+        return offsets;
+    }
+
+    uint64_t VideoHnS::batch_frames(const Y4mLayout& layout)
+    {
+        uint64_t by_threads = 2ULL * ThreadPool::shared().size();
+        uint64_t by_memory = std::max<uint64_t>(1, MAX_BATCH_BYTES / layout.frame_size);
+        return std::max<uint64_t>(1, std::min(by_threads, by_memory));
+    }
+
+    bool VideoHnS::run_parallel(std::vector<std::function<bool()>>& jobs)
+    {
+        // parallel_for claims frames on the calling thread too: safe from pool workers.
+        std::atomic<bool> ok{true};
+        Parallel::parallel_for(jobs.size(), [&jobs, &ok](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                if (!jobs[i]())
+                    ok = false;
+        });
+        return ok;
+    }
+
+    std::optional<std::string> VideoHnS::embed(const std::vector<byte>& data, const std::string& path,
+                                               const std::string& out_path)
+    {
+        this->embed_data = std::make_unique<EmbedData>();
+        this->embed_data->plain_data = data;
+        this->embed_data->meta.container = ContainerType::VIDEO;
+        this->embed_data->meta.ext = Extension::Y4M;
+        this->embed_data->meta.lsb_mode = LsbMode::OneBit;
+
+        // Content is checked by parse_header: the extension may be missing or wrong.
+        if (!validate_path(path)) {
+            std::cerr << CLI_RED << "VideoHnS::embed(): Invalid path: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        // The output is streamed while the carrier is still being read: truncating it would destroy the input.
+        std::error_code ec;
+        if (std::filesystem::exists(out_path, ec) && std::filesystem::equivalent(path, out_path, ec)) {
+            std::cerr << CLI_RED << "VideoHnS::embed(): Output is the input clip, write to another file: " << out_path
+                      << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::string filename_str = std::filesystem::path(path).filename().string();
+        if (filename_str.size() >= 64) {
+            std::cerr << CLI_RED << "VideoHnS::embed(): Filename too long (max 63 chars): " << filename_str << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        std::strncpy(this->embed_data->meta.filename, filename_str.c_str(), 63);
+        this->embed_data->meta.filename[63] = '\0';
+
+        // Key, encryption, ECC (sets write_size).
+        if (!this->seal_payload())
+            return std::nullopt;
+
+        std::ifstream in(path, std::ios::binary);
+        auto layout = in ? parse_header(in) : std::nullopt;
+        if (!layout || layout->bytes_per_frame() < META_STREAM_SIZE) {
+            std::cerr << CLI_RED << "VideoHnS::embed(): Not an 8-bit Y4M clip: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        const MetaData& meta = this->embed_data->meta;
+        const uint64_t per_frame = layout->bytes_per_frame();
+        const uint64_t frames_needed = (meta.write_size + per_frame - 1) / per_frame;
+        if (!index_frames(in, *layout, frames_needed)) {
+            std::cerr << CLI_RED << "Error: Data too large for clip (" << meta.write_size << " bytes, "
+                      << per_frame << " per frame, " << frames_needed << " frames needed)." << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        std::vector<byte> stream(meta.write_size);
+        HnS::pack_meta(meta, stream.data());
+        std::copy(this->embed_data->coded_data.begin(), this->embed_data->coded_data.end(),
+                  stream.begin() + META_STREAM_SIZE);
+
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << CLI_RED << "Error: Failed to open output clip: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        in.clear();
+        in.seekg(0, std::ios::beg);
+        std::string header(static_cast<size_t>(layout->header_size), '\0');
+        in.read(header.data(), static_cast<std::streamsize>(header.size()));
+        out << header;
+
+        const uint64_t batch = batch_frames(*layout);
+        std::vector<std::vector<byte>> frames(static_cast<size_t>(std::min(batch, frames_needed)),
+                                              std::vector<byte>(layout->frame_size));
+        std::vector<std::string> frame_headers(frames.size());
+        KernelMode kernel = this->options.kernel_mode;
+
+        for (uint64_t first = 0; first < frames_needed; first += batch) {
+            uint64_t count = std::min(batch, frames_needed - first);
+            std::vector<std::function<bool()>> jobs;
+            for (uint64_t i = 0; i < count; ++i) {
+                auto frame_header = read_frame_header(in);
+                if (!frame_header ||
+                    !in.read(reinterpret_cast<char*>(frames[i].data()), static_cast<std::streamsize>(layout->frame_size))) {
+                    std::cerr << CLI_RED << "Error: Truncated frame " << first + i << "." << CLI_RESET << std::endl;
+                    return std::nullopt;
+                }
+                frame_headers[i] = std::move(*frame_header);
+
+                uint64_t begin = (first + i) * per_frame;
+                uint64_t bytes = std::min(per_frame, stream.size() - begin);
+                byte* frame = frames[i].data();
+                const byte* src = stream.data() + begin;
+                uint64_t slots = layout->frame_size;
+                jobs.emplace_back([frame, src, bytes, slots, kernel] {
+                    return BitKernels::strided_embed(frame, slots, 1, src, bytes, LsbMode::OneBit, kernel);
+                });
+            }
+            if (!run_parallel(jobs))
+                return std::nullopt;
+            for (uint64_t i = 0; i < count; ++i) {
+                out << frame_headers[i];
+                out.write(reinterpret_cast<const char*>(frames[i].data()), static_cast<std::streamsize>(layout->frame_size));
+            }
+        }
+
+        // Frames after the stream are copied untouched.
+        std::vector<byte> copy_buffer(1 << 20);
+        while (in) {
+            in.read(reinterpret_cast<char*>(copy_buffer.data()), static_cast<std::streamsize>(copy_buffer.size()));
+            out.write(reinterpret_cast<const char*>(copy_buffer.data()), in.gcount());
+        }
+        if (!out) {
+            std::cerr << CLI_RED << "Error: Failed to write clip: " << out_path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        std::cout << CLI_GREEN << "Embedded " << meta.write_size << " bytes into " << frames_needed
+                  << " frames of " << out_path << "." << CLI_RESET << std::endl;
+        return out_path;
+    }
+
+    std::optional<std::vector<byte>> VideoHnS::read_stream(const std::string& path, uint64_t offset,
+                                                           uint64_t length) const
+    {
+        if (length == 0)
+            return std::vector<byte>{};
+
+        std::ifstream in(path, std::ios::binary);
+        auto layout = in ? parse_header(in) : std::nullopt;
+        if (!layout || layout->bytes_per_frame() == 0)
+            return std::nullopt;
+
+        const uint64_t per_frame = layout->bytes_per_frame();
+        const uint64_t end = offset + length;
+        const uint64_t first_frame = offset / per_frame;
+        const uint64_t last_frame = (end - 1) / per_frame;
+        auto offsets = index_frames(in, *layout, last_frame + 1);
+        if (!offsets)
+            return std::nullopt;
+
+        std::vector<byte> result(length);
+        const uint64_t batch = batch_frames(*layout);
+        std::vector<std::vector<byte>> slots(static_cast<size_t>(std::min(batch, last_frame - first_frame + 1)));
+        KernelMode kernel = this->options.kernel_mode;
+
+        in.clear();
+        for (uint64_t first = first_frame; first <= last_frame; first += batch) {
+            uint64_t count = std::min(batch, last_frame - first + 1);
+            std::vector<std::function<bool()>> jobs;
+            for (uint64_t i = 0; i < count; ++i) {
+                uint64_t frame = first + i;
+                // Only the carrier bytes of [offset, end) inside this frame are read.
+                uint64_t lo = std::max(offset, frame * per_frame) - frame * per_frame;
+                uint64_t hi = std::min(end, (frame + 1) * per_frame) - frame * per_frame;
+                std::vector<byte>& buffer = slots[i];
+                buffer.resize(static_cast<size_t>((hi - lo) * 8ULL));
+                in.seekg(static_cast<std::streamoff>((*offsets)[frame] + lo * 8ULL), std::ios::beg);
+                if (!in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size())))
+                    return std::nullopt;
+
+                byte* dst = result.data() + (frame * per_frame + lo - offset);
+                const byte* src = buffer.data();
+                uint64_t bytes = hi - lo;
+                jobs.emplace_back([src, dst, bytes, kernel] {
+                    return BitKernels::strided_extract(src, bytes * 8ULL, 1, dst, bytes, LsbMode::OneBit, kernel);
+                });
+            }
+            if (!run_parallel(jobs))
+                return std::nullopt;
+        }
+        return result;
+    }
+
+    std::optional<std::vector<byte>> VideoHnS::extract(const std::string& path)
+    {
+        if (!this->embed_data)
+            this->embed_data = std::make_unique<EmbedData>();
+
+        auto meta_bytes = this->read_stream(path, 0, META_STREAM_SIZE);
+        if (!meta_bytes) {
+            std::cerr << CLI_RED << "Error: Not an 8-bit Y4M clip: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        MetaData& meta = this->embed_data->meta;
+        if (!HnS::unpack_meta(meta_bytes->data(), meta) || meta.container != ContainerType::VIDEO || meta.ext != Extension::Y4M ||
+            meta.write_size < META_STREAM_SIZE || meta.lsb_mode != LsbMode::OneBit) {
+            std::cerr << CLI_RED << "Error: No valid metadata in clip: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+
+        auto coded = this->read_stream(path, META_STREAM_SIZE, meta.write_size - META_STREAM_SIZE);
+        if (!coded) {
+            std::cerr << CLI_RED << "Error: Incomplete extraction from clip: " << path << CLI_RESET << std::endl;
+            return std::nullopt;
+        }
+        this->embed_data->coded_data = std::move(*coded);
+        if (!this->decode_payload())
+            return std::nullopt;
+
+        std::cout << CLI_GREEN << "Extracted " << this->embed_data->plain_data.size() << " bytes from Y4M." << CLI_RESET << std::endl;
+        return this->embed_data->plain_data;
+    }
+
+    void VideoHnS::inspect(const byte* file, uint64_t size, Extension, ProbeReport& report) const
+    {
+        MemoryBuf buffer(file, size);
+        std::istream in(&buffer);
+        auto layout = parse_header(in);
+        if (!layout) {
+            report.error = "unsupported variant";
+            return;
+        }
+        report.width = layout->width;
+        report.height = layout->height;
+        report.bits_per_sample = 8;
+
+        // Complete frames only (headers are walked, data is skipped).
+        uint64_t frames = 0;
+        uint64_t first_frame = 0;
+        uint64_t position = layout->header_size;
+        while (auto header = read_frame_header(in)) {
+            position += header->size();
+            if (layout->frame_size > size - position)
+                break;
+            if (frames++ == 0)
+                first_frame = position;
+            position += layout->frame_size;
+            in.seekg(static_cast<std::streamoff>(position), std::ios::beg);
+        }
+
+        const uint64_t per_frame = layout->bytes_per_frame();
+        if (frames == 0 || per_frame < META_STREAM_SIZE)
+            return;
+        report.capacity[0] = Probe::payload_capacity(frames * per_frame);
+        std::vector<byte> stream(META_STREAM_SIZE);
+        if (BitKernels::strided_extract(file + first_frame, META_STREAM_SIZE * 8ULL, 1, stream.data(),
+                                        stream.size(), LsbMode::OneBit, KernelMode::Fast))
+            report.has_payload = Probe::plausible_meta(stream, Extension::Y4M);
+    }
+} // Yps
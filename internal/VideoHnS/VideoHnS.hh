@@ -0,0 +1,111 @@
+#ifndef YPSHNS_VIDEOHNS_HH
+#define YPSHNS_VIDEOHNS_HH
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <HnS.hh>
+#include <EmbedData.hh>
+#include <Encryption.hh>
+
+namespace Yps
+{
+    /**
+     * Uncompressed Y4M (YUV4MPEG2, 8-bit) container: 1 LSB per byte of planar frame data.
+     * Stream (meta + payload) is spread over frames in order: stream byte i lives in frame i / bytes_per_frame,
+     * so any byte range maps straight to its frames (read_stream seeks there without touching the rest).
+     * Frames are streamed in bounded batches; frames of a batch are processed in parallel on ThreadPool::shared().
+     */
+    class VideoHnS : public HnS
+    {
+    private:
+        struct Y4mLayout
+        {
+            uint32_t width{};
+            uint32_t height{};
+            std::string colorspace;
+            uint64_t header_size{};     // Stream header line incl. '\n'
+            uint64_t frame_size{};      // Planar bytes per frame
+
+            /**
+             * Stream bytes carried by one frame
+             */
+            [[nodiscard]] uint64_t bytes_per_frame() const { return frame_size / 8ULL; }
+        };
+
+        /**
+         * Upper bound for buffered frame data per batch
+         */
+        static constexpr uint64_t MAX_BATCH_BYTES = 256ULL * 1024 * 1024;
+
+        /**
+         * Parse "YUV4MPEG2 W.. H.. C.." line.
+         * @param in Stream at file start (left after header on success)
+         * @return layout or std::nullopt (not Y4M / unsupported colorspace)
+         */
+        static std::optional<Y4mLayout> parse_header(std::istream& in);
+
+        /**
+         * Read "FRAME[ params]\n" line.
+         * @return line incl. '\n' or std::nullopt
+         */
+        static std::optional<std::string> read_frame_header(std::istream& in);
+
+        /**
+         * Data offsets of first count frames (walks frame headers, skips data).
+         * @return offsets or std::nullopt (clip shorter than count frames)
+         */
+        static std::optional<std::vector<uint64_t>> index_frames(std::istream& in, const Y4mLayout& layout,
+                                                                 uint64_t count);
+
+        /**
+         * Frames buffered at once (2 per pool worker, bounded by MAX_BATCH_BYTES)
+         */
+        static uint64_t batch_frames(const Y4mLayout& layout);
+
+        /**
+         * Run frame jobs through Parallel::parallel_for (ThreadPool::shared() and the calling thread)
+         * @return false, if any job failed
+         */
+        static bool run_parallel(std::vector<std::function<bool()>>& jobs);
+
+    public:
+        ~VideoHnS() = default;
+        VideoHnS() = default;
+
+        /**
+         * Embed data into Y4M clip
+         * @param data Data to hide
+         * @param path Input .y4m
+         * @param out_path Output .y4m
+         * @return out_path or std::nullopt (invalid file/capacity)
+         */
+        std::optional<std::string> embed(const std::vector<byte>& data, const std::string& path,
+                                         const std::string& out_path) override;
+
+        /**
+         * Extract data from Y4M clip (reads only frames holding the stream)
+         * @param path Clip with embedded data
+         * @return plain_data or std::nullopt
+         */
+        std::optional<std::vector<byte>> extract(const std::string& path) override;
+
+        /**
+         * Probe a Y4M clip in memory or mapped: frame size, capacity over its complete frames and header check
+         * (HnS::inspect). 1-bit only.
+         */
+        void inspect(const byte* file, uint64_t size, Extension format, ProbeReport& report) const override;
+
+        /**
+         * Read raw embedded stream bytes [offset, offset + length) (meta at 0, then ECC-coded ciphertext).
+         * Only frames holding the range are read.
+         * @param path Clip with embedded data
+         * @param offset First stream byte
+         * @param length Number of bytes
+         * @return bytes or std::nullopt (out of range / I/O error)
+         */
+        std::optional<std::vector<byte>> read_stream(const std::string& path, uint64_t offset, uint64_t length) const;
+    };
+} // Yps
+
+#endif //YPSHNS_VIDEOHNS_HH